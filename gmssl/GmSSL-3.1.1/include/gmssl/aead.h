@@ -101,6 +101,12 @@ _gmssl_export int sm4_gcm_decrypt_update(SM4_GCM_CTX *ctx,
 _gmssl_export int sm4_gcm_decrypt_finish(SM4_GCM_CTX *ctx,
 	uint8_t *out, size_t *outlen);
 
+// same output as the _update functions, CTR and GHASH of the full blocks are done by the threads
+_gmssl_export int sm4_gcm_encrypt_update_threads(SM4_GCM_CTX *ctx,
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen, int threads);
+_gmssl_export int sm4_gcm_decrypt_update_threads(SM4_GCM_CTX *ctx,
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen, int threads);
+
 
 #ifdef __cplusplus
 }
@@ -290,6 +290,45 @@ int asn1_types_get_item_by_index(const uint8_t *d, size_t dlen, int tag,
 
 
 
+/*
+ASN1_BUILDER writes DER backwards from the end of a caller supplied arena.
+The content of a constructed type is added before its header, so the header
+length is known when it is written and every field is encoded only once.
+Fields are added in reverse order:
+
+	size_t mark = asn1_builder_mark(b);
+	asn1_builder_int(b, 2);
+	asn1_builder_int(b, 1);
+	asn1_builder_sequence_header(b, mark); // SEQUENCE { 1, 2 }
+*/
+typedef struct {
+	uint8_t *buf;
+	size_t size;
+	size_t len; // the output is the last len bytes of buf
+} ASN1_BUILDER;
+
+int asn1_builder_init(ASN1_BUILDER *b, uint8_t *buf, size_t size);
+#define asn1_builder_mark(b) ((b)->len)
+uint8_t *asn1_builder_reserve(ASN1_BUILDER *b, size_t len);
+const uint8_t *asn1_builder_get_data(const ASN1_BUILDER *b, size_t mark, size_t *len); // added since mark
+int asn1_builder_data(ASN1_BUILDER *b, const uint8_t *d, size_t dlen);
+int asn1_builder_header(ASN1_BUILDER *b, int tag, size_t mark); // header of the data added since mark
+int asn1_builder_type(ASN1_BUILDER *b, int tag, const uint8_t *d, size_t dlen);
+int asn1_builder_integer_ex(ASN1_BUILDER *b, int tag, const uint8_t *a, size_t alen);
+int asn1_builder_int_ex(ASN1_BUILDER *b, int tag, int a);
+int asn1_builder_bit_octets_ex(ASN1_BUILDER *b, int tag, const uint8_t *octs, size_t nocts);
+int asn1_builder_to_der(const ASN1_BUILDER *b, uint8_t **out, size_t *outlen);
+
+#define asn1_builder_sequence_header(b,mark) asn1_builder_header(b,ASN1_TAG_SEQUENCE,mark)
+#define asn1_builder_explicit_header(b,i,mark) asn1_builder_header(b,ASN1_TAG_EXPLICIT(i),mark)
+#define asn1_builder_sequence(b,d,dlen) asn1_builder_type(b,ASN1_TAG_SEQUENCE,d,dlen)
+#define asn1_builder_implicit_set(b,i,d,dlen) asn1_builder_type(b,ASN1_TAG_EXPLICIT(i),d,dlen)
+#define asn1_builder_integer(b,d,dlen) asn1_builder_integer_ex(b,ASN1_TAG_INTEGER,d,dlen)
+#define asn1_builder_int(b,val) asn1_builder_int_ex(b,ASN1_TAG_INTEGER,val)
+#define asn1_builder_bit_octets(b,d,dlen) asn1_builder_bit_octets_ex(b,ASN1_TAG_BIT_STRING,d,dlen)
+#define asn1_builder_implicit_bit_octets(b,i,d,dlen) asn1_builder_bit_octets_ex(b,ASN1_TAG_IMPLICIT(i),d,dlen)
+
+
 
 
 int asn1_check(int expr);
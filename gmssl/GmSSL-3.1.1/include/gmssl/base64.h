@@ -29,6 +29,7 @@ BASE64 Public API
 	base64_decode_init
 	base64_decode_update
 	base64_decode_finish
+	base64_decode
 
 */
 
@@ -65,6 +66,13 @@ int  base64_decode_finish(BASE64_CTX *ctx, uint8_t *out, int *outlen);
 int base64_encode_block(unsigned char *t, const unsigned char *f, int dlen);
 int base64_decode_block(unsigned char *t, const unsigned char *f, int n);
 
+/*
+	base64_decode() decodes a whole base64 text in one call. Line breaks and white spaces
+	are skipped, the text must end with a complete (maybe padded) block. The output
+	is at most inlen/4*3 bytes.
+*/
+int base64_decode(const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
+
 
 #ifdef __cplusplus
 }
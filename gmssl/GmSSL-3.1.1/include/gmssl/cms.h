@@ -23,6 +23,8 @@ References:
 #include <stdint.h>
 #include <sys/types.h>
 #include <gmssl/x509.h>
+#include <gmssl/sm3.h>
+#include <gmssl/sm4.h>
 
 
 #ifdef __cplusplus
@@ -538,6 +540,128 @@ int cms_set_key_agreement_info(
 	const uint8_t *user_cert, size_t user_cert_len,
 	const uint8_t *user_id, size_t user_id_len);
 
+/*
+Streaming API
+
+	Sign, verify, envelop and deenvelop content of any size with bounded memory, the content
+	is never held in memory as a whole.
+
+	cms_sign_init() / cms_sign_update() / cms_sign_finish()
+		SignedData with attached OID_cms_data content, same encoding as cms_sign().
+		The content length must be known in advance, the output is
+		header (from init) || content (written by the caller) || trailer (from finish).
+	cms_sign_detached_init() / cms_sign_update() / cms_sign_finish()
+		SignedData without content, the signature is over SM3(content) only.
+		The content length need not be known, the output is produced by finish.
+	cms_verify_init() / cms_verify_update() / cms_verify_finish()
+		Streaming input of a SignedData with attached OID_cms_data content, as produced by
+		cms_sign() or cms_sign_init(). The content is output while it is hashed.
+	cms_verify_detached_init() / cms_verify_detached_update() / cms_verify_finish()
+		Verify a detached SignedData (held in memory) over streamed content.
+	cms_envelop_init() / cms_envelop_update() / cms_envelop_finish()
+		EnvelopedData of OID_cms_data content with SM4-CBC. With a known content_len the
+		output is DER, same encoding as cms_envelop(). With CMS_CONTENT_LENGTH_UNKNOWN the
+		ContentInfo, EnvelopedData and EncryptedContentInfo use BER indefinite length and the
+		encryptedContent is a constructed OCTET STRING of one segment per update.
+	cms_deenvelop_init() / cms_deenvelop_update() / cms_deenvelop_finish()
+		Streaming input of both encodings of EnvelopedData above.
+
+	Buffer requirements:
+		sign init: CMS_STREAM_HEADER_SIZE, finish: call with out == NULL to get the length
+		verify update: inlen, out may be NULL if the content is not needed
+		envelop init: CMS_STREAM_BUF_SIZE, update: inlen + CMS_STREAM_UPDATE_OVERHEAD,
+			finish: CMS_STREAM_HEADER_SIZE + shared_info1_len + shared_info2_len
+		deenvelop update: inlen + SM4_BLOCK_SIZE, finish: SM4_BLOCK_SIZE
+
+	The headers and trailers of the encodings (recipientInfos, certificates, signerInfos)
+	are buffered and must not exceed CMS_STREAM_BUF_SIZE.
+*/
+#define CMS_STREAM_BUF_SIZE		8192
+#define CMS_STREAM_HEADER_SIZE		128
+#define CMS_STREAM_UPDATE_OVERHEAD	(SM4_BLOCK_SIZE + 6)
+#define CMS_CONTENT_LENGTH_UNKNOWN	((size_t)-1)
+
+typedef struct {
+	SM3_CTX sm3_ctx;
+	const CMS_CERTS_AND_KEY *signers;
+	size_t signers_cnt;
+	const uint8_t *crls;
+	size_t crls_len;
+	int detached;
+	size_t content_len;
+	size_t nbytes;
+} CMS_SIGN_CTX;
+
+int cms_sign_init(CMS_SIGN_CTX *ctx,
+	const CMS_CERTS_AND_KEY *signers, size_t signers_cnt,
+	const uint8_t *crls, size_t crls_len,
+	size_t content_len, uint8_t *out, size_t *outlen);
+int cms_sign_detached_init(CMS_SIGN_CTX *ctx,
+	const CMS_CERTS_AND_KEY *signers, size_t signers_cnt,
+	const uint8_t *crls, size_t crls_len);
+int cms_sign_update(CMS_SIGN_CTX *ctx, const uint8_t *data, size_t datalen);
+int cms_sign_finish(CMS_SIGN_CTX *ctx, uint8_t *out, size_t *outlen);
+
+typedef struct {
+	SM3_CTX sm3_ctx;
+	int state;
+	int detached;
+	uint8_t buf[CMS_STREAM_BUF_SIZE];
+	size_t buflen;
+	size_t content_left;
+	size_t trailer_len;
+	const uint8_t *certs;
+	size_t certs_len;
+	const uint8_t *signer_infos;
+	size_t signer_infos_len;
+} CMS_VERIFY_CTX;
+
+int cms_verify_init(CMS_VERIFY_CTX *ctx);
+int cms_verify_update(CMS_VERIFY_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
+int cms_verify_detached_init(CMS_VERIFY_CTX *ctx, const uint8_t *cms, size_t cmslen);
+int cms_verify_detached_update(CMS_VERIFY_CTX *ctx, const uint8_t *data, size_t datalen);
+int cms_verify_finish(CMS_VERIFY_CTX *ctx);
+
+typedef struct {
+	SM4_CBC_CTX sm4_ctx;
+	size_t content_len;
+	size_t nbytes;
+	const uint8_t *shared_info1;
+	size_t shared_info1_len;
+	const uint8_t *shared_info2;
+	size_t shared_info2_len;
+} CMS_ENVELOP_CTX;
+
+int cms_envelop_init(CMS_ENVELOP_CTX *ctx,
+	const uint8_t *rcpt_certs, size_t rcpt_certs_len,
+	int enc_algor, const uint8_t *key, size_t keylen, const uint8_t *iv, size_t ivlen,
+	size_t content_len,
+	const uint8_t *shared_info1, size_t shared_info1_len,
+	const uint8_t *shared_info2, size_t shared_info2_len,
+	uint8_t *out, size_t *outlen);
+int cms_envelop_update(CMS_ENVELOP_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
+int cms_envelop_finish(CMS_ENVELOP_CTX *ctx, uint8_t *out, size_t *outlen);
+
+typedef struct {
+	SM4_CBC_CTX sm4_ctx;
+	const SM2_KEY *rcpt_key;
+	const uint8_t *rcpt_issuer;
+	size_t rcpt_issuer_len;
+	const uint8_t *rcpt_serial;
+	size_t rcpt_serial_len;
+	int state;
+	int indefinite;
+	uint8_t buf[CMS_STREAM_BUF_SIZE];
+	size_t buflen;
+	size_t content_left;
+	size_t trailer_len;
+} CMS_DEENVELOP_CTX;
+
+int cms_deenvelop_init(CMS_DEENVELOP_CTX *ctx,
+	const SM2_KEY *rcpt_key, const uint8_t *rcpt_cert, size_t rcpt_cert_len);
+int cms_deenvelop_update(CMS_DEENVELOP_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
+int cms_deenvelop_finish(CMS_DEENVELOP_CTX *ctx, uint8_t *out, size_t *outlen);
+
 #define PEM_CMS "CMS"
 int cms_to_pem(const uint8_t *cms, size_t cms_len, FILE *fp);
 int cms_from_pem(uint8_t *cms, size_t *cms_len, size_t maxlen, FILE *fp);
@@ -22,6 +22,10 @@ extern "C" {
 int file_size(FILE *fp, size_t *size);
 int file_read_all(const char *file, uint8_t **out, size_t *outlen);
 
+// map a regular file read-only with sequential readahead, return 0 if it can only be read
+int file_map(FILE *fp, const uint8_t **data, size_t *datalen);
+void file_unmap(const uint8_t *data, size_t datalen);
+
 
 #ifdef __cplusplus
 }
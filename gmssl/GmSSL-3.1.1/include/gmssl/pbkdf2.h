@@ -30,6 +30,7 @@ PBKDF2 Public API
 	PBKDF2_MAX_SALT_SIZE
 
 	pbkdf2_hmac_sm3_genkey
+	pbkdf2_hmac_sm3_genkey_batch
 */
 
 
@@ -47,6 +48,14 @@ int pbkdf2_hmac_sm3_genkey(
 	const char *pass, size_t passlen, const uint8_t *salt, size_t saltlen, size_t iter,
 	size_t outlen, uint8_t *out);
 
+/*
+	Derive `count` keys with the same iteration count, the key of pass[k] is written to
+	out + k * outlen. The independent SM3 chains are computed in parallel lanes.
+*/
+int pbkdf2_hmac_sm3_genkey_batch(
+	const char *pass[], const size_t passlen[], const uint8_t *salt[], const size_t saltlen[],
+	size_t count, size_t iter, size_t outlen, uint8_t *out);
+
 
 #ifdef __cplusplus
 }
@@ -26,6 +26,37 @@ extern "C" {
 int pem_read(FILE *fp, const char *name, uint8_t *out, size_t *outlen, size_t maxlen);
 int pem_write(FILE *fp, const char *name, const uint8_t *in, size_t inlen);
 
+/*
+PEM streaming
+
+	pem_read_update() decodes whole lines into out, maxlen must be at least PEM_LINE_DECODE_SIZE.
+	It returns 1 (maybe with *outlen == 0) until the END line has been processed, then 0.
+*/
+#define PEM_LINE_DECODE_SIZE	64
+
+typedef struct {
+	BASE64_CTX base64_ctx;
+	FILE *fp;
+	const char *name;
+	int done;
+} PEM_CTX;
+
+int pem_write_init(PEM_CTX *ctx, FILE *fp, const char *name);
+int pem_write_update(PEM_CTX *ctx, const uint8_t *in, size_t inlen);
+int pem_write_finish(PEM_CTX *ctx);
+int pem_read_init(PEM_CTX *ctx, FILE *fp, const char *name);
+int pem_read_update(PEM_CTX *ctx, uint8_t *out, size_t *outlen, size_t maxlen);
+
+/*
+PEM file loader
+
+	pem_blocks_new_from_file() maps the file and decodes all the `name` blocks in one pass,
+	the DER of the blocks are concatenated into one allocated buffer in the file order.
+	Blocks of other names and text between the blocks are skipped.
+	It returns 0 if no `name` block is found.
+*/
+int pem_blocks_new_from_file(const char *file, const char *name, uint8_t **out, size_t *outlen);
+
 
 #ifdef __cplusplus
 }
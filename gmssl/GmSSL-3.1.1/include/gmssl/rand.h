@@ -20,6 +20,12 @@ extern "C" {
 #endif
 
 
+/*
+rand_bytes()
+	With getentropy() (src/rand_unix.c) the output is from a per-thread, fork-safe SM3
+	Hash_DRBG and buflen is not limited. Other platforms return at most RAND_BYTES_MAX_SIZE
+	bytes per call.
+*/
 #define RAND_BYTES_MAX_SIZE	(256)
 
 _gmssl_export int rand_bytes(uint8_t *buf, size_t buflen);
@@ -36,6 +36,19 @@ SDF Public API
 	SDF_KEY
 	sdf_sign
 	sdf_release_key
+
+	SDF_JOB_QUEUE
+	sdf_job_queue_new
+	sdf_job_queue_submit
+	sdf_job_queue_poll
+	sdf_job_queue_free
+
+	SDF_JOB
+	sdf_job_set_sign
+	sdf_job_set_verify
+	sdf_job_set_encrypt
+	sdf_job_poll
+	sdf_job_wait
 */
 
 typedef struct {
@@ -63,6 +76,65 @@ int sdf_close_device(SDF_DEVICE *dev);
 void sdf_unload_library(void);
 
 
+/*
+SDF Job Queue
+
+	The queue opens `sessions` sessions to the device, each with the access right of
+	the sign key, and one worker thread per session. The latency of a network HSM is
+	hidden by the parallel sessions, a worker takes up to SDF_JOB_BATCH_SIZE jobs at a
+	time so the lock and the wakeup are paid once per batch.
+
+	A job is owned by the queue from sdf_job_queue_submit() until it is done. A job with
+	a callback is done when the callback has been called by sdf_job_queue_poll() in the
+	thread of the caller, a job without a callback is done when sdf_job_poll() or
+	sdf_job_wait() returns 1. job->ret is 1 on success, 0 if a verified signature is
+	invalid and -1 on error.
+
+	Without threads (WIN32) the jobs are done in sdf_job_queue_submit().
+*/
+
+#define SDF_JOB_SIGN		1
+#define SDF_JOB_VERIFY		2
+#define SDF_JOB_ENCRYPT		3
+
+#define SDF_JOB_MAX_SESSIONS	64
+#define SDF_JOB_BATCH_SIZE	16
+
+typedef struct SDF_JOB_st SDF_JOB;
+typedef struct SDF_JOB_QUEUE_st SDF_JOB_QUEUE;
+
+typedef void (*SDF_JOB_CALLBACK)(SDF_JOB *job, void *arg);
+
+struct SDF_JOB_st {
+	int type;
+	uint8_t dgst[32]; // sign, verify
+	SM2_KEY public_key; // verify, encrypt
+	uint8_t in[SM2_MAX_PLAINTEXT_SIZE]; // DER signature to verify, or plaintext
+	size_t inlen;
+	uint8_t out[SM2_MAX_CIPHERTEXT_SIZE]; // DER signature, or DER ciphertext
+	size_t outlen;
+	int ret;
+	SDF_JOB_CALLBACK callback;
+	void *callback_arg;
+	int done;
+	SDF_JOB *next;
+};
+
+int sdf_job_set_sign(SDF_JOB *job, const uint8_t dgst[32]);
+int sdf_job_set_verify(SDF_JOB *job, const SM2_KEY *public_key, const uint8_t dgst[32],
+	const uint8_t *sig, size_t siglen);
+int sdf_job_set_encrypt(SDF_JOB *job, const SM2_KEY *public_key, const uint8_t *in, size_t inlen);
+void sdf_job_set_callback(SDF_JOB *job, SDF_JOB_CALLBACK callback, void *arg);
+
+SDF_JOB_QUEUE *sdf_job_queue_new(SDF_DEVICE *dev, int key_index, const char *pass, size_t sessions);
+int sdf_job_queue_get_public_key(const SDF_JOB_QUEUE *queue, SM2_KEY *public_key);
+int sdf_job_queue_submit(SDF_JOB_QUEUE *queue, SDF_JOB **jobs, size_t jobs_cnt);
+int sdf_job_queue_poll(SDF_JOB_QUEUE *queue, int timeout_ms, size_t *done_cnt);
+int sdf_job_poll(SDF_JOB_QUEUE *queue, SDF_JOB *job);
+int sdf_job_wait(SDF_JOB_QUEUE *queue, SDF_JOB *job);
+void sdf_job_queue_free(SDF_JOB_QUEUE *queue);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -99,6 +99,7 @@ void sm2_fp_div2(SM2_Fp r, const SM2_Fp a);
 void sm2_fp_neg(SM2_Fp r, const SM2_Fp a);
 void sm2_fp_sqr(SM2_Fp r, const SM2_Fp a);
 void sm2_fp_inv(SM2_Fp r, const SM2_Fp a);
+void sm2_fp_inv_fermat(SM2_Fp r, const SM2_Fp a); // a^(p-2), sm2_fp_inv() is safegcd
 int  sm2_fp_rand(SM2_Fp r);
 
 int sm2_fp_sqrt(SM2_Fp r, const SM2_Fp a);
@@ -120,6 +121,7 @@ void sm2_fn_exp(SM2_Fn r, const SM2_Fn a, const SM2_Fn e);
 void sm2_fn_neg(SM2_Fn r, const SM2_Fn a);
 void sm2_fn_sqr(SM2_Fn r, const SM2_Fn a);
 void sm2_fn_inv(SM2_Fn r, const SM2_Fn a);
+void sm2_fn_inv_fermat(SM2_Fn r, const SM2_Fn a); // a^(n-2), sm2_fn_inv() is safegcd
 int  sm2_fn_rand(SM2_Fn r);
 
 #define sm2_fn_init(r)		sm2_bn_init(r)
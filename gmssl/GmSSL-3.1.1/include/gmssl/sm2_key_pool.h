@@ -0,0 +1,52 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#ifndef GMSSL_SM2_KEY_POOL_H
+#define GMSSL_SM2_KEY_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <gmssl/sm2.h>
+#include <gmssl/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+SM2 Ephemeral Key Pool
+
+	Pre-generated SM2 key pairs for ECDHE key exchange, so the handshake does not do the
+	fixed-base scalar multiplication of sm2_key_generate() in the request path.
+
+	* A background thread keeps up to `size` keys in the pool and generates a new key
+	  every time one is taken.
+	* Every key is returned by sm2_key_pool_get() only once and is wiped from the pool.
+	* If the pool is empty sm2_key_pool_get() generates the key inline, it never waits.
+	* The pool can be shared by many threads. A child process drops the keys inherited
+	  from the parent and starts its own thread on the first sm2_key_pool_get().
+	* Without pthreads (WIN32) every key is generated inline.
+*/
+
+#define SM2_KEY_POOL_MAX_SIZE	4096
+
+typedef struct sm2_key_pool_st SM2_KEY_POOL;
+
+_gmssl_export SM2_KEY_POOL *sm2_key_pool_new(size_t size);
+_gmssl_export int sm2_key_pool_get(SM2_KEY_POOL *pool, SM2_KEY *key);
+_gmssl_export size_t sm2_key_pool_count(SM2_KEY_POOL *pool);
+_gmssl_export void sm2_key_pool_free(SM2_KEY_POOL *pool);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -83,6 +83,46 @@ void sm3_kdf_update(SM3_KDF_CTX *ctx, const uint8_t *data, size_t datalen);
 void sm3_kdf_finish(SM3_KDF_CTX *ctx, uint8_t *out);
 
 
+/*
+SM3 Tree Hash
+
+	The input is split into leaves of leaf_size bytes, only the last leaf may
+	be shorter and an empty input is a single empty leaf. The leaves are
+	hashed independently and combined as in RFC 6962:
+
+	leaf(d)          = SM3(0x00 || d)
+	node(l, r)       = SM3(0x01 || l || r)
+	MTH(D[0:1])      = leaf(D[0])
+	MTH(D[0:n])      = node(MTH(D[0:k]), MTH(D[k:n])), k the largest power of 2 less than n
+	sm3_tree(D)      = SM3(0x02 || uint32be(leaf_size) || uint64be(datalen) || MTH(D[0:n]))
+
+	The output is not the SM3 of the input, and depends on leaf_size.
+*/
+
+#define SM3_TREE_MIN_LEAF_SIZE		SM3_BLOCK_SIZE
+#define SM3_TREE_MAX_LEAF_SIZE		(1 << 30)
+#define SM3_TREE_DEFAULT_LEAF_SIZE	(1024 * 1024)
+#define SM3_TREE_MAX_THREADS		64
+
+typedef struct {
+	size_t leaf_size;
+	int threads;
+	uint64_t datalen;
+	SM3_CTX leaf_ctx; // the partial leaf
+	size_t leaf_nbytes;
+	uint8_t *dgsts; // digests of the finished leaves
+	size_t ndgsts;
+	size_t maxdgsts;
+} SM3_TREE_CTX;
+
+int sm3_tree_init(SM3_TREE_CTX *ctx, size_t leaf_size, int threads);
+int sm3_tree_update(SM3_TREE_CTX *ctx, const uint8_t *data, size_t datalen);
+int sm3_tree_finish(SM3_TREE_CTX *ctx, uint8_t dgst[SM3_DIGEST_SIZE]);
+void sm3_tree_cleanup(SM3_TREE_CTX *ctx);
+int sm3_tree_digest(const uint8_t *data, size_t datalen, size_t leaf_size, int threads,
+	uint8_t dgst[SM3_DIGEST_SIZE]);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,6 +26,14 @@ void sm3_x8_init(SM3_X8_CTX *ctx);
 void sm3_x8_compress_blocks(__m256i digest[8], const uint8_t *data, size_t datalen);
 void sm3_x8_digest(const uint8_t *data, size_t datalen, uint8_t dgst[8][32]);
 
+/*
+ * Only sm3_x8_avx2.c is compiled with -mavx2, other files must not use AVX2 intrinsics.
+ * The lanes are passed in plain arrays in the lane layout, digest[i][lane] and
+ * words[j][lane], and the callers check sm3_x8_avx2_cpu_support() first.
+ */
+int  sm3_x8_avx2_cpu_support(void);
+void sm3_x8_compress_lanes(uint32_t digest[8][8], uint32_t words[16][8]);
+
 
 #ifdef __cplusplus
 }
@@ -136,6 +136,15 @@ int sm4_ctr_encrypt_finish(SM4_CTR_CTX *ctx, uint8_t *out, size_t *outlen);
 #define sm4_ctr_decrypt_finish(ctx,out,outlen) sm4_ctr_encrypt_finish(ctx,out,outlen)
 
 
+#define SM4_MAX_THREADS		64
+
+// the full blocks are split into independent counter ranges, one per thread
+int sm4_ctr_encrypt_update_threads(SM4_CTR_CTX *ctx, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen, int threads);
+#define sm4_ctr_decrypt_update_threads(ctx,in,inlen,out,outlen,threads) \
+	sm4_ctr_encrypt_update_threads(ctx,in,inlen,out,outlen,threads)
+
+
 #ifdef __cplusplus
 }
 #endif
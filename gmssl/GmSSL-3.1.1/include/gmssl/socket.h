@@ -66,6 +66,12 @@ int tls_socket_bind(tls_socket_t sock, const struct sockaddr_in *addr);
 int tls_socket_listen(tls_socket_t sock, int backlog);
 int tls_socket_accept(tls_socket_t sock, struct sockaddr_in *addr, tls_socket_t *conn_sock);
 
+/*
+Let every worker bind its own listening socket to the same port, the kernel then spreads
+incoming connections over the listeners. Returns 0 if not supported by the platform.
+*/
+int tls_socket_set_reuseport(tls_socket_t sock);
+
 
 #ifdef __cplusplus
 }
@@ -15,11 +15,14 @@
 
 #include <stdint.h>
 #include <gmssl/sm2.h>
+#include <gmssl/sm2_key_pool.h>
+#include <gmssl/sdf.h>
 #include <gmssl/sm3.h>
 #include <gmssl/sm4.h>
 #include <gmssl/digest.h>
 #include <gmssl/block_cipher.h>
 #include <gmssl/socket.h>
+#include <gmssl/x509_cer.h>
 
 
 #ifdef __cplusplus
@@ -65,6 +68,9 @@ typedef uint32_t uint24_t;
 #define tls_uint8_size()	1
 #define tls_uint16_size()	2
 #define tls_uint24_size()	3
+#define tls_uint32_size()	4
+#define tls_uint8array_size(len)	(tls_uint8_size() + (len))
+#define tls_uint16array_size(len)	(tls_uint16_size() + (len))
 
 void tls_uint8_to_bytes(uint8_t a, uint8_t **out, size_t *outlen);
 void tls_uint16_to_bytes(uint16_t a, uint8_t **out, size_t *outlen);
@@ -268,6 +274,12 @@ typedef enum {
 const char *tls_extension_name(int ext);
 
 
+typedef enum {
+	TLS_psk_ke				= 0,
+	TLS_psk_dhe_ke				= 1,
+} TLS_PSK_KEY_EXCHANGE_MODE;
+
+
 typedef enum {
 	TLS_point_uncompressed			= 0,
 	TLS_point_ansix962_compressed_prime	= 1,
@@ -395,6 +407,7 @@ int tls13_hkdf_expand_label(const DIGEST *digest, const uint8_t secret[32],
 	const char *label, const uint8_t *context, size_t context_len,
 	size_t outlen, uint8_t *out);
 int tls13_derive_secret(const uint8_t secret[32], const char *label, const DIGEST_CTX *dgst_ctx, uint8_t out[32]);
+int tls13_cipher_suite_get(int cipher_suite, const DIGEST **digest, const BLOCK_CIPHER **cipher);
 
 int tls_cbc_encrypt(const SM3_HMAC_CTX *hmac_ctx, const SM4_KEY *enc_key,
 	const uint8_t seq_num[8], const uint8_t header[5],
@@ -408,6 +421,12 @@ int tls_record_encrypt(const SM3_HMAC_CTX *hmac_ctx, const SM4_KEY *cbc_key,
 int tls_record_decrypt(const SM3_HMAC_CTX *hmac_ctx, const SM4_KEY *cbc_key,
 	const uint8_t seq_num[8], const uint8_t *in, size_t inlen,
 	uint8_t *out, size_t *outlen);
+int tls_gcm_encrypt(const BLOCK_CIPHER_KEY *key, const uint8_t iv[4],
+	const uint8_t seq_num[8], const uint8_t header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
+int tls_gcm_decrypt(const BLOCK_CIPHER_KEY *key, const uint8_t iv[4],
+	const uint8_t seq_num[8], const uint8_t header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen);
 
 int tls_seq_num_incr(uint8_t seq_num[8]);
 int tls_random_generate(uint8_t random[32]);
@@ -546,6 +565,21 @@ int tls13_process_server_key_share(const uint8_t *ext_data, size_t ext_datalen,
 int tls13_certificate_authorities_ext_to_bytes(const uint8_t *ca_names, size_t ca_names_len,
 	uint8_t **out, size_t *outlen);
 
+int tls13_psk_key_exchange_modes_ext_to_bytes(uint8_t **out, size_t *outlen);
+int tls13_process_client_psk_key_exchange_modes(const uint8_t *ext_data, size_t ext_datalen);
+int tls13_early_data_ext_to_bytes(int handshake_type, uint32_t max_early_data_size,
+	uint8_t **out, size_t *outlen);
+int tls13_process_early_data_ext(int handshake_type, const uint8_t *ext_data, size_t ext_datalen,
+	uint32_t *max_early_data_size);
+int tls13_client_pre_shared_key_ext_to_bytes(const uint8_t *identity, size_t identity_len,
+	uint32_t obfuscated_ticket_age, const uint8_t *binder, size_t binder_len,
+	uint8_t **out, size_t *outlen);
+int tls13_process_client_pre_shared_key(const uint8_t *ext_data, size_t ext_datalen,
+	const uint8_t **identity, size_t *identity_len, uint32_t *obfuscated_ticket_age,
+	const uint8_t **binder, size_t *binder_len, size_t *binders_len);
+int tls13_server_pre_shared_key_ext_to_bytes(int selected_identity, uint8_t **out, size_t *outlen);
+int tls13_process_server_pre_shared_key(const uint8_t *ext_data, size_t ext_datalen, int *selected_identity);
+
 int tls_ext_from_bytes(int *type, const uint8_t **data, size_t *datalen, const uint8_t **in, size_t *inlen);
 int tls_process_client_exts(const uint8_t *exts, size_t extslen, uint8_t *out, size_t *outlen, size_t maxlen);
 int tls_process_server_exts(const uint8_t *exts, size_t extslen,
@@ -638,13 +672,29 @@ typedef enum {
 	TLS_client_verify_client_key_exchange	= 7,
 } TLS_CLIENT_VERIFY_INDEX;
 
+/*
+The handshake messages are hashed into the SM2 verify context of the client CertificateVerify
+as they are received. The signed hash is SM3(Z || messages) and Z depends on the client
+public key, so the messages before the client Certificate are kept in buf and hashed once
+when the public key is set. The client Certificate and the following messages are hashed
+directly.
+
+The six messages from ClientHello to ServerHelloDone are each sent in one record, so buf
+holds six full records. It is allocated once by tls_client_verify_init() and freed by
+tls_client_verify_cleanup(), the context itself is small enough for the stack.
+*/
+#define TLS_CLIENT_VERIFY_BUF_SIZE	(TLS_client_verify_client_certificate * TLS_MAX_PLAINTEXT_SIZE)
+
 typedef struct {
 	TLS_CLIENT_VERIFY_INDEX index;
-	uint8_t *handshake[8]; // Record data only, no record header
-	size_t handshake_len[8];
+	SM2_SIGN_CTX sm2_ctx;
+	int sm2_ctx_inited;
+	uint8_t *buf; // TLS_CLIENT_VERIFY_BUF_SIZE bytes of record data, no record header
+	size_t buflen;
 } TLS_CLIENT_VERIFY_CTX;
 
 int tls_client_verify_init(TLS_CLIENT_VERIFY_CTX *ctx);
+int tls_client_verify_set_public_key(TLS_CLIENT_VERIFY_CTX *ctx, const SM2_KEY *public_key);
 int tls_client_verify_update(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *handshake, size_t handshake_len);
 int tls_client_verify_finish(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *sig, size_t siglen, const SM2_KEY *public_key);
 void tls_client_verify_cleanup(TLS_CLIENT_VERIFY_CTX *ctx);
@@ -704,6 +754,82 @@ enum {
 
 #define TLS_MAX_CIPHER_SUITES_COUNT	64
 
+
+/*
+TLS 1.3 Session Resumption and 0-RTT
+
+	The server issues a stateless ticket after the handshake, the resumption PSK and the
+	ticket parameters are encrypted with SM4-GCM under the ticket key of the TLS_CTX, so
+	all the workers sharing the TLS_CTX can resume the sessions of each other.
+
+	Only psk_dhe_ke is supported, a resumed handshake still does the ECDHE key exchange
+	and skips the server Certificate and CertificateVerify. Tickets are not issued and
+	not accepted when the server requests client certificates.
+
+	The client keeps the ticket and the PSK in a TLS13_SESSION, exported with
+	tls13_get_session() and restored with tls13_set_session(). Data set with
+	tls13_set_early_data() is sent as 0-RTT data right after the ClientHello, the
+	early_data_status of the connection tells if the server accepted it, rejected data
+	should be sent again with tls13_send().
+
+	0-RTT data is replayable (RFC 8446 8). The server accepts it only if the ticket age
+	reported by the client is within replay_window seconds of the real age, and the
+	binder of the ClientHello was not seen before. The age check lets a ClientHello in
+	for at most 2 * replay_window seconds. The seen binders are kept in two rotating
+	bloom filters, each covering 2 * replay_window seconds, so a binder is remembered
+	for at least 2 and at most 4 times replay_window seconds after it was first seen,
+	which covers the whole time its age can be accepted. The filters are in shared
+	memory, so the anti-replay state is shared by the threads and the pre-forked
+	processes of the server. A false positive of the bloom filter only falls back to
+	the 1-RTT handshake.
+
+	The accepted 0-RTT data is read with tls13_recv_early_data() after tls_do_handshake()
+	and before tls13_recv(), it returns 0 when the client ended the early data and the
+	handshake is finished. The server can send 0.5-RTT data before that.
+*/
+
+#define TLS13_TICKET_PLAINTEXT_SIZE	(2 + 8 + 4 + 4 + 32)
+#define TLS13_TICKET_SIZE		(12 + TLS13_TICKET_PLAINTEXT_SIZE + 16)
+#define TLS13_MAX_TICKET_SIZE		512
+#define TLS13_MAX_TICKET_LIFETIME	604800 // 7 days
+#define TLS13_MAX_SESSION_SIZE		(64 + TLS13_MAX_TICKET_SIZE)
+#define TLS13_DEFAULT_REPLAY_WINDOW	10
+
+enum {
+	TLS13_early_data_none		= 0,
+	TLS13_early_data_rejected	= 1,
+	TLS13_early_data_accepted	= 2,
+};
+
+typedef struct {
+	int cipher_suite;
+	uint32_t ticket_lifetime; // seconds
+	uint32_t ticket_age_add;
+	uint32_t max_early_data_size;
+	uint64_t received_time; // milliseconds
+	uint8_t psk[32];
+	uint8_t ticket[TLS13_MAX_TICKET_SIZE];
+	size_t ticketlen;
+} TLS13_SESSION;
+
+uint64_t tls13_time_ms(void);
+
+int tls13_ticket_encrypt(const SM4_KEY *key, int cipher_suite, uint64_t issue_time,
+	uint32_t age_add, uint32_t max_early_data_size, const uint8_t psk[32],
+	uint8_t *ticket, size_t *ticketlen);
+int tls13_ticket_decrypt(const SM4_KEY *key, const uint8_t *ticket, size_t ticketlen,
+	int *cipher_suite, uint64_t *issue_time, uint32_t *age_add, uint32_t *max_early_data_size,
+	uint8_t psk[32]);
+
+int tls13_session_to_bytes(const TLS13_SESSION *sess, uint8_t **out, size_t *outlen);
+int tls13_session_from_bytes(TLS13_SESSION *sess, const uint8_t **in, size_t *inlen);
+
+typedef struct tls13_anti_replay_st TLS13_ANTI_REPLAY;
+
+TLS13_ANTI_REPLAY *tls13_anti_replay_new(int window);
+int tls13_anti_replay_check(TLS13_ANTI_REPLAY *ar, const uint8_t *binder, size_t binderlen, uint64_t now);
+void tls13_anti_replay_free(TLS13_ANTI_REPLAY *ar);
+
 typedef struct {
 	int protocol;
 	int is_client;
@@ -711,11 +837,21 @@ typedef struct {
 	size_t cipher_suites_cnt;
 	uint8_t *cacerts;
 	size_t cacertslen;
+	X509_TRUST_STORE ca_store;
+	uint8_t *ca_names; // CertificateRequest certificate_authorities, NULL for an empty list
+	size_t ca_names_len;
 	uint8_t *certs;
 	size_t certslen;
 	SM2_KEY signkey;
 	SM2_KEY kenckey;
 	int verify_depth;
+	SM2_KEY_POOL *key_pool; // ECDHE keys of TLS 1.2 and TLS 1.3, NULL to generate inline
+	SDF_JOB_QUEUE *sdf_queue; // TLS 1.3 signatures are done by the device, owned by the caller
+	SM4_KEY ticket_key;
+	uint32_t ticket_lifetime; // TLS 1.3 server issues tickets if not zero
+	uint32_t max_early_data_size; // TLS 1.3 server accepts 0-RTT data if not zero
+	int replay_window;
+	TLS13_ANTI_REPLAY *anti_replay;
 } TLS_CTX;
 
 int tls_ctx_init(TLS_CTX *ctx, int protocol, int is_client);
@@ -723,9 +859,13 @@ int tls_ctx_set_cipher_suites(TLS_CTX *ctx, const int *cipher_suites, size_t cip
 int tls_ctx_set_ca_certificates(TLS_CTX *ctx, const char *cacertsfile, int depth);
 int tls_ctx_set_certificate_and_key(TLS_CTX *ctx, const char *chainfile,
 	const char *keyfile, const char *keypass);
+int tls_ctx_set_certificate_and_sdf_queue(TLS_CTX *ctx, const char *chainfile, SDF_JOB_QUEUE *queue);
 int tls_ctx_set_tlcp_server_certificate_and_keys(TLS_CTX *ctx, const char *chainfile,
 	const char *signkeyfile, const char *signkeypass,
 	const char *kenckeyfile, const char *kenckeypass);
+int tls_ctx_set_key_pool(TLS_CTX *ctx, size_t size);
+int tls13_ctx_enable_session_tickets(TLS_CTX *ctx, uint32_t lifetime);
+int tls13_ctx_enable_early_data(TLS_CTX *ctx, uint32_t max_early_data_size, int replay_window);
 void tls_ctx_cleanup(TLS_CTX *ctx);
 
 
@@ -749,7 +889,7 @@ typedef struct {
 	uint8_t record[TLS_MAX_RECORD_SIZE]; //  定义一个uint8_t数组record，用于存储TLS记录，数组大小为TLS_MAX_RECORD_SIZE
 
 	// 其实这个就不太对了，还是应该有一个完整的密文记录
-	uint8_t databuf[TLS_MAX_PLAINTEXT_SIZE]; //  定义一个长度为TLS_MAX_PLAINTEXT_SIZE的uint8_t类型数组databuf，用于存储明文数据
+	uint8_t databuf[TLS_MAX_CIPHERTEXT_SIZE]; // 解密时MAC、填充和TLS 1.3的内容类型也先写入这里 //  定义一个长度为TLS_MAX_PLAINTEXT_SIZE的uint8_t类型数组databuf，用于存储明文数据
 	uint8_t *data; //  定义一个指向uint8_t类型的指针data，用于指向明文数据
 	size_t datalen; //  定义一个size_t类型的变量datalen，用于存储明文数据的长度
 
@@ -762,6 +902,9 @@ typedef struct {
 	size_t client_certs_len; //  定义一个无符号整型变量，用于存储客户端证书的长度
 	uint8_t ca_certs[2048]; //  定义一个长度为2048字节的数组，用于存储CA证书
 	size_t ca_certs_len; //  定义一个无符号整型变量，用于存储CA证书的长度
+	const X509_TRUST_STORE *ca_store; // 指向TLS_CTX中已建立索引的CA证书库，为NULL时使用ca_certs
+	const uint8_t *ca_names; // 指向TLS_CTX中预先编码的CA名称列表，服务器在CertificateRequest中发送
+	size_t ca_names_len;
 
 	SM2_KEY sign_key; //  定义一个SM2_KEY类型的变量，用于存储签名密钥
 	SM2_KEY kenc_key; //  定义一个SM2_KEY类型的变量，用于存储加密密钥
@@ -783,6 +926,30 @@ typedef struct {
 	BLOCK_CIPHER_KEY client_write_key; //  定义一个BLOCK_CIPHER_KEY类型的变量，用于存储客户端写密钥
 	BLOCK_CIPHER_KEY server_write_key; //  定义一个BLOCK_CIPHER_KEY类型的变量，用于存储服务器写密钥
 
+	SM2_KEY_POOL *key_pool; // TLS_CTX中的临时密钥池，为NULL时直接生成ECDHE密钥
+	SDF_JOB_QUEUE *sdf_queue; // 签名私钥在SDF设备中时的任务队列，握手线程等待签名任务完成
+
+	// TLS 1.3 会话恢复和0-RTT
+	const SM4_KEY *ticket_key; // 服务器的票据密钥，ticket_lifetime为0时不签发票据
+	uint32_t ticket_lifetime;
+	uint32_t max_early_data_size; // 服务器可接收的0-RTT数据长度
+	int replay_window;
+	TLS13_ANTI_REPLAY *anti_replay;
+	TLS13_SESSION session; // 客户端用于恢复的会话，或者收到的新会话
+	int session_set;
+	int session_received;
+	const uint8_t *early_data; // 客户端的0-RTT数据，由调用方保留
+	size_t early_data_len;
+	int psk_resumed;
+	int early_data_status;
+	int early_data_pending; // 服务器尚未读完客户端的0-RTT数据
+	size_t early_data_recv_len;
+	size_t early_data_skip_len; // 服务器拒绝0-RTT时可丢弃的数据长度
+	DIGEST_CTX dgst_ctx;
+	uint8_t client_handshake_traffic_secret[32];
+	uint8_t client_application_traffic_secret[32];
+	uint8_t resumption_master_secret[32];
+
 } TLS_CONNECT;
 
 
@@ -797,6 +964,16 @@ int tls_recv(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen);
 int tls_shutdown(TLS_CONNECT *conn);
 void tls_cleanup(TLS_CONNECT *conn);
 
+int tls_cipher_suite_is_aead(int cipher_suite);
+int tls_cipher_suites_filter(const int *cipher_suites, size_t cipher_suites_cnt,
+	const int *supported, size_t supported_cnt, int *out, size_t *outcnt);
+int tls_set_record_keys(TLS_CONNECT *conn);
+int tls_ecdhe_key_generate(const TLS_CONNECT *conn, SM2_KEY *key);
+int tls_conn_record_encrypt(const TLS_CONNECT *conn, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen);
+int tls_conn_record_decrypt(const TLS_CONNECT *conn, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen);
+
 int tlcp_do_connect(TLS_CONNECT *conn);
 int tlcp_do_accept(TLS_CONNECT *conn);
 int tls12_do_connect(TLS_CONNECT *conn);
@@ -809,12 +986,22 @@ int tls12_do_accept(TLS_CONNECT *conn);
 int tls13_do_connect(TLS_CONNECT *conn);
 int tls13_do_accept(TLS_CONNECT *conn);
 
+int tls_verify_peer_certs(const TLS_CONNECT *conn, const uint8_t *certs, size_t certslen,
+	int certs_type, int depth, int *verify_result);
+int tls_verify_peer_certs_tlcp(const TLS_CONNECT *conn, const uint8_t *certs, size_t certslen,
+	int certs_type, int depth, int *verify_result);
+
 int tls_send_alert(TLS_CONNECT *conn, int alert);
 int tls_send_warning(TLS_CONNECT *conn, int alert);
 
 int tls13_send(TLS_CONNECT *conn, const uint8_t *data, size_t datalen, size_t *sentlen);
 int tls13_recv(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen);
 
+int tls13_set_session(TLS_CONNECT *conn, const uint8_t *sess, size_t sesslen);
+int tls13_get_session(const TLS_CONNECT *conn, uint8_t *sess, size_t *sesslen);
+int tls13_set_early_data(TLS_CONNECT *conn, const uint8_t *data, size_t datalen);
+int tls13_recv_early_data(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen);
+
 
 int tls13_connect(TLS_CONNECT *conn, const char *hostname, int port, FILE *server_cacerts_fp,
 	FILE *client_certs_fp, const SM2_KEY *client_sign_key);
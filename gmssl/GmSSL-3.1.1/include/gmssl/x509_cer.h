@@ -284,6 +284,24 @@ int x509_signed_verify(const uint8_t *a, size_t alen, const SM2_KEY *pub_key,
 int x509_signed_verify_by_ca_cert(const uint8_t *a, size_t alen, const uint8_t *cacert, size_t cacertlen,
 	const char *signer_id, size_t signer_id_len);
 
+/*
+Single pass encoding of the signed structures with ASN1_BUILDER. The fields
+are added in reverse order: x509_builder_signature() adds the fixed length
+signatureValue and the signatureAlgorithm, the caller adds the TBS structure
+and x509_builder_sign() fills the reserved signatureValue.
+*/
+#define X509_BUILDER_OVERHEAD 512 // all the fields except the variable length inputs
+
+int x509_builder_explicit_version(ASN1_BUILDER *b, int index, int version);
+int x509_builder_time(ASN1_BUILDER *b, time_t tv);
+int x509_builder_validity(ASN1_BUILDER *b, time_t not_before, time_t not_after);
+int x509_builder_signature_algor(ASN1_BUILDER *b, int oid);
+int x509_builder_public_key_info(ASN1_BUILDER *b, const SM2_KEY *key);
+int x509_builder_explicit_exts(ASN1_BUILDER *b, int index, const uint8_t *d, size_t dlen);
+int x509_builder_signature(ASN1_BUILDER *b, int sig_alg, size_t siglen, uint8_t **sig);
+int x509_builder_sign(ASN1_BUILDER *b, size_t tbs_mark, uint8_t *sig, size_t siglen,
+	const SM2_KEY *sign_key, const char *signer_id, size_t signer_id_len);
+
 // x509_cert functions
 int x509_cert_sign_to_der(
 	int version,
@@ -309,6 +327,63 @@ int x509_cert_print(FILE *fp, int fmt, int ind, const char *label, const uint8_t
 int x509_cert_verify_by_ca_cert(const uint8_t *a, size_t alen, const uint8_t *cacert, size_t cacertlen,
 	const char *signer_id, size_t signer_id_len);
 
+/*
+X509_CERT_VIEW
+
+	A certificate parsed once: pointers and lengths of every TBSCertificate field and of
+	every extension, all pointing into the caller's DER buffer, nothing is allocated or
+	copied. The buffer must outlive the view. The subjectPublicKeyInfo is decoded into
+	an SM2_KEY by x509_cert_view_init(), a certificate without a valid SM2 public key
+	is rejected as by x509_cert_get_details().
+*/
+#define X509_CERT_VIEW_MAX_EXTS	24
+
+typedef struct {
+	int oid;
+	int critical;
+	const uint8_t *val;
+	size_t vlen;
+} X509_EXT_VIEW;
+
+typedef struct {
+	const uint8_t *cert;
+	size_t certlen;
+	const uint8_t *tbs;
+	size_t tbslen;
+	int version;
+	const uint8_t *serial;
+	size_t serial_len;
+	int inner_signature_algor;
+	const uint8_t *issuer;
+	size_t issuer_len;
+	time_t not_before;
+	time_t not_after;
+	const uint8_t *subject;
+	size_t subject_len;
+	const uint8_t *subject_public_key_info;
+	size_t subject_public_key_info_len;
+	SM2_KEY subject_public_key;
+	const uint8_t *issuer_unique_id;
+	size_t issuer_unique_id_len;
+	const uint8_t *subject_unique_id;
+	size_t subject_unique_id_len;
+	const uint8_t *exts;
+	size_t exts_len;
+	X509_EXT_VIEW ext[X509_CERT_VIEW_MAX_EXTS];
+	size_t exts_cnt; // > X509_CERT_VIEW_MAX_EXTS when not all extensions are indexed
+	int signature_algor;
+	const uint8_t *signature;
+	size_t signature_len;
+} X509_CERT_VIEW;
+
+int x509_cert_view_init(X509_CERT_VIEW *view, const uint8_t *a, size_t alen);
+int x509_cert_view_get_subject_public_key(const X509_CERT_VIEW *view, SM2_KEY *public_key);
+int x509_cert_view_get_ext_by_oid(const X509_CERT_VIEW *view, int oid,
+	int *critical, const uint8_t **val, size_t *vlen);
+int x509_cert_view_check(const X509_CERT_VIEW *view, int cert_type, int *path_len_constraint);
+int x509_cert_view_verify_by_ca_view(const X509_CERT_VIEW *view, const X509_CERT_VIEW *ca_view,
+	const char *signer_id, size_t signer_id_len);
+
 int x509_cert_get_details(const uint8_t *a, size_t alen,
 	int *version,
 	const uint8_t **serial_number, size_t *serial_number_len,
@@ -379,8 +454,97 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 int x509_certs_get_subjects(const uint8_t *certs, size_t certslen, uint8_t *names, size_t *nameslen);
 int x509_certs_print(FILE *fp, int fmt, int ind, const char *label, const uint8_t *d, size_t dlen);
 
+/*
+Trust Store
+
+	CA certificates are parsed once into a DER arena and indexed by hash tables on the
+	subject name and on the SubjectKeyIdentifier, so issuer lookup during chain building
+	costs one hash probe instead of a linear scan with full DER parsing of every CA.
+	Lookup of the issuer of a certificate prefers the AuthorityKeyIdentifier keyIdentifier
+	and falls back to the issuer name.
+*/
+typedef struct {
+	const uint8_t *cert;
+	size_t certlen;
+	const uint8_t *subject;
+	size_t subject_len;
+	const uint8_t *key_id;
+	size_t key_id_len;
+	int subject_next;
+	int key_id_next;
+} X509_TRUST_ANCHOR;
+
+typedef struct {
+	uint8_t *certs;
+	size_t certslen;
+	X509_TRUST_ANCHOR *anchors;
+	size_t anchors_cnt;
+	int *subject_table;
+	int *key_id_table;
+	size_t table_size;
+} X509_TRUST_STORE;
+
+int x509_trust_store_init(X509_TRUST_STORE *store, const uint8_t *certs, size_t certslen);
+int x509_trust_store_init_from_file(X509_TRUST_STORE *store, const char *file);
+void x509_trust_store_cleanup(X509_TRUST_STORE *store);
+int x509_trust_store_get_cert_by_subject(const X509_TRUST_STORE *store,
+	const uint8_t *subject, size_t subject_len,
+	const uint8_t **cert, size_t *certlen);
+int x509_trust_store_get_cert_by_key_identifier(const X509_TRUST_STORE *store,
+	const uint8_t *key_id, size_t key_id_len,
+	const uint8_t **cert, size_t *certlen);
+int x509_trust_store_get_issuer_cert(const X509_TRUST_STORE *store,
+	const uint8_t *cert, size_t certlen,
+	const uint8_t **cacert, size_t *cacertlen);
+int x509_trust_store_get_issuer_cert_by_view(const X509_TRUST_STORE *store,
+	const X509_CERT_VIEW *view,
+	const uint8_t **cacert, size_t *cacertlen);
+
+int x509_cert_get_subject_key_identifier(const uint8_t *cert, size_t certlen,
+	const uint8_t **key_id, size_t *key_id_len);
+int x509_cert_get_authority_key_identifier(const uint8_t *cert, size_t certlen,
+	const uint8_t **key_id, size_t *key_id_len);
+int x509_cert_view_get_subject_key_identifier(const X509_CERT_VIEW *view,
+	const uint8_t **key_id, size_t *key_id_len);
+int x509_cert_view_get_authority_key_identifier(const X509_CERT_VIEW *view,
+	const uint8_t **key_id, size_t *key_id_len);
+
+int x509_certs_verify_by_trust_store(const uint8_t *certs, size_t certslen, int certs_type,
+	const X509_TRUST_STORE *store, int depth, int *verify_result);
+int x509_certs_verify_tlcp_by_trust_store(const uint8_t *certs, size_t certslen, int certs_type,
+	const X509_TRUST_STORE *store, int depth, int *verify_result);
+
+/*
+Verified Signature Cache
+
+	Opt-in, process-wide cache of successful x509_cert_verify_by_ca_cert() signature checks.
+	Entries are keyed by SM3(certlen || cert || cacertlen || cacert || signer_id), so a hit
+	means exactly this (cert, issuer cert, signer_id) triple has been verified before.
+	Only the SM2 signature check is cached, validity, path length and revocation are still
+	evaluated by every x509_certs_verify() call.
+*/
+#define X509_VERIFY_CACHE_WAYS		4
+#define X509_VERIFY_CACHE_DEFAULT_SIZE	1024
+#define X509_VERIFY_CACHE_MAX_SIZE	(1 << 20)
+#define X509_VERIFY_CACHE_DEFAULT_TTL	3600 // seconds
+
+int x509_verify_cache_enable(size_t max_entries, int ttl_secs);
+void x509_verify_cache_disable(void);
+int x509_verify_cache_is_enabled(void);
+void x509_verify_cache_flush(void);
+int x509_verify_cache_get_stats(size_t *hits, size_t *misses, size_t *entries);
+int x509_verify_cache_fingerprint(const uint8_t *cert, size_t certlen,
+	const uint8_t *cacert, size_t cacertlen,
+	const char *signer_id, size_t signer_id_len, uint8_t fingerprint[32]);
+int x509_verify_cache_lookup(const uint8_t fingerprint[32]);
+int x509_verify_cache_add(const uint8_t fingerprint[32]);
+
 
 int x509_cert_new_from_file(uint8_t **out, size_t *outlen, const char *file);
+/*
+x509_certs_new_from_file
+	A file without any CERTIFICATE block returns 1 with *out = NULL and *outlen = 0.
+*/
 int x509_certs_new_from_file(uint8_t **out, size_t *outlen, const char *file);
 
 
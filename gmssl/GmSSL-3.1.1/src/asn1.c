@@ -1935,3 +1935,182 @@ int asn1_length_le(size_t len1, size_t len2)
 	}
 	return 1;
 }
+
+int asn1_builder_init(ASN1_BUILDER *b, uint8_t *buf, size_t size)
+{
+	if (!b || !buf || !size) {
+		error_print();
+		return -1;
+	}
+	b->buf = buf;
+	b->size = size;
+	b->len = 0;
+	return 1;
+}
+
+uint8_t *asn1_builder_reserve(ASN1_BUILDER *b, size_t len)
+{
+	if (len > b->size - b->len) {
+		error_print();
+		return NULL;
+	}
+	b->len += len;
+	return b->buf + b->size - b->len;
+}
+
+const uint8_t *asn1_builder_get_data(const ASN1_BUILDER *b, size_t mark, size_t *len)
+{
+	*len = b->len - mark;
+	return b->buf + b->size - b->len;
+}
+
+int asn1_builder_data(ASN1_BUILDER *b, const uint8_t *d, size_t dlen)
+{
+	uint8_t *p;
+
+	if (!(p = asn1_builder_reserve(b, dlen))) {
+		error_print();
+		return -1;
+	}
+	if (dlen) {
+		memcpy(p, d, dlen);
+	}
+	return 1;
+}
+
+int asn1_builder_header(ASN1_BUILDER *b, int tag, size_t mark)
+{
+	size_t dlen;
+	uint8_t buf[6];
+	uint8_t *p = buf + sizeof(buf);
+
+	if (mark > b->len) {
+		error_print();
+		return -1;
+	}
+	dlen = b->len - mark;
+	if (dlen > INT_MAX) {
+		error_print();
+		return -1;
+	}
+
+	if (dlen < 128) {
+		*(--p) = (uint8_t)dlen;
+	} else {
+		uint8_t nbytes = 0;
+		while (dlen) {
+			*(--p) = (uint8_t)dlen;
+			dlen >>= 8;
+			nbytes++;
+		}
+		*(--p) = 0x80 + nbytes;
+	}
+	*(--p) = (uint8_t)tag;
+
+	if (asn1_builder_data(b, p, buf + sizeof(buf) - p) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int asn1_builder_type(ASN1_BUILDER *b, int tag, const uint8_t *d, size_t dlen)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (!d) {
+		if (dlen) {
+			error_print();
+			return -1;
+		}
+		return 0;
+	}
+	if (asn1_builder_data(b, d, dlen) != 1
+		|| asn1_builder_header(b, tag, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int asn1_builder_integer_ex(ASN1_BUILDER *b, int tag, const uint8_t *a, size_t alen)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (!a) {
+		return 0;
+	}
+	if (alen <= 0 || alen > INT_MAX) {
+		error_print();
+		return -1;
+	}
+	while (*a == 0 && alen > 1) {
+		a++;
+		alen--;
+	}
+	if (asn1_builder_data(b, a, alen) != 1
+		|| ((a[0] & 0x80) && asn1_builder_data(b, (const uint8_t *)"", 1) != 1)
+		|| asn1_builder_header(b, tag, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int asn1_builder_int_ex(ASN1_BUILDER *b, int tag, int a)
+{
+	uint8_t buf[4] = {0};
+	size_t len = 0;
+
+	if (a == -1) {
+		return 0;
+	}
+	while (a > 0) {
+		buf[3 - len] = a & 0xff;
+		a >>= 8;
+		len++;
+	}
+	if (!len) {
+		len = 1;
+	}
+	if (asn1_builder_integer_ex(b, tag, buf + 4 - len, len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int asn1_builder_bit_octets_ex(ASN1_BUILDER *b, int tag, const uint8_t *octs, size_t nocts)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (!octs) {
+		if (nocts) {
+			error_print();
+			return -1;
+		}
+		return 0;
+	}
+	// no unused bits
+	if (asn1_builder_data(b, octs, nocts) != 1
+		|| asn1_builder_data(b, (const uint8_t *)"", 1) != 1
+		|| asn1_builder_header(b, tag, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int asn1_builder_to_der(const ASN1_BUILDER *b, uint8_t **out, size_t *outlen)
+{
+	if (!outlen) {
+		error_print();
+		return -1;
+	}
+	if (out && *out) {
+		memcpy(*out, b->buf + b->size - b->len, b->len);
+		*out += b->len;
+	}
+	*outlen += b->len;
+	return 1;
+}
@@ -15,6 +15,9 @@
 #include <assert.h>
 #include <gmssl/base64.h>
 #include <gmssl/error.h>
+#ifdef BASE64_SIMD
+#include <immintrin.h>
+#endif
 
 static unsigned char conv_ascii2bin(unsigned char a);
 #define conv_bin2ascii(a)       (data_bin2ascii[(a)&0x3f])
@@ -78,6 +81,186 @@ static unsigned char conv_ascii2bin(unsigned char a)
 }
 
 
+#ifdef BASE64_SIMD
+/*
+ * SSSE3/AVX2 codec, see Wojciech Mula and Daniel Lemire, "Faster Base64 Encoding and
+ * Decoding using AVX2 Instructions". The chars are classified by the two nibbles with
+ * pshufb lookups, so a chunk with any non-base64 char (white space, '=') is left to the
+ * scalar code.
+ */
+
+#if defined(__SSSE3__)
+static inline __m128i base64_decode_chunk16(__m128i str, int *ok)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i hi_nibbles, lo_nibbles, hi, lo, roll;
+
+    hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), nibble);
+    lo_nibbles = _mm_and_si128(str, nibble);
+    hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff) {
+        *ok = 0;
+        return str;
+    }
+    *ok = 1;
+    roll = _mm_shuffle_epi8(lut_roll,
+        _mm_add_epi8(_mm_cmpeq_epi8(str, _mm_set1_epi8('/')), hi_nibbles));
+    str = _mm_add_epi8(str, roll);
+
+    // 4 x 6-bit => 3 bytes, packed to the low 12 bytes
+    str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(str, _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+static inline __m128i base64_encode_chunk12(__m128i in)
+{
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i t0, t1, t2, t3, indices, result, less;
+
+    // 3 bytes => 4 x 6-bit in the 4 bytes of a 32-bit word
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    indices = _mm_or_si128(t1, t3);
+
+    result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shift_lut, result);
+    return _mm_add_epi8(result, indices);
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i base64_decode_chunk32(__m256i str, int *ok)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i hi_nibbles, lo_nibbles, hi, lo, roll;
+
+    hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), nibble);
+    lo_nibbles = _mm256_and_si256(str, nibble);
+    hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm256_testz_si256(lo, hi)) {
+        *ok = 0;
+        return str;
+    }
+    *ok = 1;
+    roll = _mm256_shuffle_epi8(lut_roll,
+        _mm256_add_epi8(_mm256_cmpeq_epi8(str, _mm256_set1_epi8('/')), hi_nibbles));
+    str = _mm256_add_epi8(str, roll);
+
+    // 12 bytes in each 128-bit lane, then packed to the low 24 bytes
+    str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+    str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    return _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+}
+#endif
+
+/*
+ * Decode whole chunks of 32 (AVX2) or 16 (SSSE3) base64 chars, return the number of
+ * chars consumed. The output is 3/4 of it, nothing is written beyond.
+ */
+static size_t base64_decode_simd(uint8_t *out, const uint8_t *in, size_t inlen)
+{
+    size_t len = 0;
+    int ok;
+
+#if defined(__AVX2__)
+    while (inlen - len >= 32) {
+        __m256i str = _mm256_loadu_si256((const __m256i *)(in + len));
+        str = base64_decode_chunk32(str, &ok);
+        if (!ok)
+            break;
+        _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(str));
+        _mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(str, 1));
+        out += 24;
+        len += 32;
+    }
+#endif
+#if defined(__SSSE3__)
+    while (inlen - len >= 16) {
+        uint8_t buf[16];
+        __m128i str = _mm_loadu_si128((const __m128i *)(in + len));
+        str = base64_decode_chunk16(str, &ok);
+        if (!ok)
+            break;
+        _mm_storeu_si128((__m128i *)buf, str);
+        memcpy(out, buf, 12);
+        out += 12;
+        len += 16;
+    }
+#endif
+    return len;
+}
+
+/*
+ * Encode whole chunks of 24 (AVX2) or 12 (SSSE3) bytes, return the number of bytes
+ * consumed. Every chunk loads 16 bytes, so the last 4 input bytes are always left to
+ * the scalar code.
+ */
+static size_t base64_encode_simd(uint8_t *out, const uint8_t *in, size_t inlen)
+{
+    size_t len = 0;
+
+#if defined(__AVX2__)
+    while (inlen - len >= 28) {
+        __m256i str = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            base64_encode_chunk12(_mm_loadu_si128((const __m128i *)(in + len)))),
+            base64_encode_chunk12(_mm_loadu_si128((const __m128i *)(in + len + 12))), 1);
+        _mm256_storeu_si256((__m256i *)out, str);
+        out += 32;
+        len += 24;
+    }
+#endif
+#if defined(__SSSE3__)
+    while (inlen - len >= 16) {
+        __m128i str = _mm_loadu_si128((const __m128i *)(in + len));
+        _mm_storeu_si128((__m128i *)out, base64_encode_chunk12(str));
+        out += 16;
+        len += 12;
+    }
+#endif
+    return len;
+}
+#endif
+
+
 int base64_ctx_num(BASE64_CTX *ctx)
 {
     return ctx->num;
@@ -156,6 +339,14 @@ int base64_encode_block(unsigned char *t, const unsigned char *f, int dlen)
     int i, ret = 0;
     unsigned long l;
 
+#ifdef BASE64_SIMD
+    i = (int)base64_encode_simd(t, f, dlen);
+    t += i / 3 * 4;
+    f += i;
+    dlen -= i;
+    ret += i / 3 * 4;
+#endif
+
     for (i = dlen; i > 0; i -= 3) {
         if (i >= 3) {
             l = (((unsigned long)f[0]) << 16L) |
@@ -341,6 +532,14 @@ int base64_decode_block(unsigned char *t, const unsigned char *f, int n)
     if (n % 4 != 0)
         return (-1);
 
+#ifdef BASE64_SIMD
+    i = (int)base64_decode_simd(t, f, n);
+    t += i / 4 * 3;
+    f += i;
+    n -= i;
+    ret += i / 4 * 3;
+#endif
+
     for (i = 0; i < n; i += 4) {
         a = conv_ascii2bin(*(f++));
         b = conv_ascii2bin(*(f++));
@@ -376,3 +575,84 @@ int base64_decode_finish(BASE64_CTX *ctx, uint8_t *out, int *outl)
     } else
         return (1);
 }
+
+int base64_decode(const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	uint32_t quad = 0;
+	int n = 0;
+	int pad = 0;
+	uint8_t *p = out;
+
+	if (!in || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+
+	while (inlen) {
+		int c, v;
+
+#ifdef BASE64_SIMD
+		// the lines of PEM are multiples of the chunk size
+		if (n == 0 && !pad) {
+			size_t len = base64_decode_simd(p, in, inlen);
+			p += len / 4 * 3;
+			in += len;
+			inlen -= len;
+			if (!inlen) {
+				break;
+			}
+		}
+#endif
+		c = *in++;
+		inlen--;
+		v = conv_ascii2bin(c);
+
+		if (v == B64_WS || v == B64_EOLN || v == B64_CR) {
+			continue;
+		}
+		if (c == '=') {
+			if (++pad > 2 || n + pad > 4) {
+				error_print();
+				return -1;
+			}
+			continue;
+		}
+		if (v & 0x80) {
+			error_print();
+			return -1;
+		}
+		if (pad) {
+			// data after padding
+			error_print();
+			return -1;
+		}
+		quad = (quad << 6) | v;
+		if (++n == 4) {
+			p[0] = (uint8_t)(quad >> 16);
+			p[1] = (uint8_t)(quad >> 8);
+			p[2] = (uint8_t)quad;
+			p += 3;
+			quad = 0;
+			n = 0;
+		}
+	}
+
+	if (pad) {
+		if (n + pad != 4) {
+			error_print();
+			return -1;
+		}
+		quad <<= 6 * pad;
+		p[0] = (uint8_t)(quad >> 16);
+		if (n == 3) {
+			p[1] = (uint8_t)(quad >> 8);
+		}
+		p += n - 1;
+	} else if (n) {
+		error_print();
+		return -1;
+	}
+
+	*outlen = p - out;
+	return 1;
+}
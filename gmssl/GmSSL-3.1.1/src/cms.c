@@ -18,6 +18,7 @@
 #include <gmssl/sm3.h>
 #include <gmssl/sm2.h>
 #include <gmssl/digest.h>
+#include <gmssl/mem.h>
 #include <gmssl/error.h>
 #include <gmssl/x509.h>
 #include <gmssl/x509_alg.h>
@@ -2445,6 +2446,1205 @@ int cms_set_key_agreement_info(
 	return 1;
 }
 
+/*
+Streaming API
+
+The attached SignedData and the EnvelopedData are parsed from a partially received input
+held in ctx->buf. A header is re-parsed from the start of the buffer each time more input
+arrives, the parsers return 0 while the header is incomplete.
+*/
+enum {
+	CMS_STREAM_HEADER = 0,
+	CMS_STREAM_CONTENT,
+	CMS_STREAM_SEGMENT_HEADER,
+	CMS_STREAM_TRAILER,
+};
+
+#define CMS_STREAM_SEGMENT_HEADER_SIZE	6
+
+static const uint8_t cms_end_of_contents[2] = { 0x00, 0x00 };
+
+// tag and length of the next TLV, an indefinite length is returned as CMS_CONTENT_LENGTH_UNKNOWN
+static int cms_stream_header_from_der(int tag, size_t *len,
+	const uint8_t *buf, size_t buflen, size_t *pos)
+{
+	const uint8_t *p = buf + *pos;
+	size_t plen = buflen - *pos;
+	size_t nbytes;
+	size_t i;
+
+	if (plen < 2) {
+		return 0;
+	}
+	if (p[0] != tag) {
+		error_print();
+		return -1;
+	}
+	if (p[1] < 0x80) {
+		*len = p[1];
+		*pos += 2;
+		return 1;
+	}
+	if (p[1] == 0x80) {
+		if (!(tag & ASN1_TAG_CONSTRUCTED)) {
+			error_print();
+			return -1;
+		}
+		*len = CMS_CONTENT_LENGTH_UNKNOWN;
+		*pos += 2;
+		return 1;
+	}
+	nbytes = p[1] & 0x7f;
+	if (nbytes > 4) {
+		error_print();
+		return -1;
+	}
+	if (plen < 2 + nbytes) {
+		return 0;
+	}
+	*len = 0;
+	for (i = 0; i < nbytes; i++) {
+		*len = (*len << 8) | p[2 + i];
+	}
+	*pos += 2 + nbytes;
+	return 1;
+}
+
+// a complete TLV, returned with its tag and length so that the *_from_der() parsers can be used
+static int cms_stream_tlv_from_der(int tag, const uint8_t **tlv, size_t *tlvlen,
+	const uint8_t *buf, size_t buflen, size_t *pos)
+{
+	size_t start = *pos;
+	size_t len;
+	int ret;
+
+	if ((ret = cms_stream_header_from_der(tag, &len, buf, buflen, pos)) != 1) {
+		if (ret < 0) error_print();
+		return ret;
+	}
+	if (len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		error_print();
+		return -1;
+	}
+	if (buflen - *pos < len) {
+		*pos = start;
+		return 0;
+	}
+	*tlv = buf + start;
+	*tlvlen = *pos - start + len;
+	*pos += len;
+	return 1;
+}
+
+static int cms_indefinite_header_to_der(int tag, uint8_t **out, size_t *outlen)
+{
+	if (out && *out) {
+		*(*out)++ = (uint8_t)tag;
+		*(*out)++ = 0x80;
+	}
+	*outlen += 2;
+	return 1;
+}
+
+static int cms_end_of_contents_to_der(size_t cnt, uint8_t **out, size_t *outlen)
+{
+	if (out && *out) {
+		memset(*out, 0, cnt * 2);
+		*out += cnt * 2;
+	}
+	*outlen += cnt * 2;
+	return 1;
+}
+
+static int cms_sign_signer_infos_length(const CMS_SIGN_CTX *ctx, size_t *len)
+{
+	uint8_t sig[SM2_signature_typical_size] = {0};
+	const uint8_t *issuer;
+	size_t issuer_len;
+	const uint8_t *serial;
+	size_t serial_len;
+	size_t i;
+
+	*len = 0;
+	for (i = 0; i < ctx->signers_cnt; i++) {
+		if (x509_cert_get_issuer_and_serial_number(
+				ctx->signers[i].certs, ctx->signers[i].certs_len,
+				&issuer, &issuer_len, &serial, &serial_len) != 1
+			|| cms_signer_info_to_der(CMS_version_v1,
+				issuer, issuer_len, serial, serial_len,
+				OID_sm3, NULL, 0,
+				OID_sm2sign_with_sm3, sig, sizeof(sig),
+				NULL, 0, NULL, len) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+// certificates, crls and signerInfos, signed only when out is not NULL
+static int cms_sign_trailer_to_der(const CMS_SIGN_CTX *ctx, size_t signer_infos_len,
+	uint8_t **out, size_t *outlen)
+{
+	const uint8_t *issuer;
+	size_t issuer_len;
+	const uint8_t *serial;
+	size_t serial_len;
+	size_t i;
+
+	if (cms_implicit_signers_certs_to_der(0, ctx->signers, ctx->signers_cnt, out, outlen) < 0
+		|| asn1_implicit_set_to_der(1, ctx->crls, ctx->crls_len, out, outlen) < 0
+		|| asn1_set_header_to_der(signer_infos_len, out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (!out) {
+		*outlen += signer_infos_len;
+		return 1;
+	}
+	for (i = 0; i < ctx->signers_cnt; i++) {
+		if (x509_cert_get_issuer_and_serial_number(
+				ctx->signers[i].certs, ctx->signers[i].certs_len,
+				&issuer, &issuer_len, &serial, &serial_len) != 1
+			|| cms_signer_info_sign_to_der(&ctx->sm3_ctx, ctx->signers[i].sign_key,
+				issuer, issuer_len, serial, serial_len,
+				NULL, 0, NULL, 0, out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+static int cms_sign_trailer_length(const CMS_SIGN_CTX *ctx, size_t *len)
+{
+	size_t signer_infos_len;
+
+	*len = 0;
+	if (cms_sign_signer_infos_length(ctx, &signer_infos_len) != 1
+		|| cms_sign_trailer_to_der(ctx, signer_infos_len, NULL, len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int cms_sign_init(CMS_SIGN_CTX *ctx,
+	const CMS_CERTS_AND_KEY *signers, size_t signers_cnt,
+	const uint8_t *crls, size_t crls_len,
+	size_t content_len, uint8_t *out, size_t *outlen)
+{
+	int digest_algors[] = { OID_sm3 };
+	size_t digest_algors_cnt = sizeof(digest_algors)/sizeof(int);
+	size_t octets_len = 0;
+	size_t content_info_len = 0;
+	size_t trailer_len;
+	size_t len = 0;
+	size_t signed_data_len = 0;
+	uint8_t *hashed;
+
+	if (!ctx || !signers || !signers_cnt || !out || !outlen
+		|| content_len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_SIGN_CTX));
+	ctx->signers = signers;
+	ctx->signers_cnt = signers_cnt;
+	ctx->crls = crls;
+	ctx->crls_len = crls_len;
+	ctx->content_len = content_len;
+
+	// same encoding as cms_signed_data_sign_to_der(), the length of signerInfos is fixed
+	// as signatures are generated by sm2_sign_fixlen()
+	if (asn1_octet_string_header_to_der(content_len, NULL, &octets_len) != 1
+		|| asn1_length_le(content_len, CMS_CONTENT_LENGTH_UNKNOWN - octets_len) != 1
+		|| cms_content_info_header_to_der(OID_cms_data, octets_len + content_len,
+			NULL, &content_info_len) != 1
+		|| cms_sign_trailer_length(ctx, &trailer_len) != 1) {
+		error_print();
+		return -1;
+	}
+	content_info_len += octets_len + content_len;
+
+	if (asn1_int_to_der(CMS_version_v1, NULL, &len) != 1
+		|| cms_digest_algors_to_der(digest_algors, digest_algors_cnt, NULL, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	len += content_info_len + trailer_len;
+	if (asn1_sequence_header_to_der(len, NULL, &signed_data_len) != 1) {
+		error_print();
+		return -1;
+	}
+	signed_data_len += len;
+
+	*outlen = 0;
+	if (cms_content_info_header_to_der(OID_cms_signed_data, signed_data_len, &out, outlen) != 1
+		|| asn1_sequence_header_to_der(len, &out, outlen) != 1
+		|| asn1_int_to_der(CMS_version_v1, &out, outlen) != 1
+		|| cms_digest_algors_to_der(digest_algors, digest_algors_cnt, &out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	hashed = out;
+	if (cms_content_info_header_to_der(OID_cms_data, octets_len + content_len, &out, outlen) != 1
+		|| asn1_octet_string_header_to_der(content_len, &out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	sm3_init(&ctx->sm3_ctx);
+	sm3_update(&ctx->sm3_ctx, hashed, out - hashed);
+	return 1;
+}
+
+int cms_sign_detached_init(CMS_SIGN_CTX *ctx,
+	const CMS_CERTS_AND_KEY *signers, size_t signers_cnt,
+	const uint8_t *crls, size_t crls_len)
+{
+	if (!ctx || !signers || !signers_cnt) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_SIGN_CTX));
+	ctx->signers = signers;
+	ctx->signers_cnt = signers_cnt;
+	ctx->crls = crls;
+	ctx->crls_len = crls_len;
+	ctx->detached = 1;
+	ctx->content_len = CMS_CONTENT_LENGTH_UNKNOWN;
+	sm3_init(&ctx->sm3_ctx);
+	return 1;
+}
+
+int cms_sign_update(CMS_SIGN_CTX *ctx, const uint8_t *data, size_t datalen)
+{
+	if (!ctx || (!data && datalen)) {
+		error_print();
+		return -1;
+	}
+	if (!ctx->detached && datalen > ctx->content_len - ctx->nbytes) {
+		error_print();
+		return -1;
+	}
+	sm3_update(&ctx->sm3_ctx, data, datalen);
+	ctx->nbytes += datalen;
+	return 1;
+}
+
+int cms_sign_finish(CMS_SIGN_CTX *ctx, uint8_t *out, size_t *outlen)
+{
+	int digest_algors[] = { OID_sm3 };
+	size_t digest_algors_cnt = sizeof(digest_algors)/sizeof(int);
+	size_t signer_infos_len;
+	size_t trailer_len;
+	size_t content_info_len = 0;
+	size_t len = 0;
+	size_t signed_data_len = 0;
+
+	if (!ctx || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (cms_sign_signer_infos_length(ctx, &signer_infos_len) != 1
+		|| cms_sign_trailer_length(ctx, &trailer_len) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (!ctx->detached) {
+		if (ctx->nbytes != ctx->content_len) {
+			error_print();
+			return -1;
+		}
+		*outlen = 0;
+		if (cms_sign_trailer_to_der(ctx, signer_infos_len, out ? &out : NULL, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+		return 1;
+	}
+
+	// ContentInfo without content
+	if (cms_content_type_to_der(OID_cms_data, NULL, &content_info_len) != 1
+		|| asn1_int_to_der(CMS_version_v1, NULL, &len) != 1
+		|| cms_digest_algors_to_der(digest_algors, digest_algors_cnt, NULL, &len) != 1
+		|| asn1_sequence_header_to_der(content_info_len, NULL, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	len += content_info_len + trailer_len;
+	if (asn1_sequence_header_to_der(len, NULL, &signed_data_len) != 1) {
+		error_print();
+		return -1;
+	}
+	signed_data_len += len;
+
+	*outlen = 0;
+	if (!out) {
+		uint8_t data[1];
+		if (cms_content_info_to_der(OID_cms_signed_data, data, signed_data_len, NULL, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+		return 1;
+	}
+	if (cms_content_info_header_to_der(OID_cms_signed_data, signed_data_len, &out, outlen) != 1
+		|| asn1_sequence_header_to_der(len, &out, outlen) != 1
+		|| asn1_int_to_der(CMS_version_v1, &out, outlen) != 1
+		|| cms_digest_algors_to_der(digest_algors, digest_algors_cnt, &out, outlen) != 1
+		|| asn1_sequence_header_to_der(content_info_len, &out, outlen) != 1
+		|| cms_content_type_to_der(OID_cms_data, &out, outlen) != 1
+		|| cms_sign_trailer_to_der(ctx, signer_infos_len, &out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int cms_verify_signer_infos(const SM3_CTX *sm3_ctx,
+	const uint8_t *certs, size_t certs_len,
+	const uint8_t *signer_infos, size_t signer_infos_len)
+{
+	const uint8_t *cert;
+	size_t certlen;
+	const uint8_t *issuer;
+	size_t issuer_len;
+	const uint8_t *serial;
+	size_t serial_len;
+	const uint8_t *authed_attrs;
+	size_t authed_attrs_len;
+	const uint8_t *unauthed_attrs;
+	size_t unauthed_attrs_len;
+
+	while (signer_infos_len) {
+		if (cms_signer_info_verify_from_der(
+			sm3_ctx, certs, certs_len,
+			&cert, &certlen,
+			&issuer, &issuer_len,
+			&serial, &serial_len,
+			&authed_attrs, &authed_attrs_len,
+			&unauthed_attrs, &unauthed_attrs_len,
+			&signer_infos, &signer_infos_len) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int cms_verify_init(CMS_VERIFY_CTX *ctx)
+{
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_VERIFY_CTX));
+	ctx->state = CMS_STREAM_HEADER;
+	return 1;
+}
+
+/*
+ContentInfo { signedData, [0] SignedData { version, digestAlgorithms,
+	ContentInfo { data, [0] OCTET STRING -- header ends here
+*/
+static int cms_verify_header_from_der(CMS_VERIFY_CTX *ctx, size_t *pos)
+{
+	const uint8_t *buf = ctx->buf;
+	size_t buflen = ctx->buflen;
+	const uint8_t *tlv;
+	size_t tlvlen;
+	int oid;
+	int version;
+	int digest_algors[4];
+	size_t digest_algors_cnt;
+	size_t content_info_len, explicit_len, signed_data_len;
+	size_t inner_content_info_len, inner_explicit_len, octets_len;
+	size_t end, signed_data_end, octets_end;
+	uint8_t header[64];
+	uint8_t *p = header;
+	size_t header_len = 0;
+	int ret;
+
+	*pos = 0;
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &content_info_len, buf, buflen, pos)) != 1
+		|| (ret = cms_stream_tlv_from_der(ASN1_TAG_OBJECT_IDENTIFIER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	end = *pos - tlvlen + content_info_len;
+	if (cms_content_type_from_der(&oid, &tlv, &tlvlen) != 1
+		|| asn1_check(oid == OID_cms_signed_data) != 1
+		|| content_info_len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_EXPLICIT(0), &explicit_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (*pos + explicit_len != end) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &signed_data_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	signed_data_end = *pos + signed_data_len;
+	if (signed_data_end != end) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_INTEGER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (asn1_int_from_der(&version, &tlv, &tlvlen) != 1
+		|| asn1_check(version == CMS_version_v1) != 1) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_SET, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (cms_digest_algors_from_der(digest_algors, &digest_algors_cnt,
+			sizeof(digest_algors)/sizeof(int), &tlv, &tlvlen) != 1
+		|| asn1_check(digest_algors_cnt == 1) != 1
+		|| asn1_check(digest_algors[0] == OID_sm3) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &inner_content_info_len, buf, buflen, pos)) != 1
+		|| (ret = cms_stream_tlv_from_der(ASN1_TAG_OBJECT_IDENTIFIER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	end = *pos - tlvlen + inner_content_info_len;
+	if (cms_content_type_from_der(&oid, &tlv, &tlvlen) != 1
+		|| asn1_check(oid == OID_cms_data) != 1
+		|| inner_content_info_len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_EXPLICIT(0), &inner_explicit_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (*pos + inner_explicit_len != end) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_OCTET_STRING, &octets_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	octets_end = *pos + octets_len;
+	if (octets_end != end || octets_end > signed_data_end
+		|| signed_data_end - octets_end > sizeof(ctx->buf)) {
+		error_print();
+		return -1;
+	}
+
+	// same digest as cms_signed_data_verify_from_der()
+	if (cms_content_info_header_to_der(OID_cms_data, inner_explicit_len, &p, &header_len) != 1
+		|| asn1_octet_string_header_to_der(octets_len, &p, &header_len) != 1) {
+		error_print();
+		return -1;
+	}
+	sm3_init(&ctx->sm3_ctx);
+	sm3_update(&ctx->sm3_ctx, header, header_len);
+
+	ctx->content_left = octets_len;
+	ctx->trailer_len = signed_data_end - octets_end;
+	return 1;
+
+end:
+	if (ret < 0) error_print();
+	return ret;
+}
+
+int cms_verify_update(CMS_VERIFY_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	size_t len;
+	size_t pos;
+	int ret;
+
+	if (!ctx || (!in && inlen) || !outlen || ctx->detached) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+
+	while (inlen) {
+		switch (ctx->state) {
+		case CMS_STREAM_HEADER:
+			len = sizeof(ctx->buf) - ctx->buflen;
+			if (len > inlen) len = inlen;
+			memcpy(ctx->buf + ctx->buflen, in, len);
+			ctx->buflen += len;
+			if ((ret = cms_verify_header_from_der(ctx, &pos)) < 0) {
+				error_print();
+				return -1;
+			}
+			if (ret == 0) {
+				if (ctx->buflen == sizeof(ctx->buf)) {
+					error_print();
+					return -1;
+				}
+				in += len;
+				inlen -= len;
+				break;
+			}
+			// the previous input did not complete the header, so the header ends in this input
+			len -= ctx->buflen - pos;
+			in += len;
+			inlen -= len;
+			ctx->buflen = 0;
+			ctx->state = ctx->content_left ? CMS_STREAM_CONTENT : CMS_STREAM_TRAILER;
+			break;
+
+		case CMS_STREAM_CONTENT:
+			len = inlen < ctx->content_left ? inlen : ctx->content_left;
+			sm3_update(&ctx->sm3_ctx, in, len);
+			if (out) {
+				memcpy(out, in, len);
+				out += len;
+				*outlen += len;
+			}
+			in += len;
+			inlen -= len;
+			if (!(ctx->content_left -= len)) {
+				ctx->state = CMS_STREAM_TRAILER;
+			}
+			break;
+
+		case CMS_STREAM_TRAILER:
+			if (inlen > ctx->trailer_len - ctx->buflen) {
+				error_print();
+				return -1;
+			}
+			memcpy(ctx->buf + ctx->buflen, in, inlen);
+			ctx->buflen += inlen;
+			inlen = 0;
+			break;
+
+		default:
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int cms_verify_detached_init(CMS_VERIFY_CTX *ctx, const uint8_t *cms, size_t cmslen)
+{
+	int cms_type;
+	const uint8_t *d;
+	size_t dlen;
+	int version;
+	int digest_algors[4];
+	size_t digest_algors_cnt;
+	int content_type;
+	const uint8_t *content;
+	size_t content_len;
+	const uint8_t *crls;
+	size_t crls_len;
+
+	if (!ctx || !cms || !cmslen) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_VERIFY_CTX));
+
+	if (cms_content_info_from_der(&cms_type, &d, &dlen, &cms, &cmslen) != 1
+		|| asn1_check(cms_type == OID_cms_signed_data) != 1
+		|| asn1_check(d && dlen) != 1
+		|| asn1_length_is_zero(cmslen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (cms_signed_data_from_der(&version,
+			digest_algors, &digest_algors_cnt, sizeof(digest_algors)/sizeof(int),
+			&content_type, &content, &content_len,
+			&ctx->certs, &ctx->certs_len,
+			&crls, &crls_len,
+			&ctx->signer_infos, &ctx->signer_infos_len,
+			&d, &dlen) != 1
+		|| asn1_length_is_zero(dlen) != 1
+		|| asn1_check(digest_algors_cnt == 1) != 1
+		|| asn1_check(digest_algors[0] == OID_sm3) != 1
+		|| asn1_check(content_type == OID_cms_data) != 1
+		|| asn1_check(content == NULL) != 1) {
+		error_print();
+		return -1;
+	}
+	ctx->detached = 1;
+	sm3_init(&ctx->sm3_ctx);
+	return 1;
+}
+
+int cms_verify_detached_update(CMS_VERIFY_CTX *ctx, const uint8_t *data, size_t datalen)
+{
+	if (!ctx || (!data && datalen) || !ctx->detached) {
+		error_print();
+		return -1;
+	}
+	sm3_update(&ctx->sm3_ctx, data, datalen);
+	return 1;
+}
+
+int cms_verify_finish(CMS_VERIFY_CTX *ctx)
+{
+	const uint8_t *p;
+	size_t len;
+	const uint8_t *crls;
+	size_t crls_len;
+
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	if (!ctx->detached) {
+		if (ctx->state != CMS_STREAM_TRAILER || ctx->buflen != ctx->trailer_len) {
+			error_print();
+			return -1;
+		}
+		p = ctx->buf;
+		len = ctx->buflen;
+		if (asn1_implicit_set_from_der(0, &ctx->certs, &ctx->certs_len, &p, &len) < 0
+			|| asn1_implicit_set_from_der(1, &crls, &crls_len, &p, &len) < 0
+			|| asn1_set_from_der(&ctx->signer_infos, &ctx->signer_infos_len, &p, &len) != 1
+			|| asn1_length_is_zero(len) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	if (cms_verify_signer_infos(&ctx->sm3_ctx, ctx->certs, ctx->certs_len,
+		ctx->signer_infos, ctx->signer_infos_len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int cms_envelop_init(CMS_ENVELOP_CTX *ctx,
+	const uint8_t *rcpt_certs, size_t rcpt_certs_len,
+	int enc_algor, const uint8_t *key, size_t keylen, const uint8_t *iv, size_t ivlen,
+	size_t content_len,
+	const uint8_t *shared_info1, size_t shared_info1_len,
+	const uint8_t *shared_info2, size_t shared_info2_len,
+	uint8_t *out, size_t *outlen)
+{
+	uint8_t rcpt_infos[CMS_STREAM_BUF_SIZE - CMS_STREAM_HEADER_SIZE];
+	size_t rcpt_infos_len = 0;
+	size_t enced_content_len;
+	size_t enced_content_info_len = 0;
+	size_t len = 0;
+	size_t enveloped_data_len = 0;
+
+	if (!ctx || !rcpt_certs || !rcpt_certs_len || !key || !iv || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (enc_algor != OID_sm4_cbc || keylen != SM4_KEY_SIZE || ivlen != SM4_BLOCK_SIZE) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_ENVELOP_CTX));
+	ctx->content_len = content_len;
+	ctx->shared_info1 = shared_info1;
+	ctx->shared_info1_len = shared_info1_len;
+	ctx->shared_info2 = shared_info2;
+	ctx->shared_info2_len = shared_info2_len;
+
+	while (rcpt_certs_len) {
+		const uint8_t *cert;
+		size_t certlen;
+		SM2_KEY public_key;
+		const uint8_t *issuer;
+		size_t issuer_len;
+		const uint8_t *serial;
+		size_t serial_len;
+
+		if (asn1_any_from_der(&cert, &certlen, &rcpt_certs, &rcpt_certs_len) != 1
+			|| x509_cert_get_issuer_and_serial_number(cert, certlen,
+				&issuer, &issuer_len, &serial, &serial_len) != 1
+			|| x509_cert_get_subject_public_key(cert, certlen, &public_key) != 1
+			|| cms_recipient_infos_add_recipient_info(rcpt_infos, &rcpt_infos_len, sizeof(rcpt_infos),
+				&public_key, issuer, issuer_len, serial, serial_len, key, keylen) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+
+	*outlen = 0;
+	if (content_len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		if (cms_indefinite_header_to_der(ASN1_TAG_SEQUENCE, &out, outlen) != 1
+			|| cms_content_type_to_der(OID_cms_enveloped_data, &out, outlen) != 1
+			|| cms_indefinite_header_to_der(ASN1_TAG_EXPLICIT(0), &out, outlen) != 1
+			|| cms_indefinite_header_to_der(ASN1_TAG_SEQUENCE, &out, outlen) != 1
+			|| asn1_int_to_der(CMS_version_v1, &out, outlen) != 1
+			|| asn1_set_to_der(rcpt_infos, rcpt_infos_len, &out, outlen) != 1
+			|| cms_indefinite_header_to_der(ASN1_TAG_SEQUENCE, &out, outlen) != 1
+			|| cms_content_type_to_der(OID_cms_data, &out, outlen) != 1
+			|| x509_encryption_algor_to_der(enc_algor, iv, ivlen, &out, outlen) != 1
+			|| cms_indefinite_header_to_der(ASN1_TAG_EXPLICIT(0), &out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+	} else {
+		// same encoding as cms_envelop(), the SM2 ciphertexts are of fixed length
+		if (content_len > CMS_CONTENT_LENGTH_UNKNOWN - SM4_BLOCK_SIZE - 64) {
+			error_print();
+			return -1;
+		}
+		enced_content_len = (content_len/SM4_BLOCK_SIZE + 1) * SM4_BLOCK_SIZE;
+		if (cms_content_type_to_der(OID_cms_data, NULL, &enced_content_info_len) != 1
+			|| x509_encryption_algor_to_der(enc_algor, iv, ivlen, NULL, &enced_content_info_len) != 1
+			|| asn1_header_to_der(ASN1_TAG_IMPLICIT(0), enced_content_len, NULL, &enced_content_info_len) != 1
+			|| asn1_implicit_octet_string_to_der(1, shared_info1, shared_info1_len, NULL, &enced_content_info_len) < 0
+			|| asn1_implicit_octet_string_to_der(2, shared_info2, shared_info2_len, NULL, &enced_content_info_len) < 0) {
+			error_print();
+			return -1;
+		}
+		enced_content_info_len += enced_content_len;
+		if (asn1_int_to_der(CMS_version_v1, NULL, &len) != 1
+			|| asn1_set_to_der(rcpt_infos, rcpt_infos_len, NULL, &len) != 1
+			|| asn1_sequence_header_to_der(enced_content_info_len, NULL, &len) != 1
+			|| asn1_sequence_header_to_der(len + enced_content_info_len, NULL, &enveloped_data_len) != 1) {
+			error_print();
+			return -1;
+		}
+		len += enced_content_info_len;
+		enveloped_data_len += len;
+
+		if (cms_content_info_header_to_der(OID_cms_enveloped_data, enveloped_data_len, &out, outlen) != 1
+			|| asn1_sequence_header_to_der(len, &out, outlen) != 1
+			|| asn1_int_to_der(CMS_version_v1, &out, outlen) != 1
+			|| asn1_set_to_der(rcpt_infos, rcpt_infos_len, &out, outlen) != 1
+			|| asn1_sequence_header_to_der(enced_content_info_len, &out, outlen) != 1
+			|| cms_content_type_to_der(OID_cms_data, &out, outlen) != 1
+			|| x509_encryption_algor_to_der(enc_algor, iv, ivlen, &out, outlen) != 1
+			|| asn1_header_to_der(ASN1_TAG_IMPLICIT(0), enced_content_len, &out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+
+	if (sm4_cbc_encrypt_init(&ctx->sm4_ctx, key, iv) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int cms_envelop_update(CMS_ENVELOP_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	size_t len;
+
+	if (!ctx || (!in && inlen) || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+	if (ctx->content_len == CMS_CONTENT_LENGTH_UNKNOWN) {
+		// one segment of the constructed encryptedContent per update
+		len = ((ctx->sm4_ctx.block_nbytes + inlen)/SM4_BLOCK_SIZE) * SM4_BLOCK_SIZE;
+		if (len && asn1_octet_string_header_to_der(len, &out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+	} else if (inlen > ctx->content_len - ctx->nbytes) {
+		error_print();
+		return -1;
+	}
+	if (sm4_cbc_encrypt_update(&ctx->sm4_ctx, in, inlen, out, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	*outlen += len;
+	ctx->nbytes += inlen;
+	return 1;
+}
+
+int cms_envelop_finish(CMS_ENVELOP_CTX *ctx, uint8_t *out, size_t *outlen)
+{
+	uint8_t block[SM4_BLOCK_SIZE];
+	size_t len;
+	int indefinite;
+
+	if (!ctx || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	indefinite = (ctx->content_len == CMS_CONTENT_LENGTH_UNKNOWN);
+	if (!indefinite && ctx->nbytes != ctx->content_len) {
+		error_print();
+		return -1;
+	}
+	if (sm4_cbc_encrypt_finish(&ctx->sm4_ctx, block, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+	if (indefinite) {
+		if (asn1_octet_string_to_der(block, len, &out, outlen) != 1
+			|| cms_end_of_contents_to_der(1, &out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+	} else {
+		memcpy(out, block, len);
+		out += len;
+		*outlen += len;
+	}
+	if (asn1_implicit_octet_string_to_der(1, ctx->shared_info1, ctx->shared_info1_len, &out, outlen) < 0
+		|| asn1_implicit_octet_string_to_der(2, ctx->shared_info2, ctx->shared_info2_len, &out, outlen) < 0) {
+		error_print();
+		return -1;
+	}
+	// EncryptedContentInfo, EnvelopedData, [0] and ContentInfo
+	if (indefinite && cms_end_of_contents_to_der(4, &out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	gmssl_secure_clear(&ctx->sm4_ctx, sizeof(SM4_CBC_CTX));
+	return 1;
+}
+
+int cms_deenvelop_init(CMS_DEENVELOP_CTX *ctx,
+	const SM2_KEY *rcpt_key, const uint8_t *rcpt_cert, size_t rcpt_cert_len)
+{
+	SM2_KEY public_key;
+
+	if (!ctx || !rcpt_key || !rcpt_cert || !rcpt_cert_len) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(CMS_DEENVELOP_CTX));
+
+	if (x509_cert_get_issuer_and_serial_number(rcpt_cert, rcpt_cert_len,
+			&ctx->rcpt_issuer, &ctx->rcpt_issuer_len,
+			&ctx->rcpt_serial, &ctx->rcpt_serial_len) != 1
+		|| x509_cert_get_subject_public_key(rcpt_cert, rcpt_cert_len, &public_key) != 1) {
+		error_print();
+		return -1;
+	}
+	if (memcmp(&public_key, rcpt_key, sizeof(SM2_POINT)) != 0) {
+		error_print();
+		return -1;
+	}
+	ctx->rcpt_key = rcpt_key;
+	ctx->state = CMS_STREAM_HEADER;
+	return 1;
+}
+
+/*
+ContentInfo { envelopedData, [0] EnvelopedData { version, recipientInfos,
+	EncryptedContentInfo { data, contentEncryptionAlgorithm, [0] -- header ends here
+*/
+static int cms_deenvelop_header_from_der(CMS_DEENVELOP_CTX *ctx, size_t *pos)
+{
+	const uint8_t *buf = ctx->buf;
+	size_t buflen = ctx->buflen;
+	const uint8_t *tlv;
+	size_t tlvlen;
+	int oid;
+	int version;
+	const uint8_t *rcpt_infos;
+	size_t rcpt_infos_len;
+	int enc_algor;
+	const uint8_t *iv;
+	size_t ivlen;
+	size_t content_info_len, explicit_len, enveloped_data_len, enced_content_info_len;
+	size_t enced_content_len;
+	size_t end = 0;
+	uint8_t key[32];
+	size_t keylen;
+	int indefinite;
+	int ret;
+
+	*pos = 0;
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &content_info_len, buf, buflen, pos)) != 1
+		|| (ret = cms_stream_tlv_from_der(ASN1_TAG_OBJECT_IDENTIFIER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	indefinite = (content_info_len == CMS_CONTENT_LENGTH_UNKNOWN);
+	if (!indefinite) {
+		end = *pos - tlvlen + content_info_len;
+	}
+	if (cms_content_type_from_der(&oid, &tlv, &tlvlen) != 1
+		|| asn1_check(oid == OID_cms_enveloped_data) != 1) {
+		error_print();
+		return -1;
+	}
+
+	// EnvelopedData and EncryptedContentInfo both end with the ContentInfo
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_EXPLICIT(0), &explicit_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (!indefinite && (explicit_len == CMS_CONTENT_LENGTH_UNKNOWN || *pos + explicit_len != end)) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &enveloped_data_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (!indefinite && (enveloped_data_len == CMS_CONTENT_LENGTH_UNKNOWN || *pos + enveloped_data_len != end)) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_INTEGER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (asn1_int_from_der(&version, &tlv, &tlvlen) != 1
+		|| asn1_check(version == CMS_version_v1) != 1) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_SET, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (asn1_set_from_der(&rcpt_infos, &rcpt_infos_len, &tlv, &tlvlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_header_from_der(ASN1_TAG_SEQUENCE, &enced_content_info_len, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (!indefinite && (enced_content_info_len == CMS_CONTENT_LENGTH_UNKNOWN || *pos + enced_content_info_len != end)) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_OBJECT_IDENTIFIER, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (cms_content_type_from_der(&oid, &tlv, &tlvlen) != 1
+		|| asn1_check(oid == OID_cms_data) != 1) {
+		error_print();
+		return -1;
+	}
+	if ((ret = cms_stream_tlv_from_der(ASN1_TAG_SEQUENCE, &tlv, &tlvlen, buf, buflen, pos)) != 1) {
+		goto end;
+	}
+	if (x509_encryption_algor_from_der(&enc_algor, &iv, &ivlen, &tlv, &tlvlen) != 1
+		|| asn1_check(enc_algor == OID_sm4_cbc) != 1
+		|| asn1_check(ivlen == SM4_BLOCK_SIZE) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (indefinite) {
+		if (explicit_len != CMS_CONTENT_LENGTH_UNKNOWN
+			|| enveloped_data_len != CMS_CONTENT_LENGTH_UNKNOWN
+			|| enced_content_info_len != CMS_CONTENT_LENGTH_UNKNOWN) {
+			error_print();
+			return -1;
+		}
+		if ((ret = cms_stream_header_from_der(ASN1_TAG_EXPLICIT(0), &enced_content_len, buf, buflen, pos)) != 1) {
+			goto end;
+		}
+		if (enced_content_len != CMS_CONTENT_LENGTH_UNKNOWN) {
+			error_print();
+			return -1;
+		}
+		ctx->trailer_len = sizeof(ctx->buf);
+	} else {
+		if ((ret = cms_stream_header_from_der(ASN1_TAG_IMPLICIT(0), &enced_content_len, buf, buflen, pos)) != 1) {
+			goto end;
+		}
+		if (!enced_content_len || enced_content_len % SM4_BLOCK_SIZE
+			|| enced_content_len > end - *pos
+			|| end - *pos - enced_content_len > sizeof(ctx->buf)) {
+			error_print();
+			return -1;
+		}
+		ctx->content_left = enced_content_len;
+		ctx->trailer_len = end - *pos - enced_content_len;
+	}
+
+	// the header is complete, decrypt the content encryption key
+	ret = 0;
+	while (rcpt_infos_len) {
+		if ((ret = cms_recipient_info_decrypt_from_der(ctx->rcpt_key,
+			ctx->rcpt_issuer, ctx->rcpt_issuer_len,
+			ctx->rcpt_serial, ctx->rcpt_serial_len,
+			key, &keylen, sizeof(key),
+			&rcpt_infos, &rcpt_infos_len)) < 0) {
+			error_print();
+			return -1;
+		} else if (ret) {
+			break;
+		}
+	}
+	if (!ret || keylen != SM4_KEY_SIZE) {
+		gmssl_secure_clear(key, sizeof(key));
+		error_print();
+		return -1;
+	}
+	ret = sm4_cbc_decrypt_init(&ctx->sm4_ctx, key, iv);
+	gmssl_secure_clear(key, sizeof(key));
+	if (ret != 1) {
+		error_print();
+		return -1;
+	}
+	ctx->indefinite = indefinite;
+	return 1;
+
+end:
+	if (ret < 0) error_print();
+	return ret;
+}
+
+int cms_deenvelop_update(CMS_DEENVELOP_CTX *ctx, const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	size_t len;
+	size_t pos;
+	size_t seglen;
+	int ret;
+
+	if (!ctx || (!in && inlen) || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+
+	while (inlen) {
+		switch (ctx->state) {
+		case CMS_STREAM_HEADER:
+			len = sizeof(ctx->buf) - ctx->buflen;
+			if (len > inlen) len = inlen;
+			memcpy(ctx->buf + ctx->buflen, in, len);
+			ctx->buflen += len;
+			if ((ret = cms_deenvelop_header_from_der(ctx, &pos)) < 0) {
+				error_print();
+				return -1;
+			}
+			if (ret == 0) {
+				if (ctx->buflen == sizeof(ctx->buf)) {
+					error_print();
+					return -1;
+				}
+				in += len;
+				inlen -= len;
+				break;
+			}
+			len -= ctx->buflen - pos;
+			in += len;
+			inlen -= len;
+			ctx->buflen = 0;
+			ctx->state = ctx->indefinite ? CMS_STREAM_SEGMENT_HEADER : CMS_STREAM_CONTENT;
+			break;
+
+		case CMS_STREAM_SEGMENT_HEADER:
+			// a segment header is at most 6 bytes, feed it byte by byte
+			ctx->buf[ctx->buflen++] = *in++;
+			inlen--;
+			if (ctx->buf[0] == 0) {
+				if (ctx->buflen < sizeof(cms_end_of_contents)) {
+					break;
+				}
+				if (ctx->buf[1] != 0) {
+					error_print();
+					return -1;
+				}
+				ctx->buflen = 0;
+				ctx->state = CMS_STREAM_TRAILER;
+				break;
+			}
+			pos = 0;
+			if ((ret = cms_stream_header_from_der(ASN1_TAG_OCTET_STRING, &seglen,
+				ctx->buf, ctx->buflen, &pos)) < 0) {
+				error_print();
+				return -1;
+			}
+			if (ret == 0) {
+				if (ctx->buflen == CMS_STREAM_SEGMENT_HEADER_SIZE) {
+					error_print();
+					return -1;
+				}
+				break;
+			}
+			ctx->buflen = 0;
+			if (seglen) {
+				ctx->content_left = seglen;
+				ctx->state = CMS_STREAM_CONTENT;
+			}
+			break;
+
+		case CMS_STREAM_CONTENT:
+			len = inlen < ctx->content_left ? inlen : ctx->content_left;
+			if (sm4_cbc_decrypt_update(&ctx->sm4_ctx, in, len, out, &seglen) != 1) {
+				error_print();
+				return -1;
+			}
+			out += seglen;
+			*outlen += seglen;
+			in += len;
+			inlen -= len;
+			if (!(ctx->content_left -= len)) {
+				ctx->state = ctx->indefinite ? CMS_STREAM_SEGMENT_HEADER : CMS_STREAM_TRAILER;
+			}
+			break;
+
+		case CMS_STREAM_TRAILER:
+			if (inlen > ctx->trailer_len - ctx->buflen) {
+				error_print();
+				return -1;
+			}
+			memcpy(ctx->buf + ctx->buflen, in, inlen);
+			ctx->buflen += inlen;
+			inlen = 0;
+			break;
+
+		default:
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int cms_deenvelop_finish(CMS_DEENVELOP_CTX *ctx, uint8_t *out, size_t *outlen)
+{
+	const uint8_t *p;
+	size_t len;
+	const uint8_t *shared_info1;
+	size_t shared_info1_len;
+	const uint8_t *shared_info2;
+	size_t shared_info2_len;
+	uint8_t end_of_contents[8] = {0};
+
+	if (!ctx || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (ctx->state != CMS_STREAM_TRAILER
+		|| (!ctx->indefinite && ctx->buflen != ctx->trailer_len)) {
+		error_print();
+		return -1;
+	}
+	if (sm4_cbc_decrypt_finish(&ctx->sm4_ctx, out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	gmssl_secure_clear(&ctx->sm4_ctx, sizeof(SM4_CBC_CTX));
+
+	p = ctx->buf;
+	len = ctx->buflen;
+	if (asn1_implicit_octet_string_from_der(1, &shared_info1, &shared_info1_len, &p, &len) < 0
+		|| asn1_implicit_octet_string_from_der(2, &shared_info2, &shared_info2_len, &p, &len) < 0) {
+		error_print();
+		return -1;
+	}
+	// EncryptedContentInfo, EnvelopedData, [0] and ContentInfo
+	if (ctx->indefinite) {
+		if (len != sizeof(end_of_contents) || memcmp(p, end_of_contents, len) != 0) {
+			error_print();
+			return -1;
+		}
+	} else if (asn1_length_is_zero(len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
 int cms_to_pem(const uint8_t *cms, size_t cms_len, FILE *fp)
 {
 	if (pem_write(fp, PEM_CMS, cms, cms_len) != 1) {
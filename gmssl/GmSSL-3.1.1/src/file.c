@@ -12,7 +12,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+#include <gmssl/file.h>
 #include <gmssl/error.h>
 
 
@@ -61,3 +66,43 @@ end:
 	return ret;
 }
 
+int file_map(FILE *fp, const uint8_t **data, size_t *datalen)
+{
+#ifndef WIN32
+	int fd;
+	struct stat st;
+	void *p;
+
+	if (!fp || !data || !datalen) {
+		error_print();
+		return -1;
+	}
+	fd = fileno(fp);
+	if (fstat(fd, &st) < 0) {
+		error_print();
+		return -1;
+	}
+	// pipes, devices and empty files are left to fread()
+	if (!S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+		return 0;
+	}
+	if ((p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		return 0;
+	}
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	*data = p;
+	*datalen = (size_t)st.st_size;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void file_unmap(const uint8_t *data, size_t datalen)
+{
+#ifndef WIN32
+	if (data) {
+		munmap((void *)data, datalen);
+	}
+#endif
+}
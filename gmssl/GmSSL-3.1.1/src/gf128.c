@@ -77,16 +77,12 @@ int gf128_print(FILE *fp, int fmt, int ind, const char *label, gf128_t a)
 
 static uint64_t reverse_bits(uint64_t a)
 {
-	uint64_t r = 0;
-	int i;
-
-	for (i = 0; i < 63; i++) {
-		r |= a & 1;
-		r <<= 1;
-		a >>= 1;
-	}
-	r |= a & 1;
-	return r;
+	a = ((a & 0x5555555555555555ULL) << 1) | ((a >> 1) & 0x5555555555555555ULL);
+	a = ((a & 0x3333333333333333ULL) << 2) | ((a >> 2) & 0x3333333333333333ULL);
+	a = ((a & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((a >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+	a = ((a & 0x00FF00FF00FF00FFULL) << 8) | ((a >> 8) & 0x00FF00FF00FF00FFULL);
+	a = ((a & 0x0000FFFF0000FFFFULL) << 16) | ((a >> 16) & 0x0000FFFF0000FFFFULL);
+	return (a << 32) | (a >> 32);
 }
 
 gf128_t gf128_from_bytes(const uint8_t p[16])
@@ -117,46 +113,56 @@ gf128_t gf128_add(gf128_t a, gf128_t b)
 	return r;
 }
 
-gf128_t gf128_mul(gf128_t a, gf128_t b)
+/*
+Constant-time carry-less multiplication with integer multiplications, the operands are
+split into 4 interleaved parts with 3-bit holes so the carries never reach the bits that
+are kept (the bmul64 of BearSSL ghash_ctmul64.c). The high half of the 128-bit product is
+the low half of the product of the bit-reversed operands.
+*/
+static uint64_t bmul64(uint64_t x, uint64_t y)
 {
-	gf128_t r = {0, 0};
-	uint64_t mask = (uint64_t)1 << 63;
-	int i;
+	const uint64_t m0 = 0x1111111111111111ULL;
+	const uint64_t m1 = 0x2222222222222222ULL;
+	const uint64_t m2 = 0x4444444444444444ULL;
+	const uint64_t m3 = 0x8888888888888888ULL;
+	uint64_t x0 = x & m0, x1 = x & m1, x2 = x & m2, x3 = x & m3;
+	uint64_t y0 = y & m0, y1 = y & m1, y2 = y & m2, y3 = y & m3;
+	uint64_t z0, z1, z2, z3;
+
+	z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+	z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+	z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+	z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+	return (z0 & m0) | (z1 & m1) | (z2 & m2) | (z3 & m3);
+}
 
-	for (i = 0; i < 64; i++) {
-		if (r.hi & mask) {
-			r.hi = r.hi << 1 | r.lo >> 63;
-			r.lo = (r.lo << 1);
-			r.lo ^= 0x87;
-		} else {
-			r.hi = r.hi << 1 | r.lo >> 63;
-			r.lo = r.lo << 1;
-		}
-
-		if (b.hi & mask) {
-			r.hi ^= a.hi;
-			r.lo ^= a.lo;
-		}
-
-		b.hi <<= 1;
-	}
-	for (i = 0; i < 64; i++) {
-		if (r.hi & mask) {
-			r.hi = r.hi << 1 | r.lo >> 63;
-			r.lo = (r.lo << 1) ^ 0x87;
-		} else {
-			r.hi = r.hi << 1 | r.lo >> 63;
-			r.lo = r.lo << 1;
-		}
-
-		if (b.lo & mask) {
-			r.hi ^= a.hi;
-			r.lo ^= a.lo;
-		}
-
-		b.lo <<= 1;
-	}
+static void clmul64(uint64_t x, uint64_t y, uint64_t *lo, uint64_t *hi)
+{
+	*lo = bmul64(x, y);
+	*hi = reverse_bits(bmul64(reverse_bits(x), reverse_bits(y))) >> 1;
+}
 
+gf128_t gf128_mul(gf128_t a, gf128_t b)
+{
+	gf128_t r;
+	uint64_t p0, p1, p2, p3;
+	uint64_t m0, m1;
+	uint64_t over;
+
+	// Karatsuba, (p3:p2:p1:p0) = a * b
+	clmul64(a.lo, b.lo, &p0, &p1);
+	clmul64(a.hi, b.hi, &p2, &p3);
+	clmul64(a.lo ^ a.hi, b.lo ^ b.hi, &m0, &m1);
+	m0 ^= p0 ^ p2;
+	m1 ^= p1 ^ p3;
+	p1 ^= m0;
+	p2 ^= m1;
+
+	// x^128 = x^7 + x^2 + x + 1, the bits shifted beyond x^127 are reduced again
+	over = (p3 >> 63) ^ (p3 >> 62) ^ (p3 >> 57);
+	r.lo = p0 ^ p2 ^ (p2 << 1) ^ (p2 << 2) ^ (p2 << 7)
+		^ over ^ (over << 1) ^ (over << 2) ^ (over << 7);
+	r.hi = p1 ^ p3 ^ (p3 << 1 | p2 >> 63) ^ (p3 << 2 | p2 >> 62) ^ (p3 << 7 | p2 >> 57);
 	return r;
 }
 
@@ -84,6 +84,11 @@
 #include <gmssl/oid.h>
 #include <gmssl/endian.h>
 #include <gmssl/mem.h>
+#include <gmssl/sm3.h>
+#include <gmssl/pbkdf2.h>
+#ifdef SM3_X8_AVX2
+#include <gmssl/sm3_x8_avx2.h>
+#endif
 
 int pbkdf2_genkey(const DIGEST *digest,
 	const char *pass, size_t passlen,
@@ -98,6 +103,10 @@ int pbkdf2_genkey(const DIGEST *digest,
 	uint8_t key_block[64];
 	size_t len;
 
+	if (digest == DIGEST_sm3()) {
+		return pbkdf2_hmac_sm3_genkey(pass, passlen, salt, saltlen, count, outlen, out);
+	}
+
 	hmac_init(&ctx_tmpl, digest, (uint8_t *)pass, passlen);
 
 	while (outlen > 0) {
@@ -136,53 +145,243 @@ int pbkdf2_genkey(const DIGEST *digest,
 	return 1;
 }
 
-int pbkdf2_hmac_sm3_genkey(
-	const char *pass, size_t passlen,
-	const uint8_t *salt, size_t saltlen, size_t count,
-	size_t outlen, uint8_t *out)
+/*
+PBKDF2-HMAC-SM3
+
+	HMAC(P, m) = SM3((P ^ opad) || SM3((P ^ ipad) || m)), the SM3 states after the
+	ipad and opad key blocks are computed once. Every U_j is 32 bytes, so
+	U_{j+1} = PRF(P, U_j) is one compression from each of the two states, the padding
+	of the single message block is constant.
+
+	The blocks T_i of all the passwords are independent. With SM3_X8_AVX2 they are
+	computed in the 8 lanes of sm3_x8_compress_lanes(), one (password, i) per lane,
+	if the CPU has AVX2.
+*/
+
+#define PBKDF2_SM3_LANES		8
+#define PBKDF2_SM3_X8_MIN_LANES		3 // fewer lanes are faster with the scalar SM3
+
+typedef struct {
+	uint32_t ipad[8];
+	uint32_t opad[8];
+	uint32_t U[8];
+	uint32_t T[8];
+} PBKDF2_SM3_LANE;
+
+static void pbkdf2_hmac_sm3_lane_init(PBKDF2_SM3_LANE *lane,
+	const char *pass, size_t passlen, const uint8_t *salt, size_t saltlen, uint32_t index)
 {
-	SM3_HMAC_CTX ctx;
-	SM3_HMAC_CTX ctx_tmpl;
-	uint32_t iter = 1;
-	uint8_t iter_be[4];
-	uint8_t tmp_block[SM3_DIGEST_SIZE];
-	uint8_t key_block[SM3_DIGEST_SIZE];
-	// TODO: a bug in 3.0.0 is fixied. How to update release version 3.0.0 ? A test is also required!
+	SM3_CTX ctx;
+	uint8_t key[SM3_BLOCK_SIZE] = {0};
+	uint8_t index_be[4];
+	uint8_t dgst[SM3_DIGEST_SIZE];
+	int i;
+
+	if (passlen <= SM3_BLOCK_SIZE) {
+		memcpy(key, pass, passlen);
+	} else {
+		sm3_digest((uint8_t *)pass, passlen, key);
+	}
+	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
+		key[i] ^= 0x36;
+	}
+	sm3_init(&ctx);
+	sm3_compress_blocks(ctx.digest, key, 1);
+	memcpy(lane->ipad, ctx.digest, sizeof(lane->ipad));
+	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
+		key[i] ^= 0x36 ^ 0x5c;
+	}
+	sm3_init(&ctx);
+	sm3_compress_blocks(ctx.digest, key, 1);
+	memcpy(lane->opad, ctx.digest, sizeof(lane->opad));
+
+	// U_1 = PRF(P, S || INT(i))
+	PUTU32(index_be, index);
+	sm3_init(&ctx);
+	memcpy(ctx.digest, lane->ipad, sizeof(lane->ipad));
+	ctx.nblocks = 1;
+	sm3_update(&ctx, salt, saltlen);
+	sm3_update(&ctx, index_be, sizeof(index_be));
+	sm3_finish(&ctx, dgst);
+	sm3_init(&ctx);
+	memcpy(ctx.digest, lane->opad, sizeof(lane->opad));
+	ctx.nblocks = 1;
+	sm3_update(&ctx, dgst, sizeof(dgst));
+	sm3_finish(&ctx, dgst);
+
+	for (i = 0; i < 8; i++) {
+		lane->U[i] = lane->T[i] = GETU32(dgst + 4*i);
+	}
 
-	sm3_hmac_init(&ctx_tmpl, (uint8_t *)pass, passlen);
+	gmssl_secure_clear(&ctx, sizeof(ctx));
+	gmssl_secure_clear(key, sizeof(key));
+	gmssl_secure_clear(dgst, sizeof(dgst));
+}
 
-	while (outlen > 0) {
-		size_t i;
+static void pbkdf2_hmac_sm3_lane_iterate(PBKDF2_SM3_LANE *lane, size_t iter)
+{
+	uint8_t block[SM3_BLOCK_SIZE] = {0};
+	uint32_t digest[8];
+	size_t j;
+	int i;
+
+	// a 32-byte message after the 64-byte key block
+	block[SM3_DIGEST_SIZE] = 0x80;
+	PUTU32(block + 60, (SM3_BLOCK_SIZE + SM3_DIGEST_SIZE) * 8);
+
+	for (j = 1; j < iter; j++) {
+		for (i = 0; i < 8; i++) {
+			PUTU32(block + 4*i, lane->U[i]);
+		}
+		memcpy(digest, lane->ipad, sizeof(digest));
+		sm3_compress_blocks(digest, block, 1);
 
-		PUTU32(iter_be, iter);
-		iter++;
+		for (i = 0; i < 8; i++) {
+			PUTU32(block + 4*i, digest[i]);
+		}
+		memcpy(digest, lane->opad, sizeof(digest));
+		sm3_compress_blocks(digest, block, 1);
 
-		ctx = ctx_tmpl;
-		sm3_hmac_update(&ctx, salt, saltlen);
-		sm3_hmac_update(&ctx, iter_be, sizeof(iter_be));
-		sm3_hmac_finish(&ctx, tmp_block);
-		memcpy(key_block, tmp_block, SM3_DIGEST_SIZE);
+		for (i = 0; i < 8; i++) {
+			lane->U[i] = digest[i];
+			lane->T[i] ^= digest[i];
+		}
+	}
 
-		for (i = 1; i < count; i++) {
-			ctx = ctx_tmpl;
-			sm3_hmac_update(&ctx, tmp_block, SM3_DIGEST_SIZE);
-			sm3_hmac_finish(&ctx, tmp_block);
-			memxor(key_block, tmp_block, SM3_DIGEST_SIZE);
+	gmssl_secure_clear(block, sizeof(block));
+	gmssl_secure_clear(digest, sizeof(digest));
+}
+
+#ifdef SM3_X8_AVX2
+static void pbkdf2_hmac_sm3_x8_iterate(PBKDF2_SM3_LANE lanes[8], size_t iter)
+{
+	uint32_t ipad[8][8];
+	uint32_t opad[8][8];
+	uint32_t T[8][8];
+	uint32_t digest[8][8];
+	uint32_t words[16][8] = {{0}};
+	size_t j;
+	int i, l;
+
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < 8; l++) {
+			ipad[i][l] = lanes[l].ipad[i];
+			opad[i][l] = lanes[l].opad[i];
+			T[i][l] = lanes[l].T[i];
+			words[i][l] = lanes[l].U[i];
 		}
+	}
+	for (l = 0; l < 8; l++) {
+		words[8][l] = 0x80000000;
+		words[15][l] = (SM3_BLOCK_SIZE + SM3_DIGEST_SIZE) * 8;
+	}
 
-		if (outlen < SM3_DIGEST_SIZE) {
-			memcpy(out, key_block, outlen);
-			out += outlen;
-			outlen = 0;
-		} else {
-			memcpy(out, key_block, SM3_DIGEST_SIZE);
-			out += SM3_DIGEST_SIZE;
-			outlen -= SM3_DIGEST_SIZE;
+	// the words stay in the lane layout, the digest of a compression is the next message
+	for (j = 1; j < iter; j++) {
+		memcpy(digest, ipad, sizeof(digest));
+		sm3_x8_compress_lanes(digest, words);
+		memcpy(words, digest, sizeof(digest));
+		memcpy(digest, opad, sizeof(digest));
+		sm3_x8_compress_lanes(digest, words);
+		memcpy(words, digest, sizeof(digest));
+		for (i = 0; i < 8; i++) {
+			for (l = 0; l < 8; l++) {
+				T[i][l] ^= digest[i][l];
+			}
 		}
 	}
 
-	memset(&ctx, 0, sizeof(ctx));
-	memset(key_block, 0, sizeof(key_block));
-	memset(tmp_block, 0, sizeof(key_block));
+	for (l = 0; l < 8; l++) {
+		for (i = 0; i < 8; i++) {
+			lanes[l].T[i] = T[i][l];
+		}
+	}
+
+	gmssl_secure_clear(ipad, sizeof(ipad));
+	gmssl_secure_clear(opad, sizeof(opad));
+	gmssl_secure_clear(T, sizeof(T));
+	gmssl_secure_clear(digest, sizeof(digest));
+	gmssl_secure_clear(words, sizeof(words));
+}
+#endif
+
+int pbkdf2_hmac_sm3_genkey_batch(
+	const char *pass[], const size_t passlen[], const uint8_t *salt[], const size_t saltlen[],
+	size_t count, size_t iter, size_t outlen, uint8_t *out)
+{
+	PBKDF2_SM3_LANE lanes[PBKDF2_SM3_LANES];
+	size_t nblocks;
+	size_t njobs;
+	size_t job;
+	size_t n;
+	size_t l;
+#ifdef SM3_X8_AVX2
+	int x8 = sm3_x8_avx2_cpu_support();
+#endif
+
+	if (!pass || !passlen || !salt || !saltlen || !out) {
+		error_print();
+		return -1;
+	}
+	if (!count || !iter || !outlen) {
+		error_print();
+		return -1;
+	}
+	nblocks = (outlen + SM3_DIGEST_SIZE - 1) / SM3_DIGEST_SIZE;
+	if (nblocks > UINT32_MAX || count > SIZE_MAX / nblocks) {
+		error_print();
+		return -1;
+	}
+	njobs = count * nblocks;
+
+	// the block T_i of the k-th password is the job k * nblocks + (i - 1)
+	for (job = 0; job < njobs; job += n) {
+		n = njobs - job;
+		if (n > PBKDF2_SM3_LANES) {
+			n = PBKDF2_SM3_LANES;
+		}
+		for (l = 0; l < n; l++) {
+			size_t k = (job + l) / nblocks;
+			size_t i = (job + l) % nblocks;
+			pbkdf2_hmac_sm3_lane_init(&lanes[l], pass[k], passlen[k], salt[k], saltlen[k], (uint32_t)(i + 1));
+		}
+#ifdef SM3_X8_AVX2
+		if (x8 && n >= PBKDF2_SM3_X8_MIN_LANES) {
+			for (l = n; l < PBKDF2_SM3_LANES; l++) {
+				lanes[l] = lanes[0];
+			}
+			pbkdf2_hmac_sm3_x8_iterate(lanes, iter);
+		} else
+#endif
+		{
+			for (l = 0; l < n; l++) {
+				pbkdf2_hmac_sm3_lane_iterate(&lanes[l], iter);
+			}
+		}
+		for (l = 0; l < n; l++) {
+			size_t k = (job + l) / nblocks;
+			size_t i = (job + l) % nblocks;
+			uint8_t *p = out + k * outlen + i * SM3_DIGEST_SIZE;
+			size_t len = outlen - i * SM3_DIGEST_SIZE;
+			uint8_t block[SM3_DIGEST_SIZE];
+			int j;
+
+			for (j = 0; j < 8; j++) {
+				PUTU32(block + 4*j, lanes[l].T[j]);
+			}
+			memcpy(p, block, len < sizeof(block) ? len : sizeof(block));
+			gmssl_secure_clear(block, sizeof(block));
+		}
+	}
+
+	gmssl_secure_clear(lanes, sizeof(lanes));
 	return 1;
 }
+
+int pbkdf2_hmac_sm3_genkey(
+	const char *pass, size_t passlen,
+	const uint8_t *salt, size_t saltlen, size_t count,
+	size_t outlen, uint8_t *out)
+{
+	return pbkdf2_hmac_sm3_genkey_batch(&pass, &passlen, &salt, &saltlen, 1, count, outlen, out);
+}
@@ -12,7 +12,14 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <gmssl/pem.h>
+#include <gmssl/file.h>
 #include <gmssl/error.h>
 
 
@@ -125,3 +132,262 @@ int pem_read(FILE *fp, const char *name, uint8_t *data, size_t *datalen, size_t
 	*datalen += len;
 	return 1;
 }
+
+int pem_write_init(PEM_CTX *ctx, FILE *fp, const char *name)
+{
+	if (!ctx || !fp || !name) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(PEM_CTX));
+	ctx->fp = fp;
+	ctx->name = name;
+	if (fprintf(fp, "-----BEGIN %s-----\n", name) < 0) {
+		error_print();
+		return -1;
+	}
+	base64_encode_init(&ctx->base64_ctx);
+	return 1;
+}
+
+int pem_write_update(PEM_CTX *ctx, const uint8_t *in, size_t inlen)
+{
+	uint8_t out[BASE64_ENCODE_LENGTH(768)];
+	int len, outlen;
+
+	while (inlen) {
+		len = inlen < 768 ? (int)inlen : 768;
+		base64_encode_update(&ctx->base64_ctx, in, len, out, &outlen);
+		if (fwrite(out, 1, outlen, ctx->fp) != (size_t)outlen) {
+			error_print();
+			return -1;
+		}
+		in += len;
+		inlen -= len;
+	}
+	return 1;
+}
+
+int pem_write_finish(PEM_CTX *ctx)
+{
+	uint8_t out[168];
+	int outlen;
+
+	base64_encode_finish(&ctx->base64_ctx, out, &outlen);
+	if (fwrite(out, 1, outlen, ctx->fp) != (size_t)outlen
+		|| fprintf(ctx->fp, "-----END %s-----\n", ctx->name) < 0) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int pem_read_init(PEM_CTX *ctx, FILE *fp, const char *name)
+{
+	char line[80];
+	char begin_line[80];
+
+	if (!ctx || !fp || !name) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(PEM_CTX));
+	ctx->fp = fp;
+	ctx->name = name;
+
+	snprintf(begin_line, sizeof(begin_line), "-----BEGIN %s-----", name);
+	if (!fgets(line, sizeof(line), fp)) {
+		error_print();
+		return -1;
+	}
+	remove_newline(line);
+	if (strcmp(line, begin_line) != 0) {
+		error_print();
+		return -1;
+	}
+	base64_decode_init(&ctx->base64_ctx);
+	return 1;
+}
+
+int pem_read_update(PEM_CTX *ctx, uint8_t *out, size_t *outlen, size_t maxlen)
+{
+	char line[80];
+	char end_line[80];
+	int len;
+
+	if (!ctx || !out || !outlen || maxlen < PEM_LINE_DECODE_SIZE) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+	if (ctx->done) {
+		return 0;
+	}
+	snprintf(end_line, sizeof(end_line), "-----END %s-----", ctx->name);
+
+	while (maxlen - *outlen >= PEM_LINE_DECODE_SIZE) {
+		if (!fgets(line, sizeof(line), ctx->fp)) {
+			error_print();
+			return -1;
+		}
+		remove_newline(line);
+
+		if (strcmp(line, end_line) == 0) {
+			if (base64_decode_finish(&ctx->base64_ctx, out + *outlen, &len) < 0) {
+				error_print();
+				return -1;
+			}
+			*outlen += len;
+			ctx->done = 1;
+			break;
+		}
+		if (base64_decode_update(&ctx->base64_ctx, (uint8_t *)line, (int)strlen(line),
+			out + *outlen, &len) < 0) {
+			error_print();
+			return -1;
+		}
+		*outlen += len;
+	}
+	return 1;
+}
+
+// find the next line starting with '-' (base64 has no '-'), return its length without the newline
+static const char *pem_next_boundary(const char *p, const char *end, const char *text, size_t *linelen)
+{
+	const char *eol;
+
+	while (p < end && (p = memchr(p, '-', end - p)) != NULL) {
+		if (p == text || p[-1] == '\n') {
+			if (!(eol = memchr(p, '\n', end - p))) {
+				eol = end;
+			}
+			*linelen = eol - p;
+			if (*linelen && p[*linelen - 1] == '\r') {
+				(*linelen)--;
+			}
+			return p;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+static int pem_text_to_der(const char *text, size_t textlen, const char *name, uint8_t *out, size_t *outlen)
+{
+	char begin_line[80];
+	char end_line[80];
+	size_t begin_len, end_len;
+	const char *end = text + textlen;
+	const char *p = text;
+	const char *body;
+	size_t linelen;
+	size_t len;
+
+	begin_len = snprintf(begin_line, sizeof(begin_line), "-----BEGIN %s-----", name);
+	end_len = snprintf(end_line, sizeof(end_line), "-----END %s-----", name);
+	*outlen = 0;
+
+	while ((p = pem_next_boundary(p, end, text, &linelen)) != NULL) {
+		if (linelen != begin_len || memcmp(p, begin_line, begin_len) != 0) {
+			// other blocks are skipped
+			p += linelen;
+			continue;
+		}
+		if (!(body = memchr(p, '\n', end - p))) {
+			error_print();
+			return -1;
+		}
+		body++;
+		if (!(p = pem_next_boundary(body, end, text, &linelen))
+			|| linelen != end_len || memcmp(p, end_line, end_len) != 0) {
+			error_print();
+			return -1;
+		}
+		if (base64_decode((uint8_t *)body, p - body, out, &len) != 1) {
+			error_print();
+			return -1;
+		}
+		out += len;
+		*outlen += len;
+		p += linelen;
+	}
+	return 1;
+}
+
+int pem_blocks_new_from_file(const char *file, const char *name, uint8_t **out, size_t *outlen)
+{
+	int ret = -1;
+	char *text = NULL;
+	size_t textlen = 0;
+	uint8_t *der = NULL;
+	size_t derlen;
+
+	if (!file || !name || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (strlen(name) > 64) {
+		error_print();
+		return -1;
+	}
+
+#ifndef WIN32
+	{
+		int fd;
+		struct stat st;
+
+		if ((fd = open(file, O_RDONLY)) < 0) {
+			error_print();
+			return -1;
+		}
+		if (fstat(fd, &st) < 0) {
+			close(fd);
+			error_print();
+			return -1;
+		}
+		textlen = (size_t)st.st_size;
+		if (textlen) {
+			text = mmap(NULL, textlen, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (text == MAP_FAILED) {
+				close(fd);
+				error_print();
+				return -1;
+			}
+			madvise(text, textlen, MADV_SEQUENTIAL);
+		}
+		close(fd);
+	}
+#else
+	if (file_read_all(file, (uint8_t **)&text, &textlen) != 1) {
+		error_print();
+		return -1;
+	}
+#endif
+
+	// the DER of all the blocks is at most 3/4 of the text
+	if (!(der = malloc(textlen / 4 * 3 + 3))) {
+		error_print();
+		goto end;
+	}
+	if (pem_text_to_der(text, textlen, name, der, &derlen) != 1) {
+		error_print();
+		goto end;
+	}
+	if (!derlen) {
+		ret = 0;
+		goto end;
+	}
+	*out = der;
+	*outlen = derlen;
+	der = NULL;
+	ret = 1;
+
+end:
+#ifndef WIN32
+	if (text) munmap(text, textlen);
+#else
+	if (text) free(text);
+#endif
+	if (der) free(der);
+	return ret;
+}
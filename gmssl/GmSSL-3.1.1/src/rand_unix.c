@@ -1,5 +1,5 @@
 /*
- *  Copyright 2014-2022 The GmSSL Project. All Rights Reserved.
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
  *
  *  Licensed under the Apache License, Version 2.0 (the License); you may
  *  not use this file except in compliance with the License.
@@ -8,34 +8,234 @@
  */
 
 
-
+#include <time.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <pthread.h>
 #include <unistd.h> // in Linux
 #ifdef APPLE
 #include <sys/random.h> // in Apple
 #endif
+#include <gmssl/mem.h>
 #include <gmssl/rand.h>
+#include <gmssl/digest.h>
+#include <gmssl/hash_drbg.h>
+#ifdef INTEL_RDSEED
+#include <gmssl/rdrand.h>
+#endif
 #include <gmssl/error.h>
 
 
-#define RAND_MAX_BUF_SIZE 256 // requirement of getentropy()
+/*
+rand_bytes() is served by a per-thread SM3 Hash_DRBG seeded from getentropy(), so most
+calls are a memcpy from a small per-thread buffer without syscalls or locks.
 
-int rand_bytes(uint8_t *buf, size_t len)
+	* Small requests are taken from a buffer of RAND_DRBG_BUF_SIZE bytes, large requests
+	  are generated directly in chunks of RAND_DRBG_MAX_REQUEST bytes.
+	* The DRBG is reseeded from getentropy() after RAND_DRBG_RESEED_COUNT generate calls
+	  or RAND_DRBG_RESEED_TIME seconds.
+	* A child process re-instantiates the DRBG and drops the buffered output inherited
+	  from the parent, detected by pthread_atfork() and getpid().
+	* The state is wiped when the thread exits.
+*/
+
+#define RAND_MAX_BUF_SIZE	256 // requirement of getentropy()
+#define RAND_DRBG_BUF_SIZE	512
+#define RAND_DRBG_MAX_REQUEST	65536 // 2^19 bits, table 2 of nist sp 800-90a rev.1
+#define RAND_DRBG_RESEED_COUNT	(1 << 16)
+#define RAND_DRBG_RESEED_TIME	300
+#define RAND_DRBG_ENTROPY_SIZE	48
+#define RAND_DRBG_NONCE_SIZE	16
+
+typedef struct {
+	HASH_DRBG drbg;
+	int initialized;
+	unsigned int fork_id;
+	pid_t pid;
+	time_t reseed_time;
+	uint64_t generate_count;
+	uint8_t buf[RAND_DRBG_BUF_SIZE];
+	size_t buflen; // unused output at the end of buf
+} RAND_DRBG_CTX;
+
+static __thread RAND_DRBG_CTX rand_drbg_ctx;
+static volatile unsigned int rand_fork_id = 0;
+static pthread_once_t rand_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rand_thread_key;
+static int rand_thread_key_ok = 0;
+
+
+static void rand_atfork_child(void)
 {
-	if (!buf) {
+	rand_fork_id++;
+}
+
+static void rand_thread_cleanup(void *ptr)
+{
+	gmssl_secure_clear(ptr, sizeof(RAND_DRBG_CTX));
+}
+
+static void rand_once_init(void)
+{
+	pthread_atfork(NULL, NULL, rand_atfork_child);
+	if (pthread_key_create(&rand_thread_key, rand_thread_cleanup) == 0) {
+		rand_thread_key_ok = 1;
+	}
+}
+
+static int rand_entropy(uint8_t *buf, size_t len)
+{
+	while (len) {
+		size_t n = len < RAND_MAX_BUF_SIZE ? len : RAND_MAX_BUF_SIZE;
+		if (getentropy(buf, n) != 0) {
+			error_print();
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 1;
+}
+
+static int rand_drbg_instantiate(RAND_DRBG_CTX *ctx)
+{
+	uint8_t entropy[RAND_DRBG_ENTROPY_SIZE];
+	uint8_t nonce[RAND_DRBG_NONCE_SIZE];
+	struct {
+		pid_t pid;
+		const void *thread;
+		time_t now;
+	} personal;
+	int ret = -1;
+
+	gmssl_secure_clear(ctx, sizeof(RAND_DRBG_CTX));
+
+	memset(&personal, 0, sizeof(personal));
+	personal.pid = getpid();
+	personal.thread = ctx;
+	personal.now = time(NULL);
+
+	if (rand_entropy(entropy, sizeof(entropy)) != 1
+		|| rand_entropy(nonce, sizeof(nonce)) != 1) {
+		error_print();
+		goto end;
+	}
+#ifdef INTEL_RDSEED
+	{
+		uint8_t seed[RAND_DRBG_NONCE_SIZE];
+		size_t i;
+		if (rdseed_bytes(seed, sizeof(seed)) == 1) {
+			for (i = 0; i < sizeof(seed); i++) {
+				nonce[i] ^= seed[i];
+			}
+		}
+		gmssl_secure_clear(seed, sizeof(seed));
+	}
+#endif
+	if (hash_drbg_init(&ctx->drbg, DIGEST_sm3(),
+		entropy, sizeof(entropy), nonce, sizeof(nonce),
+		(uint8_t *)&personal, sizeof(personal)) != 1) {
+		error_print();
+		goto end;
+	}
+	ctx->initialized = 1;
+	ctx->fork_id = rand_fork_id;
+	ctx->pid = personal.pid;
+	ctx->reseed_time = personal.now;
+	ret = 1;
+
+end:
+	gmssl_secure_clear(entropy, sizeof(entropy));
+	gmssl_secure_clear(nonce, sizeof(nonce));
+	return ret;
+}
+
+static int rand_drbg_reseed(RAND_DRBG_CTX *ctx, time_t now)
+{
+	uint8_t entropy[RAND_DRBG_ENTROPY_SIZE];
+
+	if (rand_entropy(entropy, sizeof(entropy)) != 1
+		|| hash_drbg_reseed(&ctx->drbg, entropy, sizeof(entropy), NULL, 0) != 1) {
+		gmssl_secure_clear(entropy, sizeof(entropy));
 		error_print();
 		return -1;
 	}
-	if (!len || len > RAND_MAX_BUF_SIZE) {
+	gmssl_secure_clear(entropy, sizeof(entropy));
+	ctx->reseed_time = now;
+	ctx->generate_count = 0;
+	return 1;
+}
+
+static int rand_drbg_generate(RAND_DRBG_CTX *ctx, uint8_t *out, size_t outlen)
+{
+	time_t now = time(NULL);
+
+	// the pid check also covers fork() of a process that never reached rand_once_init()
+	if (ctx->pid != getpid()) {
+		if (rand_drbg_instantiate(ctx) != 1) {
+			error_print();
+			return -1;
+		}
+	} else if (ctx->generate_count >= RAND_DRBG_RESEED_COUNT
+		|| now - ctx->reseed_time >= RAND_DRBG_RESEED_TIME
+		|| now < ctx->reseed_time) {
+		if (rand_drbg_reseed(ctx, now) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	while (outlen) {
+		size_t len = outlen < RAND_DRBG_MAX_REQUEST ? outlen : RAND_DRBG_MAX_REQUEST;
+		if (hash_drbg_generate(&ctx->drbg, NULL, 0, len, out) != 1) {
+			error_print();
+			return -1;
+		}
+		ctx->generate_count++;
+		out += len;
+		outlen -= len;
+	}
+	return 1;
+}
+
+int rand_bytes(uint8_t *buf, size_t len)
+{
+	RAND_DRBG_CTX *ctx = &rand_drbg_ctx;
+
+	if (!buf) {
 		error_print();
 		return -1;
 	}
-	if (getentropy(buf, len) != 0) {
+	if (!len) {
 		error_print();
 		return -1;
 	}
+
+	if (!ctx->initialized || ctx->fork_id != rand_fork_id) {
+		pthread_once(&rand_once, rand_once_init);
+		if (rand_drbg_instantiate(ctx) != 1) {
+			error_print();
+			return -1;
+		}
+		if (rand_thread_key_ok) {
+			pthread_setspecific(rand_thread_key, ctx);
+		}
+	}
+
+	if (len > RAND_DRBG_BUF_SIZE / 2) {
+		return rand_drbg_generate(ctx, buf, len);
+	}
+	if (len > ctx->buflen) {
+		if (rand_drbg_generate(ctx, ctx->buf, RAND_DRBG_BUF_SIZE) != 1) {
+			error_print();
+			return -1;
+		}
+		ctx->buflen = RAND_DRBG_BUF_SIZE;
+	}
+	// take from the end of the unused output and wipe it, so it is never returned twice
+	ctx->buflen -= len;
+	memcpy(buf, ctx->buf + ctx->buflen, len);
+	gmssl_secure_clear(ctx->buf + ctx->buflen, len);
 	return 1;
 }
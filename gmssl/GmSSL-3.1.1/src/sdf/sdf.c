@@ -11,8 +11,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#ifndef WIN32
+#include <time.h>
+#include <pthread.h>
+#endif
 #include <gmssl/sdf.h>
 #include <gmssl/sm2.h>
+#include <gmssl/mem.h>
+#include <gmssl/asn1.h>
 #include <gmssl/error.h>
 #include "sdf.h"
 #include "sdf_ext.h"
@@ -56,6 +63,41 @@ static int SDF_ECCSignature_to_SM2_SIGNATURE(const ECCSignature *ref, SM2_SIGNAT
 	return SDR_OK;
 }
 
+static void SM2_KEY_to_SDF_ECCrefPublicKey(const SM2_KEY *sm2_key, ECCrefPublicKey *ref)
+{
+	memset(ref, 0, sizeof(ECCrefPublicKey));
+	ref->bits = 256;
+	memcpy(ref->x + ECCref_MAX_LEN - 32, sm2_key->public_key.x, 32);
+	memcpy(ref->y + ECCref_MAX_LEN - 32, sm2_key->public_key.y, 32);
+}
+
+static void SM2_SIGNATURE_to_SDF_ECCSignature(const SM2_SIGNATURE *sig, ECCSignature *ref)
+{
+	memset(ref, 0, sizeof(ECCSignature));
+	memcpy(ref->r + ECCref_MAX_LEN - 32, sig->r, 32);
+	memcpy(ref->s + ECCref_MAX_LEN - 32, sig->s, 32);
+}
+
+static int SDF_ECCCipher_to_SM2_CIPHERTEXT(const ECCCipher *ref, SM2_CIPHERTEXT *c)
+{
+	if (memcmp(ref->x, zeros, sizeof(zeros)) != 0
+		|| memcmp(ref->y, zeros, sizeof(zeros)) != 0) {
+		error_print();
+		return -1;
+	}
+	if (ref->L < SM2_MIN_PLAINTEXT_SIZE || ref->L > SM2_MAX_PLAINTEXT_SIZE) {
+		error_print();
+		return -1;
+	}
+	memset(c, 0, sizeof(SM2_CIPHERTEXT));
+	memcpy(c->point.x, ref->x + ECCref_MAX_LEN - 32, 32);
+	memcpy(c->point.y, ref->y + ECCref_MAX_LEN - 32, 32);
+	memcpy(c->hash, ref->M, 32);
+	c->ciphertext_size = (uint8_t)ref->L;
+	memcpy(c->ciphertext, ref->C, ref->L);
+	return SDR_OK;
+}
+
 int sdf_load_library(const char *so_path, const char *vendor)
 {
 	if (SDF_LoadLibrary((char *)so_path, (char *)vendor) != SDR_OK) {
@@ -211,3 +253,476 @@ int sdf_close_device(SDF_DEVICE *dev)
 	memset(dev, 0, sizeof(SDF_DEVICE));
 	return 1;
 }
+
+int sdf_job_set_sign(SDF_JOB *job, const uint8_t dgst[32])
+{
+	if (!job || !dgst) {
+		error_print();
+		return -1;
+	}
+	memset(job, 0, sizeof(SDF_JOB));
+	job->type = SDF_JOB_SIGN;
+	memcpy(job->dgst, dgst, 32);
+	return 1;
+}
+
+int sdf_job_set_verify(SDF_JOB *job, const SM2_KEY *public_key, const uint8_t dgst[32],
+	const uint8_t *sig, size_t siglen)
+{
+	if (!job || !public_key || !dgst || !sig) {
+		error_print();
+		return -1;
+	}
+	if (!siglen || siglen > SM2_MAX_SIGNATURE_SIZE) {
+		error_print();
+		return -1;
+	}
+	memset(job, 0, sizeof(SDF_JOB));
+	job->type = SDF_JOB_VERIFY;
+	if (sm2_key_set_public_key(&job->public_key, &public_key->public_key) != 1) {
+		error_print();
+		return -1;
+	}
+	memcpy(job->dgst, dgst, 32);
+	memcpy(job->in, sig, siglen);
+	job->inlen = siglen;
+	return 1;
+}
+
+int sdf_job_set_encrypt(SDF_JOB *job, const SM2_KEY *public_key, const uint8_t *in, size_t inlen)
+{
+	if (!job || !public_key || !in) {
+		error_print();
+		return -1;
+	}
+	if (inlen < SM2_MIN_PLAINTEXT_SIZE || inlen > SM2_MAX_PLAINTEXT_SIZE) {
+		error_print();
+		return -1;
+	}
+	memset(job, 0, sizeof(SDF_JOB));
+	job->type = SDF_JOB_ENCRYPT;
+	if (sm2_key_set_public_key(&job->public_key, &public_key->public_key) != 1) {
+		error_print();
+		return -1;
+	}
+	memcpy(job->in, in, inlen);
+	job->inlen = inlen;
+	return 1;
+}
+
+void sdf_job_set_callback(SDF_JOB *job, SDF_JOB_CALLBACK callback, void *arg)
+{
+	job->callback = callback;
+	job->callback_arg = arg;
+}
+
+// returns 0 if the signature of a verify job is invalid
+static int sdf_job_do(void *hSession, int key_index, SDF_JOB *job)
+{
+	ECCrefPublicKey eccPublicKey;
+	ECCSignature eccSignature;
+	struct {
+		ECCCipher cipher;
+		uint8_t buf[SM2_MAX_PLAINTEXT_SIZE];
+	} eccCipher;
+	SM2_SIGNATURE sig;
+	SM2_CIPHERTEXT ciphertext;
+	const uint8_t *cp;
+	uint8_t *p;
+	size_t len;
+	int rv;
+
+	switch (job->type) {
+	case SDF_JOB_SIGN:
+		if (SDF_InternalSign_ECC(hSession, key_index, job->dgst, 32, &eccSignature) != SDR_OK
+			|| SDF_ECCSignature_to_SM2_SIGNATURE(&eccSignature, &sig) != SDR_OK) {
+			error_print();
+			return -1;
+		}
+		p = job->out;
+		job->outlen = 0;
+		if (sm2_signature_to_der(&sig, &p, &job->outlen) != 1) {
+			error_print();
+			return -1;
+		}
+		return 1;
+
+	case SDF_JOB_VERIFY:
+		cp = job->in;
+		len = job->inlen;
+		if (sm2_signature_from_der(&sig, &cp, &len) != 1
+			|| asn1_length_is_zero(len) != 1) {
+			error_print();
+			return -1;
+		}
+		SM2_KEY_to_SDF_ECCrefPublicKey(&job->public_key, &eccPublicKey);
+		SM2_SIGNATURE_to_SDF_ECCSignature(&sig, &eccSignature);
+		rv = SDF_ExternalVerify_ECC(hSession, SGD_SM2_1, &eccPublicKey, job->dgst, 32, &eccSignature);
+		if (rv == SDR_VERIFYERR) {
+			return 0;
+		}
+		if (rv != SDR_OK) {
+			error_print();
+			return -1;
+		}
+		return 1;
+
+	case SDF_JOB_ENCRYPT:
+		SM2_KEY_to_SDF_ECCrefPublicKey(&job->public_key, &eccPublicKey);
+		memset(&eccCipher, 0, sizeof(eccCipher));
+		if (SDF_ExternalEncrypt_ECC(hSession, SGD_SM2_3, &eccPublicKey,
+				job->in, (unsigned int)job->inlen, &eccCipher.cipher) != SDR_OK
+			|| SDF_ECCCipher_to_SM2_CIPHERTEXT(&eccCipher.cipher, &ciphertext) != SDR_OK) {
+			error_print();
+			return -1;
+		}
+		p = job->out;
+		job->outlen = 0;
+		if (sm2_ciphertext_to_der(&ciphertext, &p, &job->outlen) != 1) {
+			error_print();
+			return -1;
+		}
+		return 1;
+	}
+
+	error_print();
+	return -1;
+}
+
+typedef struct {
+	SDF_JOB_QUEUE *queue;
+	void *session;
+} SDF_JOB_WORKER;
+
+struct SDF_JOB_QUEUE_st {
+	int key_index;
+	SM2_KEY public_key;
+	SDF_JOB_WORKER workers[SDF_JOB_MAX_SESSIONS];
+	size_t sessions_cnt;
+	SDF_JOB *head;
+	SDF_JOB *tail;
+	size_t pending_cnt;
+	SDF_JOB *done_head; // jobs with a callback not yet reported by sdf_job_queue_poll()
+	SDF_JOB *done_tail;
+#ifndef WIN32
+	pthread_mutex_t mutex;
+	pthread_cond_t submit_cond;
+	pthread_cond_t done_cond;
+	pthread_t threads[SDF_JOB_MAX_SESSIONS];
+	size_t threads_cnt;
+	int stop;
+#endif
+};
+
+// the caller holds the lock
+static void sdf_job_queue_complete(SDF_JOB_QUEUE *queue, SDF_JOB *job)
+{
+	job->next = NULL;
+	if (job->callback) {
+		if (queue->done_tail) {
+			queue->done_tail->next = job;
+		} else {
+			queue->done_head = job;
+		}
+		queue->done_tail = job;
+	} else {
+		job->done = 1;
+	}
+}
+
+#ifndef WIN32
+static void *sdf_job_worker(void *arg)
+{
+	SDF_JOB_WORKER *worker = arg;
+	SDF_JOB_QUEUE *queue = worker->queue;
+	SDF_JOB *batch[SDF_JOB_BATCH_SIZE];
+	size_t n, i;
+
+	pthread_mutex_lock(&queue->mutex);
+	for (;;) {
+		while (!queue->stop && !queue->head) {
+			pthread_cond_wait(&queue->submit_cond, &queue->mutex);
+		}
+		if (queue->stop) {
+			break;
+		}
+
+		// a fair share of the pending jobs keeps every session busy
+		n = (queue->pending_cnt + queue->sessions_cnt - 1) / queue->sessions_cnt;
+		if (n > SDF_JOB_BATCH_SIZE) {
+			n = SDF_JOB_BATCH_SIZE;
+		}
+		for (i = 0; i < n && queue->head; i++) {
+			batch[i] = queue->head;
+			queue->head = queue->head->next;
+		}
+		n = i;
+		if (!queue->head) {
+			queue->tail = NULL;
+		}
+		queue->pending_cnt -= n;
+		pthread_mutex_unlock(&queue->mutex);
+
+		for (i = 0; i < n; i++) {
+			batch[i]->ret = sdf_job_do(worker->session, queue->key_index, batch[i]);
+		}
+
+		pthread_mutex_lock(&queue->mutex);
+		for (i = 0; i < n; i++) {
+			sdf_job_queue_complete(queue, batch[i]);
+		}
+		pthread_cond_broadcast(&queue->done_cond);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	return NULL;
+}
+#endif
+
+SDF_JOB_QUEUE *sdf_job_queue_new(SDF_DEVICE *dev, int key_index, const char *pass, size_t sessions)
+{
+	SDF_JOB_QUEUE *queue;
+	ECCrefPublicKey eccPublicKey;
+	void *hSession;
+	size_t i;
+
+	if (!dev || !pass) {
+		error_print();
+		return NULL;
+	}
+	if (!sessions || sessions > SDF_JOB_MAX_SESSIONS) {
+		error_print();
+		return NULL;
+	}
+	if (!(queue = calloc(1, sizeof(SDF_JOB_QUEUE)))) {
+		error_print();
+		return NULL;
+	}
+	queue->key_index = key_index;
+#ifndef WIN32
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->submit_cond, NULL);
+	pthread_cond_init(&queue->done_cond, NULL);
+#endif
+
+	for (i = 0; i < sessions; i++) {
+		hSession = NULL;
+		if (SDF_OpenSession(dev->handle, &hSession) != SDR_OK) {
+			error_print();
+			goto err;
+		}
+		if (SDF_GetPrivateKeyAccessRight(hSession, key_index, (unsigned char *)pass, (unsigned int)strlen(pass)) != SDR_OK) {
+			SDF_CloseSession(hSession);
+			error_print();
+			goto err;
+		}
+		queue->workers[i].queue = queue;
+		queue->workers[i].session = hSession;
+		queue->sessions_cnt++;
+	}
+	if (SDF_ExportSignPublicKey_ECC(queue->workers[0].session, key_index, &eccPublicKey) != SDR_OK
+		|| SDF_ECCrefPublicKey_to_SM2_KEY(&eccPublicKey, &queue->public_key) != SDR_OK) {
+		error_print();
+		goto err;
+	}
+
+#ifndef WIN32
+	for (i = 0; i < queue->sessions_cnt; i++) {
+		if (pthread_create(&queue->threads[i], NULL, sdf_job_worker, &queue->workers[i]) != 0) {
+			error_print();
+			goto err;
+		}
+		queue->threads_cnt++;
+	}
+#endif
+	return queue;
+
+err:
+	sdf_job_queue_free(queue);
+	return NULL;
+}
+
+int sdf_job_queue_get_public_key(const SDF_JOB_QUEUE *queue, SM2_KEY *public_key)
+{
+	if (!queue || !public_key) {
+		error_print();
+		return -1;
+	}
+	*public_key = queue->public_key;
+	return 1;
+}
+
+int sdf_job_queue_submit(SDF_JOB_QUEUE *queue, SDF_JOB **jobs, size_t jobs_cnt)
+{
+	size_t i;
+
+	if (!queue || !jobs || !jobs_cnt) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < jobs_cnt; i++) {
+		if (!jobs[i]) {
+			error_print();
+			return -1;
+		}
+		switch (jobs[i]->type) {
+		case SDF_JOB_SIGN:
+		case SDF_JOB_VERIFY:
+		case SDF_JOB_ENCRYPT:
+			break;
+		default:
+			error_print();
+			return -1;
+		}
+	}
+	for (i = 0; i < jobs_cnt; i++) {
+		jobs[i]->ret = -1;
+		jobs[i]->done = 0;
+		jobs[i]->next = i + 1 < jobs_cnt ? jobs[i + 1] : NULL;
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->tail) {
+		queue->tail->next = jobs[0];
+	} else {
+		queue->head = jobs[0];
+	}
+	queue->tail = jobs[jobs_cnt - 1];
+	queue->pending_cnt += jobs_cnt;
+	if (jobs_cnt == 1) {
+		pthread_cond_signal(&queue->submit_cond);
+	} else {
+		pthread_cond_broadcast(&queue->submit_cond);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+#else
+	for (i = 0; i < jobs_cnt; i++) {
+		jobs[i]->ret = sdf_job_do(queue->workers[0].session, queue->key_index, jobs[i]);
+		sdf_job_queue_complete(queue, jobs[i]);
+	}
+#endif
+	return 1;
+}
+
+int sdf_job_queue_poll(SDF_JOB_QUEUE *queue, int timeout_ms, size_t *done_cnt)
+{
+	SDF_JOB *job;
+	SDF_JOB *next;
+	size_t n = 0;
+
+	if (!queue || !done_cnt) {
+		error_print();
+		return -1;
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&queue->mutex);
+	if (!queue->done_head && timeout_ms) {
+		if (timeout_ms < 0) {
+			while (!queue->done_head) {
+				pthread_cond_wait(&queue->done_cond, &queue->mutex);
+			}
+		} else {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += timeout_ms / 1000;
+			ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			while (!queue->done_head) {
+				if (pthread_cond_timedwait(&queue->done_cond, &queue->mutex, &ts) == ETIMEDOUT) {
+					break;
+				}
+			}
+		}
+	}
+#endif
+	job = queue->done_head;
+	queue->done_head = NULL;
+	queue->done_tail = NULL;
+#ifndef WIN32
+	pthread_mutex_unlock(&queue->mutex);
+#endif
+
+	// the callback may free or submit the job again
+	for (; job; job = next) {
+		next = job->next;
+		job->next = NULL;
+		job->done = 1;
+		job->callback(job, job->callback_arg);
+		n++;
+	}
+	*done_cnt = n;
+	return 1;
+}
+
+int sdf_job_poll(SDF_JOB_QUEUE *queue, SDF_JOB *job)
+{
+	int done;
+
+	if (!queue || !job || job->callback) {
+		error_print();
+		return -1;
+	}
+#ifndef WIN32
+	pthread_mutex_lock(&queue->mutex);
+	done = job->done;
+	pthread_mutex_unlock(&queue->mutex);
+#else
+	done = job->done;
+#endif
+	return done ? 1 : 0;
+}
+
+int sdf_job_wait(SDF_JOB_QUEUE *queue, SDF_JOB *job)
+{
+	if (!queue || !job || job->callback) {
+		error_print();
+		return -1;
+	}
+#ifndef WIN32
+	pthread_mutex_lock(&queue->mutex);
+	while (!job->done) {
+		pthread_cond_wait(&queue->done_cond, &queue->mutex);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+#endif
+	return 1;
+}
+
+// jobs not taken by a worker are failed without calling the callbacks
+void sdf_job_queue_free(SDF_JOB_QUEUE *queue)
+{
+	SDF_JOB *job;
+	size_t i;
+
+	if (!queue) {
+		return;
+	}
+#ifndef WIN32
+	pthread_mutex_lock(&queue->mutex);
+	queue->stop = 1;
+	pthread_cond_broadcast(&queue->submit_cond);
+	pthread_mutex_unlock(&queue->mutex);
+	for (i = 0; i < queue->threads_cnt; i++) {
+		pthread_join(queue->threads[i], NULL);
+	}
+#endif
+	for (job = queue->head; job; job = job->next) {
+		job->ret = -1;
+		job->done = 1;
+	}
+	for (i = 0; i < queue->sessions_cnt; i++) {
+		SDF_ReleasePrivateKeyAccessRight(queue->workers[i].session, queue->key_index);
+		SDF_CloseSession(queue->workers[i].session);
+	}
+#ifndef WIN32
+	pthread_cond_destroy(&queue->done_cond);
+	pthread_cond_destroy(&queue->submit_cond);
+	pthread_mutex_destroy(&queue->mutex);
+#endif
+	gmssl_secure_clear(queue, sizeof(SDF_JOB_QUEUE));
+	free(queue);
+}
@@ -11,6 +11,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#include <gmssl/sm2.h>
 #include "../sgd.h"
 #include "sdf.h"
 
@@ -163,12 +168,87 @@ unsigned char eccPrivateKeyBuf[68] = {
 
 #define SDF_TRACE() fprintf(stderr, "SDF_Dummy->%s\n", __FUNCTION__)
 
+/*
+The ECC operations are done in software with the key of eccPrivateKeyBuf. The
+environment variable SDF_DUMMY_LATENCY_US, read when the device is opened, is added to
+each of them to stand in for a network HSM. The largest number of operations waiting
+in this latency at the same time since the device was opened is returned by
+SDF_Dummy_GetPeakInFlight(), so that tests can check that the sessions overlap.
+*/
+static unsigned long latency_us = 0;
+static unsigned int in_flight = 0;
+static unsigned int peak_in_flight = 0;
+#ifndef WIN32
+static pthread_mutex_t in_flight_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void dummy_latency(void)
+{
+	if (latency_us) {
+#ifdef WIN32
+		Sleep((DWORD)(latency_us / 1000));
+#else
+		pthread_mutex_lock(&in_flight_mutex);
+		if (++in_flight > peak_in_flight) {
+			peak_in_flight = in_flight;
+		}
+		pthread_mutex_unlock(&in_flight_mutex);
+
+		usleep((useconds_t)latency_us);
+
+		pthread_mutex_lock(&in_flight_mutex);
+		in_flight--;
+		pthread_mutex_unlock(&in_flight_mutex);
+#endif
+	}
+}
+
+unsigned int SDF_Dummy_GetPeakInFlight(void)
+{
+	unsigned int peak;
+
+#ifndef WIN32
+	pthread_mutex_lock(&in_flight_mutex);
+#endif
+	peak = peak_in_flight;
+#ifndef WIN32
+	pthread_mutex_unlock(&in_flight_mutex);
+#endif
+	return peak;
+}
+
+static int dummy_ecc_key(SM2_KEY *key)
+{
+	return sm2_key_set_private_key(key, eccPrivateKeyBuf + sizeof(eccPrivateKeyBuf) - 32);
+}
+
+static int dummy_ecc_public_key(const ECCrefPublicKey *ref, SM2_KEY *key)
+{
+	SM2_POINT point;
+
+	if (ref->bits != 256)
+		return -1;
+	memcpy(point.x, ref->x + ECCref_MAX_LEN - 32, 32);
+	memcpy(point.y, ref->y + ECCref_MAX_LEN - 32, 32);
+	return sm2_key_set_public_key(key, &point);
+}
+
 int SDF_OpenDevice(
 	void **phDeviceHandle)
 {
+	const char *latency;
+
 	if (!phDeviceHandle /* || !(*phDeviceHandle) */)
 		return SDR_INARGERR;
 
+	latency = getenv("SDF_DUMMY_LATENCY_US");
+	latency_us = latency ? strtoul(latency, NULL, 10) : 0;
+#ifndef WIN32
+	pthread_mutex_lock(&in_flight_mutex);
+	peak_in_flight = in_flight;
+	pthread_mutex_unlock(&in_flight_mutex);
+#endif
+
 	*phDeviceHandle = deviceHandle;
 	return SDR_OK;
 }
@@ -574,6 +654,18 @@ int SDF_ExternalVerify_ECC(
 	unsigned int uiInputLength,
 	ECCSignature *pucSignature)
 {
+	SM2_KEY key;
+	SM2_SIGNATURE sig;
+
+	if (!pucPublicKey || !pucDataInput || uiInputLength != 32 || !pucSignature)
+		return SDR_INARGERR;
+	if (dummy_ecc_public_key(pucPublicKey, &key) != 1)
+		return SDR_KEYERR;
+	memcpy(sig.r, pucSignature->r + ECCref_MAX_LEN - 32, 32);
+	memcpy(sig.s, pucSignature->s + ECCref_MAX_LEN - 32, 32);
+	dummy_latency();
+	if (sm2_do_verify(&key, pucDataInput, &sig) != 1)
+		return SDR_VERIFYERR;
 	return SDR_OK;
 }
 
@@ -584,6 +676,20 @@ int SDF_InternalSign_ECC(
 	unsigned int uiDataLength,
 	ECCSignature *pucSignature)
 {
+	SM2_KEY key;
+	SM2_SIGNATURE sig;
+
+	if (!pucData || uiDataLength != 32 || !pucSignature)
+		return SDR_INARGERR;
+	if (dummy_ecc_key(&key) != 1)
+		return SDR_KEYERR;
+	dummy_latency();
+	if (sm2_do_sign(&key, pucData, &sig) != 1)
+		return SDR_SIGNERR;
+	memset(pucSignature, 0, sizeof(*pucSignature));
+	memcpy(pucSignature->r + ECCref_MAX_LEN - 32, sig.r, 32);
+	memcpy(pucSignature->s + ECCref_MAX_LEN - 32, sig.s, 32);
+	memset(&key, 0, sizeof(key));
 	return SDR_OK;
 }
 
@@ -605,9 +711,24 @@ int SDF_ExternalEncrypt_ECC(
 	unsigned int uiDataLength,
 	ECCCipher *pucEncData)
 {
-	if (!pucEncData)
+	SM2_KEY key;
+	SM2_CIPHERTEXT c;
+
+	if (!pucPublicKey || !pucData || !pucEncData)
+		return SDR_INARGERR;
+	if (uiDataLength < SM2_MIN_PLAINTEXT_SIZE || uiDataLength > SM2_MAX_PLAINTEXT_SIZE)
 		return SDR_INARGERR;
-	pucEncData->L = uiDataLength;
+	if (dummy_ecc_public_key(pucPublicKey, &key) != 1)
+		return SDR_KEYERR;
+	dummy_latency();
+	if (sm2_do_encrypt(&key, pucData, uiDataLength, &c) != 1)
+		return SDR_PKOPERR;
+	memset(pucEncData, 0, sizeof(*pucEncData) - 1);
+	memcpy(pucEncData->x + ECCref_MAX_LEN - 32, c.point.x, 32);
+	memcpy(pucEncData->y + ECCref_MAX_LEN - 32, c.point.y, 32);
+	memcpy(pucEncData->M, c.hash, 32);
+	pucEncData->L = c.ciphertext_size;
+	memcpy(pucEncData->C, c.ciphertext, c.ciphertext_size);
 	return SDR_OK;
 }
 
@@ -461,82 +461,103 @@ void sm2_fp_exp(SM2_Fp r, const SM2_Fp a, const SM2_Fp e)
 	sm2_bn_copy(r, t);
 }
 
-void sm2_fp_inv(SM2_Fp r, const SM2_Fp a)
+/*
+Fixed exponents p - 2, (p + 1)/4 and n - 2 are computed with addition chains
+over x_k = a^(2^k - 1), the long runs of 1 bits of the exponents are x_31,
+x_32, x_62 and x_128. The chains depend only on the public exponents, so the
+sequence of squarings and multiplications is the same for every input.
+*/
+
+typedef void (*SM2_MUL_FUNC)(SM2_BN r, const SM2_BN a, const SM2_BN b);
+
+// r = a^(2^k) * b
+static void sm2_sqrn_mul(SM2_MUL_FUNC mul, SM2_BN r, const SM2_BN a, int k, const SM2_BN b)
+{
+	SM2_BN t;
+	int i;
+
+	sm2_bn_copy(t, a);
+	for (i = 0; i < k; i++) {
+		mul(t, t, t);
+	}
+	mul(r, t, b);
+	sm2_bn_clean(t);
+}
+
+// x31 = a^(2^31 - 1), x32 = a^(2^32 - 1)
+static void sm2_exp_x31_x32(SM2_MUL_FUNC mul, SM2_BN x31, SM2_BN x32, const SM2_BN a)
+{
+	SM2_BN x3;
+	SM2_BN x6;
+	SM2_BN t;
+
+	mul(t, a, a);
+	mul(t, t, a);			// x2
+	mul(x3, t, t);
+	mul(x3, x3, a);			// x3
+	sm2_sqrn_mul(mul, x6, x3, 3, x3);	// x6
+	sm2_sqrn_mul(mul, t, x6, 6, x6);	// x12
+	sm2_sqrn_mul(mul, t, t, 12, t);		// x24
+	sm2_sqrn_mul(mul, t, t, 6, x6);		// x30
+	sm2_sqrn_mul(mul, x31, t, 1, a);
+	sm2_sqrn_mul(mul, x32, x31, 1, a);
+
+	sm2_bn_clean(x3);
+	sm2_bn_clean(x6);
+	sm2_bn_clean(t);
+}
+
+// t = a^(2^32 - 2) * a^(2^128 - 1), the common high 160 bits of p - 2 and (p + 1)/4
+static void sm2_fp_exp_high160(SM2_Fp t, SM2_Fp x31, const SM2_Fp a)
 {
-	SM2_BN a1;
-	SM2_BN a2;
-	SM2_BN a3;
-	SM2_BN a4;
-	SM2_BN a5;
+	SM2_BN x32;
+	SM2_BN x128;
+
+	sm2_exp_x31_x32(sm2_fp_mul, x31, x32, a);
+	sm2_sqrn_mul(sm2_fp_mul, x128, x32, 32, x32);	// x64
+	sm2_sqrn_mul(sm2_fp_mul, x128, x128, 64, x128);	// x128
+	sm2_fp_sqr(t, x31);
+	sm2_sqrn_mul(sm2_fp_mul, t, t, 128, x128);
+
+	sm2_bn_clean(x32);
+	sm2_bn_clean(x128);
+}
+
+// p - 2 = 1{31} 0 1{128} 0{32} 1{62} 0 1
+void sm2_fp_inv_fermat(SM2_Fp r, const SM2_Fp a)
+{
+	SM2_BN x31;
+	SM2_BN t;
+	int i;
+
+	sm2_fp_exp_high160(t, x31, a);
+	for (i = 0; i < 32; i++) {
+		sm2_fp_sqr(t, t);
+	}
+	sm2_sqrn_mul(sm2_fp_mul, x31, x31, 31, x31);	// x62
+	sm2_sqrn_mul(sm2_fp_mul, t, t, 62, x31);
+	sm2_sqrn_mul(sm2_fp_mul, r, t, 2, a);
+
+	sm2_bn_clean(x31);
+	sm2_bn_clean(t);
+}
+
+// r = a^((p + 1)/4), (p + 1)/4 = 1{31} 0 1{128} 0{31} 1 0{62}
+static void sm2_fp_exp_u_plus_one(SM2_Fp r, const SM2_Fp a)
+{
+	SM2_BN x31;
+	SM2_BN t;
 	int i;
 
-	sm2_fp_sqr(a1, a);
-	sm2_fp_mul(a2, a1, a);
-	sm2_fp_sqr(a3, a2);
-	sm2_fp_sqr(a3, a3);
-	sm2_fp_mul(a3, a3, a2);
-	sm2_fp_sqr(a4, a3);
-	sm2_fp_sqr(a4, a4);
-	sm2_fp_sqr(a4, a4);
-	sm2_fp_sqr(a4, a4);
-	sm2_fp_mul(a4, a4, a3);
-	sm2_fp_sqr(a5, a4);
-	for (i = 1; i < 8; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a5, a5, a4);
-	for (i = 0; i < 8; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a5, a5, a4);
-	for (i = 0; i < 4; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a5, a5, a3);
-	sm2_fp_sqr(a5, a5);
-	sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a5, a5, a2);
-	sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a5, a5, a);
-	sm2_fp_sqr(a4, a5);
-	sm2_fp_mul(a3, a4, a1);
-	sm2_fp_sqr(a5, a4);
-	for (i = 1; i< 31; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a4, a5, a4);
-	sm2_fp_sqr(a4, a4);
-	sm2_fp_mul(a4, a4, a);
-	sm2_fp_mul(a3, a4, a2);
-	for (i = 0; i < 33; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a2, a5, a3);
-	sm2_fp_mul(a3, a2, a3);
-	for (i = 0; i < 32; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a2, a5, a3);
-	sm2_fp_mul(a3, a2, a3);
-	sm2_fp_mul(a4, a2, a4);
-	for (i = 0; i < 32; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a2, a5, a3);
-	sm2_fp_mul(a3, a2, a3);
-	sm2_fp_mul(a4, a2, a4);
-	for (i = 0; i < 32; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a2, a5, a3);
-	sm2_fp_mul(a3, a2, a3);
-	sm2_fp_mul(a4, a2, a4);
-	for (i = 0; i < 32; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(a2, a5, a3);
-	sm2_fp_mul(a3, a2, a3);
-	sm2_fp_mul(a4, a2, a4);
-	for (i = 0; i < 32; i++)
-		sm2_fp_sqr(a5, a5);
-	sm2_fp_mul(r, a4, a5);
-
-	sm2_bn_clean(a1);
-	sm2_bn_clean(a2);
-	sm2_bn_clean(a3);
-	sm2_bn_clean(a4);
-	sm2_bn_clean(a5);
+	sm2_fp_exp_high160(t, x31, a);
+	sm2_sqrn_mul(sm2_fp_mul, t, t, 32, a);
+	for (i = 0; i < 62; i++) {
+		sm2_fp_sqr(t, t);
+	}
+	sm2_bn_copy(r, t);
+
+	sm2_bn_clean(x31);
+	sm2_bn_clean(t);
 }
 
 int sm2_fp_sqrt(SM2_Fp r, const SM2_Fp a)
@@ -545,9 +566,7 @@ int sm2_fp_sqrt(SM2_Fp r, const SM2_Fp a)
 	SM2_BN y; // temp result, prevent call sm2_fp_sqrt(a, a)
 
 	// r = a^((p + 1)/4) when p = 3 (mod 4)
-	sm2_bn_add(u, SM2_P, SM2_ONE);
-	sm2_bn_rshift(u, u, 2);
-	sm2_fp_exp(y, a, u);
+	sm2_fp_exp_u_plus_one(y, a);
 
 	// check r^2 == a
 	sm2_fp_sqr(u, y);
@@ -759,11 +778,47 @@ void sm2_fn_exp(SM2_BN r, const SM2_BN a, const SM2_BN e)
 	sm2_bn_copy(r, t);
 }
 
-void sm2_fn_inv(SM2_BN r, const SM2_BN a)
+// n - 2 = 1{31} 0 1{96} || 0x7203df6b21c6052b53bbf40939d54121, the low half in 4-bit windows
+void sm2_fn_inv_fermat(SM2_BN r, const SM2_BN a)
 {
-	SM2_BN e;
-	sm2_bn_sub(e, SM2_N, SM2_TWO);
-	sm2_fn_exp(r, a, e);
+	static const uint32_t n_minus_two_low[4] = {
+		0x7203df6b, 0x21c6052b, 0x53bbf409, 0x39d54121,
+	};
+	SM2_BN table[16];
+	SM2_BN x31;
+	SM2_BN x32;
+	SM2_BN t;
+	uint32_t w;
+	int i, j;
+
+	sm2_exp_x31_x32(sm2_fn_mul, x31, x32, a);
+	sm2_fn_sqr(t, x31);
+	for (i = 0; i < 3; i++) {
+		sm2_sqrn_mul(sm2_fn_mul, t, t, 32, x32);
+	}
+
+	sm2_bn_copy(table[1], a);
+	for (i = 2; i < 16; i++) {
+		sm2_fn_mul(table[i], table[i - 1], a);
+	}
+	for (i = 0; i < 4; i++) {
+		w = n_minus_two_low[i];
+		for (j = 28; j >= 0; j -= 4) {
+			sm2_fn_sqr(t, t);
+			sm2_fn_sqr(t, t);
+			sm2_fn_sqr(t, t);
+			sm2_fn_sqr(t, t);
+			if ((w >> j) & 0xf) {
+				sm2_fn_mul(t, t, table[(w >> j) & 0xf]);
+			}
+		}
+	}
+	sm2_bn_copy(r, t);
+
+	gmssl_secure_clear(table, sizeof(table));
+	sm2_bn_clean(x31);
+	sm2_bn_clean(x32);
+	sm2_bn_clean(t);
 }
 
 int sm2_fn_rand(SM2_BN r)
@@ -776,6 +831,262 @@ int sm2_fn_rand(SM2_BN r)
 }
 
 
+/*
+Constant-time inversion with the safegcd divsteps of Bernstein and Yang, in
+the form of the 32-bit modinv of libsecp256k1. Numbers are 9 signed limbs of
+30 bits, each batch of 30 divsteps is done on the low limbs only and gives a
+2x2 matrix that is applied to (f, g) and (d, e). 20 batches are more than the
+590 divsteps needed by any 256-bit input, so the running time does not depend
+on the input.
+
+It needs no field multiplication and is about 20 times faster than the Fermat
+addition chains, sm2_fp_inv() and sm2_fn_inv() use it and 0 is mapped to 0 as
+with the chains.
+*/
+
+typedef struct {
+	int32_t v[9];
+} SM2_SIGNED30;
+
+typedef struct {
+	SM2_SIGNED30 modulus;
+	uint32_t modulus_inv30; // modulus^-1 mod 2^30
+} SM2_SAFEGCD_MODINFO;
+
+typedef struct {
+	int32_t u, v, q, r;
+} SM2_SAFEGCD_TRANS;
+
+static const SM2_SAFEGCD_MODINFO sm2_safegcd_p = {
+	{{ 0x3fffffff, 0x3fffffff, 0x0000000f, 0x3fffffc0, 0x3fffffff,
+	   0x3fffffff, 0x3fffffff, 0x3fffbfff, 0x0000ffff }},
+	0x3fffffff,
+};
+
+static const SM2_SAFEGCD_MODINFO sm2_safegcd_n = {
+	{{ 0x39d54123, 0x0eefd024, 0x1c6052b5, 0x00f7dac8, 0x3fffff72,
+	   0x3fffffff, 0x3fffffff, 0x3fffbfff, 0x0000ffff }},
+	0x0dcaf68b,
+};
+
+#define SM2_M30 ((int32_t)0x3fffffff)
+
+static void sm2_bn_to_signed30(SM2_SIGNED30 *r, const SM2_BN a)
+{
+	uint64_t acc = 0;
+	int bits = 0;
+	int i, j = 0;
+
+	for (i = 0; i < 8; i++) {
+		acc |= (a[i] & 0xffffffff) << bits;
+		bits += 32;
+		while (bits >= 30) {
+			r->v[j++] = (int32_t)(acc & SM2_M30);
+			acc >>= 30;
+			bits -= 30;
+		}
+	}
+	r->v[j] = (int32_t)acc;
+}
+
+// a must be normalized in [0, modulus)
+static void sm2_bn_from_signed30(SM2_BN r, const SM2_SIGNED30 *a)
+{
+	uint64_t acc = 0;
+	int bits = 0;
+	int i, j = 0;
+
+	for (i = 0; i < 9; i++) {
+		acc |= (uint64_t)a->v[i] << bits;
+		bits += 30;
+		if (bits >= 32) {
+			r[j++] = acc & 0xffffffff;
+			acc >>= 32;
+			bits -= 32;
+		}
+	}
+}
+
+// zeta = -(delta + 1/2), u, v, q, r are kept mod 2^32 to avoid shifting negative numbers
+static int32_t sm2_safegcd_divsteps_30(int32_t zeta, uint32_t f0, uint32_t g0, SM2_SAFEGCD_TRANS *t)
+{
+	uint32_t u = 1, v = 0, q = 0, r = 1;
+	volatile uint32_t c1, c2;
+	uint32_t mask1, mask2, f = f0, g = g0, x, y, z;
+	int i;
+
+	for (i = 0; i < 30; i++) {
+		// masks of (zeta < 0) and (g is odd)
+		c1 = zeta >> 31;
+		mask1 = c1;
+		c2 = g & 1;
+		mask2 = -c2;
+
+		// conditionally add -f, -u, -v or f, u, v to g, q, r
+		x = (f ^ mask1) - mask1;
+		y = (u ^ mask1) - mask1;
+		z = (v ^ mask1) - mask1;
+		g += x & mask2;
+		q += y & mask2;
+		r += z & mask2;
+
+		// swap case: zeta becomes -zeta - 2, otherwise zeta - 1
+		mask1 &= mask2;
+		zeta = (zeta ^ (int32_t)mask1) - 1;
+		f += g & mask1;
+		u += q & mask1;
+		v += r & mask1;
+
+		g >>= 1;
+		u <<= 1;
+		v <<= 1;
+	}
+	t->u = (int32_t)u;
+	t->v = (int32_t)v;
+	t->q = (int32_t)q;
+	t->r = (int32_t)r;
+	return zeta;
+}
+
+// [d, e] = t * [d, e] / 2^30 mod modulus, a multiple of the modulus is added to clear the low bits
+static void sm2_safegcd_update_de_30(SM2_SIGNED30 *d, SM2_SIGNED30 *e,
+	const SM2_SAFEGCD_TRANS *t, const SM2_SAFEGCD_MODINFO *modinfo)
+{
+	const int32_t u = t->u, v = t->v, q = t->q, r = t->r;
+	int32_t di, ei, md, me, sd, se;
+	int64_t cd, ce;
+	int i;
+
+	// keep d, e in range (-2 * modulus, modulus)
+	sd = d->v[8] >> 31;
+	se = e->v[8] >> 31;
+	md = (u & sd) + (v & se);
+	me = (q & sd) + (r & se);
+
+	di = d->v[0];
+	ei = e->v[0];
+	cd = (int64_t)u * di + (int64_t)v * ei;
+	ce = (int64_t)q * di + (int64_t)r * ei;
+
+	md -= (modinfo->modulus_inv30 * (uint32_t)cd + md) & SM2_M30;
+	me -= (modinfo->modulus_inv30 * (uint32_t)ce + me) & SM2_M30;
+	cd += (int64_t)modinfo->modulus.v[0] * md;
+	ce += (int64_t)modinfo->modulus.v[0] * me;
+	cd >>= 30;
+	ce >>= 30;
+
+	for (i = 1; i < 9; i++) {
+		di = d->v[i];
+		ei = e->v[i];
+		cd += (int64_t)u * di + (int64_t)v * ei;
+		ce += (int64_t)q * di + (int64_t)r * ei;
+		cd += (int64_t)modinfo->modulus.v[i] * md;
+		ce += (int64_t)modinfo->modulus.v[i] * me;
+		d->v[i - 1] = (int32_t)cd & SM2_M30;
+		e->v[i - 1] = (int32_t)ce & SM2_M30;
+		cd >>= 30;
+		ce >>= 30;
+	}
+	d->v[8] = (int32_t)cd;
+	e->v[8] = (int32_t)ce;
+}
+
+// [f, g] = t * [f, g] / 2^30, the low 30 bits are zero
+static void sm2_safegcd_update_fg_30(SM2_SIGNED30 *f, SM2_SIGNED30 *g, const SM2_SAFEGCD_TRANS *t)
+{
+	const int32_t u = t->u, v = t->v, q = t->q, r = t->r;
+	int32_t fi, gi;
+	int64_t cf, cg;
+	int i;
+
+	fi = f->v[0];
+	gi = g->v[0];
+	cf = (int64_t)u * fi + (int64_t)v * gi;
+	cg = (int64_t)q * fi + (int64_t)r * gi;
+	cf >>= 30;
+	cg >>= 30;
+
+	for (i = 1; i < 9; i++) {
+		fi = f->v[i];
+		gi = g->v[i];
+		cf += (int64_t)u * fi + (int64_t)v * gi;
+		cg += (int64_t)q * fi + (int64_t)r * gi;
+		f->v[i - 1] = (int32_t)cf & SM2_M30;
+		g->v[i - 1] = (int32_t)cg & SM2_M30;
+		cf >>= 30;
+		cg >>= 30;
+	}
+	f->v[8] = (int32_t)cf;
+	g->v[8] = (int32_t)cg;
+}
+
+// r in (-2 * modulus, modulus) is negated if sign < 0 and reduced to [0, modulus)
+static void sm2_safegcd_normalize_30(SM2_SIGNED30 *r, int32_t sign, const SM2_SAFEGCD_MODINFO *modinfo)
+{
+	volatile int32_t cond_add, cond_negate;
+	int i;
+
+	cond_add = r->v[8] >> 31;
+	for (i = 0; i < 9; i++) {
+		r->v[i] += modinfo->modulus.v[i] & cond_add;
+	}
+	cond_negate = sign >> 31;
+	for (i = 0; i < 9; i++) {
+		r->v[i] = (r->v[i] ^ cond_negate) - cond_negate;
+	}
+	for (i = 1; i < 9; i++) {
+		r->v[i] += r->v[i - 1] >> 30;
+		r->v[i - 1] &= SM2_M30;
+	}
+
+	cond_add = r->v[8] >> 31;
+	for (i = 0; i < 9; i++) {
+		r->v[i] += modinfo->modulus.v[i] & cond_add;
+	}
+	for (i = 1; i < 9; i++) {
+		r->v[i] += r->v[i - 1] >> 30;
+		r->v[i - 1] &= SM2_M30;
+	}
+}
+
+static void sm2_safegcd_inv(SM2_BN r, const SM2_BN a, const SM2_SAFEGCD_MODINFO *modinfo)
+{
+	SM2_SIGNED30 d = {{0}};
+	SM2_SIGNED30 e = {{1}};
+	SM2_SIGNED30 f = modinfo->modulus;
+	SM2_SIGNED30 g;
+	SM2_SAFEGCD_TRANS t;
+	int32_t zeta = -1; // delta = 1/2
+	int i;
+
+	sm2_bn_to_signed30(&g, a);
+	for (i = 0; i < 20; i++) {
+		zeta = sm2_safegcd_divsteps_30(zeta, (uint32_t)f.v[0], (uint32_t)g.v[0], &t);
+		sm2_safegcd_update_de_30(&d, &e, &t, modinfo);
+		sm2_safegcd_update_fg_30(&f, &g, &t);
+	}
+	// g = 0 and f = +/-1, d = +/-a^-1
+	sm2_safegcd_normalize_30(&d, f.v[8], modinfo);
+	sm2_bn_from_signed30(r, &d);
+
+	gmssl_secure_clear(&d, sizeof(d));
+	gmssl_secure_clear(&e, sizeof(e));
+	gmssl_secure_clear(&f, sizeof(f));
+	gmssl_secure_clear(&g, sizeof(g));
+	gmssl_secure_clear(&t, sizeof(t));
+}
+
+void sm2_fp_inv(SM2_Fp r, const SM2_Fp a)
+{
+	sm2_safegcd_inv(r, a, &sm2_safegcd_p);
+}
+
+void sm2_fn_inv(SM2_Fn r, const SM2_Fn a)
+{
+	sm2_safegcd_inv(r, a, &sm2_safegcd_n);
+}
+
+
 
 void sm2_jacobian_point_init(SM2_JACOBIAN_POINT *R)
 {
@@ -1106,7 +1417,7 @@ int sm2_point_from_x(SM2_POINT *P, const uint8_t x[32], int y)
 	sm2_fp_add(_g, _g, SM2_B);
 
 	// y = g^(u + 1) mod p, u = (p - 3)/4
-	sm2_fp_exp(_y, _g, SM2_U_PLUS_ONE);
+	sm2_fp_exp_u_plus_one(_y, _g);
 
 	// z = y^2 mod p
 	sm2_fp_sqr(_z, _y);
@@ -1310,17 +1621,12 @@ int sm2_point_from_der(SM2_POINT *P, const uint8_t **in, size_t *inlen)
 
 int sm2_point_from_hash(SM2_POINT *R, const uint8_t *data, size_t datalen)
 {
-	SM2_BN u;
 	SM2_Fp x;
 	SM2_Fp y;
 	SM2_Fp s;
 	SM2_Fp s_;
 	uint8_t dgst[32];
 
-	// u = (p + 1)/4
-	sm2_bn_add(u, SM2_P, SM2_ONE);
-	sm2_bn_rshift(u, u, 2);
-
 	do {
 		sm3_digest(data, datalen, dgst);
 
@@ -1336,7 +1642,7 @@ int sm2_point_from_hash(SM2_POINT *R, const uint8_t *data, size_t datalen)
 		sm2_fp_add(s, s, SM2_B);
 
 		// y = s^((p+1)/4) = (sqrt(s) (mod p))
-		sm2_fp_exp(y, s, u);
+		sm2_fp_exp_u_plus_one(y, s);
 		sm2_fp_sqr(s_, y);
 
 		data = dgst;
@@ -0,0 +1,240 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include <gmssl/mem.h>
+#include <gmssl/sm2.h>
+#include <gmssl/sm2_key_pool.h>
+#include <gmssl/error.h>
+
+
+struct sm2_key_pool_st {
+	SM2_KEY *keys;
+	size_t size;
+	size_t count;
+#ifndef WIN32
+	int started; // the refill thread is running in this process
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; // signaled when a key is taken or the pool is stopped
+	struct sm2_key_pool_st *next;
+#endif
+};
+
+
+#ifndef WIN32
+
+// all the pools of the process, so the keys can be dropped in a child after fork()
+static pthread_mutex_t sm2_key_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SM2_KEY_POOL *sm2_key_pools = NULL;
+static pthread_once_t sm2_key_pool_once = PTHREAD_ONCE_INIT;
+
+static void sm2_key_pool_atfork_prepare(void)
+{
+	SM2_KEY_POOL *pool;
+	pthread_mutex_lock(&sm2_key_pools_mutex);
+	for (pool = sm2_key_pools; pool; pool = pool->next) {
+		pthread_mutex_lock(&pool->mutex);
+	}
+}
+
+static void sm2_key_pool_atfork_parent(void)
+{
+	SM2_KEY_POOL *pool;
+	for (pool = sm2_key_pools; pool; pool = pool->next) {
+		pthread_mutex_unlock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&sm2_key_pools_mutex);
+}
+
+// the refill thread does not exist in the child, and the keys must not be used twice
+static void sm2_key_pool_atfork_child(void)
+{
+	SM2_KEY_POOL *pool;
+	for (pool = sm2_key_pools; pool; pool = pool->next) {
+		gmssl_secure_clear(pool->keys, sizeof(SM2_KEY) * pool->count);
+		pool->count = 0;
+		pool->started = 0;
+		pthread_cond_init(&pool->cond, NULL);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&sm2_key_pools_mutex);
+}
+
+static void sm2_key_pool_once_init(void)
+{
+	pthread_atfork(sm2_key_pool_atfork_prepare, sm2_key_pool_atfork_parent, sm2_key_pool_atfork_child);
+}
+
+static void *sm2_key_pool_refill(void *arg)
+{
+	SM2_KEY_POOL *pool = arg;
+	SM2_KEY key;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->mutex);
+		while (!pool->stop && pool->count >= pool->size) {
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+		}
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+
+		// generated without the lock, sm2_key_pool_get() is never blocked by the refill
+		if (sm2_key_generate(&key) != 1) {
+			error_print();
+			break;
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		if (pool->count < pool->size) {
+			pool->keys[pool->count++] = key;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+		gmssl_secure_clear(&key, sizeof(key));
+	}
+	return NULL;
+}
+
+// called with pool->mutex locked
+static void sm2_key_pool_start(SM2_KEY_POOL *pool)
+{
+	if (pthread_create(&pool->thread, NULL, sm2_key_pool_refill, pool) == 0) {
+		pool->started = 1;
+	} else {
+		error_print();
+	}
+}
+#endif
+
+SM2_KEY_POOL *sm2_key_pool_new(size_t size)
+{
+	SM2_KEY_POOL *pool;
+
+	if (!size || size > SM2_KEY_POOL_MAX_SIZE) {
+		error_print();
+		return NULL;
+	}
+	if (!(pool = (SM2_KEY_POOL *)calloc(1, sizeof(SM2_KEY_POOL)))) {
+		error_print();
+		return NULL;
+	}
+	if (!(pool->keys = (SM2_KEY *)calloc(size, sizeof(SM2_KEY)))) {
+		free(pool);
+		error_print();
+		return NULL;
+	}
+	pool->size = size;
+
+#ifndef WIN32
+	pthread_once(&sm2_key_pool_once, sm2_key_pool_once_init);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	pthread_mutex_lock(&sm2_key_pools_mutex);
+	pool->next = sm2_key_pools;
+	sm2_key_pools = pool;
+	pthread_mutex_unlock(&sm2_key_pools_mutex);
+
+	pthread_mutex_lock(&pool->mutex);
+	sm2_key_pool_start(pool);
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+	return pool;
+}
+
+int sm2_key_pool_get(SM2_KEY_POOL *pool, SM2_KEY *key)
+{
+	if (!pool || !key) {
+		error_print();
+		return -1;
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&pool->mutex);
+	if (!pool->started) {
+		sm2_key_pool_start(pool);
+	}
+	if (pool->count) {
+		pool->count--;
+		*key = pool->keys[pool->count];
+		gmssl_secure_clear(&pool->keys[pool->count], sizeof(SM2_KEY));
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
+		return 1;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+
+	if (sm2_key_generate(key) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+size_t sm2_key_pool_count(SM2_KEY_POOL *pool)
+{
+	size_t count;
+
+	if (!pool) {
+		return 0;
+	}
+#ifndef WIN32
+	pthread_mutex_lock(&pool->mutex);
+	count = pool->count;
+	pthread_mutex_unlock(&pool->mutex);
+#else
+	count = pool->count;
+#endif
+	return count;
+}
+
+void sm2_key_pool_free(SM2_KEY_POOL *pool)
+{
+	if (!pool) {
+		return;
+	}
+#ifndef WIN32
+	{
+		SM2_KEY_POOL **pp;
+
+		pthread_mutex_lock(&sm2_key_pools_mutex);
+		for (pp = &sm2_key_pools; *pp; pp = &(*pp)->next) {
+			if (*pp == pool) {
+				*pp = pool->next;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&sm2_key_pools_mutex);
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->stop = 1;
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
+		if (pool->started) {
+			pthread_join(pool->thread, NULL);
+		}
+		pthread_cond_destroy(&pool->cond);
+		pthread_mutex_destroy(&pool->mutex);
+	}
+#endif
+	gmssl_secure_clear(pool->keys, sizeof(SM2_KEY) * pool->size);
+	free(pool->keys);
+	free(pool);
+}
@@ -447,31 +447,16 @@ int sm2_verify_finish(SM2_SIGN_CTX *ctx, const uint8_t *sig, size_t siglen)
 	return 1;
 }
 
+// the state after `in` is computed once, see sm3_kdf_finish()
 int sm2_kdf(const uint8_t *in, size_t inlen, size_t outlen, uint8_t *out)
 {
-	SM3_CTX ctx;
-	uint8_t counter_be[4];
-	uint8_t dgst[SM3_DIGEST_SIZE];
-	uint32_t counter = 1;
-	size_t len;
+	SM3_KDF_CTX ctx;
 
-	while (outlen) {
-		PUTU32(counter_be, counter);
-		counter++;
-
-		sm3_init(&ctx);
-		sm3_update(&ctx, in, inlen);
-		sm3_update(&ctx, counter_be, sizeof(counter_be));
-		sm3_finish(&ctx, dgst);
-
-		len = outlen < SM3_DIGEST_SIZE ? outlen : SM3_DIGEST_SIZE;
-		memcpy(out, dgst, len);
-		out += len;
-		outlen -= len;
-	}
+	sm3_kdf_init(&ctx, outlen);
+	sm3_kdf_update(&ctx, in, inlen);
+	sm3_kdf_finish(&ctx, out);
 
-	memset(&ctx, 0, sizeof(SM3_CTX));
-	memset(dgst, 0, sizeof(dgst));
+	memset(&ctx, 0, sizeof(SM3_KDF_CTX));
 	return 1;
 }
 
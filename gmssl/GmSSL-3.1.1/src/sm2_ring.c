@@ -18,6 +18,117 @@
 
 extern SM2_BN SM2_N;
 extern SM2_BN SM2_ONE;
+extern const SM2_JACOBIAN_POINT *SM2_G;
+
+
+/*
+Every member of the ring costs R = t * P[i] + s * G, and the x of R is needed for the
+scalars of the next member, so the members are computed one after another.
+
+What does not depend on the chain is computed up front: the multiples 1..15 of every
+public key and of G are normalized with a single inversion, then each R is one pass of
+4-bit windows over t and s sharing the doublings, with only mixed additions.
+*/
+
+#define SM2_RING_WINDOW_POINTS	15
+
+static int sm2_ring_tables_new(const SM2_POINT *public_keys, size_t public_keys_cnt,
+	SM2_JACOBIAN_POINT **tables)
+{
+	SM2_JACOBIAN_POINT *T;
+	SM2_JACOBIAN_POINT P;
+	SM2_BN *prod;
+	SM2_BN inv;
+	SM2_BN z_inv;
+	SM2_BN z_inv2;
+	size_t n, i, j;
+
+	// the table of G is after the tables of the public keys
+	if (public_keys_cnt > SIZE_MAX / SM2_RING_WINDOW_POINTS / sizeof(SM2_JACOBIAN_POINT) - 1) {
+		error_print();
+		return -1;
+	}
+	n = (public_keys_cnt + 1) * SM2_RING_WINDOW_POINTS;
+	if (!(T = malloc(n * sizeof(SM2_JACOBIAN_POINT)))) {
+		error_print();
+		return -1;
+	}
+	if (!(prod = malloc(n * sizeof(SM2_BN)))) {
+		free(T);
+		error_print();
+		return -1;
+	}
+
+	for (i = 0; i <= public_keys_cnt; i++) {
+		SM2_JACOBIAN_POINT *t = T + SM2_RING_WINDOW_POINTS * i;
+		if (i < public_keys_cnt) {
+			sm2_jacobian_point_from_bytes(&P, (const uint8_t *)&public_keys[i]);
+		} else {
+			sm2_jacobian_point_copy(&P, SM2_G);
+		}
+		sm2_jacobian_point_copy(&t[0], &P);
+		for (j = 1; j < SM2_RING_WINDOW_POINTS; j++) {
+			sm2_jacobian_point_add(&t[j], &t[j - 1], &P);
+		}
+	}
+
+	// Montgomery's trick, a point at infinity (only from an invalid public key) is skipped
+	for (i = 0; i < n; i++) {
+		const uint64_t *z = sm2_bn_is_zero(T[i].Z) ? SM2_ONE : T[i].Z;
+		if (i == 0) {
+			sm2_bn_copy(prod[0], z);
+		} else {
+			sm2_fp_mul(prod[i], prod[i - 1], z);
+		}
+	}
+	sm2_fp_inv(inv, prod[n - 1]);
+	for (i = n; i-- > 0; ) {
+		if (sm2_bn_is_zero(T[i].Z)) {
+			continue;
+		}
+		if (i) {
+			sm2_fp_mul(z_inv, inv, prod[i - 1]);
+			sm2_fp_mul(inv, inv, T[i].Z);
+		} else {
+			sm2_bn_copy(z_inv, inv);
+		}
+		sm2_fp_sqr(z_inv2, z_inv);
+		sm2_fp_mul(T[i].X, T[i].X, z_inv2);
+		sm2_fp_mul(z_inv2, z_inv2, z_inv);
+		sm2_fp_mul(T[i].Y, T[i].Y, z_inv2);
+		sm2_bn_set_one(T[i].Z);
+	}
+
+	free(prod);
+	*tables = T;
+	return 1;
+}
+
+static int sm2_bn_window(const SM2_BN a, int i)
+{
+	return (int)((a[i / 8] >> ((i % 8) * 4)) & 0xf);
+}
+
+// R = t * P + s * G, TP and TG are the normalized multiples 1..15 of P and G
+static void sm2_ring_point_mul_sum(SM2_JACOBIAN_POINT *R,
+	const SM2_BN t, const SM2_JACOBIAN_POINT *TP, const SM2_BN s, const SM2_JACOBIAN_POINT *TG)
+{
+	int i, w;
+
+	sm2_jacobian_point_set_infinity(R);
+	for (i = 63; i >= 0; i--) {
+		sm2_jacobian_point_dbl(R, R);
+		sm2_jacobian_point_dbl(R, R);
+		sm2_jacobian_point_dbl(R, R);
+		sm2_jacobian_point_dbl(R, R);
+		if ((w = sm2_bn_window(t, i)) != 0) {
+			sm2_jacobian_point_add(R, R, &TP[w - 1]);
+		}
+		if ((w = sm2_bn_window(s, i)) != 0) {
+			sm2_jacobian_point_add(R, R, &TG[w - 1]);
+		}
+	}
+}
 
 
 static int compare_point(const void *P, const void *Q)
@@ -114,8 +225,10 @@ int sm2_ring_do_sign(const SM2_KEY *sign_key,
 	size_t i;
 	size_t sign_index = public_keys_cnt; // assign an invalid value
 
+	SM2_JACOBIAN_POINT *tables;
+	const SM2_JACOBIAN_POINT *TG;
 	SM2_JACOBIAN_POINT R;
-	SM2_JACOBIAN_POINT P;
+	SM2_Fn zero;
 	SM2_Fn e;
 	SM2_Fn k;
 	SM2_Fp x;
@@ -141,12 +254,18 @@ int sm2_ring_do_sign(const SM2_KEY *sign_key,
 		error_print();
 		return -1;
 	}
+	if (sm2_ring_tables_new(public_keys, public_keys_cnt, &tables) != 1) {
+		error_print();
+		return -1;
+	}
+	TG = tables + SM2_RING_WINDOW_POINTS * public_keys_cnt;
+	sm2_bn_set_zero(zero);
 
 	// k[i] = rand(1, n-1), r[i], s[i] will be computed at the last step
 	sm2_fn_rand(k);
 
 	// R[i+1] = k[i] * G
-	sm2_jacobian_point_mul_generator(&R, k);
+	sm2_ring_point_mul_sum(&R, zero, TG, k, TG);
 	sm2_jacobian_point_get_xy(&R, x, NULL);
 
 	// i = i + 1 (mod N)
@@ -166,10 +285,10 @@ int sm2_ring_do_sign(const SM2_KEY *sign_key,
 
 		// R[i+1] = k[i] * G = (s[i] + r[i]) * P[i] + s[i] * G
 		sm2_fn_add(t, s, r);
-		sm2_jacobian_point_from_bytes(&P, (const uint8_t *)&public_keys[i]);
-		sm2_jacobian_point_mul_sum(&R, t, &P, s);
+		sm2_ring_point_mul_sum(&R, t, tables + SM2_RING_WINDOW_POINTS * i, s, TG);
 		sm2_jacobian_point_get_xy(&R, x, NULL);
 	}
+	free(tables);
 
 	// r[i] = x[i] + e (mod n)
 	sm2_fn_add(r, x, e);
@@ -196,7 +315,8 @@ int sm2_ring_do_sign(const SM2_KEY *sign_key,
 int sm2_ring_do_verify(const SM2_POINT *public_keys, size_t public_keys_cnt,
 	const uint8_t dgst[32], const uint8_t r0[32], const sm2_bn_t *s_vec)
 {
-	SM2_JACOBIAN_POINT P;
+	SM2_JACOBIAN_POINT *tables;
+	const SM2_JACOBIAN_POINT *TG;
 	SM2_JACOBIAN_POINT R;
 	SM2_Fn r;
 	SM2_Fn r_;
@@ -213,18 +333,24 @@ int sm2_ring_do_verify(const SM2_POINT *public_keys, size_t public_keys_cnt,
 
 	sm2_bn_from_bytes(r, r0);
 
+	if (sm2_ring_tables_new(public_keys, public_keys_cnt, &tables) != 1) {
+		error_print();
+		return -1;
+	}
+	TG = tables + SM2_RING_WINDOW_POINTS * public_keys_cnt;
+
 	for (i = 0; i < public_keys_cnt; i++) {
 		sm2_bn_from_bytes(s, s_vec[i]);
 
 		// R(x, y) = k * G = s * G + (s + r) * P
 		sm2_fn_add(t, s, r);
-		sm2_jacobian_point_from_bytes(&P, (const uint8_t *)&public_keys[i]);
-		sm2_jacobian_point_mul_sum(&R, t, &P, s);
+		sm2_ring_point_mul_sum(&R, t, tables + SM2_RING_WINDOW_POINTS * i, s, TG);
 		sm2_jacobian_point_get_xy(&R, x, NULL);
 
 		// r = e + x (mod n)
 		sm2_fn_add(r, x, e);
 	}
+	free(tables);
 
 	sm2_bn_from_bytes(r_, r0);
 	if (sm2_bn_cmp(r_, r) != 0) {
@@ -10,9 +10,13 @@
 
 
 #include <string.h>
+#include <gmssl/mem.h>
 #include <gmssl/sm3.h>
 #include <gmssl/endian.h>
 #include <gmssl/error.h>
+#ifdef SM3_X8_AVX2
+#include <gmssl/sm3_x8_avx2.h>
+#endif
 
 
 void sm3_kdf_init(SM3_KDF_CTX *ctx, size_t outlen)
@@ -26,29 +30,123 @@ void sm3_kdf_update(SM3_KDF_CTX *ctx, const uint8_t *data, size_t datalen)
 	sm3_update(&ctx->sm3_ctx, data, datalen);
 }
 
+/*
+ * KDF(Z, klen) = SM3(Z || ct_1) || SM3(Z || ct_2) || ...
+ *
+ * Z is absorbed once in ctx->sm3_ctx. The remaining bytes of Z, the counter and the
+ * padding form the same 1 or 2 block tail for every counter, so each output block is
+ * only the compression of the tail from the saved state. With SM3_X8_AVX2 the tails
+ * of 8 counters are compressed in the lanes of sm3_x8_compress_lanes() if the CPU
+ * has AVX2.
+ */
+
+#define SM3_KDF_X8_MIN_BLOCKS	3 // fewer blocks are faster with the scalar SM3
+#define SM3_KDF_MAX_TAILS	2
+
+#ifdef SM3_X8_AVX2
+static void sm3_kdf_x8_blocks(const uint32_t digest[8], uint8_t tails[8][SM3_BLOCK_SIZE * SM3_KDF_MAX_TAILS],
+	size_t ntails, size_t counter_offset, uint32_t counter, size_t nlanes, uint8_t *out, size_t outlen)
+{
+	uint32_t d[8][8];
+	uint32_t words[16][8];
+	size_t b, l;
+	int i;
+
+	for (l = 0; l < 8; l++) {
+		PUTU32(tails[l] + counter_offset, counter + (uint32_t)l);
+	}
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < 8; l++) {
+			d[i][l] = digest[i];
+		}
+	}
+	for (b = 0; b < ntails && b < SM3_KDF_MAX_TAILS; b++) {
+		for (l = 0; l < 8; l++) {
+			const uint8_t *block = tails[l] + SM3_BLOCK_SIZE * b;
+			for (i = 0; i < 16; i++) {
+				words[i][l] = GETU32(block + 4 * i);
+			}
+		}
+		sm3_x8_compress_lanes(d, words);
+	}
+	for (l = 0; l < nlanes; l++) {
+		uint8_t dgst[SM3_DIGEST_SIZE];
+		size_t len = outlen < SM3_DIGEST_SIZE ? outlen : SM3_DIGEST_SIZE;
+		for (i = 0; i < 8; i++) {
+			PUTU32(dgst + 4*i, d[i][l]);
+		}
+		memcpy(out, dgst, len);
+		out += len;
+		outlen -= len;
+		gmssl_secure_clear(dgst, sizeof(dgst));
+	}
+
+	gmssl_secure_clear(words, sizeof(words));
+	gmssl_secure_clear(d, sizeof(d));
+}
+#endif
+
 void sm3_kdf_finish(SM3_KDF_CTX *ctx, uint8_t *out)
 {
-	SM3_CTX sm3_ctx;
+	const SM3_CTX *sm3_ctx = &ctx->sm3_ctx;
 	size_t outlen = ctx->outlen;
-	uint8_t counter_be[4];
+	uint8_t tail[SM3_BLOCK_SIZE * SM3_KDF_MAX_TAILS] = {0};
+	size_t ntails;
+	size_t counter_offset = sm3_ctx->num;
+	uint64_t nbits;
+	uint32_t digest[8];
 	uint8_t dgst[SM3_DIGEST_SIZE];
 	uint32_t counter = 1;
 	size_t len;
+	int i;
+
+	// Z mod 64 || counter || 0x80 || 0x00... || nbits
+	memcpy(tail, sm3_ctx->block, sm3_ctx->num);
+	tail[sm3_ctx->num + 4] = 0x80;
+	ntails = (sm3_ctx->num + 4 + 1 + 8 <= SM3_BLOCK_SIZE) ? 1 : SM3_KDF_MAX_TAILS;
+	nbits = ((sm3_ctx->nblocks << 9) + ((sm3_ctx->num + 4) << 3));
+	PUTU64(tail + SM3_BLOCK_SIZE * ntails - 8, nbits);
+
+#ifdef SM3_X8_AVX2
+	if (sm3_x8_avx2_cpu_support()) {
+		uint8_t tails[8][SM3_BLOCK_SIZE * SM3_KDF_MAX_TAILS];
+		size_t nlanes;
+
+		for (i = 0; i < 8; i++) {
+			memcpy(tails[i], tail, sizeof(tail));
+		}
+		while ((outlen + SM3_DIGEST_SIZE - 1) / SM3_DIGEST_SIZE >= SM3_KDF_X8_MIN_BLOCKS) {
+			nlanes = (outlen + SM3_DIGEST_SIZE - 1) / SM3_DIGEST_SIZE;
+			if (nlanes > 8) {
+				nlanes = 8;
+			}
+			len = outlen < SM3_DIGEST_SIZE * nlanes ? outlen : SM3_DIGEST_SIZE * nlanes;
+			sm3_kdf_x8_blocks(sm3_ctx->digest, tails, ntails, counter_offset, counter, nlanes, out, len);
+			counter += (uint32_t)nlanes;
+			out += len;
+			outlen -= len;
+		}
+		gmssl_secure_clear(tails, sizeof(tails));
+	}
+#endif
 
 	while (outlen) {
-		PUTU32(counter_be, counter);
+		PUTU32(tail + counter_offset, counter);
 		counter++;
 
-		sm3_ctx = ctx->sm3_ctx;
-		sm3_update(&sm3_ctx, counter_be, sizeof(counter_be));
-		sm3_finish(&sm3_ctx, dgst);
+		memcpy(digest, sm3_ctx->digest, sizeof(digest));
+		sm3_compress_blocks(digest, tail, ntails);
 
+		for (i = 0; i < 8; i++) {
+			PUTU32(dgst + 4*i, digest[i]);
+		}
 		len = outlen < SM3_DIGEST_SIZE ? outlen : SM3_DIGEST_SIZE;
 		memcpy(out, dgst, len);
 		out += len;
 		outlen -= len;
 	}
 
-	memset(&sm3_ctx, 0, sizeof(SM3_CTX));
-	memset(dgst, 0, sizeof(dgst));
+	gmssl_secure_clear(tail, sizeof(tail));
+	gmssl_secure_clear(digest, sizeof(digest));
+	gmssl_secure_clear(dgst, sizeof(dgst));
 }
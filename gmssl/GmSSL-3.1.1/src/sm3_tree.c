@@ -0,0 +1,275 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include <gmssl/mem.h>
+#include <gmssl/sm3.h>
+#include <gmssl/endian.h>
+#include <gmssl/error.h>
+
+
+#define SM3_TREE_LEAF	0x00
+#define SM3_TREE_NODE	0x01
+#define SM3_TREE_ROOT	0x02
+
+
+static void sm3_tree_leaf_init(SM3_CTX *ctx)
+{
+	uint8_t prefix = SM3_TREE_LEAF;
+	sm3_init(ctx);
+	sm3_update(ctx, &prefix, 1);
+}
+
+typedef struct {
+	const uint8_t *data;
+	size_t leaf_size;
+	size_t nleaves;
+	uint8_t *dgsts;
+} SM3_TREE_LEAVES;
+
+static void *sm3_tree_hash_leaves(void *arg)
+{
+	SM3_TREE_LEAVES *job = arg;
+	SM3_CTX ctx;
+	size_t i;
+
+	for (i = 0; i < job->nleaves; i++) {
+		sm3_tree_leaf_init(&ctx);
+		sm3_update(&ctx, job->data + job->leaf_size * i, job->leaf_size);
+		sm3_finish(&ctx, job->dgsts + SM3_DIGEST_SIZE * i);
+	}
+	return NULL;
+}
+
+// full leaves are split into one contiguous range per thread
+static void sm3_tree_hash_leaves_threads(const uint8_t *data, size_t leaf_size, size_t nleaves,
+	uint8_t *dgsts, int threads)
+{
+	SM3_TREE_LEAVES jobs[SM3_TREE_MAX_THREADS];
+	size_t njobs = (size_t)threads < nleaves ? (size_t)threads : nleaves;
+	size_t i;
+
+#ifndef WIN32
+	pthread_t tids[SM3_TREE_MAX_THREADS];
+	int started[SM3_TREE_MAX_THREADS] = {0};
+#endif
+
+	if (!njobs) {
+		return;
+	}
+	for (i = 0; i < njobs; i++) {
+		size_t start = nleaves * i / njobs;
+		size_t end = nleaves * (i + 1) / njobs;
+		jobs[i].data = data + leaf_size * start;
+		jobs[i].leaf_size = leaf_size;
+		jobs[i].nleaves = end - start;
+		jobs[i].dgsts = dgsts + SM3_DIGEST_SIZE * start;
+	}
+
+#ifndef WIN32
+	// the calling thread takes the first range, a range not started is also done here
+	for (i = 1; i < njobs; i++) {
+		started[i] = (pthread_create(&tids[i], NULL, sm3_tree_hash_leaves, &jobs[i]) == 0);
+	}
+	sm3_tree_hash_leaves(&jobs[0]);
+	for (i = 1; i < njobs; i++) {
+		if (started[i]) {
+			pthread_join(tids[i], NULL);
+		} else {
+			sm3_tree_hash_leaves(&jobs[i]);
+		}
+	}
+#else
+	for (i = 0; i < njobs; i++) {
+		sm3_tree_hash_leaves(&jobs[i]);
+	}
+#endif
+}
+
+static int sm3_tree_reserve(SM3_TREE_CTX *ctx, size_t nleaves)
+{
+	uint8_t *dgsts;
+	size_t maxdgsts;
+
+	if (nleaves <= ctx->maxdgsts - ctx->ndgsts) {
+		return 1;
+	}
+	maxdgsts = ctx->maxdgsts ? ctx->maxdgsts : 64;
+	while (maxdgsts - ctx->ndgsts < nleaves) {
+		if (maxdgsts > SIZE_MAX / 2 / SM3_DIGEST_SIZE) {
+			error_print();
+			return -1;
+		}
+		maxdgsts *= 2;
+	}
+	if (!(dgsts = realloc(ctx->dgsts, maxdgsts * SM3_DIGEST_SIZE))) {
+		error_print();
+		return -1;
+	}
+	ctx->dgsts = dgsts;
+	ctx->maxdgsts = maxdgsts;
+	return 1;
+}
+
+int sm3_tree_init(SM3_TREE_CTX *ctx, size_t leaf_size, int threads)
+{
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	if (leaf_size < SM3_TREE_MIN_LEAF_SIZE || leaf_size > SM3_TREE_MAX_LEAF_SIZE) {
+		error_print();
+		return -1;
+	}
+	if (threads < 1 || threads > SM3_TREE_MAX_THREADS) {
+		error_print();
+		return -1;
+	}
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->leaf_size = leaf_size;
+	ctx->threads = threads;
+	return 1;
+}
+
+int sm3_tree_update(SM3_TREE_CTX *ctx, const uint8_t *data, size_t datalen)
+{
+	size_t nleaves;
+	size_t len;
+
+	if (!ctx || (!data && datalen)) {
+		error_print();
+		return -1;
+	}
+	ctx->datalen += datalen;
+
+	if (ctx->leaf_nbytes) {
+		len = ctx->leaf_size - ctx->leaf_nbytes;
+		if (datalen < len) {
+			sm3_update(&ctx->leaf_ctx, data, datalen);
+			ctx->leaf_nbytes += datalen;
+			return 1;
+		}
+		if (sm3_tree_reserve(ctx, 1) != 1) {
+			error_print();
+			return -1;
+		}
+		sm3_update(&ctx->leaf_ctx, data, len);
+		sm3_finish(&ctx->leaf_ctx, ctx->dgsts + SM3_DIGEST_SIZE * ctx->ndgsts);
+		ctx->ndgsts++;
+		ctx->leaf_nbytes = 0;
+		data += len;
+		datalen -= len;
+	}
+
+	if ((nleaves = datalen / ctx->leaf_size) > 0) {
+		if (sm3_tree_reserve(ctx, nleaves) != 1) {
+			error_print();
+			return -1;
+		}
+		sm3_tree_hash_leaves_threads(data, ctx->leaf_size, nleaves,
+			ctx->dgsts + SM3_DIGEST_SIZE * ctx->ndgsts, ctx->threads);
+		ctx->ndgsts += nleaves;
+		len = ctx->leaf_size * nleaves;
+		data += len;
+		datalen -= len;
+	}
+
+	if (datalen) {
+		sm3_tree_leaf_init(&ctx->leaf_ctx);
+		sm3_update(&ctx->leaf_ctx, data, datalen);
+		ctx->leaf_nbytes = datalen;
+	}
+	return 1;
+}
+
+int sm3_tree_finish(SM3_TREE_CTX *ctx, uint8_t dgst[SM3_DIGEST_SIZE])
+{
+	uint8_t prefix;
+	uint8_t params[12];
+	SM3_CTX sm3_ctx;
+	size_t n, i;
+
+	if (!ctx || !dgst) {
+		error_print();
+		return -1;
+	}
+
+	// the last short leaf, or the single empty leaf
+	if (ctx->leaf_nbytes || !ctx->ndgsts) {
+		if (sm3_tree_reserve(ctx, 1) != 1) {
+			error_print();
+			return -1;
+		}
+		if (!ctx->leaf_nbytes) {
+			sm3_tree_leaf_init(&ctx->leaf_ctx);
+		}
+		sm3_finish(&ctx->leaf_ctx, ctx->dgsts + SM3_DIGEST_SIZE * ctx->ndgsts);
+		ctx->ndgsts++;
+		ctx->leaf_nbytes = 0;
+	}
+
+	// bottom-up pairing with the odd node promoted is the same tree as the RFC 6962 split
+	prefix = SM3_TREE_NODE;
+	for (n = ctx->ndgsts; n > 1; n = (n + 1) / 2) {
+		for (i = 0; i < n / 2; i++) {
+			sm3_init(&sm3_ctx);
+			sm3_update(&sm3_ctx, &prefix, 1);
+			sm3_update(&sm3_ctx, ctx->dgsts + SM3_DIGEST_SIZE * 2 * i, SM3_DIGEST_SIZE * 2);
+			sm3_finish(&sm3_ctx, ctx->dgsts + SM3_DIGEST_SIZE * i);
+		}
+		if (n % 2) {
+			memmove(ctx->dgsts + SM3_DIGEST_SIZE * i, ctx->dgsts + SM3_DIGEST_SIZE * (n - 1), SM3_DIGEST_SIZE);
+		}
+	}
+
+	prefix = SM3_TREE_ROOT;
+	PUTU32(params, (uint32_t)ctx->leaf_size);
+	PUTU64(params + 4, ctx->datalen);
+	sm3_init(&sm3_ctx);
+	sm3_update(&sm3_ctx, &prefix, 1);
+	sm3_update(&sm3_ctx, params, sizeof(params));
+	sm3_update(&sm3_ctx, ctx->dgsts, SM3_DIGEST_SIZE);
+	sm3_finish(&sm3_ctx, dgst);
+
+	sm3_tree_cleanup(ctx);
+	return 1;
+}
+
+void sm3_tree_cleanup(SM3_TREE_CTX *ctx)
+{
+	if (ctx) {
+		if (ctx->dgsts) {
+			free(ctx->dgsts);
+		}
+		gmssl_secure_clear(ctx, sizeof(SM3_TREE_CTX));
+	}
+}
+
+int sm3_tree_digest(const uint8_t *data, size_t datalen, size_t leaf_size, int threads,
+	uint8_t dgst[SM3_DIGEST_SIZE])
+{
+	SM3_TREE_CTX ctx;
+
+	if (sm3_tree_init(&ctx, leaf_size, threads) != 1) {
+		error_print();
+		return -1;
+	}
+	if (sm3_tree_update(&ctx, data, datalen) != 1
+		|| sm3_tree_finish(&ctx, dgst) != 1) {
+		sm3_tree_cleanup(&ctx);
+		error_print();
+		return -1;
+	}
+	return 1;
+}
@@ -49,21 +49,6 @@ static uint32_t K[64] = {
 	0xa7a879d8U, 0x4f50f3b1U, 0x9ea1e762U, 0x3d43cec5U,
 };
 
-static int _mm256_print(FILE *fp, int fmt, int ind, const char *label, __m256i a)
-{
-	uint32_t arr[8];
-	int i;
-
-	_mm256_storeu_si256((__m256i *)arr, a);
-
-	format_print(fp, fmt, ind, "%s: ", label);
-	for (i = 0; i < 7; i++) {
-		fprintf(fp, "%08X ", arr[i]);
-	}
-	fprintf(fp, "%08X\n", arr[i]);
-	return 1;
-}
-
 void sm3_x8_init(SM3_X8_CTX *ctx)
 {
 	ctx->digest[0] = _mm256_set1_epi32(0x7380166F);
@@ -76,7 +61,8 @@ void sm3_x8_init(SM3_X8_CTX *ctx)
 	ctx->digest[7] = _mm256_set1_epi32(0xB0FB0E4E);
 }
 
-void sm3_x8_compress_blocks(__m256i digest[8], const uint8_t *data, size_t datalen)
+// W[0..15] are the message words of the 8 lanes, W[16..67] are expanded here
+static void sm3_x8_compress(__m256i digest[8], uint32_t W[68][8])
 {
 	__m256i A;
 	__m256i B;
@@ -87,12 +73,8 @@ void sm3_x8_compress_blocks(__m256i digest[8], const uint8_t *data, size_t datal
 	__m256i G;
 	__m256i H;
 	__m256i SS1, SS2, TT1, TT2;
-	uint32_t W[68][8];
-	size_t nblocks = datalen/SM3_BLOCK_SIZE;
 	int j;
 
-	memset(W, 0, sizeof(W));
-
 	A = digest[0];
 	B = digest[1];
 	C = digest[2];
@@ -102,159 +84,158 @@ void sm3_x8_compress_blocks(__m256i digest[8], const uint8_t *data, size_t datal
 	G = digest[6];
 	H = digest[7];
 
-	/*
-	format_print(stderr, 0, 0, "state %d\n", 0);
-	_mm256_print(stderr, 0, 4, "A", A);
-	_mm256_print(stderr, 0, 4, "B", B);
-	_mm256_print(stderr, 0, 4, "C", C);
-	_mm256_print(stderr, 0, 4, "D", D);
-	_mm256_print(stderr, 0, 4, "E", E);
-	_mm256_print(stderr, 0, 4, "F", F);
-	_mm256_print(stderr, 0, 4, "G", G);
-	_mm256_print(stderr, 0, 4, "H", H);
-	*/
+	for (j = 16; j < 68; j++) {
+		// SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
+		SS1 = _mm256_loadu_si256((__m256i *)W[j - 16]);
+		SS2 = _mm256_loadu_si256((__m256i *)W[j -  9]);
+		SS1 = _mm256_xor_si256(SS1, SS2);
+		SS2 = _mm256_loadu_si256((__m256i *)W[j -  3]);
+		SS2 = ROLT(SS2, 15);
+		SS1 = _mm256_xor_si256(SS1, SS2);
+
+		// P1(x) = (x) ^ ROLT((x),15) ^ ROLT((x),23)
+		TT1 = ROLT(SS1, 15);
+		TT2 = ROLT(SS1, 23);
+		SS1 = _mm256_xor_si256(SS1, TT1);
+		SS1 = _mm256_xor_si256(SS1, TT2);
+
+		// ^ (W[j - 13] >>> 7) ^ W[j - 6]
+		SS2 = _mm256_loadu_si256((__m256i *)W[j - 13]);
+		SS2 = ROLT(SS2, 7);
+		SS1 = _mm256_xor_si256(SS1, SS2);
+		SS2 = _mm256_loadu_si256((__m256i *)W[j -  6]);
+		SS1 = _mm256_xor_si256(SS1, SS2);
+
+		_mm256_storeu_si256((__m256i *)&W[j], SS1);
+	}
 
-	while (nblocks--) {
 
-		TT1 = _mm256_setr_epi32(
-			datalen*0, datalen*1, datalen*2, datalen*3,
-			datalen*4, datalen*5, datalen*6, datalen*7);
-		TT2 = _mm256_setr_epi8(
-			3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
-			3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+	for (j = 0; j < 16; j++) {
+		//SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
+		SS2 = ROLT(A, 12);
+		SS1 = _mm256_add_epi32(SS2, E);
+		SS1 = _mm256_add_epi32(SS1, _mm256_set1_epi32(K[j]));
+		SS1 = ROLT(SS1, 7);
+
+		//SS2 = SS1 ^ ROLT(A, 12);
+		SS2 = _mm256_xor_si256(SS2, SS1);
+
+		//TT1 = FF00(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
+		TT2 = _mm256_loadu_si256((__m256i *)W[j]);
+		TT1 = _mm256_xor_si256(TT2, _mm256_loadu_si256((__m256i *)W[j + 4]));
+		TT1 = _mm256_add_epi32(TT1, FF00(A, B, C));
+		TT1 = _mm256_add_epi32(TT1, D);
+		TT1 = _mm256_add_epi32(TT1, SS2);
+
+		//TT2 = GG00(E, F, G) + H + SS1 + W[j];
+		TT2 = _mm256_add_epi32(TT2, GG00(E, F, G));
+		TT2 = _mm256_add_epi32(TT2, H);
+		TT2 = _mm256_add_epi32(TT2, SS1);
+
+		D = C;
+		C = ROLT(B, 9);
+		B = A;
+		A = TT1;
+		H = G;
+		G = ROLT(F, 19);
+		F = E;
+		E = P0(TT2);
+	}
 
-		for (j = 0; j < 16; j++) {
-			SS1 = _mm256_i32gather_epi32(data + 4*j, TT1, 1);
-			SS1 = _mm256_shuffle_epi8(SS1, TT2);
-			_mm256_storeu_si256((__m256i *)W[j], SS1);
-		}
 
-		for (; j < 68; j++) {
-			// SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
-			SS1 = _mm256_loadu_si256((__m256i *)W[j - 16]);
-			SS2 = _mm256_loadu_si256((__m256i *)W[j -  9]);
-			SS1 = _mm256_xor_si256(SS1, SS2);
-			SS2 = _mm256_loadu_si256((__m256i *)W[j -  3]);
-			SS2 = ROLT(SS2, 15);
-			SS1 = _mm256_xor_si256(SS1, SS2);
-
-			// P1(x) = (x) ^ ROLT((x),15) ^ ROLT((x),23)
-			TT1 = ROLT(SS1, 15);
-			TT2 = ROLT(SS1, 23);
-			SS1 = _mm256_xor_si256(SS1, TT1);
-			SS1 = _mm256_xor_si256(SS1, TT2);
-
-			// ^ (W[j - 13] >>> 7) ^ W[j - 6]
-			SS2 = _mm256_loadu_si256((__m256i *)W[j - 13]);
-			SS2 = ROLT(SS2, 7);
-			SS1 = _mm256_xor_si256(SS1, SS2);
-			SS2 = _mm256_loadu_si256((__m256i *)W[j -  6]);
-			SS1 = _mm256_xor_si256(SS1, SS2);
-
-			_mm256_storeu_si256((__m256i *)&W[j], SS1);
-		}
+	for (; j < 64; j++) {
+		//SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
+		SS2 = ROLT(A, 12);
+		SS1 = _mm256_add_epi32(SS2, E);
+		SS1 = _mm256_add_epi32(SS1, _mm256_set1_epi32(K[j]));
+		SS1 = ROLT(SS1, 7);
+
+		//SS2 = SS1 ^ ROLT(A, 12);
+		SS2 = _mm256_xor_si256(SS2, SS1);
+
+		//TT1 = FF16(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
+		TT2 = _mm256_loadu_si256((__m256i *)W[j]);
+		TT1 = _mm256_xor_si256(TT2, _mm256_loadu_si256((__m256i *)W[j + 4]));
+		TT1 = _mm256_add_epi32(TT1, FF16(A, B, C));
+		TT1 = _mm256_add_epi32(TT1, D);
+		TT1 = _mm256_add_epi32(TT1, SS2);
+
+		// TT2 = GG16(E, F, G) + H + SS1 + W[j];
+		TT2 = _mm256_add_epi32(TT2, GG16(E, F, G));
+		TT2 = _mm256_add_epi32(TT2, H);
+		TT2 = _mm256_add_epi32(TT2, SS1);
+
+		D = C;
+		C = ROLT(B, 9);
+		B = A;
+		A = TT1;
+		H = G;
+		G = ROLT(F, 19);
+		F = E;
+		E = P0(TT2);
+	}
 
+	_mm256_storeu_si256((__m256i *)&digest[0], _mm256_xor_si256(A, _mm256_loadu_si256((__m256i *)&digest[0])));
+	_mm256_storeu_si256((__m256i *)&digest[1], _mm256_xor_si256(B, _mm256_loadu_si256((__m256i *)&digest[1])));
+	_mm256_storeu_si256((__m256i *)&digest[2], _mm256_xor_si256(C, _mm256_loadu_si256((__m256i *)&digest[2])));
+	_mm256_storeu_si256((__m256i *)&digest[3], _mm256_xor_si256(D, _mm256_loadu_si256((__m256i *)&digest[3])));
+	_mm256_storeu_si256((__m256i *)&digest[4], _mm256_xor_si256(E, _mm256_loadu_si256((__m256i *)&digest[4])));
+	_mm256_storeu_si256((__m256i *)&digest[5], _mm256_xor_si256(F, _mm256_loadu_si256((__m256i *)&digest[5])));
+	_mm256_storeu_si256((__m256i *)&digest[6], _mm256_xor_si256(G, _mm256_loadu_si256((__m256i *)&digest[6])));
+	_mm256_storeu_si256((__m256i *)&digest[7], _mm256_xor_si256(H, _mm256_loadu_si256((__m256i *)&digest[7])));
+}
 
-		for (j = 0; j < 16; j++) {
-			//SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
-			SS2 = ROLT(A, 12);
-			SS1 = _mm256_add_epi32(SS2, E);
-			SS1 = _mm256_add_epi32(SS1, _mm256_set1_epi32(K[j]));
-			SS1 = ROLT(SS1, 7);
-
-			//SS2 = SS1 ^ ROLT(A, 12);
-			SS2 = _mm256_xor_si256(SS2, SS1);
-
-			//TT1 = FF00(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
-			TT2 = _mm256_loadu_si256((__m256i *)W[j]);
-			TT1 = _mm256_xor_si256(TT2, _mm256_loadu_si256((__m256i *)W[j + 4]));
-			TT1 = _mm256_add_epi32(TT1, FF00(A, B, C));
-			TT1 = _mm256_add_epi32(TT1, D);
-			TT1 = _mm256_add_epi32(TT1, SS2);
-
-			//TT2 = GG00(E, F, G) + H + SS1 + W[j];
-			TT2 = _mm256_add_epi32(TT2, GG00(E, F, G));
-			TT2 = _mm256_add_epi32(TT2, H);
-			TT2 = _mm256_add_epi32(TT2, SS1);
-
-			D = C;
-			C = ROLT(B, 9);
-			B = A;
-			A = TT1;
-			H = G;
-			G = ROLT(F, 19);
-			F = E;
-			E = P0(TT2);
-
-			/*
-			format_print(stderr, 0, 0, "state %d\n", j+1);
-			_mm256_print(stderr, 0, 4, "A", A);
-			_mm256_print(stderr, 0, 4, "B", B);
-			_mm256_print(stderr, 0, 4, "C", C);
-			_mm256_print(stderr, 0, 4, "D", D);
-			_mm256_print(stderr, 0, 4, "E", E);
-			_mm256_print(stderr, 0, 4, "F", F);
-			_mm256_print(stderr, 0, 4, "G", G);
-			_mm256_print(stderr, 0, 4, "H", H);
-			*/
-		}
+void sm3_x8_compress_blocks(__m256i digest[8], const uint8_t *data, size_t datalen)
+{
+	__m256i vindex, bswap, w;
+	uint32_t W[68][8];
+	size_t nblocks = datalen/SM3_BLOCK_SIZE;
+	int j;
 
+	vindex = _mm256_setr_epi32(
+		datalen*0, datalen*1, datalen*2, datalen*3,
+		datalen*4, datalen*5, datalen*6, datalen*7);
+	bswap = _mm256_setr_epi8(
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
 
-		for (; j < 64; j++) {
-			//SS1 = ROLT((ROLT(A, 12) + E + K(j)), 7);
-			SS2 = ROLT(A, 12);
-			SS1 = _mm256_add_epi32(SS2, E);
-			SS1 = _mm256_add_epi32(SS1, _mm256_set1_epi32(K[j]));
-			SS1 = ROLT(SS1, 7);
-
-			//SS2 = SS1 ^ ROLT(A, 12);
-			SS2 = _mm256_xor_si256(SS2, SS1);
-
-			//TT1 = FF16(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
-			TT2 = _mm256_loadu_si256((__m256i *)W[j]);
-			TT1 = _mm256_xor_si256(TT2, _mm256_loadu_si256((__m256i *)W[j + 4]));
-			TT1 = _mm256_add_epi32(TT1, FF16(A, B, C));
-			TT1 = _mm256_add_epi32(TT1, D);
-			TT1 = _mm256_add_epi32(TT1, SS2);
-
-			// TT2 = GG16(E, F, G) + H + SS1 + W[j];
-			TT2 = _mm256_add_epi32(TT2, GG16(E, F, G));
-			TT2 = _mm256_add_epi32(TT2, H);
-			TT2 = _mm256_add_epi32(TT2, SS1);
-
-			D = C;
-			C = ROLT(B, 9);
-			B = A;
-			A = TT1;
-			H = G;
-			G = ROLT(F, 19);
-			F = E;
-			E = P0(TT2);
-
-			/*
-			format_print(stderr, 0, 0, "state %d\n", j+1);
-			_mm256_print(stderr, 0, 4, "A", A);
-			_mm256_print(stderr, 0, 4, "B", B);
-			_mm256_print(stderr, 0, 4, "C", C);
-			_mm256_print(stderr, 0, 4, "D", D);
-			_mm256_print(stderr, 0, 4, "E", E);
-			_mm256_print(stderr, 0, 4, "F", F);
-			_mm256_print(stderr, 0, 4, "G", G);
-			_mm256_print(stderr, 0, 4, "H", H);
-			*/
+	while (nblocks--) {
+		for (j = 0; j < 16; j++) {
+			w = _mm256_i32gather_epi32((const int *)(data + 4*j), vindex, 1);
+			w = _mm256_shuffle_epi8(w, bswap);
+			_mm256_storeu_si256((__m256i *)W[j], w);
 		}
+		sm3_x8_compress(digest, W);
+		data += SM3_BLOCK_SIZE;
+	}
+}
+
+int sm3_x8_avx2_cpu_support(void)
+{
+#if defined(__GNUC__)
+	return __builtin_cpu_supports("avx2");
+#else
+	return 1;
+#endif
+}
 
-		_mm256_storeu_si256((__m256i *)&digest[0], _mm256_xor_si256(A, _mm256_loadu_si256((__m256i *)&digest[0])));
-		_mm256_storeu_si256((__m256i *)&digest[1], _mm256_xor_si256(B, _mm256_loadu_si256((__m256i *)&digest[1])));
-		_mm256_storeu_si256((__m256i *)&digest[2], _mm256_xor_si256(C, _mm256_loadu_si256((__m256i *)&digest[2])));
-		_mm256_storeu_si256((__m256i *)&digest[3], _mm256_xor_si256(D, _mm256_loadu_si256((__m256i *)&digest[3])));
-		_mm256_storeu_si256((__m256i *)&digest[4], _mm256_xor_si256(E, _mm256_loadu_si256((__m256i *)&digest[4])));
-		_mm256_storeu_si256((__m256i *)&digest[5], _mm256_xor_si256(F, _mm256_loadu_si256((__m256i *)&digest[5])));
-		_mm256_storeu_si256((__m256i *)&digest[6], _mm256_xor_si256(G, _mm256_loadu_si256((__m256i *)&digest[6])));
-		_mm256_storeu_si256((__m256i *)&digest[7], _mm256_xor_si256(H, _mm256_loadu_si256((__m256i *)&digest[7])));
+// the message words are already in the lane layout, no gather and byte swap
+void sm3_x8_compress_lanes(uint32_t digest[8][8], uint32_t words[16][8])
+{
+	__m256i state[8];
+	uint32_t W[68][8];
+	int i;
 
-		data += SM3_BLOCK_SIZE;
+	for (i = 0; i < 8; i++) {
+		state[i] = _mm256_loadu_si256((const __m256i *)digest[i]);
+	}
+	memcpy(W, words, sizeof(uint32_t) * 16 * 8);
+	sm3_x8_compress(state, W);
+	for (i = 0; i < 8; i++) {
+		_mm256_storeu_si256((__m256i *)digest[i], state[i]);
 	}
+	gmssl_secure_clear(state, sizeof(state));
+	gmssl_secure_clear(W, sizeof(W));
 }
 
 void sm3_x8_digest(const uint8_t *data, size_t datalen, uint8_t dgst[8][32])
@@ -293,7 +274,7 @@ void sm3_x8_digest(const uint8_t *data, size_t datalen, uint8_t dgst[8][32])
 			3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
 			3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
 	for (i = 0; i < 8; i++) {
-		a = _mm256_i32gather_epi32((uint8_t *)&ctx + 4*i, vindex, 1);
+		a = _mm256_i32gather_epi32((const int *)((uint8_t *)&ctx + 4*i), vindex, 1);
 		a = _mm256_shuffle_epi8(a, b);
 		_mm256_storeu_si256((__m256i *)dgst[i], a);
 	}
@@ -301,24 +282,3 @@ void sm3_x8_digest(const uint8_t *data, size_t datalen, uint8_t dgst[8][32])
 	gmssl_secure_clear(&ctx, sizeof(ctx));
 	gmssl_secure_clear(block, sizeof(block));
 }
-
-static int test_sm3_x8_avx2(void)
-{
-	uint8_t data[8][96] = {0};
-	uint8_t dgst[8][32];
-	uint8_t dgst2[8][32] = {{0}};
-	int i;
-
-	rand_bytes(data[0], sizeof(data));
-	for (i = 0; i < 8; i++) {
-		sm3_digest(data[i], sizeof(data)/8, dgst[i]);
-	}
-	sm3_x8_digest(&data[0][0], sizeof(data)/8, dgst2);
-
-	if (memcmp(dgst2, dgst, sizeof(dgst)) != 0) {
-		error_print();
-		return -1;
-	}
-	printf("%s() ok\n", __FUNCTION__);
-	return 1;
-}
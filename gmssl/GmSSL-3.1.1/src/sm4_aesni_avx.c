@@ -188,3 +188,35 @@ void sm4_ctr_encrypt(const SM4_KEY *key, uint8_t ctr[16], const uint8_t *in, siz
 
 	memset(blocks, 0, sizeof(blocks));
 }
+
+// CBC decryption has no chaining dependency, 4 blocks are decrypted in parallel
+void sm4_cbc_decrypt(const SM4_KEY *key, const uint8_t iv[16],
+	const uint8_t *in, size_t nblocks, uint8_t *out)
+{
+	uint8_t blocks[64];
+	uint8_t last[16];
+
+	memcpy(last, iv, 16);
+
+	while (nblocks >= 4) {
+		sm4_aesni_avx_encrypt(key->rk, in, blocks);
+		gmssl_memxor(blocks, blocks, last, 16);
+		gmssl_memxor(blocks + 16, blocks + 16, in, 48);
+		memcpy(last, in + 48, 16);
+		memcpy(out, blocks, 64);
+		in += 64;
+		out += 64;
+		nblocks -= 4;
+	}
+
+	while (nblocks--) {
+		sm4_encrypt(key, in, blocks);
+		gmssl_memxor(blocks, blocks, last, 16);
+		memcpy(last, in, 16);
+		memcpy(out, blocks, 16);
+		in += 16;
+		out += 16;
+	}
+
+	memset(blocks, 0, sizeof(blocks));
+}
@@ -25,6 +25,7 @@ void sm4_cbc_encrypt(const SM4_KEY *key, const uint8_t iv[16],
 	}
 }
 
+#ifndef SM4_AESNI_AVX
 void sm4_cbc_decrypt(const SM4_KEY *key, const uint8_t iv[16],
 	const uint8_t *in, size_t nblocks, uint8_t *out)
 {
@@ -36,6 +37,7 @@ void sm4_cbc_decrypt(const SM4_KEY *key, const uint8_t iv[16],
 		out += 16;
 	}
 }
+#endif
 
 int sm4_cbc_padding_encrypt(const SM4_KEY *key, const uint8_t iv[16],
 	const uint8_t *in, size_t inlen,
@@ -123,9 +125,6 @@ int sm4_gcm_encrypt(const SM4_KEY *key, const uint8_t *iv, size_t ivlen,
 	const uint8_t *aad, size_t aadlen, const uint8_t *in, size_t inlen,
 	uint8_t *out, size_t taglen, uint8_t *tag)
 {
-	const uint8_t *pin = in;
-	uint8_t *pout = out;
-	size_t left = inlen;
 	uint8_t H[16] = {0};
 	uint8_t Y[16];
 	uint8_t T[16];
@@ -147,16 +146,9 @@ int sm4_gcm_encrypt(const SM4_KEY *key, const uint8_t *iv, size_t ivlen,
 
 	sm4_encrypt(key, Y, T);
 
-	while (left) {
-		uint8_t block[16];
-		size_t len = left < 16 ? left : 16;
-		ctr_incr(Y);
-		sm4_encrypt(key, Y, block);
-		gmssl_memxor(pout, pin, block, len);
-		pin += len;
-		pout += len;
-		left -= len;
-	}
+	// the counter blocks start from Y + 1, so the multi-block sm4_ctr_encrypt can be used
+	ctr_incr(Y);
+	sm4_ctr_encrypt(key, Y, in, inlen, out);
 
 	ghash(H, aad, aadlen, out, inlen, H);
 	gmssl_memxor(tag, T, H, taglen);
@@ -167,9 +159,6 @@ int sm4_gcm_decrypt(const SM4_KEY *key, const uint8_t *iv, size_t ivlen,
 	const uint8_t *aad, size_t aadlen, const uint8_t *in, size_t inlen,
 	const uint8_t *tag, size_t taglen, uint8_t *out)
 {
-	const uint8_t *pin = in;
-	uint8_t *pout = out;
-	size_t left = inlen;
 	uint8_t H[16] = {0};
 	uint8_t Y[16];
 	uint8_t T[16];
@@ -192,16 +181,9 @@ int sm4_gcm_decrypt(const SM4_KEY *key, const uint8_t *iv, size_t ivlen,
 		return -1;
 	}
 
-	while (left) {
-		uint8_t block[16];
-		size_t len = left < 16 ? left : 16;
-		ctr_incr(Y);
-		sm4_encrypt(key, Y, block);
-		gmssl_memxor(pout, pin, block, len);
-		pin += len;
-		pout += len;
-		left -= len;
-	}
+	// the counter blocks start from Y + 1, so the multi-block sm4_ctr_encrypt can be used
+	ctr_incr(Y);
+	sm4_ctr_encrypt(key, Y, in, inlen, out);
 	return 1;
 }
 
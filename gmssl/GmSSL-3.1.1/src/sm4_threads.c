@@ -0,0 +1,312 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include <gmssl/mem.h>
+#include <gmssl/sm4.h>
+#include <gmssl/gf128.h>
+#include <gmssl/gcm.h>
+#include <gmssl/aead.h>
+#include <gmssl/error.h>
+
+
+// a thread is not worth starting for less than 64 KB
+#define SM4_THREAD_MIN_BLOCKS	4096
+
+// the GHASH of a chunk is done while the chunk is still in the L1 cache
+#define SM4_CHUNK_BLOCKS	256
+
+
+typedef struct {
+	const SM4_KEY *key;
+	uint8_t ctr[SM4_BLOCK_SIZE];
+	const uint8_t *in;
+	uint8_t *out;
+	size_t nblocks;
+	const gf128_t *H; // NULL for CTR only
+	int enc;
+	gf128_t X; // GHASH of the ciphertext of the range, starting from zero
+} SM4_CTR_RANGE;
+
+
+static void ctr_add(uint8_t ctr[16], uint64_t n)
+{
+	int i;
+	for (i = 15; i >= 0 && n; i--) {
+		n += ctr[i];
+		ctr[i] = (uint8_t)n;
+		n >>= 8;
+	}
+}
+
+static gf128_t ghash_blocks(gf128_t X, gf128_t H, const uint8_t *c, size_t nblocks)
+{
+	while (nblocks--) {
+		X = gf128_add(X, gf128_from_bytes(c));
+		X = gf128_mul(X, H);
+		c += 16;
+	}
+	return X;
+}
+
+// H^n for n >= 1
+static gf128_t gf128_pow(gf128_t H, uint64_t n)
+{
+	gf128_t R = H;
+	int i = 63;
+
+	while (!((n >> i) & 1)) {
+		i--;
+	}
+	for (i--; i >= 0; i--) {
+		R = gf128_mul(R, R);
+		if ((n >> i) & 1) {
+			R = gf128_mul(R, H);
+		}
+	}
+	return R;
+}
+
+static void *sm4_ctr_range(void *arg)
+{
+	SM4_CTR_RANGE *r = arg;
+	const uint8_t *in = r->in;
+	uint8_t *out = r->out;
+	size_t nblocks = r->nblocks;
+	size_t n;
+
+	r->X = gf128_zero();
+	while (nblocks) {
+		n = nblocks < SM4_CHUNK_BLOCKS ? nblocks : SM4_CHUNK_BLOCKS;
+		if (r->H && !r->enc) {
+			r->X = ghash_blocks(r->X, *r->H, in, n);
+		}
+		sm4_ctr_encrypt(r->key, r->ctr, in, n * SM4_BLOCK_SIZE, out);
+		if (r->H && r->enc) {
+			r->X = ghash_blocks(r->X, *r->H, out, n);
+		}
+		in += n * SM4_BLOCK_SIZE;
+		out += n * SM4_BLOCK_SIZE;
+		nblocks -= n;
+	}
+	return NULL;
+}
+
+/*
+ * The ranges are independent, the GHASH state is combined in order as
+ *   X = X * H^{nblocks_i} + X_i
+ */
+static void sm4_ctr_blocks_threads(const SM4_KEY *key, uint8_t ctr[SM4_BLOCK_SIZE],
+	GHASH_CTX *ghash_ctx, int enc, const uint8_t *in, size_t nblocks, uint8_t *out, int threads)
+{
+	SM4_CTR_RANGE ranges[SM4_MAX_THREADS];
+	size_t nranges;
+	size_t start = 0;
+	size_t i;
+
+#ifndef WIN32
+	pthread_t tids[SM4_MAX_THREADS];
+	int started[SM4_MAX_THREADS] = {0};
+#endif
+
+	if (threads > SM4_MAX_THREADS) {
+		threads = SM4_MAX_THREADS;
+	}
+	nranges = nblocks / SM4_THREAD_MIN_BLOCKS;
+	if (nranges > (size_t)threads) {
+		nranges = (size_t)threads;
+	}
+	if (!nranges) {
+		nranges = 1;
+	}
+
+	for (i = 0; i < nranges; i++) {
+		size_t end = nblocks * (i + 1) / nranges;
+		ranges[i].key = key;
+		memcpy(ranges[i].ctr, ctr, SM4_BLOCK_SIZE);
+		ctr_add(ranges[i].ctr, start);
+		ranges[i].in = in + start * SM4_BLOCK_SIZE;
+		ranges[i].out = out + start * SM4_BLOCK_SIZE;
+		ranges[i].nblocks = end - start;
+		ranges[i].H = ghash_ctx ? &ghash_ctx->H : NULL;
+		ranges[i].enc = enc;
+		start = end;
+	}
+
+#ifndef WIN32
+	for (i = 1; i < nranges; i++) {
+		started[i] = (pthread_create(&tids[i], NULL, sm4_ctr_range, &ranges[i]) == 0);
+	}
+	sm4_ctr_range(&ranges[0]);
+	for (i = 1; i < nranges; i++) {
+		if (started[i]) {
+			pthread_join(tids[i], NULL);
+		} else {
+			sm4_ctr_range(&ranges[i]);
+		}
+	}
+#else
+	for (i = 0; i < nranges; i++) {
+		sm4_ctr_range(&ranges[i]);
+	}
+#endif
+
+	ctr_add(ctr, nblocks);
+
+	if (ghash_ctx) {
+		for (i = 0; i < nranges; i++) {
+			ghash_ctx->X = gf128_mul(ghash_ctx->X, gf128_pow(ghash_ctx->H, ranges[i].nblocks));
+			ghash_ctx->X = gf128_add(ghash_ctx->X, ranges[i].X);
+		}
+		ghash_ctx->clen += nblocks * SM4_BLOCK_SIZE;
+	}
+	gmssl_secure_clear(ranges, sizeof(ranges));
+}
+
+// GHASH is over the output when encrypting and over the input when decrypting
+static int sm4_ctr_update_threads(SM4_CTR_CTX *ctx, GHASH_CTX *ghash_ctx, int enc,
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen, int threads)
+{
+	size_t len;
+	size_t n;
+
+	if (!ctx || !in || !out || !outlen || threads < 1) {
+		error_print();
+		return -1;
+	}
+	*outlen = 0;
+
+	// finish the partial block first, then the counter is block aligned
+	if (ctx->block_nbytes) {
+		len = SM4_BLOCK_SIZE - ctx->block_nbytes;
+		if (len > inlen) {
+			len = inlen;
+		}
+		if (ghash_ctx && !enc) {
+			ghash_update(ghash_ctx, in, len);
+		}
+		if (sm4_ctr_encrypt_update(ctx, in, len, out, &n) != 1) {
+			error_print();
+			return -1;
+		}
+		if (ghash_ctx && enc) {
+			ghash_update(ghash_ctx, out, n);
+		}
+		in += len;
+		inlen -= len;
+		out += n;
+		*outlen += n;
+	}
+
+	if (inlen >= SM4_BLOCK_SIZE) {
+		if (ghash_ctx && ghash_ctx->num) {
+			error_print();
+			return -1;
+		}
+		n = inlen / SM4_BLOCK_SIZE;
+		sm4_ctr_blocks_threads(&ctx->sm4_key, ctx->ctr, ghash_ctx, enc, in, n, out, threads);
+		len = n * SM4_BLOCK_SIZE;
+		in += len;
+		inlen -= len;
+		out += len;
+		*outlen += len;
+	}
+
+	if (inlen) {
+		if (ghash_ctx && !enc) {
+			ghash_update(ghash_ctx, in, inlen);
+		}
+		if (sm4_ctr_encrypt_update(ctx, in, inlen, out, &n) != 1) {
+			error_print();
+			return -1;
+		}
+		*outlen += n;
+	}
+	return 1;
+}
+
+int sm4_ctr_encrypt_update_threads(SM4_CTR_CTX *ctx, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen, int threads)
+{
+	if (sm4_ctr_update_threads(ctx, NULL, 1, in, inlen, out, outlen, threads) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int sm4_gcm_encrypt_update_threads(SM4_GCM_CTX *ctx,
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen, int threads)
+{
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	if (sm4_ctr_update_threads(&ctx->enc_ctx, &ctx->mac_ctx, 1, in, inlen, out, outlen, threads) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+// the last taglen bytes of the input are kept in ctx->mac as in sm4_gcm_decrypt_update()
+int sm4_gcm_decrypt_update_threads(SM4_GCM_CTX *ctx,
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen, int threads)
+{
+	size_t len;
+
+	if (!ctx || !in || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (ctx->maclen > ctx->taglen) {
+		error_print();
+		return -1;
+	}
+
+	if (ctx->maclen < ctx->taglen) {
+		len = ctx->taglen - ctx->maclen;
+		if (inlen <= len) {
+			memcpy(ctx->mac + ctx->maclen, in, inlen);
+			ctx->maclen += inlen;
+			*outlen = 0;
+			return 1;
+		}
+		memcpy(ctx->mac + ctx->maclen, in, len);
+		ctx->maclen += len;
+		in += len;
+		inlen -= len;
+	}
+	if (inlen <= ctx->taglen) {
+		if (sm4_gcm_decrypt_update(ctx, in, inlen, out, outlen) != 1) {
+			error_print();
+			return -1;
+		}
+		return 1;
+	}
+
+	if (sm4_ctr_update_threads(&ctx->enc_ctx, &ctx->mac_ctx, 0, ctx->mac, ctx->taglen, out, outlen, 1) != 1) {
+		error_print();
+		return -1;
+	}
+	out += *outlen;
+	inlen -= ctx->taglen;
+	if (sm4_ctr_update_threads(&ctx->enc_ctx, &ctx->mac_ctx, 0, in, inlen, out, &len, threads) != 1) {
+		error_print();
+		return -1;
+	}
+	*outlen += len;
+	memcpy(ctx->mac, in + inlen, ctx->taglen);
+	return 1;
+}
@@ -98,6 +98,11 @@ int tls_socket_accept(tls_socket_t sock, struct sockaddr_in *addr, tls_socket_t
 	return 1;
 }
 
+int tls_socket_set_reuseport(tls_socket_t sock)
+{
+	return 0;
+}
+
 #else
 
 int tls_socket_lib_init(void)
@@ -166,4 +171,19 @@ int tls_socket_accept(tls_socket_t sock, struct sockaddr_in *addr, tls_socket_t
 	}
 	return 1;
 }
+
+int tls_socket_set_reuseport(tls_socket_t sock)
+{
+#ifdef SO_REUSEPORT
+	int on = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1) {
+		fprintf(stderr, "%s %d: setsockopt SO_REUSEPORT error: %s\n", __FILE__, __LINE__, strerror(errno));
+		error_print();
+		return -1;
+	}
+	return 1;
+#else
+	return 0;
+#endif
+}
 #endif
@@ -25,7 +25,7 @@
 #include <gmssl/tls.h>
 
 
-static const int tlcp_ciphers[] = { TLS_cipher_ecc_sm4_cbc_sm3 };
+static const int tlcp_ciphers[] = { TLS_cipher_ecc_sm4_gcm_sm3, TLS_cipher_ecc_sm4_cbc_sm3 };
 static const size_t tlcp_ciphers_count = sizeof(tlcp_ciphers)/sizeof(tlcp_ciphers[0]);
 
 void printbyte(uint8_t *ptr, int len, char *name) {
@@ -137,6 +137,8 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 	uint8_t server_random[32];
 	int protocol;
 	int cipher_suite;
+	int ciphers[TLS_MAX_CIPHER_SUITES_COUNT];
+	size_t ciphers_cnt;
 	const uint8_t *random;
 	const uint8_t *session_id;
 	size_t session_id_len;
@@ -181,9 +183,11 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 
 	// send ClientHello
 	tls_random_generate(client_random);
-	if (tls_record_set_handshake_client_hello(record, &recordlen,
-		TLS_protocol_tlcp, client_random, NULL, 0,
-		tlcp_ciphers, tlcp_ciphers_count, NULL, 0) != 1) {
+	if (tls_cipher_suites_filter(conn->cipher_suites, conn->cipher_suites_cnt,
+			tlcp_ciphers, tlcp_ciphers_count, ciphers, &ciphers_cnt) != 1
+		|| tls_record_set_handshake_client_hello(record, &recordlen,
+			TLS_protocol_tlcp, client_random, NULL, 0,
+			ciphers, ciphers_cnt, NULL, 0) != 1) {
 		error_print();
 		goto end;
 	}
@@ -220,7 +224,7 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 		error_print();
 		goto end;
 	}
-	if (tls_cipher_suite_in_list(cipher_suite, tlcp_ciphers, tlcp_ciphers_count) != 1) {
+	if (tls_cipher_suite_in_list(cipher_suite, ciphers, ciphers_cnt) != 1) {
 		tls_send_alert(conn, TLS_alert_handshake_failure);
 		error_print();
 		goto end;
@@ -254,11 +258,11 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
 
 	// verify ServerCertificate
-	if (conn->ca_certs_len) {
+	if (conn->ca_certs_len || conn->ca_store) {
 		// 只有提供了CA证书才验证服务器证书链
 		// FIXME: 逻辑需要再检查
-		if (x509_certs_verify_tlcp(conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
-			conn->ca_certs, conn->ca_certs_len, depth, &verify_result) != 1) {
+		if (tls_verify_peer_certs_tlcp(conn, conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
+			depth, &verify_result) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_bad_certificate);
 			goto end;
@@ -394,10 +398,11 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
 	}
-	sm3_hmac_init(&conn->client_write_mac_ctx, conn->key_block, 32);
-	sm3_hmac_init(&conn->server_write_mac_ctx, conn->key_block + 32, 32);
-	sm4_set_encrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
-	sm4_set_decrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	if (tls_set_record_keys(conn) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	/*
 	tls_secrets_print(stderr,
 		pre_master_secret, 48,
@@ -483,8 +488,7 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 
 	// encrypt Client Finished
 	tls_trace("encrypt Finished\n");
-	if (tls_record_encrypt(&conn->client_write_mac_ctx, &conn->client_write_enc_key,
-		conn->client_seq_num, finished_record, finished_record_len, record, &recordlen) != 1) {
+	if (tls_conn_record_encrypt(conn, finished_record, finished_record_len, record, &recordlen) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
@@ -526,8 +530,7 @@ int tlcp_do_connect(TLS_CONNECT *conn)
 	}
 	tlcp_record_trace(stderr, record, recordlen, (1<<24), 0); // 强制打印密文原数据
 	tls_trace("decrypt Finished\n");
-	if (tls_record_decrypt(&conn->server_write_mac_ctx, &conn->server_write_enc_key,
-		conn->server_seq_num, record, recordlen, finished_record, &finished_record_len) != 1) {
+	if (tls_conn_record_decrypt(conn, record, recordlen, finished_record, &finished_record_len) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
@@ -579,7 +582,8 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 	uint8_t *record = conn->record;
 	uint8_t finished_record[TLS_FINISHED_RECORD_BUF_SIZE]; // 解密可能导致前面的record被覆盖
 	size_t recordlen, finished_record_len;
-	const int server_ciphers[] = { TLS_cipher_ecc_sm4_cbc_sm3 }; // 未来应该支持GCM/CBC两个套件
+	int server_ciphers[TLS_MAX_CIPHER_SUITES_COUNT];
+	size_t server_ciphers_cnt;
 
 	// ClientHello, ServerHello
 	uint8_t client_random[32];
@@ -628,7 +632,7 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 
 
 	// 服务器端如果设置了CA
-	if (conn->ca_certs_len)
+	if (conn->ca_certs_len || conn->ca_store)
 		client_verify = 1;
 
 	// 初始化Finished和客户端验证环境
@@ -662,9 +666,10 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	memcpy(client_random, random, 32);
-	if (tls_cipher_suites_select(client_ciphers, client_ciphers_len,
-		server_ciphers, sizeof(server_ciphers)/sizeof(server_ciphers[0]),
-		&conn->cipher_suite) != 1) {
+	if (tls_cipher_suites_filter(conn->cipher_suites, conn->cipher_suites_cnt,
+			tlcp_ciphers, tlcp_ciphers_count, server_ciphers, &server_ciphers_cnt) != 1
+		|| tls_cipher_suites_select(client_ciphers, client_ciphers_len,
+			server_ciphers, server_ciphers_cnt, &conn->cipher_suite) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_insufficient_security);
 		goto end;
@@ -743,18 +748,12 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 	// send CertificateRequest
 	if (client_verify) {
 		const uint8_t cert_types[] = { TLS_cert_type_ecdsa_sign };
-		uint8_t ca_names[TLS_MAX_CA_NAMES_SIZE] = {0}; // TODO: 根据客户端验证CA证书列计算缓冲大小，或直接输出到record缓冲
-		size_t ca_names_len = 0;
 
+		// the names are encoded once by tls_ctx_set_ca_certificates()
 		tls_trace("send CertificateRequest\n");
-		if (tls_authorities_from_certs(ca_names, &ca_names_len, sizeof(ca_names),
-			conn->ca_certs, conn->ca_certs_len) != 1) {
-			error_print();
-			goto end;
-		}
 		if (tls_record_set_handshake_certificate_request(record, &recordlen,
 			cert_types, sizeof(cert_types),
-			ca_names, ca_names_len) != 1) {
+			conn->ca_names, conn->ca_names_len) != 1) {
 			error_print();
 			goto end;
 		}
@@ -777,7 +776,7 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
 
 	// recv ClientCertificate
-	if (conn->ca_certs_len) {
+	if (conn->ca_certs_len || conn->ca_store) {
 		tls_trace("recv ClientCertificate\n");
 		if (tls_record_recv(record, &recordlen, conn->sock) != 1
 			|| tls_record_protocol(record) != TLS_protocol_tlcp) {
@@ -791,8 +790,8 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 			tls_send_alert(conn, TLS_alert_unexpected_message);
 			goto end;
 		}
-		if (x509_certs_verify(conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
-			conn->ca_certs, conn->ca_certs_len, verify_depth, &verify_result) != 1) {
+		if (tls_verify_peer_certs(conn, conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
+			verify_depth, &verify_result) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_bad_certificate);
 			goto end;
@@ -875,10 +874,11 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
 	}
-	sm3_hmac_init(&conn->client_write_mac_ctx, conn->key_block, 32);
-	sm3_hmac_init(&conn->server_write_mac_ctx, conn->key_block + 32, 32);
-	sm4_set_decrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
-	sm4_set_encrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	if (tls_set_record_keys(conn) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	/*
 	tls_secrets_print(stderr,
 		pre_master_secret, 48,
@@ -920,8 +920,7 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 
 	// decrypt ClientFinished
 	tls_trace("decrypt Finished\n");
-	if (tls_record_decrypt(&conn->client_write_mac_ctx, &conn->client_write_enc_key,
-		conn->client_seq_num, record, recordlen, finished_record, &finished_record_len) != 1) {
+	if (tls_conn_record_decrypt(conn, record, recordlen, finished_record, &finished_record_len) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
@@ -980,8 +979,7 @@ int tlcp_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	tlcp_record_trace(stderr, finished_record, finished_record_len, 0, 0);
-	if (tls_record_encrypt(&conn->server_write_mac_ctx, &conn->server_write_enc_key,
-		conn->server_seq_num, finished_record, finished_record_len, record, &recordlen) != 1) {
+	if (tls_conn_record_encrypt(conn, finished_record, finished_record_len, record, &recordlen) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
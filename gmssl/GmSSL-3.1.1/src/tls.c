@@ -21,6 +21,7 @@
 #include <gmssl/sm2.h>
 #include <gmssl/sm3.h>
 #include <gmssl/sm4.h>
+#include <gmssl/gcm.h>
 #include <gmssl/pem.h>
 #include <gmssl/tls.h>
 
@@ -264,6 +265,17 @@ int tls_record_set_data(uint8_t *record, const uint8_t *data, size_t datalen)
 	return 1;
 }
 
+/*
+The MAC-then-encrypt CBC record protection is stitched: the record is processed in chunks
+of TLS_CBC_STITCH_SIZE bytes, each chunk is MACed and encrypted (or decrypted and MACed)
+while it is still in the L1 cache, so the 16 KB record is not read twice from memory.
+
+The explicit IV of a record is E_K(seq_num || 0^64) with the record encryption key, the
+encrypted nonce method of NIST SP 800-38A Appendix C. The sequence number never repeats
+under the same key, so the IV is unpredictable without a rand_bytes() call per record.
+*/
+#define TLS_CBC_STITCH_SIZE	1024
+
 int tls_cbc_encrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *enc_key,
 	const uint8_t seq_num[8], const uint8_t header[5],
 	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
@@ -271,6 +283,7 @@ int tls_cbc_encrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *enc_key,
 	SM3_HMAC_CTX hmac_ctx;
 	uint8_t last_blocks[32 + 16] = {0};
 	uint8_t *mac, *padding, *iv;
+	size_t left, len;
 	int rem, padding_len;
 	int i;
 
@@ -288,13 +301,31 @@ int tls_cbc_encrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *enc_key,
 	}
 
 	rem = (inlen + 32) % 16;
-	memcpy(last_blocks, in + inlen - rem, rem);
-	mac = last_blocks + rem;
+
+	iv = out;
+	memcpy(iv, seq_num, 8);
+	memset(iv + 8, 0, 8);
+	sm4_encrypt(enc_key, iv, iv);
+	out += 16;
 
 	memcpy(&hmac_ctx, inited_hmac_ctx, sizeof(SM3_HMAC_CTX));
 	sm3_hmac_update(&hmac_ctx, seq_num, 8);
 	sm3_hmac_update(&hmac_ctx, header, 5);
-	sm3_hmac_update(&hmac_ctx, in, inlen);
+
+	left = inlen - rem;
+	while (left) {
+		len = left < TLS_CBC_STITCH_SIZE ? left : TLS_CBC_STITCH_SIZE;
+		sm3_hmac_update(&hmac_ctx, in, len);
+		sm4_cbc_encrypt(enc_key, iv, in, len/16, out);
+		iv = out + len - 16;
+		in += len;
+		out += len;
+		left -= len;
+	}
+
+	memcpy(last_blocks, in, rem);
+	mac = last_blocks + rem;
+	sm3_hmac_update(&hmac_ctx, in, rem);
 	sm3_hmac_finish(&hmac_ctx, mac);
 
 	padding = mac + 32;
@@ -303,20 +334,9 @@ int tls_cbc_encrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *enc_key,
 		padding[i] = (uint8_t)padding_len;
 	}
 
-	iv = out;
-	if (rand_bytes(iv, 16) != 1) {
-		error_print();
-		return -1;
-	}
-	out += 16;
-
-	if (inlen >= 16) {
-		sm4_cbc_encrypt(enc_key, iv, in, inlen/16, out);
-		out += inlen - rem;
-		iv = out - 16;
-	}
 	sm4_cbc_encrypt(enc_key, iv, last_blocks, sizeof(last_blocks)/16, out);
 	*outlen = 16 + inlen - rem + sizeof(last_blocks);
+	gmssl_secure_clear(last_blocks, sizeof(last_blocks));
 	return 1;
 }
 
@@ -331,6 +351,7 @@ int tls_cbc_decrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *dec_key,
 	uint8_t header[5];
 	int padding_len;
 	uint8_t hmac[32];
+	size_t datalen, left, len, off;
 	int i;
 
 	if (!inited_hmac_ctx || !dec_key || !seq_num || !enced_header || !in || !inlen || !out || !outlen) {
@@ -348,39 +369,53 @@ int tls_cbc_decrypt(const SM3_HMAC_CTX *inited_hmac_ctx, const SM4_KEY *dec_key,
 	in += 16;
 	inlen -= 16;
 
-	sm4_cbc_decrypt(dec_key, iv, in, inlen/16, out);
-
+	// the last block gives the padding length, so the data length in the MACed header
+	// is known before the data is decrypted
+	sm4_cbc_decrypt(dec_key, in + inlen - 32, in + inlen - 16, 1, out + inlen - 16);
 	padding_len = out[inlen - 1];
-	padding = out + inlen - padding_len - 1;
-	if (padding < out + 32) {
+	if (inlen < 32 + (size_t)padding_len + 1) {
 		error_print();
 		return -1;
 	}
-	for (i = 0; i < padding_len; i++) {
-		if (padding[i] != padding_len) {
-			error_puts("tls ciphertext cbc-padding check failure");
-			return -1;
-		}
-	}
-
-	*outlen = inlen - 32 - padding_len - 1;
+	datalen = inlen - 32 - padding_len - 1;
 
 	header[0] = enced_header[0];
 	header[1] = enced_header[1];
 	header[2] = enced_header[2];
-	header[3] = (uint8_t)((*outlen) >> 8);
-	header[4] = (uint8_t)(*outlen);
-	mac = padding - 32;
+	header[3] = (uint8_t)(datalen >> 8);
+	header[4] = (uint8_t)datalen;
 
 	memcpy(&hmac_ctx, inited_hmac_ctx, sizeof(SM3_HMAC_CTX));
 	sm3_hmac_update(&hmac_ctx, seq_num, 8);
 	sm3_hmac_update(&hmac_ctx, header, 5);
-	sm3_hmac_update(&hmac_ctx, out, *outlen);
+
+	left = inlen - 16;
+	off = 0;
+	while (left) {
+		len = left < TLS_CBC_STITCH_SIZE ? left : TLS_CBC_STITCH_SIZE;
+		sm4_cbc_decrypt(dec_key, iv, in + off, len/16, out + off);
+		if (off < datalen) {
+			sm3_hmac_update(&hmac_ctx, out + off, (datalen - off) < len ? (datalen - off) : len);
+		}
+		iv = in + off + len - 16;
+		off += len;
+		left -= len;
+	}
 	sm3_hmac_finish(&hmac_ctx, hmac);
+
+	padding = out + inlen - padding_len - 1;
+	for (i = 0; i < padding_len; i++) {
+		if (padding[i] != padding_len) {
+			error_puts("tls ciphertext cbc-padding check failure");
+			return -1;
+		}
+	}
+	mac = padding - 32;
 	if (gmssl_secure_memcmp(mac, hmac, sizeof(hmac)) != 0) {
 		error_puts("tls ciphertext mac check failure\n");
 		return -1;
 	}
+	*outlen = datalen;
 	return 1;
 }
 
@@ -425,6 +460,255 @@ int tls_record_decrypt(const SM3_HMAC_CTX *hmac_ctx, const SM4_KEY *cbc_key,
 	return 1;
 }
 
+/*
+AEAD record protection of the GCM cipher suites of TLCP and TLS 1.2 (RFC 5288)
+
+	GenericAEADCipher = nonce_explicit (8) || ciphertext || tag (16)
+	nonce = implicit iv (4) || nonce_explicit
+	additional_data = seq_num || type || version || length
+
+The sequence number is used as the nonce_explicit, it never repeats under the same key.
+*/
+int tls_gcm_encrypt(const BLOCK_CIPHER_KEY *key, const uint8_t iv[4],
+	const uint8_t seq_num[8], const uint8_t header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	uint8_t nonce[12];
+	uint8_t aad[13];
+
+	if (!key || !iv || !seq_num || !header || !in || !inlen || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (inlen > TLS_MAX_PLAINTEXT_SIZE) {
+		error_print_msg("invalid tls record data length %zu\n", inlen);
+		return -1;
+	}
+	if ((((size_t)header[3]) << 8) + header[4] != inlen) {
+		error_print();
+		return -1;
+	}
+
+	memcpy(nonce, iv, 4);
+	memcpy(nonce + 4, seq_num, 8);
+	memcpy(aad, seq_num, 8);
+	memcpy(aad + 8, header, 5);
+
+	memcpy(out, seq_num, 8);
+	if (gcm_encrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), in, inlen,
+		out + 8, GHASH_SIZE, out + 8 + inlen) != 1) {
+		error_print();
+		return -1;
+	}
+	*outlen = 8 + inlen + GHASH_SIZE;
+	return 1;
+}
+
+int tls_gcm_decrypt(const BLOCK_CIPHER_KEY *key, const uint8_t iv[4],
+	const uint8_t seq_num[8], const uint8_t enced_header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	uint8_t nonce[12];
+	uint8_t aad[13];
+	size_t datalen;
+
+	if (!key || !iv || !seq_num || !enced_header || !in || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (inlen <= 8 + GHASH_SIZE
+		|| inlen > 8 + TLS_MAX_PLAINTEXT_SIZE + GHASH_SIZE) {
+		error_print_msg("invalid tls gcm ciphertext length %zu\n", inlen);
+		return -1;
+	}
+	datalen = inlen - 8 - GHASH_SIZE;
+
+	memcpy(nonce, iv, 4);
+	memcpy(nonce + 4, in, 8);
+	memcpy(aad, seq_num, 8);
+	aad[8] = enced_header[0];
+	aad[9] = enced_header[1];
+	aad[10] = enced_header[2];
+	aad[11] = (uint8_t)(datalen >> 8);
+	aad[12] = (uint8_t)datalen;
+
+	if (gcm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), in + 8, datalen,
+		in + 8 + datalen, GHASH_SIZE, out) != 1) {
+		error_puts("tls ciphertext gcm tag check failure");
+		return -1;
+	}
+	*outlen = datalen;
+	return 1;
+}
+
+int tls_cipher_suite_is_aead(int cipher_suite)
+{
+	switch (cipher_suite) {
+	case TLS_cipher_ecc_sm4_gcm_sm3:
+	case TLS_cipher_ecdhe_sm4_gcm_sm3:
+		return 1;
+	}
+	return 0;
+}
+
+int tls_cipher_suites_filter(const int *cipher_suites, size_t cipher_suites_cnt,
+	const int *supported, size_t supported_cnt, int *out, size_t *outcnt)
+{
+	size_t i;
+
+	if (!supported || !supported_cnt || !out || !outcnt) {
+		error_print();
+		return -1;
+	}
+	if (!cipher_suites || !cipher_suites_cnt) {
+		memcpy(out, supported, supported_cnt * sizeof(int));
+		*outcnt = supported_cnt;
+		return 1;
+	}
+	*outcnt = 0;
+	for (i = 0; i < cipher_suites_cnt; i++) {
+		if (tls_cipher_suite_in_list(cipher_suites[i], supported, supported_cnt) == 1) {
+			out[(*outcnt)++] = cipher_suites[i];
+		}
+	}
+	if (!*outcnt) {
+		error_puts("no supported cipher suite");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+key_block of the CBC suites:
+	client_write_MAC_key[32] server_write_MAC_key[32] client_write_key[16] server_write_key[16]
+key_block of the GCM suites:
+	client_write_key[16] server_write_key[16] client_write_IV[4] server_write_IV[4]
+*/
+int tls_ecdhe_key_generate(const TLS_CONNECT *conn, SM2_KEY *key)
+{
+	if (!conn || !key) {
+		error_print();
+		return -1;
+	}
+	if (conn->key_pool) {
+		if (sm2_key_pool_get(conn->key_pool, key) != 1) {
+			error_print();
+			return -1;
+		}
+	} else {
+		if (sm2_key_generate(key) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int tls_set_record_keys(TLS_CONNECT *conn)
+{
+	if (!conn) {
+		error_print();
+		return -1;
+	}
+	if (tls_cipher_suite_is_aead(conn->cipher_suite)) {
+		if (block_cipher_set_encrypt_key(&conn->client_write_key, BLOCK_CIPHER_sm4(), conn->key_block) != 1
+			|| block_cipher_set_encrypt_key(&conn->server_write_key, BLOCK_CIPHER_sm4(), conn->key_block + 16) != 1) {
+			error_print();
+			return -1;
+		}
+		memcpy(conn->client_write_iv, conn->key_block + 32, 4);
+		memcpy(conn->server_write_iv, conn->key_block + 36, 4);
+		return 1;
+	}
+
+	sm3_hmac_init(&conn->client_write_mac_ctx, conn->key_block, 32);
+	sm3_hmac_init(&conn->server_write_mac_ctx, conn->key_block + 32, 32);
+	if (conn->is_client) {
+		sm4_set_encrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
+		sm4_set_decrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	} else {
+		sm4_set_decrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
+		sm4_set_encrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	}
+	return 1;
+}
+
+// protect the record data with the write keys and sequence number of this side
+static int tls_data_encrypt(const TLS_CONNECT *conn, const uint8_t header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	int client = conn->is_client;
+
+	if (tls_cipher_suite_is_aead(conn->cipher_suite)) {
+		return tls_gcm_encrypt(client ? &conn->client_write_key : &conn->server_write_key,
+			client ? conn->client_write_iv : conn->server_write_iv,
+			client ? conn->client_seq_num : conn->server_seq_num,
+			header, in, inlen, out, outlen);
+	}
+	return tls_cbc_encrypt(client ? &conn->client_write_mac_ctx : &conn->server_write_mac_ctx,
+		client ? &conn->client_write_enc_key : &conn->server_write_enc_key,
+		client ? conn->client_seq_num : conn->server_seq_num,
+		header, in, inlen, out, outlen);
+}
+
+// remove the protection with the write keys and sequence number of the peer
+static int tls_data_decrypt(const TLS_CONNECT *conn, const uint8_t header[5],
+	const uint8_t *in, size_t inlen, uint8_t *out, size_t *outlen)
+{
+	int client = conn->is_client;
+
+	if (tls_cipher_suite_is_aead(conn->cipher_suite)) {
+		return tls_gcm_decrypt(client ? &conn->server_write_key : &conn->client_write_key,
+			client ? conn->server_write_iv : conn->client_write_iv,
+			client ? conn->server_seq_num : conn->client_seq_num,
+			header, in, inlen, out, outlen);
+	}
+	return tls_cbc_decrypt(client ? &conn->server_write_mac_ctx : &conn->client_write_mac_ctx,
+		client ? &conn->server_write_enc_key : &conn->client_write_enc_key,
+		client ? conn->server_seq_num : conn->client_seq_num,
+		header, in, inlen, out, outlen);
+}
+
+int tls_conn_record_encrypt(const TLS_CONNECT *conn, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen)
+{
+	if (!conn || !in || inlen < 5 || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (tls_data_encrypt(conn, in, in + 5, inlen - 5, out + 5, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	out[0] = in[0];
+	out[1] = in[1];
+	out[2] = in[2];
+	out[3] = (uint8_t)((*outlen) >> 8);
+	out[4] = (uint8_t)(*outlen);
+	(*outlen) += 5;
+	return 1;
+}
+
+int tls_conn_record_decrypt(const TLS_CONNECT *conn, const uint8_t *in, size_t inlen,
+	uint8_t *out, size_t *outlen)
+{
+	if (!conn || !in || inlen < 5 || !out || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (tls_data_decrypt(conn, in, in + 5, inlen - 5, out + 5, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	out[0] = in[0];
+	out[1] = in[1];
+	out[2] = in[2];
+	out[3] = (uint8_t)((*outlen) >> 8);
+	out[4] = (uint8_t)(*outlen);
+	(*outlen) += 5;
+	return 1;
+}
+
 int tls_random_generate(uint8_t random[32])
 {
 	uint32_t gmt_unix_time = (uint32_t)time(NULL);
@@ -1650,8 +1934,6 @@ int tls_send_warning(TLS_CONNECT *conn, int alert)
 
 int tls_send(TLS_CONNECT *conn, const uint8_t *in, size_t inlen, size_t *sentlen)
 {
-	const SM3_HMAC_CTX *hmac_ctx;
-	const SM4_KEY *enc_key;
 	uint8_t *seq_num;
 	uint8_t *record;
 	size_t datalen;
@@ -1669,15 +1951,7 @@ int tls_send(TLS_CONNECT *conn, const uint8_t *in, size_t inlen, size_t *sentlen
 		inlen = TLS_MAX_PLAINTEXT_SIZE;
 	}
 
-	if (conn->is_client) {
-		hmac_ctx = &conn->client_write_mac_ctx;
-		enc_key = &conn->client_write_enc_key;
-		seq_num = conn->client_seq_num;
-	} else {
-		hmac_ctx = &conn->server_write_mac_ctx;
-		enc_key = &conn->server_write_enc_key;
-		seq_num = conn->server_seq_num;
-	}
+	seq_num = conn->is_client ? conn->client_seq_num : conn->server_seq_num;
 	record = conn->record;
 
 	tls_trace("send ApplicationData\n");
@@ -1689,7 +1963,7 @@ int tls_send(TLS_CONNECT *conn, const uint8_t *in, size_t inlen, size_t *sentlen
 		return -1;
 	}
 
-	if (tls_cbc_encrypt(hmac_ctx, enc_key, seq_num, tls_record_header(record),
+	if (tls_data_encrypt(conn, tls_record_header(record),
 		in, inlen, tls_record_data(record), &datalen) != 1) {
 		error_print();
 		return -1;
@@ -1711,22 +1985,12 @@ int tls_send(TLS_CONNECT *conn, const uint8_t *in, size_t inlen, size_t *sentlen
 int tls_do_recv(TLS_CONNECT *conn)
 {
 	int ret;
-	const SM3_HMAC_CTX *hmac_ctx;
-	const SM4_KEY *dec_key;
 	uint8_t *seq_num;
 
 	uint8_t *record = conn->record;
 	size_t recordlen;
 
-	if (conn->is_client) {
-		hmac_ctx = &conn->server_write_mac_ctx;
-		dec_key = &conn->server_write_enc_key;
-		seq_num = conn->server_seq_num;
-	} else {
-		hmac_ctx = &conn->client_write_mac_ctx;
-		dec_key = &conn->client_write_enc_key;
-		seq_num = conn->client_seq_num;
-	}
+	seq_num = conn->is_client ? conn->server_seq_num : conn->client_seq_num;
 
 	tls_trace("recv ApplicationData\n");
 	if ((ret = tls_record_recv(record, &recordlen, conn->sock)) != 1) {
@@ -1735,7 +1999,7 @@ int tls_do_recv(TLS_CONNECT *conn)
 	}
 
 	tls_record_trace(stderr, record, recordlen, 0, 0);
-	if (tls_cbc_decrypt(hmac_ctx, dec_key, seq_num, record,
+	if (tls_data_decrypt(conn, record,
 		tls_record_data(record), tls_record_data_length(record),
 		conn->databuf, &conn->datalen) != 1) {
 		error_print();
@@ -1827,6 +2091,61 @@ int tls_authorities_from_certs(uint8_t *names, size_t *nameslen, size_t maxlen,
 	return 1;
 }
 
+// names that do not fit in TLS_MAX_CA_NAMES_SIZE are left out, a client may still send
+// a certificate issued by them
+static int tls_ca_names_new(uint8_t **names, size_t *nameslen, const uint8_t *certs, size_t certslen)
+{
+	const uint8_t *cp = certs;
+	size_t len = certslen;
+	const uint8_t *cert;
+	size_t certlen;
+	const uint8_t *name;
+	size_t namelen;
+	size_t maxlen = 0;
+	uint8_t *p;
+
+	*names = NULL;
+	*nameslen = 0;
+
+	while (len) {
+		size_t alen = 0;
+		if (x509_cert_from_der(&cert, &certlen, &cp, &len) != 1
+			|| x509_cert_get_subject(cert, certlen, &name, &namelen) != 1
+			|| asn1_sequence_to_der(name, namelen, NULL, &alen) != 1) {
+			error_print();
+			return -1;
+		}
+		if (alen > UINT16_MAX || maxlen + tls_uint16_size() + alen > TLS_MAX_CA_NAMES_SIZE) {
+			break;
+		}
+		maxlen += tls_uint16_size() + alen;
+	}
+	if (!maxlen) {
+		return 1;
+	}
+	if (!(*names = (uint8_t *)malloc(maxlen))) {
+		error_print();
+		return -1;
+	}
+
+	p = *names;
+	while (*nameslen < maxlen) {
+		size_t alen = 0;
+		if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+			|| x509_cert_get_subject(cert, certlen, &name, &namelen) != 1
+			|| asn1_sequence_to_der(name, namelen, NULL, &alen) != 1) {
+			free(*names);
+			*names = NULL;
+			*nameslen = 0;
+			error_print();
+			return -1;
+		}
+		tls_uint16_to_bytes((uint16_t)alen, &p, nameslen);
+		asn1_sequence_to_der(name, namelen, &p, nameslen);
+	}
+	return 1;
+}
+
 int tls_authorities_issued_certificate(const uint8_t *ca_names, size_t ca_names_len, const uint8_t *certs, size_t certslen)
 {
 	const uint8_t *cert;
@@ -1834,6 +2153,10 @@ int tls_authorities_issued_certificate(const uint8_t *ca_names, size_t ca_names_
 	const uint8_t *issuer;
 	size_t issuer_len;
 
+	// an empty certificate_authorities list accepts any CA (RFC 5246 7.4.4)
+	if (!ca_names_len) {
+		return 1;
+	}
 	if (x509_certs_get_last(certs, certslen, &cert, &certlen) != 1
 		|| x509_cert_get_issuer(cert, certlen, &issuer, &issuer_len) != 1) {
 		error_print();
@@ -1891,13 +2214,39 @@ int tls_client_verify_init(TLS_CLIENT_VERIFY_CTX *ctx)
 		error_print();
 		return -1;
 	}
-	memset(ctx, 0, sizeof(TLS_CLIENT_VERIFY_CTX));
+	ctx->index = 0;
+	ctx->sm2_ctx_inited = 0;
+	ctx->buflen = 0;
+	if (!(ctx->buf = malloc(TLS_CLIENT_VERIFY_BUF_SIZE))) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int tls_client_verify_set_public_key(TLS_CLIENT_VERIFY_CTX *ctx, const SM2_KEY *public_key)
+{
+	if (!ctx || !public_key) {
+		error_print();
+		return -1;
+	}
+	if (ctx->sm2_ctx_inited) {
+		error_print();
+		return -1;
+	}
+	if (sm2_verify_init(&ctx->sm2_ctx, public_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1
+		|| sm2_verify_update(&ctx->sm2_ctx, ctx->buf, ctx->buflen) != 1) {
+		error_print();
+		return -1;
+	}
+	ctx->sm2_ctx_inited = 1;
+	gmssl_secure_clear(ctx->buf, ctx->buflen);
+	ctx->buflen = 0;
 	return 1;
 }
 
 int tls_client_verify_update(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *handshake, size_t handshake_len)
 {
-	uint8_t *buf;
 	if (!ctx || !handshake || !handshake_len) {
 		error_print();
 		return -1;
@@ -1906,13 +2255,19 @@ int tls_client_verify_update(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *handshak
 		error_print();
 		return -1;
 	}
-	if (!(buf = malloc(handshake_len))) {
-		error_print();
-		return -1;
+	if (ctx->sm2_ctx_inited) {
+		if (sm2_verify_update(&ctx->sm2_ctx, handshake, handshake_len) != 1) {
+			error_print();
+			return -1;
+		}
+	} else {
+		if (!ctx->buf || handshake_len > TLS_CLIENT_VERIFY_BUF_SIZE - ctx->buflen) {
+			error_print();
+			return -1;
+		}
+		memcpy(ctx->buf + ctx->buflen, handshake, handshake_len);
+		ctx->buflen += handshake_len;
 	}
-	memcpy(buf, handshake, handshake_len);
-	ctx->handshake[ctx->index] = buf;
-	ctx->handshake_len[ctx->index] = handshake_len;
 	ctx->index++;
 	return 1;
 }
@@ -1920,8 +2275,6 @@ int tls_client_verify_update(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *handshak
 int tls_client_verify_finish(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *sig, size_t siglen, const SM2_KEY *public_key)
 {
 	int ret;
-	SM2_SIGN_CTX sm2_ctx;
-	int i;
 
 	if (!ctx || !sig || !siglen || !public_key) {
 		error_print();
@@ -1932,17 +2285,16 @@ int tls_client_verify_finish(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *sig, siz
 		error_print();
 		return -1;
 	}
-	if (sm2_verify_init(&sm2_ctx, public_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
-		error_print();
-		return -1;
-	}
-	for (i = 0; i < 8; i++) {
-		if (sm2_verify_update(&sm2_ctx, ctx->handshake[i], ctx->handshake_len[i]) != 1) {
+	if (!ctx->sm2_ctx_inited) {
+		if (tls_client_verify_set_public_key(ctx, public_key) != 1) {
 			error_print();
 			return -1;
 		}
+	} else if (memcmp(&ctx->sm2_ctx.key.public_key, &public_key->public_key, sizeof(SM2_POINT)) != 0) {
+		error_print();
+		return -1;
 	}
-	if ((ret = sm2_verify_finish(&sm2_ctx, sig, siglen)) < 0) {
+	if ((ret = sm2_verify_finish(&ctx->sm2_ctx, sig, siglen)) < 0) {
 		error_print();
 		return -1;
 	}
@@ -1952,14 +2304,15 @@ int tls_client_verify_finish(TLS_CLIENT_VERIFY_CTX *ctx, const uint8_t *sig, siz
 void tls_client_verify_cleanup(TLS_CLIENT_VERIFY_CTX *ctx)
 {
 	if (ctx) {
-		int i;
-		for (i = 0; i< ctx->index; i++) {
-			if (ctx->handshake[i]) {
-				free(ctx->handshake[i]);
-				ctx->handshake[i] = NULL;
-				ctx->handshake_len[i] = 0;
-			}
+		if (ctx->buf) {
+			gmssl_secure_clear(ctx->buf, ctx->buflen);
+			free(ctx->buf);
+			ctx->buf = NULL;
 		}
+		gmssl_secure_clear(&ctx->sm2_ctx, sizeof(SM2_SIGN_CTX));
+		ctx->index = 0;
+		ctx->sm2_ctx_inited = 0;
+		ctx->buflen = 0;
 	}
 }
 
@@ -1994,14 +2347,36 @@ int tls_cipher_suites_select(const uint8_t *client_ciphers, size_t client_cipher
 void tls_ctx_cleanup(TLS_CTX *ctx)
 {
 	if (ctx) {
+		sm2_key_pool_free(ctx->key_pool);
+		tls13_anti_replay_free(ctx->anti_replay);
+		gmssl_secure_clear(&ctx->ticket_key, sizeof(SM4_KEY));
 		gmssl_secure_clear(&ctx->signkey, sizeof(SM2_KEY));
 		gmssl_secure_clear(&ctx->kenckey, sizeof(SM2_KEY));
 		if (ctx->certs) free(ctx->certs);
 		if (ctx->cacerts) free(ctx->cacerts);
+		if (ctx->ca_names) free(ctx->ca_names);
+		x509_trust_store_cleanup(&ctx->ca_store);
 		memset(ctx, 0, sizeof(TLS_CTX));
 	}
 }
 
+int tls_ctx_set_key_pool(TLS_CTX *ctx, size_t size)
+{
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	sm2_key_pool_free(ctx->key_pool);
+	ctx->key_pool = NULL;
+	if (size) {
+		if (!(ctx->key_pool = sm2_key_pool_new(size))) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
 int tls_ctx_init(TLS_CTX *ctx, int protocol, int is_client)
 {
 	if (!ctx) {
@@ -2051,6 +2426,12 @@ int tls_ctx_set_cipher_suites(TLS_CTX *ctx, const int *cipher_suites, size_t cip
 
 int tls_ctx_set_ca_certificates(TLS_CTX *ctx, const char *cacertsfile, int depth)
 {
+	uint8_t *cacerts = NULL;
+	size_t cacertslen = 0;
+	X509_TRUST_STORE ca_store;
+	uint8_t *ca_names = NULL;
+	size_t ca_names_len = 0;
+
 	if (!ctx || !cacertsfile) {
 		error_print();
 		return -1;
@@ -2063,19 +2444,32 @@ int tls_ctx_set_ca_certificates(TLS_CTX *ctx, const char *cacertsfile, int depth
 		error_print();
 		return -1;
 	}
-	if (ctx->cacerts) {
+	if (x509_certs_new_from_file(&cacerts, &cacertslen, cacertsfile) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_certs_new_from_file(&ctx->cacerts, &ctx->cacertslen, cacertsfile) != 1) {
+	if (cacertslen == 0) {
 		error_print();
 		return -1;
 	}
-	if (ctx->cacertslen == 0) {
+	if (x509_trust_store_init(&ca_store, cacerts, cacertslen) != 1
+		|| tls_ca_names_new(&ca_names, &ca_names_len, cacerts, cacertslen) != 1) {
+		x509_trust_store_cleanup(&ca_store);
+		free(cacerts);
 		error_print();
 		return -1;
 	}
 
+	// a second call replaces the previous CA certificates
+	if (ctx->cacerts) free(ctx->cacerts);
+	if (ctx->ca_names) free(ctx->ca_names);
+	x509_trust_store_cleanup(&ctx->ca_store);
+
+	ctx->cacerts = cacerts;
+	ctx->cacertslen = cacertslen;
+	ctx->ca_store = ca_store;
+	ctx->ca_names = ca_names;
+	ctx->ca_names_len = ca_names_len;
 	ctx->verify_depth = depth;
 	return 1;
 }
@@ -2139,6 +2533,56 @@ end:
 	return ret;
 }
 
+// only the public key is in ctx->signkey, the signatures are done by the jobs of the queue
+int tls_ctx_set_certificate_and_sdf_queue(TLS_CTX *ctx, const char *chainfile, SDF_JOB_QUEUE *queue)
+{
+	int ret = -1;
+	uint8_t *certs = NULL;
+	size_t certslen;
+	const uint8_t *cert;
+	size_t certlen;
+	SM2_KEY public_key;
+	SM2_KEY sdf_public_key;
+
+	if (!ctx || !chainfile || !queue) {
+		error_print();
+		return -1;
+	}
+	if (ctx->protocol != TLS_protocol_tls13) {
+		error_print();
+		return -1;
+	}
+	if (ctx->certs) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_certs_new_from_file(&certs, &certslen, chainfile) != 1) {
+		error_print();
+		goto end;
+	}
+	if (x509_certs_get_cert_by_index(certs, certslen, 0, &cert, &certlen) != 1
+		|| x509_cert_get_subject_public_key(cert, certlen, &public_key) != 1
+		|| sdf_job_queue_get_public_key(queue, &sdf_public_key) != 1) {
+		error_print();
+		goto end;
+	}
+	if (sm2_public_key_equ(&sdf_public_key, &public_key) != 1) {
+		error_print();
+		goto end;
+	}
+	ctx->certs = certs;
+	ctx->certslen = certslen;
+	ctx->signkey = public_key;
+	ctx->sdf_queue = queue;
+	certs = NULL;
+	ret = 1;
+
+end:
+	if (certs) free(certs);
+	return ret;
+}
+
 int tls_ctx_set_tlcp_server_certificate_and_keys(TLS_CTX *ctx, const char *chainfile,
 	const char *signkeyfile, const char *signkeypass,
 	const char *kenckeyfile, const char *kenckeypass)
@@ -2244,15 +2688,33 @@ int tls_init(TLS_CONNECT *conn, const TLS_CTX *ctx)
 		conn->server_certs_len = ctx->certslen;
 	}
 
-	if (ctx->cacertslen > TLS_MAX_CERTIFICATES_SIZE) {
+	conn->ca_names = ctx->ca_names;
+	conn->ca_names_len = ctx->ca_names_len;
+
+	// large CA bundles are only reachable through the shared trust store
+	if (ctx->ca_store.anchors) {
+		conn->ca_store = &ctx->ca_store;
+	} else if (ctx->cacertslen > sizeof(conn->ca_certs)) {
 		error_print();
 		return -1;
 	}
-	memcpy(conn->ca_certs, ctx->cacerts, ctx->cacertslen);
-	conn->ca_certs_len = ctx->cacertslen;
+	if (ctx->cacertslen <= sizeof(conn->ca_certs)) {
+		memcpy(conn->ca_certs, ctx->cacerts, ctx->cacertslen);
+		conn->ca_certs_len = ctx->cacertslen;
+	}
 
 	conn->sign_key = ctx->signkey;
 	conn->kenc_key = ctx->kenckey;
+	conn->key_pool = ctx->key_pool;
+	conn->sdf_queue = ctx->sdf_queue;
+
+	if (ctx->ticket_lifetime) {
+		conn->ticket_key = &ctx->ticket_key;
+		conn->ticket_lifetime = ctx->ticket_lifetime;
+	}
+	conn->max_early_data_size = ctx->max_early_data_size;
+	conn->replay_window = ctx->replay_window;
+	conn->anti_replay = ctx->anti_replay;
 
 	return 1;
 }
@@ -2300,6 +2762,28 @@ int tls_do_handshake(TLS_CONNECT *conn)
 	return -1;
 }
 
+int tls_verify_peer_certs(const TLS_CONNECT *conn, const uint8_t *certs, size_t certslen,
+	int certs_type, int depth, int *verify_result)
+{
+	if (conn->ca_store) {
+		return x509_certs_verify_by_trust_store(certs, certslen, certs_type,
+			conn->ca_store, depth, verify_result);
+	}
+	return x509_certs_verify(certs, certslen, certs_type,
+		conn->ca_certs, conn->ca_certs_len, depth, verify_result);
+}
+
+int tls_verify_peer_certs_tlcp(const TLS_CONNECT *conn, const uint8_t *certs, size_t certslen,
+	int certs_type, int depth, int *verify_result)
+{
+	if (conn->ca_store) {
+		return x509_certs_verify_tlcp_by_trust_store(certs, certslen, certs_type,
+			conn->ca_store, depth, verify_result);
+	}
+	return x509_certs_verify_tlcp(certs, certslen, certs_type,
+		conn->ca_certs, conn->ca_certs_len, depth, verify_result);
+}
+
 int tls_get_verify_result(TLS_CONNECT *conn, int *result)
 {
 	*result = conn->verify_result;
@@ -26,6 +26,7 @@
 
 
 static const int tls12_ciphers[] = {
+	TLS_cipher_ecdhe_sm4_gcm_sm3,
 	TLS_cipher_ecdhe_sm4_cbc_sm3,
 };
 
@@ -191,6 +192,8 @@ int tls12_do_connect(TLS_CONNECT *conn)
 	uint8_t server_random[32];
 	int protocol;
 	int cipher_suite;
+	int ciphers[TLS_MAX_CIPHER_SUITES_COUNT];
+	size_t ciphers_cnt;
 	const uint8_t *random;
 	const uint8_t *session_id;
 	size_t session_id_len;
@@ -255,10 +258,12 @@ int tls12_do_connect(TLS_CONNECT *conn)
 	tls_supported_groups_ext_to_bytes(supported_groups, supported_groups_cnt, &p, &client_exts_len);
 	tls_signature_algorithms_ext_to_bytes(signature_algors, signature_algors_cnt, &p, &client_exts_len);
 
-	if (tls_record_set_handshake_client_hello(record, &recordlen,
-		conn->protocol, client_random, NULL, 0,
-		tls12_ciphers, tls12_ciphers_count,
-		client_exts, client_exts_len) != 1) {
+	if (tls_cipher_suites_filter(conn->cipher_suites, conn->cipher_suites_cnt,
+			tls12_ciphers, tls12_ciphers_count, ciphers, &ciphers_cnt) != 1
+		|| tls_record_set_handshake_client_hello(record, &recordlen,
+			conn->protocol, client_random, NULL, 0,
+			ciphers, ciphers_cnt,
+			client_exts, client_exts_len) != 1) {
 		error_print();
 		goto end;
 	}
@@ -297,8 +302,7 @@ int tls12_do_connect(TLS_CONNECT *conn)
 		tls_send_alert(conn, TLS_alert_protocol_version);
 		goto end;
 	}
-	// tls12_ciphers 应该改为conn的内部变量
-	if (tls_cipher_suite_in_list(cipher_suite, tls12_ciphers, tls12_ciphers_count) != 1) {
+	if (tls_cipher_suite_in_list(cipher_suite, ciphers, ciphers_cnt) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_handshake_failure);
 		goto end;
@@ -344,8 +348,8 @@ int tls12_do_connect(TLS_CONNECT *conn)
 		sm2_sign_update(&sign_ctx, record + 5, recordlen - 5);
 
 	// verify ServerCertificate
-	if (x509_certs_verify(conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
-		conn->ca_certs, conn->ca_certs_len, depth, &verify_result) != 1) {
+	if (tls_verify_peer_certs(conn, conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
+		depth, &verify_result) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_bad_certificate);
 		goto end;
@@ -471,7 +475,11 @@ int tls12_do_connect(TLS_CONNECT *conn)
 	// generate MASTER_SECRET
 	tls_trace("generate secrets\n");
 	SM2_KEY client_ecdh;
-	sm2_key_generate(&client_ecdh);
+	if (tls_ecdhe_key_generate(conn, &client_ecdh) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	sm2_do_ecdh(&client_ecdh, &server_ecdhe_public, &server_ecdhe_public);
 	memcpy(pre_master_secret, &server_ecdhe_public, 32); // 这个做法很不优雅
 	// ECDHE和ECC的PMS结构是不一样的吗？
@@ -486,10 +494,11 @@ int tls12_do_connect(TLS_CONNECT *conn)
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
 	}
-	sm3_hmac_init(&conn->client_write_mac_ctx, conn->key_block, 32);
-	sm3_hmac_init(&conn->server_write_mac_ctx, conn->key_block + 32, 32);
-	sm4_set_encrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
-	sm4_set_decrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	if (tls_set_record_keys(conn) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	/*
 	tls_secrets_print(stderr,
 		pre_master_secret, 48,
@@ -563,8 +572,7 @@ int tls12_do_connect(TLS_CONNECT *conn)
 
 	// encrypt Client Finished
 	tls_trace("encrypt Finished\n");
-	if (tls_record_encrypt(&conn->client_write_mac_ctx, &conn->client_write_enc_key,
-		conn->client_seq_num, finished_record, finished_record_len, record, &recordlen) != 1) {
+	if (tls_conn_record_encrypt(conn, finished_record, finished_record_len, record, &recordlen) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
@@ -606,8 +614,7 @@ int tls12_do_connect(TLS_CONNECT *conn)
 	}
 	tls12_record_trace(stderr, record, recordlen, (1<<24), 0); // 强制打印密文原数据
 	tls_trace("decrypt Finished\n");
-	if (tls_record_decrypt(&conn->server_write_mac_ctx, &conn->server_write_enc_key,
-		conn->server_seq_num, record, recordlen, finished_record, &finished_record_len) != 1) {
+	if (tls_conn_record_decrypt(conn, record, recordlen, finished_record, &finished_record_len) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
@@ -660,8 +667,8 @@ int tls12_do_accept(TLS_CONNECT *conn)
 	uint8_t finished_record[TLS_FINISHED_RECORD_BUF_SIZE]; // 解密可能导致前面的record被覆盖
 	size_t recordlen, finished_record_len;
 
-	// 这个ciphers不是应该在CTX中设置的吗
-	const int server_ciphers[] = { TLS_cipher_ecdhe_sm4_cbc_sm3 }; // 未来应该支持GCM/CBC两个套件
+	int server_ciphers[TLS_MAX_CIPHER_SUITES_COUNT];
+	size_t server_ciphers_cnt;
 
 	// ClientHello, ServerHello
 	uint8_t client_random[32];
@@ -708,13 +715,17 @@ int tls12_do_accept(TLS_CONNECT *conn)
 
 
 	// 服务器端如果设置了CA
-	if (conn->ca_certs_len)
+	if (conn->ca_certs_len || conn->ca_store)
 		client_verify = 1;
 
 	// 初始化Finished和客户端验证环境
 	sm3_init(&sm3_ctx);
-	if (client_verify)
-		tls_client_verify_init(&client_verify_ctx);
+	if (client_verify
+		&& tls_client_verify_init(&client_verify_ctx) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 
 	// recv ClientHello
@@ -745,9 +756,10 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	memcpy(client_random, random, 32);
-	if (tls_cipher_suites_select(client_ciphers, client_ciphers_len,
-		server_ciphers, sizeof(server_ciphers)/sizeof(server_ciphers[0]),
-		&conn->cipher_suite) != 1) {
+	if (tls_cipher_suites_filter(conn->cipher_suites, conn->cipher_suites_cnt,
+			tls12_ciphers, tls12_ciphers_count, server_ciphers, &server_ciphers_cnt) != 1
+		|| tls_cipher_suites_select(client_ciphers, client_ciphers_len,
+			server_ciphers, server_ciphers_cnt, &conn->cipher_suite) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_insufficient_security);
 		goto end;
@@ -762,8 +774,12 @@ int tls12_do_accept(TLS_CONNECT *conn)
 
 	}
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 
 	// send ServerHello
@@ -783,8 +799,12 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 	// send ServerCertificate
 	tls_trace("send ServerCertificate\n");
@@ -800,12 +820,20 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 	// send ServerKeyExchange
 	tls_trace("send ServerKeyExchange\n");
-	sm2_key_generate(&server_ecdhe_key);
+	if (tls_ecdhe_key_generate(conn, &server_ecdhe_key) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	if (tls_sign_server_ecdh_params(&conn->sign_key,
 		client_random, server_random, TLS_curve_sm2p256v1, &server_ecdhe_key.public_key,
 		sigbuf, &siglen) != 1) {
@@ -825,24 +853,22 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 	// send CertificateRequest
 	if (client_verify) {
 		const uint8_t cert_types[] = { TLS_cert_type_ecdsa_sign };
-		uint8_t ca_names[TLS_MAX_CA_NAMES_SIZE] = {0}; // TODO: 根据客户端验证CA证书列计算缓冲大小，或直接输出到record缓冲
-		size_t ca_names_len = 0;
 
+		// the names are encoded once by tls_ctx_set_ca_certificates()
 		tls_trace("send CertificateRequest\n");
-		if (tls_authorities_from_certs(ca_names, &ca_names_len, sizeof(ca_names),
-			conn->ca_certs, conn->ca_certs_len) != 1) {
-			error_print();
-			goto end;
-		}
 		if (tls_record_set_handshake_certificate_request(record, &recordlen,
 			cert_types, sizeof(cert_types),
-			ca_names, ca_names_len) != 1) {
+			conn->ca_names, conn->ca_names_len) != 1) {
 			error_print();
 			goto end;
 		}
@@ -852,7 +878,11 @@ int tls12_do_accept(TLS_CONNECT *conn)
 			goto end;
 		}
 		sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+		if (tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
 	}
 
 	// send ServerHelloDone
@@ -864,11 +894,15 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 	// recv ClientCertificate
-	if (conn->ca_certs_len) {
+	if (conn->ca_certs_len || conn->ca_store) {
 		tls_trace("recv ClientCertificate\n");
 		if (tls_record_recv(record, &recordlen, conn->sock) != 1
 			|| tls_record_protocol(record) != conn->protocol) { // protocol检查应该在trace之后
@@ -882,14 +916,27 @@ int tls12_do_accept(TLS_CONNECT *conn)
 			tls_send_alert(conn, TLS_alert_unexpected_message);
 			goto end;
 		}
-		if (x509_certs_verify(conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
-			conn->ca_certs, conn->ca_certs_len, verify_depth, &verify_result) != 1) {
+		if (tls_verify_peer_certs(conn, conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
+			verify_depth, &verify_result) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_bad_certificate);
+			goto end;
+		}
+		// the client public key is known from here, the client certificates and the
+		// following messages are hashed into the CertificateVerify context directly
+		if (x509_certs_get_cert_by_index(conn->client_certs, conn->client_certs_len, 0, &cp, &len) != 1
+			|| x509_cert_get_subject_public_key(cp, len, &client_sign_key) != 1
+			|| tls_client_verify_set_public_key(&client_verify_ctx, &client_sign_key) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_bad_certificate);
 			goto end;
 		}
 		sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+		if (tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
 	}
 
 	// recv ClientKeyExchange
@@ -908,8 +955,12 @@ int tls12_do_accept(TLS_CONNECT *conn)
 	}
 
 	sm3_update(&sm3_ctx, record + 5, recordlen - 5);
-	if (client_verify)
-		tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5);
+	if (client_verify
+		&& tls_client_verify_update(&client_verify_ctx, record + 5, recordlen - 5) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 
 	// recv CertificateVerify
 	if (client_verify) {
@@ -926,12 +977,6 @@ int tls12_do_accept(TLS_CONNECT *conn)
 			error_print();
 			goto end;
 		}
-		if (x509_certs_get_cert_by_index(conn->client_certs, conn->client_certs_len, 0, &cp, &len) != 1
-			|| x509_cert_get_subject_public_key(cp, len, &client_sign_key) != 1) {
-			error_print();
-			tls_send_alert(conn, TLS_alert_bad_certificate);
-			goto end;
-		}
 		if (tls_client_verify_finish(&client_verify_ctx, sig, siglen, &client_sign_key) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_decrypt_error);
@@ -950,10 +995,11 @@ int tls12_do_accept(TLS_CONNECT *conn)
 	tls_prf(conn->master_secret, 48, "key expansion",
 		server_random, 32, client_random, 32,
 		96, conn->key_block);
-	sm3_hmac_init(&conn->client_write_mac_ctx, conn->key_block, 32);
-	sm3_hmac_init(&conn->server_write_mac_ctx, conn->key_block + 32, 32);
-	sm4_set_decrypt_key(&conn->client_write_enc_key, conn->key_block + 64);
-	sm4_set_encrypt_key(&conn->server_write_enc_key, conn->key_block + 80);
+	if (tls_set_record_keys(conn) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	/*
 	tls_secrets_print(stderr, pre_master_secret, 32, client_random, server_random,
 		conn->master_secret, conn->key_block, 96, 0, 4);
@@ -991,8 +1037,7 @@ int tls12_do_accept(TLS_CONNECT *conn)
 
 	// decrypt ClientFinished
 	tls_trace("decrypt Finished\n");
-	if (tls_record_decrypt(&conn->client_write_mac_ctx, &conn->client_write_enc_key,
-		conn->client_seq_num, record, recordlen, finished_record, &finished_record_len) != 1) {
+	if (tls_conn_record_decrypt(conn, record, recordlen, finished_record, &finished_record_len) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
@@ -1051,8 +1096,7 @@ int tls12_do_accept(TLS_CONNECT *conn)
 		goto end;
 	}
 	tls12_record_trace(stderr, finished_record, finished_record_len, 0, 0);
-	if (tls_record_encrypt(&conn->server_write_mac_ctx, &conn->server_write_enc_key,
-		conn->server_seq_num, finished_record, finished_record_len, record, &recordlen) != 1) {
+	if (tls_conn_record_encrypt(conn, finished_record, finished_record_len, record, &recordlen) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_internal_error);
 		goto end;
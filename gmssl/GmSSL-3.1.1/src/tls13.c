@@ -26,6 +26,7 @@
 #include <gmssl/hmac.h>
 #include <gmssl/hkdf.h>
 #include <gmssl/mem.h>
+#include <gmssl/endian.h>
 
 static const int tls13_ciphers[] = { TLS_cipher_sm4_gcm_sm3 };
 static size_t tls13_ciphers_count = sizeof(tls13_ciphers)/sizeof(int);
@@ -296,6 +297,142 @@ int tls13_recv(TLS_CONNECT *conn, uint8_t *data, size_t *datalen)
 }
 */
 
+/*
+struct {
+	uint32 ticket_lifetime;
+	uint32 ticket_age_add;
+	opaque ticket_nonce<0..255>;
+	opaque ticket<1..2^16-1>;
+	Extension extensions<0..2^16-2>;
+} NewSessionTicket;
+*/
+
+int tls13_record_set_handshake_new_session_ticket(uint8_t *record, size_t *recordlen,
+	uint32_t ticket_lifetime, uint32_t ticket_age_add, const uint8_t *nonce, size_t noncelen,
+	const uint8_t *ticket, size_t ticketlen, uint32_t max_early_data_size)
+{
+	int type = TLS_handshake_new_session_ticket;
+	uint8_t *p = record + 5 + 4;
+	size_t len = 0;
+	uint8_t exts[16];
+	uint8_t *pexts = exts;
+	size_t extslen = 0;
+
+	if (!record || !recordlen || noncelen > 255
+		|| !ticket || !ticketlen || ticketlen > TLS13_MAX_TICKET_SIZE) {
+		error_print();
+		return -1;
+	}
+	if (max_early_data_size) {
+		tls13_early_data_ext_to_bytes(TLS_handshake_new_session_ticket, max_early_data_size, &pexts, &extslen);
+	}
+	tls_uint32_to_bytes(ticket_lifetime, &p, &len);
+	tls_uint32_to_bytes(ticket_age_add, &p, &len);
+	tls_uint8array_to_bytes(nonce, noncelen, &p, &len);
+	tls_uint16array_to_bytes(ticket, ticketlen, &p, &len);
+	tls_uint16array_to_bytes(exts, extslen, &p, &len);
+	tls_record_set_handshake(record, recordlen, type, NULL, len);
+	return 1;
+}
+
+int tls13_record_get_handshake_new_session_ticket(const uint8_t *record,
+	uint32_t *ticket_lifetime, uint32_t *ticket_age_add, const uint8_t **nonce, size_t *noncelen,
+	const uint8_t **ticket, size_t *ticketlen, uint32_t *max_early_data_size)
+{
+	int type;
+	const uint8_t *p;
+	size_t len;
+	const uint8_t *exts;
+	size_t extslen;
+
+	if (tls_record_get_handshake(record, &type, &p, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	if (type != TLS_handshake_new_session_ticket) {
+		error_print();
+		return -1;
+	}
+	if (tls_uint32_from_bytes(ticket_lifetime, &p, &len) != 1
+		|| tls_uint32_from_bytes(ticket_age_add, &p, &len) != 1
+		|| tls_uint8array_from_bytes(nonce, noncelen, &p, &len) != 1
+		|| tls_uint16array_from_bytes(ticket, ticketlen, &p, &len) != 1
+		|| tls_uint16array_from_bytes(&exts, &extslen, &p, &len) != 1
+		|| tls_length_is_zero(len) != 1) {
+		error_print();
+		return -1;
+	}
+	if (!(*ticketlen)) {
+		error_print();
+		return -1;
+	}
+	*max_early_data_size = 0;
+	while (extslen) {
+		int ext_type;
+		const uint8_t *ext_data;
+		size_t ext_datalen;
+
+		if (tls_ext_from_bytes(&ext_type, &ext_data, &ext_datalen, &exts, &extslen) != 1) {
+			error_print();
+			return -1;
+		}
+		if (ext_type == TLS_extension_early_data) {
+			if (tls13_process_early_data_ext(TLS_handshake_new_session_ticket,
+				ext_data, ext_datalen, max_early_data_size) != 1) {
+				error_print();
+				return -1;
+			}
+		}
+	}
+	return 1;
+}
+
+// the client keeps the ticket as the session of the next connection
+static int tls13_process_new_session_ticket(TLS_CONNECT *conn, const uint8_t *record)
+{
+	uint32_t ticket_lifetime;
+	uint32_t ticket_age_add;
+	const uint8_t *nonce;
+	size_t noncelen;
+	const uint8_t *ticket;
+	size_t ticketlen;
+	uint32_t max_early_data_size;
+	const DIGEST *digest;
+	const BLOCK_CIPHER *cipher;
+
+	tls_trace("recv {NewSessionTicket}\n");
+	if (tls13_record_get_handshake_new_session_ticket(record,
+		&ticket_lifetime, &ticket_age_add, &nonce, &noncelen,
+		&ticket, &ticketlen, &max_early_data_size) != 1) {
+		error_print();
+		return -1;
+	}
+	if (ticket_lifetime > TLS13_MAX_TICKET_LIFETIME) {
+		error_print();
+		return -1;
+	}
+	if (!ticket_lifetime || ticketlen > TLS13_MAX_TICKET_SIZE) {
+		// the ticket can not be used
+		return 1;
+	}
+	if (tls13_cipher_suite_get(conn->cipher_suite, &digest, &cipher) != 1) {
+		error_print();
+		return -1;
+	}
+	conn->session.cipher_suite = conn->cipher_suite;
+	conn->session.ticket_lifetime = ticket_lifetime;
+	conn->session.ticket_age_add = ticket_age_add;
+	conn->session.max_early_data_size = max_early_data_size;
+	conn->session.received_time = tls13_time_ms();
+	// psk = HKDF-Expand-Label(resumption_master_secret, "resumption", ticket_nonce, Hash.length)
+	tls13_hkdf_expand_label(digest, conn->resumption_master_secret, "resumption",
+		nonce, noncelen, 32, conn->session.psk);
+	memcpy(conn->session.ticket, ticket, ticketlen);
+	conn->session.ticketlen = ticketlen;
+	conn->session_received = 1;
+	return 1;
+}
+
 int tls13_do_recv(TLS_CONNECT *conn)
 {
 	int ret;
@@ -316,27 +453,40 @@ int tls13_do_recv(TLS_CONNECT *conn)
 		seq_num = conn->client_seq_num;
 	}
 
-	tls_trace("recv ApplicationData\n");
-	if ((ret = tls_record_recv(record, &recordlen, conn->sock)) != 1) {
-		if (ret < 0) error_print();
-		return ret;
-	}
-	tls_record_trace(stderr, record, recordlen, 0, 0);
-	// TODO: 是否需要检查record_type?  record[0] != TLS_record_application_data		
+	for (;;) {
+		tls_trace("recv ApplicationData\n");
+		if ((ret = tls_record_recv(record, &recordlen, conn->sock)) != 1) {
+			if (ret < 0) error_print();
+			return ret;
+		}
+		tls_record_trace(stderr, record, recordlen, 0, 0);
+		// TODO: 是否需要检查record_type?  record[0] != TLS_record_application_data		
 
-	if (tls13_gcm_decrypt(key, iv,
-		seq_num, record + 5, recordlen - 5,
-		&record_type, conn->databuf, &conn->datalen) != 1) {
-		error_print();
-		return -1;
-	}
-	conn->data = conn->databuf;
-	tls_seq_num_incr(seq_num);
+		if (tls13_gcm_decrypt(key, iv,
+			seq_num, record + 5, recordlen - 5,
+			&record_type, conn->databuf, &conn->datalen) != 1) {
+			error_print();
+			return -1;
+		}
+		conn->data = conn->databuf;
+		tls_seq_num_incr(seq_num);
 
-	tls_record_set_data(record, conn->data, conn->datalen);
-	tls_trace("decrypt ApplicationData\n");
-	tls_record_trace(stderr, record, tls_record_length(record), 0, 0);
+		record[0] = record_type;
+		tls_record_set_data(record, conn->data, conn->datalen);
+		tls_trace("decrypt ApplicationData\n");
+		tls_record_trace(stderr, record, tls_record_length(record), 0, 0);
 
+		// post-handshake NewSessionTicket
+		if (record_type == TLS_record_handshake && conn->is_client) {
+			if (tls13_process_new_session_ticket(conn, record) != 1) {
+				error_print();
+				return -1;
+			}
+			conn->datalen = 0;
+			continue;
+		}
+		break;
+	}
 
 	if (record_type != TLS_record_application_data) {
 		error_print();
@@ -351,6 +501,11 @@ int tls13_recv(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen)
 		error_print();
 		return -1;
 	}
+	if (conn->early_data_pending) {
+		// the early data must be read with tls13_recv_early_data() first
+		error_print();
+		return -1;
+	}
 	if (conn->datalen == 0) {
 		int ret;
 		if ((ret = tls13_do_recv(conn)) != 1) {
@@ -366,6 +521,60 @@ int tls13_recv(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen)
 }
 
 
+int tls13_set_session(TLS_CONNECT *conn, const uint8_t *sess, size_t sesslen)
+{
+	if (!conn || !sess || !sesslen) {
+		error_print();
+		return -1;
+	}
+	if (!conn->is_client) {
+		error_print();
+		return -1;
+	}
+	if (tls13_session_from_bytes(&conn->session, &sess, &sesslen) != 1
+		|| tls_length_is_zero(sesslen) != 1) {
+		error_print();
+		return -1;
+	}
+	conn->session_set = 1;
+	conn->session_received = 0;
+	return 1;
+}
+
+// return 0 if the server did not issue a ticket
+int tls13_get_session(const TLS_CONNECT *conn, uint8_t *sess, size_t *sesslen)
+{
+	if (!conn || !sesslen) {
+		error_print();
+		return -1;
+	}
+	if (!conn->session_received) {
+		*sesslen = 0;
+		return 0;
+	}
+	*sesslen = 0;
+	if (tls13_session_to_bytes(&conn->session, sess ? &sess : NULL, sesslen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int tls13_set_early_data(TLS_CONNECT *conn, const uint8_t *data, size_t datalen)
+{
+	if (!conn || !data || !datalen) {
+		error_print();
+		return -1;
+	}
+	if (!conn->is_client) {
+		error_print();
+		return -1;
+	}
+	conn->early_data = data;
+	conn->early_data_len = datalen;
+	return 1;
+}
+
 
 /*
 HKDF-Expand-Label(Secret, Label, Context, Length) =
@@ -433,10 +642,10 @@ static const uint8_t TLS13_server_context_str_and_zero[] = "TLS 1.3, server Cert
 static size_t TLS13_client_context_str_and_zero_size = sizeof(TLS13_client_context_str_and_zero);
 static size_t TLS13_server_context_str_and_zero_size = sizeof(TLS13_server_context_str_and_zero);
 
-int tls13_sign_certificate_verify(int tls_mode,
+// the SM2 digest of the signed content, the same as in sm2_sign_finish()
+static int tls13_certificate_verify_digest(int tls_mode,
 	const SM2_KEY *key, const char *signer_id, size_t signer_id_len,
-	const DIGEST_CTX *tbs_dgst_ctx,
-	uint8_t *sig, size_t *siglen)
+	const DIGEST_CTX *tbs_dgst_ctx, uint8_t sm2_dgst[SM3_DIGEST_SIZE])
 {
 	SM2_SIGN_CTX sign_ctx;
 	uint8_t prefix[64];
@@ -469,12 +678,56 @@ int tls13_sign_certificate_verify(int tls_mode,
 	sm2_sign_update(&sign_ctx, prefix, 64);
 	sm2_sign_update(&sign_ctx, context_str_and_zero, context_str_and_zero_len);
 	sm2_sign_update(&sign_ctx, dgst, dgstlen);
-	sm2_sign_finish(&sign_ctx, sig, siglen);
+	sm3_finish(&sign_ctx.sm3_ctx, sm2_dgst);
 
 	gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
 	return 1;
 }
 
+int tls13_sign_certificate_verify(int tls_mode,
+	const SM2_KEY *key, const char *signer_id, size_t signer_id_len,
+	const DIGEST_CTX *tbs_dgst_ctx,
+	uint8_t *sig, size_t *siglen)
+{
+	uint8_t dgst[SM3_DIGEST_SIZE];
+
+	if (tls13_certificate_verify_digest(tls_mode, key, signer_id, signer_id_len, tbs_dgst_ctx, dgst) != 1
+		|| sm2_sign(key, dgst, sig, siglen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+/*
+With the sign key in an SDF device the handshake thread waits for its job, while the
+workers of the queue do the signatures of all the connections in parallel sessions.
+*/
+static int tls13_conn_sign_certificate_verify(const TLS_CONNECT *conn, int tls_mode,
+	const DIGEST_CTX *tbs_dgst_ctx, uint8_t *sig, size_t *siglen)
+{
+	uint8_t dgst[SM3_DIGEST_SIZE];
+	SDF_JOB job;
+	SDF_JOB *jobs[1] = { &job };
+
+	if (!conn->sdf_queue) {
+		return tls13_sign_certificate_verify(tls_mode, &conn->sign_key,
+			TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, tbs_dgst_ctx, sig, siglen);
+	}
+	if (tls13_certificate_verify_digest(tls_mode, &conn->sign_key,
+			TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, tbs_dgst_ctx, dgst) != 1
+		|| sdf_job_set_sign(&job, dgst) != 1
+		|| sdf_job_queue_submit(conn->sdf_queue, jobs, 1) != 1
+		|| sdf_job_wait(conn->sdf_queue, &job) != 1
+		|| job.ret != 1) {
+		error_print();
+		return -1;
+	}
+	memcpy(sig, job.out, job.outlen);
+	*siglen = job.outlen;
+	return 1;
+}
+
 int tls13_verify_certificate_verify(int tls_mode,
 	const SM2_KEY *public_key, const char *signer_id, size_t signer_id_len,
 	const DIGEST_CTX *tbs_dgst_ctx, const uint8_t *sig, size_t siglen)
@@ -695,9 +948,12 @@ int tls_client_key_shares_from_bytes(SM2_POINT *sm2_point, const uint8_t **in, s
 }
 
 // 这个函数不是太正确，应该也是一个process
-int tls13_server_hello_extensions_get(const uint8_t *exts, size_t extslen, SM2_POINT *sm2_point)
+int tls13_server_hello_extensions_get(const uint8_t *exts, size_t extslen, SM2_POINT *sm2_point,
+	int *selected_identity)
 {
 	uint16_t version;
+
+	*selected_identity = -1;
 	while (extslen) {
 		uint16_t ext_type;
 		const uint8_t *ext_data;
@@ -724,6 +980,12 @@ int tls13_server_hello_extensions_get(const uint8_t *exts, size_t extslen, SM2_P
 				return -1;
 			}
 			break;
+		case TLS_extension_pre_shared_key:
+			if (tls13_process_server_pre_shared_key(ext_data, ext_datalen, selected_identity) != 1) {
+				error_print();
+				return -1;
+			}
+			break;
 		//default:
 			// FIXME: 还有几个扩展没有处理！
 			//error_print();
@@ -773,7 +1035,7 @@ int tls13_encrypted_extensions_print(FILE *fp, int fmt, int ind, const uint8_t *
 	return 1;
 }
 
-int tls13_record_set_handshake_encrypted_extensions(uint8_t *record, size_t *recordlen)
+int tls13_record_set_handshake_encrypted_extensions(uint8_t *record, size_t *recordlen, int early_data)
 {
 	int type = TLS_handshake_encrypted_extensions;
 	uint8_t *p = record + 5 + 4;
@@ -784,6 +1046,9 @@ int tls13_record_set_handshake_encrypted_extensions(uint8_t *record, size_t *rec
 	const int supported_groups[] = { TLS_curve_sm2p256v1 };
 
 	tls_supported_groups_ext_to_bytes(supported_groups, sizeof(supported_groups)/sizeof(int), &pexts, &extslen);
+	if (early_data) {
+		tls13_early_data_ext_to_bytes(TLS_handshake_encrypted_extensions, 0, &pexts, &extslen);
+	}
 
 	tls_uint16array_to_bytes(exts, extslen, &p, &len);
 	tls_record_set_handshake(record, recordlen, type, NULL, len);
@@ -791,7 +1056,7 @@ int tls13_record_set_handshake_encrypted_extensions(uint8_t *record, size_t *rec
 	return 1;
 }
 
-int tls13_record_get_handshake_encrypted_extensions(const uint8_t *record)
+int tls13_record_get_handshake_encrypted_extensions(const uint8_t *record, int *early_data)
 {
 	int type;
 	const uint8_t *p;
@@ -803,15 +1068,33 @@ int tls13_record_get_handshake_encrypted_extensions(const uint8_t *record)
 		error_print();
 		return -1;
 	}
+	if (type != TLS_handshake_encrypted_extensions) {
+		error_print();
+		return -1;
+	}
 	if (tls_uint16array_from_bytes(&exts_data, &exts_datalen, &p, &len) != 1) {
 		error_print();
 		return -1;
 	}
-	// 当前实现不需要在EncryptedExtensions提供扩展
-	if (exts_datalen) {
-		// FIXME: 实际上supported_groups是放在这里的，应该加以处理		
-		//error_print();
-		//return -1;
+	// FIXME: 实际上supported_groups是放在这里的，应该加以处理
+	*early_data = 0;
+	while (exts_datalen) {
+		int ext_type;
+		const uint8_t *ext_data;
+		size_t ext_datalen;
+
+		if (tls_ext_from_bytes(&ext_type, &ext_data, &ext_datalen, &exts_data, &exts_datalen) != 1) {
+			error_print();
+			return -1;
+		}
+		if (ext_type == TLS_extension_early_data) {
+			if (tls13_process_early_data_ext(TLS_handshake_encrypted_extensions,
+				ext_data, ext_datalen, NULL) != 1) {
+				error_print();
+				return -1;
+			}
+			*early_data = 1;
+		}
 	}
 	return 1;
 }
@@ -1413,6 +1696,17 @@ TLS 1.3的区别：
 */
 
 
+static void tls13_update_client_write_key(TLS_CONNECT *conn, const DIGEST *digest,
+	const BLOCK_CIPHER *cipher, const uint8_t traffic_secret[32])
+{
+	uint8_t client_write_key[16];
+
+	tls13_hkdf_expand_label(digest, traffic_secret, "key", NULL, 0, 16, client_write_key);
+	tls13_hkdf_expand_label(digest, traffic_secret, "iv", NULL, 0, 12, conn->client_write_iv);
+	block_cipher_set_encrypt_key(&conn->client_write_key, cipher, client_write_key);
+	memset(conn->client_seq_num, 0, 8);
+	gmssl_secure_clear(client_write_key, sizeof(client_write_key));
+}
 
 int tls13_do_connect(TLS_CONNECT *conn)
 {
@@ -1488,30 +1782,120 @@ int tls13_do_connect(TLS_CONNECT *conn)
 	const uint8_t *cert;
 	size_t certlen;
 
+	int offer_psk = 0;
+	int offer_early_data = 0;
+	int selected_identity;
+	int early_data;
+	uint32_t ticket_age = 0;
+	uint8_t binder_key[32];
+	uint8_t binder[32] = {0};
+	size_t binderlen;
+	uint8_t client_early_traffic_secret[32];
+	DIGEST_CTX binder_dgst_ctx;
+
 
 	conn->is_client = 1;
+	conn->psk_resumed = 0;
+	conn->early_data_status = TLS13_early_data_none;
 	tls_record_set_protocol(enced_record, TLS_protocol_tls12);
 
+	// the session is offered before the ticket expires, 0-RTT data only if all of it is allowed
+	if (conn->session_set
+		&& tls13_cipher_suite_get(conn->session.cipher_suite, &digest, &cipher) == 1) {
+		uint64_t now = tls13_time_ms();
+
+		if (now >= conn->session.received_time
+			&& now - conn->session.received_time < (uint64_t)conn->session.ticket_lifetime * 1000) {
+			size_t len = 0;
+
+			ticket_age = (uint32_t)(now - conn->session.received_time);
+			if (conn->early_data_len && conn->early_data_len <= conn->session.max_early_data_size) {
+				offer_early_data = 1;
+			}
+			tls13_psk_key_exchange_modes_ext_to_bytes(NULL, &len);
+			tls13_early_data_ext_to_bytes(TLS_handshake_client_hello, 0, NULL, &len);
+			tls13_client_pre_shared_key_ext_to_bytes(conn->session.ticket, conn->session.ticketlen,
+				ticket_age, binder, sizeof(binder), NULL, &len);
+			// a ticket too large for the ClientHello is not used
+			if (len <= sizeof(client_exts) - 256) {
+				offer_psk = 1;
+				memcpy(psk, conn->session.psk, 32);
+			}
+		}
+	}
+	if (!offer_psk) {
+		offer_early_data = 0;
+	}
+
 	digest_init(&dgst_ctx, digest);
 	null_dgst_ctx = dgst_ctx;
 
+	/* [1]  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
+	if (offer_psk) {
+		/* [2]  */ tls13_derive_secret(early_secret, "res binder", &null_dgst_ctx, binder_key);
+	}
+
 
 	// send ClientHello
 	tls_trace("send ClientHello\n");
 	tls_record_set_protocol(record, TLS_protocol_tls1);
 	rand_bytes(client_random, 32); // TLS 1.3 Random 不再包含 UNIX Time
-	sm2_key_generate(&client_ecdhe);
+	if (tls_ecdhe_key_generate(conn, &client_ecdhe) != 1) {
+		error_print();
+		goto end;
+	}
 	tls13_client_hello_exts_set(client_exts, &client_exts_len, sizeof(client_exts), &(client_ecdhe.public_key));
+	if (offer_psk) {
+		// pre_shared_key must be the last extension, the binder is set after the ClientHello is encoded
+		uint8_t *p = client_exts + client_exts_len;
+
+		tls13_psk_key_exchange_modes_ext_to_bytes(&p, &client_exts_len);
+		if (offer_early_data) {
+			tls13_early_data_ext_to_bytes(TLS_handshake_client_hello, 0, &p, &client_exts_len);
+		}
+		tls13_client_pre_shared_key_ext_to_bytes(conn->session.ticket, conn->session.ticketlen,
+			ticket_age + conn->session.ticket_age_add, binder, sizeof(binder), &p, &client_exts_len);
+	}
 	tls_record_set_handshake_client_hello(record, &recordlen,
 		TLS_protocol_tls12, client_random, NULL, 0,
 		tls13_ciphers, sizeof(tls13_ciphers)/sizeof(tls13_ciphers[0]),
 		client_exts, client_exts_len);
+	if (offer_psk) {
+		// binder = HMAC(finished_key(binder_key), Hash(ClientHello without the binders))
+		binder_dgst_ctx = null_dgst_ctx;
+		digest_update(&binder_dgst_ctx, record + 5,
+			recordlen - 5 - tls_uint16array_size(tls_uint8array_size(sizeof(binder))));
+		tls13_compute_verify_data(binder_key, &binder_dgst_ctx, binder, &binderlen);
+		memcpy(record + recordlen - sizeof(binder), binder, sizeof(binder));
+	}
 	tls13_record_trace(stderr, record, recordlen, 0, 0);
 	if (tls_record_send(record, recordlen, conn->sock) != 1) {
 		error_print();
 		goto end;
 	}
-	// 此时尚未确定digest算法，因此无法digest_update
+	digest_update(&dgst_ctx, record + 5, recordlen - 5);
+
+	// send (EarlyData)
+	if (offer_early_data) {
+		size_t offset = 0;
+
+		tls_trace("send (EarlyData)\n");
+		/* [3]  */ tls13_derive_secret(early_secret, "c e traffic", &dgst_ctx, client_early_traffic_secret);
+		tls13_update_client_write_key(conn, digest, cipher, client_early_traffic_secret);
+		while (offset < conn->early_data_len) {
+			size_t len = conn->early_data_len - offset;
+			size_t sentlen;
+
+			if (len > TLS_MAX_PLAINTEXT_SIZE) {
+				len = TLS_MAX_PLAINTEXT_SIZE;
+			}
+			if (tls13_send(conn, conn->early_data + offset, len, &sentlen) != 1) {
+				error_print();
+				goto end;
+			}
+			offset += len;
+		}
+	}
 
 
 	// recv ServerHello
@@ -1544,19 +1928,32 @@ int tls13_do_connect(TLS_CONNECT *conn)
 		goto end;
 	}
 	conn->cipher_suite = cipher_suite;
-	if (tls13_server_hello_extensions_get(server_exts, server_exts_len, &server_ecdhe_public) != 1) {
+	if (tls13_server_hello_extensions_get(server_exts, server_exts_len, &server_ecdhe_public,
+		&selected_identity) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_handshake_failure);
 		goto end;
 	}
+	if (selected_identity >= 0) {
+		if (!offer_psk || selected_identity != 0
+			|| cipher_suite != conn->session.cipher_suite) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_illegal_parameter);
+			goto end;
+		}
+		conn->psk_resumed = 1;
+	} else if (offer_psk) {
+		// full handshake
+		memset(psk, 0, sizeof(psk));
+		/* [1]  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
+	}
 	conn->protocol = TLS_protocol_tls13;
 
 	tls13_cipher_suite_get(conn->cipher_suite, &digest, &cipher);
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
 	digest_update(&dgst_ctx, enced_record + 5, enced_recordlen - 5);
 
 
-	printf("generate handshake secrets\n");
+	tls_trace("generate handshake secrets\n");
 	/*
 	generate handshake keys
 		uint8_t client_write_key[32]
@@ -1565,7 +1962,6 @@ int tls13_do_connect(TLS_CONNECT *conn)
 		uint8_t server_write_iv[12]
 	*/
 	sm2_do_ecdh(&client_ecdhe, &server_ecdhe_public, &server_ecdhe_public);
-	/* [1]  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
 	/* [5]  */ tls13_derive_secret(early_secret, "derived", &null_dgst_ctx, handshake_secret);
 	/* [6]  */ tls13_hkdf_extract(digest, handshake_secret, (uint8_t *)&server_ecdhe_public, handshake_secret);
 	/* [7]  */ tls13_derive_secret(handshake_secret, "c hs traffic", &dgst_ctx, client_handshake_traffic_secret);
@@ -1579,10 +1975,10 @@ int tls13_do_connect(TLS_CONNECT *conn)
 	tls13_hkdf_expand_label(digest, server_handshake_traffic_secret, "iv", NULL, 0, 12, conn->server_write_iv);
 	block_cipher_set_encrypt_key(&conn->server_write_key, cipher, server_write_key);
 	memset(conn->server_seq_num, 0, 8);
-	tls13_hkdf_expand_label(digest, client_handshake_traffic_secret, "key", NULL, 0, 16, client_write_key);
-	tls13_hkdf_expand_label(digest, client_handshake_traffic_secret, "iv", NULL, 0, 12, conn->client_write_iv);
-	block_cipher_set_encrypt_key(&conn->client_write_key, cipher, client_write_key);
-	memset(conn->client_seq_num, 0, 8);
+	// the early data key is kept for EndOfEarlyData until the server accepts or rejects
+	if (!offer_early_data) {
+		tls13_update_client_write_key(conn, digest, cipher, client_handshake_traffic_secret);
+	}
 	/*
 	format_bytes(stderr, 0, 4, "client_write_key", client_write_key, 16);
 	format_bytes(stderr, 0, 4, "server_write_key", server_write_key, 16);
@@ -1592,7 +1988,7 @@ int tls13_do_connect(TLS_CONNECT *conn)
 	*/
 
 	// recv {EncryptedExtensions}
-	printf("recv {EncryptedExtensions}\n");
+	tls_trace("recv {EncryptedExtensions}\n");
 	if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
 		error_print();
 		tls_send_alert(conn, TLS_alert_handshake_failure);
@@ -1606,50 +2002,34 @@ int tls13_do_connect(TLS_CONNECT *conn)
 		goto end;
 	}
 	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	if (tls13_record_get_handshake_encrypted_extensions(record) != 1) {
-		tls_send_alert(conn, TLS_alert_handshake_failure);
-		error_print();
-		goto end;
-	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->server_seq_num);
-
-
-	// recv {CertififcateRequest*} or {Certificate}
-	if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
-		error_print();
+	if (tls13_record_get_handshake_encrypted_extensions(record, &early_data) != 1) {
 		tls_send_alert(conn, TLS_alert_handshake_failure);
-		goto end;
-	}
-	if (tls13_record_decrypt(&conn->server_write_key, conn->server_write_iv,
-		conn->server_seq_num, enced_record, enced_recordlen,
-		record, &recordlen) != 1) {
 		error_print();
-		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
 	}
-	if (tls_record_get_handshake(record, &type, &data, &datalen) != 1) {
+	if (early_data && (!offer_early_data || !conn->psk_resumed)) {
 		error_print();
-		tls_send_alert(conn, TLS_alert_handshake_failure);
+		tls_send_alert(conn, TLS_alert_unsupported_extension);
 		goto end;
 	}
-	if (type == TLS_handshake_certificate_request) {
-		tls_trace("recv {CertificateRequest*}\n");
-		tls13_record_trace(stderr, record, recordlen, 0, 0);
-		if (tls13_record_get_handshake_certificate_request(record,
-			&request_context, &request_context_len,
-			&cert_request_exts, &cert_request_extslen) != 1) {
-			error_print();
-			tls_send_alert(conn, TLS_alert_handshake_failure);
-			goto end;
+	digest_update(&dgst_ctx, record + 5, recordlen - 5);
+	tls_seq_num_incr(conn->server_seq_num);
+
+	if (offer_early_data) {
+		if (early_data) {
+			conn->early_data_status = TLS13_early_data_accepted;
+		} else {
+			conn->early_data_status = TLS13_early_data_rejected;
+			tls13_update_client_write_key(conn, digest, cipher, client_handshake_traffic_secret);
 		}
-		// 当前忽略 request_context 和 cert_request_exts
-		// request_context 应该为空，当前实现中不支持Post-Handshake Auth
-		digest_update(&dgst_ctx, record + 5, recordlen - 5);
-		tls_seq_num_incr(conn->server_seq_num);
+	}
 
 
-		// recv {Certificate}
+	// a resumed handshake is authenticated by the PSK
+	if (conn->psk_resumed) {
+		conn->client_certs_len = 0;
+	} else {
+		// recv {CertififcateRequest*} or {Certificate}
 		if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_handshake_failure);
@@ -1662,76 +2042,111 @@ int tls13_do_connect(TLS_CONNECT *conn)
 			tls_send_alert(conn, TLS_alert_bad_record_mac);
 			goto end;
 		}
-	} else {
-		conn->client_certs_len = 0;
-		// 清空客户端签名密钥
-	}
-
-	// recv {Certificate}
-	tls_trace("recv {Certificate}\n");
-	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	if (tls13_record_get_handshake_certificate(record,
-		&request_context, &request_context_len,
-		&cert_list, &cert_list_len) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (tls13_process_certificate_list(cert_list, cert_list_len, conn->server_certs, &conn->server_certs_len) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (x509_certs_get_cert_by_index(conn->server_certs, conn->server_certs_len, 0, &cert, &certlen) != 1
-		|| x509_cert_get_subject_public_key(cert, certlen, &server_sign_key) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->server_seq_num);
+		if (tls_record_get_handshake(record, &type, &data, &datalen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_handshake_failure);
+			goto end;
+		}
+		if (type == TLS_handshake_certificate_request) {
+			tls_trace("recv {CertificateRequest*}\n");
+			tls13_record_trace(stderr, record, recordlen, 0, 0);
+			if (tls13_record_get_handshake_certificate_request(record,
+				&request_context, &request_context_len,
+				&cert_request_exts, &cert_request_extslen) != 1) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_handshake_failure);
+				goto end;
+			}
+			// 当前忽略 request_context 和 cert_request_exts
+			// request_context 应该为空，当前实现中不支持Post-Handshake Auth
+			digest_update(&dgst_ctx, record + 5, recordlen - 5);
+			tls_seq_num_incr(conn->server_seq_num);
 
-	// verify ServerCertificate
-	int verify_result = 0; // TODO: maybe remove this arg from x509_certs_verify()
-	if (x509_certs_verify(conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
-		conn->ca_certs, conn->ca_certs_len, X509_MAX_VERIFY_DEPTH, &verify_result) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_bad_certificate);
-		goto end;
-	}
 
-	// recv {CertificateVerify}
-	tls_trace("recv {CertificateVerify}\n");
-	if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (tls13_record_decrypt(&conn->server_write_key, conn->server_write_iv,
-		conn->server_seq_num, enced_record, enced_recordlen,
-		record, &recordlen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_bad_record_mac);
-		goto end;
-	}
-	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	if (tls13_record_get_handshake_certificate_verify(record,
-		&server_sign_algor, &server_sig, &server_siglen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (server_sign_algor != TLS_sig_sm2sig_sm3) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (tls13_verify_certificate_verify(TLS_server_mode, &server_sign_key, TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, &dgst_ctx, server_sig, server_siglen) != 1) {
-		error_print();
-		goto end;
+			// recv {Certificate}
+			if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_handshake_failure);
+				goto end;
+			}
+			if (tls13_record_decrypt(&conn->server_write_key, conn->server_write_iv,
+				conn->server_seq_num, enced_record, enced_recordlen,
+				record, &recordlen) != 1) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_bad_record_mac);
+				goto end;
+			}
+		} else {
+			conn->client_certs_len = 0;
+			// 清空客户端签名密钥
+		}
+
+		// recv {Certificate}
+		tls_trace("recv {Certificate}\n");
+		tls13_record_trace(stderr, record, recordlen, 0, 0);
+		if (tls13_record_get_handshake_certificate(record,
+			&request_context, &request_context_len,
+			&cert_list, &cert_list_len) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		if (tls13_process_certificate_list(cert_list, cert_list_len, conn->server_certs, &conn->server_certs_len) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		if (x509_certs_get_cert_by_index(conn->server_certs, conn->server_certs_len, 0, &cert, &certlen) != 1
+			|| x509_cert_get_subject_public_key(cert, certlen, &server_sign_key) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		digest_update(&dgst_ctx, record + 5, recordlen - 5);
+		tls_seq_num_incr(conn->server_seq_num);
+
+		// verify ServerCertificate
+		int verify_result = 0; // TODO: maybe remove this arg from x509_certs_verify()
+		if (tls_verify_peer_certs(conn, conn->server_certs, conn->server_certs_len, X509_cert_chain_server,
+			X509_MAX_VERIFY_DEPTH, &verify_result) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_bad_certificate);
+			goto end;
+		}
+
+		// recv {CertificateVerify}
+		tls_trace("recv {CertificateVerify}\n");
+		if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		if (tls13_record_decrypt(&conn->server_write_key, conn->server_write_iv,
+			conn->server_seq_num, enced_record, enced_recordlen,
+			record, &recordlen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_bad_record_mac);
+			goto end;
+		}
+		tls13_record_trace(stderr, record, recordlen, 0, 0);
+		if (tls13_record_get_handshake_certificate_verify(record,
+			&server_sign_algor, &server_sig, &server_siglen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		if (server_sign_algor != TLS_sig_sm2sig_sm3) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			goto end;
+		}
+		if (tls13_verify_certificate_verify(TLS_server_mode, &server_sign_key, TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, &dgst_ctx, server_sig, server_siglen) != 1) {
+			error_print();
+			goto end;
+		}
+		digest_update(&dgst_ctx, record + 5, recordlen - 5);
+		tls_seq_num_incr(conn->server_seq_num);
 	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->server_seq_num);
 
 
 	// use Transcript-Hash(Handshake Context, Certificate*, CertificateVerify*)
@@ -1776,6 +2191,31 @@ int tls13_do_connect(TLS_CONNECT *conn)
 	/* [11] */ tls13_derive_secret(master_secret, "c ap traffic", &dgst_ctx, client_application_traffic_secret);
 
 
+	// send (EndOfEarlyData), then the handshake key is used
+	if (conn->early_data_status == TLS13_early_data_accepted) {
+		tls_trace("send (EndOfEarlyData)\n");
+		if (tls_record_set_handshake(record, &recordlen, TLS_handshake_end_of_early_data, NULL, 0) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		tls13_record_trace(stderr, record, recordlen, 0, 0);
+		tls13_padding_len_rand(&padding_len);
+		if (tls13_record_encrypt(&conn->client_write_key, conn->client_write_iv,
+			conn->client_seq_num, record, recordlen, padding_len,
+			enced_record, &enced_recordlen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
+			error_print();
+			goto end;
+		}
+		digest_update(&dgst_ctx, record + 5, recordlen - 5);
+		tls13_update_client_write_key(conn, digest, cipher, client_handshake_traffic_secret);
+	}
+
 	if (conn->client_certs_len) {
 		int client_sign_algor;
 		uint8_t sig[TLS_MAX_SIGNATURE_SIZE];
@@ -1811,7 +2251,11 @@ int tls13_do_connect(TLS_CONNECT *conn)
 		// send {CertificateVerify*}
 		tls_trace("send {CertificateVerify*}\n");
 		client_sign_algor = TLS_sig_sm2sig_sm3; // FIXME: 应该放在conn里面
-		tls13_sign_certificate_verify(TLS_client_mode, &conn->sign_key, TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, &dgst_ctx, sig, &siglen);
+		if (tls13_conn_sign_certificate_verify(conn, TLS_client_mode, &dgst_ctx, sig, &siglen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
 		if (tls13_record_set_handshake_certificate_verify(record, &recordlen,
 			client_sign_algor, sig, siglen) != 1) {
 			error_print();
@@ -1859,6 +2303,8 @@ int tls13_do_connect(TLS_CONNECT *conn)
 	digest_update(&dgst_ctx, record + 5, recordlen - 5);
 	tls_seq_num_incr(conn->client_seq_num);
 
+	// the PSK of the NewSessionTicket is derived from resumption_master_secret
+	/* [14] */ tls13_derive_secret(master_secret, "res master", &dgst_ctx, conn->resumption_master_secret);
 
 
 	// update server_write_key, server_write_iv, reset server_seq_num
@@ -1901,6 +2347,215 @@ end:
 	gmssl_secure_clear(server_application_traffic_secret, sizeof(server_application_traffic_secret));
 	gmssl_secure_clear(client_write_key, sizeof(client_write_key));
 	gmssl_secure_clear(server_write_key, sizeof(server_write_key));
+	gmssl_secure_clear(binder_key, sizeof(binder_key));
+	gmssl_secure_clear(client_early_traffic_secret, sizeof(client_early_traffic_secret));
+	return ret;
+}
+
+// return 1 if pre_shared_key is offered, it must be the last extension of ClientHello
+static int tls13_client_hello_get_psk_exts(const uint8_t *exts, size_t extslen,
+	int *psk_dhe_ke, int *early_data,
+	const uint8_t **identity, size_t *identity_len, uint32_t *obfuscated_ticket_age,
+	const uint8_t **binder, size_t *binder_len, size_t *binders_len)
+{
+	int ret = 0;
+
+	*psk_dhe_ke = 0;
+	*early_data = 0;
+	while (extslen) {
+		int ext_type;
+		const uint8_t *ext_data;
+		size_t ext_datalen;
+
+		if (ret) {
+			error_print();
+			return -1;
+		}
+		if (tls_ext_from_bytes(&ext_type, &ext_data, &ext_datalen, &exts, &extslen) != 1) {
+			error_print();
+			return -1;
+		}
+		switch (ext_type) {
+		case TLS_extension_psk_key_exchange_modes:
+			if ((*psk_dhe_ke = tls13_process_client_psk_key_exchange_modes(ext_data, ext_datalen)) < 0) {
+				error_print();
+				return -1;
+			}
+			break;
+		case TLS_extension_early_data:
+			if (tls13_process_early_data_ext(TLS_handshake_client_hello, ext_data, ext_datalen, NULL) != 1) {
+				error_print();
+				return -1;
+			}
+			*early_data = 1;
+			break;
+		case TLS_extension_pre_shared_key:
+			if (tls13_process_client_pre_shared_key(ext_data, ext_datalen,
+				identity, identity_len, obfuscated_ticket_age,
+				binder, binder_len, binders_len) != 1) {
+				error_print();
+				return -1;
+			}
+			ret = 1;
+			break;
+		}
+	}
+	return ret;
+}
+
+// the client records of the rejected 0-RTT data can not be decrypted and are skipped
+static int tls13_recv_client_record(TLS_CONNECT *conn, uint8_t *enced_record, size_t *enced_recordlen,
+	uint8_t *record, size_t *recordlen)
+{
+	for (;;) {
+		if (tls_record_recv(enced_record, enced_recordlen, conn->sock) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			return -1;
+		}
+		if (tls13_record_decrypt(&conn->client_write_key, conn->client_write_iv,
+			conn->client_seq_num, enced_record, *enced_recordlen,
+			record, recordlen) == 1) {
+			conn->early_data_skip_len = 0;
+			return 1;
+		}
+		if (*enced_recordlen - 5 > conn->early_data_skip_len) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_bad_record_mac);
+			return -1;
+		}
+		conn->early_data_skip_len -= *enced_recordlen - 5;
+	}
+}
+
+static int tls13_send_new_session_ticket(TLS_CONNECT *conn, const DIGEST *digest)
+{
+	uint8_t *record = conn->record;
+	size_t recordlen;
+	uint8_t *enced_record = conn->enced_record;
+	size_t enced_recordlen;
+	size_t padding_len;
+	uint8_t nonce[8];
+	uint8_t age_add_bytes[4];
+	uint32_t age_add;
+	uint32_t max_early_data_size = conn->anti_replay ? conn->max_early_data_size : 0;
+	uint8_t psk[32];
+	uint8_t ticket[TLS13_TICKET_SIZE];
+	size_t ticketlen;
+
+	tls_trace("send {NewSessionTicket}\n");
+	if (rand_bytes(nonce, sizeof(nonce)) != 1
+		|| rand_bytes(age_add_bytes, sizeof(age_add_bytes)) != 1) {
+		error_print();
+		return -1;
+	}
+	age_add = GETU32(age_add_bytes);
+
+	// psk = HKDF-Expand-Label(resumption_master_secret, "resumption", ticket_nonce, Hash.length)
+	tls13_hkdf_expand_label(digest, conn->resumption_master_secret, "resumption",
+		nonce, sizeof(nonce), 32, psk);
+	if (tls13_ticket_encrypt(conn->ticket_key, conn->cipher_suite, tls13_time_ms(),
+		age_add, max_early_data_size, psk, ticket, &ticketlen) != 1) {
+		gmssl_secure_clear(psk, sizeof(psk));
+		error_print();
+		return -1;
+	}
+	gmssl_secure_clear(psk, sizeof(psk));
+
+	tls_record_set_protocol(record, TLS_protocol_tls12);
+	if (tls13_record_set_handshake_new_session_ticket(record, &recordlen,
+		conn->ticket_lifetime, age_add, nonce, sizeof(nonce),
+		ticket, ticketlen, max_early_data_size) != 1) {
+		error_print();
+		return -1;
+	}
+	tls13_record_trace(stderr, record, recordlen, 0, 0);
+	tls13_padding_len_rand(&padding_len);
+	if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
+		conn->server_seq_num, record, recordlen, padding_len,
+		enced_record, &enced_recordlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
+		error_print();
+		return -1;
+	}
+	tls_seq_num_incr(conn->server_seq_num);
+	return 1;
+}
+
+// recv client {Finished}, the handshake state is kept in conn after the server Finished
+static int tls13_accept_finish(TLS_CONNECT *conn)
+{
+	int ret = -1;
+	uint8_t *record = conn->record;
+	size_t recordlen;
+	uint8_t *enced_record = conn->enced_record;
+	size_t enced_recordlen;
+	const DIGEST *digest;
+	const BLOCK_CIPHER *cipher;
+	const uint8_t *client_verify_data;
+	size_t client_verify_data_len;
+	uint8_t verify_data[32];
+	size_t verify_data_len;
+
+	if (tls13_cipher_suite_get(conn->cipher_suite, &digest, &cipher) != 1) {
+		error_print();
+		goto end;
+	}
+
+	tls_trace("recv {Finished}\n");
+	if (tls13_recv_client_record(conn, enced_record, &enced_recordlen, record, &recordlen) != 1) {
+		error_print();
+		goto end;
+	}
+	tls13_record_trace(stderr, record, recordlen, 0, 0);
+	if (tls13_record_get_handshake_finished(record, &client_verify_data, &client_verify_data_len) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_unexpected_message);
+		goto end;
+	}
+	if (tls13_compute_verify_data(conn->client_handshake_traffic_secret, &conn->dgst_ctx,
+		verify_data, &verify_data_len) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
+	if (client_verify_data_len != verify_data_len
+		|| memcmp(client_verify_data, verify_data, verify_data_len) != 0) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_bad_record_mac);
+		goto end;
+	}
+	digest_update(&conn->dgst_ctx, record + 5, recordlen - 5);
+	tls_seq_num_incr(conn->client_seq_num);
+
+
+	// 注意：OpenSSL兼容模式在此处会收发ChangeCipherSpec报文
+
+
+	// update client_write_key, client_write_iv
+	// reset client_seq_num
+	tls13_update_client_write_key(conn, digest, cipher, conn->client_application_traffic_secret);
+
+	// no tickets if the client is authenticated by certificate
+	if (conn->ticket_lifetime && !conn->ca_certs_len && !conn->ca_store) {
+		/* 14 */ tls13_derive_secret(conn->master_secret, "res master", &conn->dgst_ctx, conn->resumption_master_secret);
+		if (tls13_send_new_session_ticket(conn, digest) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+	}
+
+	fprintf(stderr, "Connection Established!\n\n");
+	ret = 1;
+end:
+	gmssl_secure_clear(conn->master_secret, sizeof(conn->master_secret));
+	gmssl_secure_clear(conn->client_handshake_traffic_secret, sizeof(conn->client_handshake_traffic_secret));
+	gmssl_secure_clear(conn->client_application_traffic_secret, sizeof(conn->client_application_traffic_secret));
+	gmssl_secure_clear(conn->resumption_master_secret, sizeof(conn->resumption_master_secret));
 	return ret;
 }
 
@@ -1945,9 +2600,6 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	uint8_t verify_data[32];
 	size_t verify_data_len;
 
-	const uint8_t *client_verify_data;
-	size_t client_verify_data_len;
-
 	uint8_t client_write_key[16];
 	uint8_t server_write_key[16];
 
@@ -1968,11 +2620,34 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	const uint8_t *cert;
 	size_t certlen;
 
+	int rv;
+	int psk_dhe_ke;
+	int early_data;
+	const uint8_t *identity;
+	size_t identity_len;
+	uint32_t obfuscated_ticket_age;
+	const uint8_t *client_binder;
+	size_t client_binder_len;
+	size_t binders_len;
+	int ticket_cipher_suite;
+	uint64_t issue_time;
+	uint32_t ticket_age_add;
+	uint32_t ticket_max_early_data_size;
+	uint8_t binder_key[32];
+	uint8_t binder[32];
+	size_t binderlen;
+	uint8_t client_early_traffic_secret[32];
+	DIGEST_CTX binder_dgst_ctx;
+
 
 	int client_verify = 0;
-	if (conn->ca_certs_len)
+	if (conn->ca_certs_len || conn->ca_store)
 		client_verify = 1;
 
+	conn->psk_resumed = 0;
+	conn->early_data_status = TLS13_early_data_none;
+	conn->early_data_pending = 0;
+
 
 	// 1. Recv ClientHello
 	tls_trace("recv ClientHello\n");
@@ -2011,13 +2686,78 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	tls13_cipher_suite_get(conn->cipher_suite, &digest, &cipher); // 这个函数是否应该放到tls_里面？
 	digest_init(&dgst_ctx, digest);
 	null_dgst_ctx = dgst_ctx; // 在密钥导出函数中可能输入的消息为空，因此需要一个空的dgst_ctx，这里不对了，应该在tls13_derive_secret里面直接支持NULL！
+
+	// resume the session of the ticket, the tickets of other keys fall back to full handshake
+	if ((rv = tls13_client_hello_get_psk_exts(client_exts, client_exts_len, &psk_dhe_ke, &early_data,
+		&identity, &identity_len, &obfuscated_ticket_age,
+		&client_binder, &client_binder_len, &binders_len)) < 0) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_decode_error);
+		goto end;
+	}
+	if (early_data) {
+		conn->early_data_status = TLS13_early_data_rejected;
+	}
+	if (rv == 1 && psk_dhe_ke && conn->ticket_lifetime && !client_verify) {
+		uint64_t now = tls13_time_ms();
+
+		if (tls13_ticket_decrypt(conn->ticket_key, identity, identity_len,
+				&ticket_cipher_suite, &issue_time, &ticket_age_add,
+				&ticket_max_early_data_size, psk) == 1
+			&& ticket_cipher_suite == conn->cipher_suite
+			&& now >= issue_time
+			&& now - issue_time < (uint64_t)conn->ticket_lifetime * 1000) {
+
+			/* 1  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
+			/* 2  */ tls13_derive_secret(early_secret, "res binder", &null_dgst_ctx, binder_key);
+			binder_dgst_ctx = null_dgst_ctx;
+			digest_update(&binder_dgst_ctx, record + 5, recordlen - 5 - binders_len);
+			tls13_compute_verify_data(binder_key, &binder_dgst_ctx, binder, &binderlen);
+			if (client_binder_len != binderlen
+				|| memcmp(client_binder, binder, binderlen) != 0) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_decrypt_error);
+				goto end;
+			}
+			conn->psk_resumed = 1;
+
+			// 0-RTT data is accepted only once in the replay window of the ticket age
+			if (early_data && conn->anti_replay && conn->max_early_data_size
+				&& ticket_max_early_data_size) {
+				uint32_t client_age = obfuscated_ticket_age - ticket_age_add;
+				uint64_t server_age = now - issue_time;
+				uint64_t diff = client_age > server_age ? client_age - server_age : server_age - client_age;
+
+				if (diff <= (uint64_t)conn->replay_window * 1000
+					&& tls13_anti_replay_check(conn->anti_replay, client_binder, client_binder_len, now) == 1) {
+					conn->early_data_status = TLS13_early_data_accepted;
+				}
+			}
+		}
+	}
+	if (!conn->psk_resumed) {
+		memset(psk, 0, sizeof(psk));
+		/* 1  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
+	}
+	if (conn->early_data_status == TLS13_early_data_rejected) {
+		// the rejected early data and the record overhead
+		conn->early_data_skip_len = conn->max_early_data_size + TLS_MAX_CIPHERTEXT_SIZE;
+	}
+
 	digest_update(&dgst_ctx, record + 5, recordlen - 5);
+	if (conn->early_data_status == TLS13_early_data_accepted) {
+		/* 3  */ tls13_derive_secret(early_secret, "c e traffic", &dgst_ctx, client_early_traffic_secret);
+	}
 
 
 	// 2. Send ServerHello
 	tls_trace("send ServerHello\n");
 	rand_bytes(server_random, 32);
-	sm2_key_generate(&server_ecdhe);
+	if (tls_ecdhe_key_generate(conn, &server_ecdhe) != 1) {
+		error_print();
+		tls_send_alert(conn, TLS_alert_internal_error);
+		goto end;
+	}
 	if (tls13_process_client_hello_exts(client_exts, client_exts_len,
 		&server_ecdhe, &client_ecdhe_public,
 		server_exts, &server_exts_len, sizeof(server_exts)) != 1) {
@@ -2025,6 +2765,18 @@ int tls13_do_accept(TLS_CONNECT *conn)
 		tls_send_alert(conn, TLS_alert_unexpected_message);
 		goto end;
 	}
+	if (conn->psk_resumed) {
+		uint8_t *p = server_exts + server_exts_len;
+		size_t len = 0;
+
+		tls13_server_pre_shared_key_ext_to_bytes(0, NULL, &len);
+		if (server_exts_len + len > sizeof(server_exts)) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		tls13_server_pre_shared_key_ext_to_bytes(0, &p, &server_exts_len);
+	}
 	tls_record_set_protocol(record, TLS_protocol_tls12);
 	if (tls_record_set_handshake_server_hello(record, &recordlen,
 		TLS_protocol_tls12, server_random,
@@ -2043,7 +2795,6 @@ int tls13_do_accept(TLS_CONNECT *conn)
 
 
 	sm2_do_ecdh(&server_ecdhe, &client_ecdhe_public, &client_ecdhe_public);
-	/* 1  */ tls13_hkdf_extract(digest, zeros, psk, early_secret);
 	/* 5  */ tls13_derive_secret(early_secret, "derived", &null_dgst_ctx, handshake_secret);
 	/* 6  */ tls13_hkdf_extract(digest, handshake_secret, (uint8_t *)&client_ecdhe_public, handshake_secret);
 	/* 7  */ tls13_derive_secret(handshake_secret, "c hs traffic", &dgst_ctx, client_handshake_traffic_secret);
@@ -2060,6 +2811,10 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	block_cipher_set_encrypt_key(&conn->client_write_key, cipher, client_write_key);
 	tls13_hkdf_expand_label(digest, client_handshake_traffic_secret, "iv", NULL, 0, 12, conn->client_write_iv);
 	memset(conn->client_seq_num, 0, 8);
+	// the accepted early data is received before the client handshake messages
+	if (conn->early_data_status == TLS13_early_data_accepted) {
+		tls13_update_client_write_key(conn, digest, cipher, client_early_traffic_secret);
+	}
 	/*
 	format_print(stderr, 0, 0, "generate handshake secrets\n");
 	format_bytes(stderr, 0, 4, "server_write_key", server_write_key, 16);
@@ -2072,7 +2827,8 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	// 3. Send {EncryptedExtensions}
 	tls_trace("send {EncryptedExtensions}\n");
 	tls_record_set_protocol(record, TLS_protocol_tls12);
-	tls13_record_set_handshake_encrypted_extensions(record, &recordlen);
+	tls13_record_set_handshake_encrypted_extensions(record, &recordlen,
+		conn->early_data_status == TLS13_early_data_accepted);
 	tls13_record_trace(stderr, record, recordlen, 0, 0);
 	tls13_padding_len_rand(&padding_len);
 	if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
@@ -2119,54 +2875,61 @@ int tls13_do_accept(TLS_CONNECT *conn)
 		tls_seq_num_incr(conn->server_seq_num);
 	}
 
-	// send Server {Certificate}
-	tls_trace("send {Certificate}\n");
-	if (tls13_record_set_handshake_certificate(record, &recordlen, NULL, 0, conn->server_certs, conn->server_certs_len) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_internal_error);
-		goto end;
-	}
-	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	tls13_padding_len_rand(&padding_len);
-	if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
-		conn->server_seq_num, record, recordlen, padding_len,
-		enced_record, &enced_recordlen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_internal_error);
-		goto end;
-	}
-	if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
-		error_print();
-		goto end;
-	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->server_seq_num);
+	// a resumed handshake is authenticated by the PSK
+	if (!conn->psk_resumed) {
+		// send Server {Certificate}
+		tls_trace("send {Certificate}\n");
+		if (tls13_record_set_handshake_certificate(record, &recordlen, NULL, 0, conn->server_certs, conn->server_certs_len) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		tls13_record_trace(stderr, record, recordlen, 0, 0);
+		tls13_padding_len_rand(&padding_len);
+		if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
+			conn->server_seq_num, record, recordlen, padding_len,
+			enced_record, &enced_recordlen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
+			error_print();
+			goto end;
+		}
+		digest_update(&dgst_ctx, record + 5, recordlen - 5);
+		tls_seq_num_incr(conn->server_seq_num);
 
 
-	// send Server {CertificateVerify}
-	tls_trace("send {CertificateVerify}\n");
-	tls13_sign_certificate_verify(TLS_server_mode, &conn->sign_key, TLS13_SM2_ID, TLS13_SM2_ID_LENGTH, &dgst_ctx, sig, &siglen);
-	if (tls13_record_set_handshake_certificate_verify(record, &recordlen,
-		TLS_sig_sm2sig_sm3, sig, siglen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_internal_error);
-		goto end;
-	}
-	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	tls13_padding_len_rand(&padding_len);
-	if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
-		conn->server_seq_num, record, recordlen, padding_len,
-		enced_record, &enced_recordlen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_internal_error);
-		goto end;
-	}
-	if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
-		error_print();
-		goto end;
+		// send Server {CertificateVerify}
+		tls_trace("send {CertificateVerify}\n");
+		if (tls13_conn_sign_certificate_verify(conn, TLS_server_mode, &dgst_ctx, sig, &siglen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		if (tls13_record_set_handshake_certificate_verify(record, &recordlen,
+			TLS_sig_sm2sig_sm3, sig, siglen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		tls13_record_trace(stderr, record, recordlen, 0, 0);
+		tls13_padding_len_rand(&padding_len);
+		if (tls13_record_encrypt(&conn->server_write_key, conn->server_write_iv,
+			conn->server_seq_num, record, recordlen, padding_len,
+			enced_record, &enced_recordlen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_internal_error);
+			goto end;
+		}
+		if (tls_record_send(enced_record, enced_recordlen, conn->sock) != 1) {
+			error_print();
+			goto end;
+		}
+		digest_update(&dgst_ctx, record + 5, recordlen - 5);
+		tls_seq_num_incr(conn->server_seq_num);
 	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->server_seq_num);
 
 
 	// Send Server {Finished}
@@ -2202,19 +2965,36 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	/* 11 */ tls13_derive_secret(master_secret, "c ap traffic", &dgst_ctx, client_application_traffic_secret);
 	// 因为后面还要解密握手消息，因此client application key, iv 等到握手结束之后再更新
 
+	// update server_write_key, server_write_iv, reset server_seq_num
+	// the server can send 0.5-RTT data before the client Finished
+	tls13_hkdf_expand_label(digest, server_application_traffic_secret, "key", NULL, 0, 16, server_write_key);
+	tls13_hkdf_expand_label(digest, server_application_traffic_secret, "iv", NULL, 0, 12, conn->server_write_iv);
+	block_cipher_set_encrypt_key(&conn->server_write_key, cipher, server_write_key);
+	memset(conn->server_seq_num, 0, 8);
+	/*
+	format_print(stderr, 0, 0, "update server secrets\n");
+	format_bytes(stderr, 0, 4, "server_write_key", server_write_key, 16);
+	format_bytes(stderr, 0, 4, "server_write_iv", conn->server_write_iv, 12);
+	format_print(stderr, 0, 0, "\n");
+	*/
+
+	// the handshake is finished by tls13_accept_finish(), after the early data if accepted
+	memcpy(conn->master_secret, master_secret, 32);
+	memcpy(conn->client_handshake_traffic_secret, client_handshake_traffic_secret, 32);
+	memcpy(conn->client_application_traffic_secret, client_application_traffic_secret, 32);
+	if (conn->early_data_status == TLS13_early_data_accepted) {
+		conn->dgst_ctx = dgst_ctx;
+		conn->early_data_pending = 1;
+		conn->early_data_recv_len = 0;
+		ret = 1;
+		goto end;
+	}
+
 	// Recv Client {Certificate*}
 	if (client_verify) {
 		tls_trace("recv {Certificate*}\n");
-		if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
-			error_print();
-			tls_send_alert(conn, TLS_alert_unexpected_message);
-			goto end;
-		}
-		if (tls13_record_decrypt(&conn->client_write_key, conn->client_write_iv,
-			conn->client_seq_num, enced_record, enced_recordlen,
-			record, &recordlen) != 1) {
+		if (tls13_recv_client_record(conn, enced_record, &enced_recordlen, record, &recordlen) != 1) {
 			error_print();
-			tls_send_alert(conn, TLS_alert_bad_record_mac);
 			goto end;
 		}
 		tls13_record_trace(stderr, record, recordlen, 0, 0);
@@ -2246,8 +3026,8 @@ int tls13_do_accept(TLS_CONNECT *conn)
 
 		// verify client Certificate
 		int verify_result;
-		if (x509_certs_verify(conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
-			conn->ca_certs, conn->ca_certs_len, X509_MAX_VERIFY_DEPTH, &verify_result) != 1) {
+		if (tls_verify_peer_certs(conn, conn->client_certs, conn->client_certs_len, X509_cert_chain_client,
+			X509_MAX_VERIFY_DEPTH, &verify_result) != 1) {
 			error_print();
 			tls_send_alert(conn, TLS_alert_bad_certificate);
 			goto end;
@@ -2289,70 +3069,11 @@ int tls13_do_accept(TLS_CONNECT *conn)
 	}
 
 	// 12. Recv Client {Finished}
-
-	tls_trace("recv {Finished}\n");
-	if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (tls13_record_decrypt(&conn->client_write_key, conn->client_write_iv,
-		conn->client_seq_num, enced_record, enced_recordlen,
-		record, &recordlen) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_bad_record_mac);
-		goto end;
-	}
-	tls13_record_trace(stderr, record, recordlen, 0, 0);
-	if (tls13_record_get_handshake_finished(record, &client_verify_data, &client_verify_data_len) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_unexpected_message);
-		goto end;
-	}
-	if (tls13_compute_verify_data(client_handshake_traffic_secret, &dgst_ctx, verify_data, &verify_data_len) != 1) {
-		error_print();
-		tls_send_alert(conn, TLS_alert_internal_error);
-		goto end;
-	}
-	if (client_verify_data_len != verify_data_len
-		|| memcmp(client_verify_data, verify_data, verify_data_len) != 0) {
+	conn->dgst_ctx = dgst_ctx;
+	if (tls13_accept_finish(conn) != 1) {
 		error_print();
-		tls_send_alert(conn, TLS_alert_bad_record_mac);
 		goto end;
 	}
-	digest_update(&dgst_ctx, record + 5, recordlen - 5);
-	tls_seq_num_incr(conn->client_seq_num);
-
-
-	// 注意：OpenSSL兼容模式在此处会收发ChangeCipherSpec报文
-
-
-	// update server_write_key, server_write_iv, reset server_seq_num
-	tls13_hkdf_expand_label(digest, server_application_traffic_secret, "key", NULL, 0, 16, server_write_key);
-	tls13_hkdf_expand_label(digest, server_application_traffic_secret, "iv", NULL, 0, 12, conn->server_write_iv);
-	block_cipher_set_encrypt_key(&conn->server_write_key, cipher, server_write_key);
-	memset(conn->server_seq_num, 0, 8);
-	/*
-	format_print(stderr, 0, 0, "update server secrets\n");
-	format_bytes(stderr, 0, 4, "server_write_key", server_write_key, 16);
-	format_bytes(stderr, 0, 4, "server_write_iv", conn->server_write_iv, 12);
-	format_print(stderr, 0, 0, "\n");
-	*/
-
-	// update client_write_key, client_write_iv
-	// reset client_seq_num
-	tls13_hkdf_expand_label(digest, client_application_traffic_secret, "key", NULL, 0, 16, client_write_key);
-	tls13_hkdf_expand_label(digest, client_application_traffic_secret, "iv", NULL, 0, 12, conn->client_write_iv);
-	block_cipher_set_encrypt_key(&conn->client_write_key, cipher, client_write_key);
-	memset(conn->client_seq_num, 0, 8);
-	/*
-	format_print(stderr, 0, 0, "update client secrets\n");
-	format_bytes(stderr, 0, 4, "client_write_key", client_write_key, 16);
-	format_bytes(stderr, 0, 4, "client_write_iv", conn->client_write_iv, 12);
-	format_print(stderr, 0, 0, "\n");
-	*/
-
-	fprintf(stderr, "Connection Established!\n\n");
 	ret = 1;
 end:
 	gmssl_secure_clear(&server_ecdhe, sizeof(server_ecdhe));
@@ -2367,5 +3088,95 @@ end:
 	gmssl_secure_clear(server_application_traffic_secret, sizeof(server_application_traffic_secret));
 	gmssl_secure_clear(client_write_key, sizeof(client_write_key));
 	gmssl_secure_clear(server_write_key, sizeof(server_write_key));
+	gmssl_secure_clear(binder_key, sizeof(binder_key));
+	gmssl_secure_clear(client_early_traffic_secret, sizeof(client_early_traffic_secret));
 	return ret;
 }
+
+// return 0 when the client ended the early data, the handshake is finished then
+int tls13_recv_early_data(TLS_CONNECT *conn, uint8_t *out, size_t outlen, size_t *recvlen)
+{
+	uint8_t *enced_record = conn->enced_record;
+	size_t enced_recordlen;
+	int record_type;
+	const DIGEST *digest;
+	const BLOCK_CIPHER *cipher;
+
+	if (!conn || !out || !outlen || !recvlen) {
+		error_print();
+		return -1;
+	}
+	if (conn->is_client) {
+		error_print();
+		return -1;
+	}
+	*recvlen = 0;
+	if (!conn->early_data_pending) {
+		return 0;
+	}
+
+	while (conn->datalen == 0) {
+		tls_trace("recv (EarlyData)\n");
+		if (tls_record_recv(enced_record, &enced_recordlen, conn->sock) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			return -1;
+		}
+		if (tls13_gcm_decrypt(&conn->client_write_key, conn->client_write_iv,
+			conn->client_seq_num, enced_record + 5, enced_recordlen - 5,
+			&record_type, conn->databuf, &conn->datalen) != 1) {
+			error_print();
+			tls_send_alert(conn, TLS_alert_bad_record_mac);
+			return -1;
+		}
+		tls_seq_num_incr(conn->client_seq_num);
+		conn->data = conn->databuf;
+
+		switch (record_type) {
+		case TLS_record_application_data:
+			conn->early_data_recv_len += conn->datalen;
+			if (conn->early_data_recv_len > conn->max_early_data_size) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_unexpected_message);
+				return -1;
+			}
+			break;
+
+		case TLS_record_handshake:
+			// EndOfEarlyData is an empty handshake message
+			tls_trace("recv (EndOfEarlyData)\n");
+			if (conn->datalen != TLS_HANDSHAKE_HEADER_SIZE
+				|| conn->databuf[0] != TLS_handshake_end_of_early_data
+				|| conn->databuf[1] || conn->databuf[2] || conn->databuf[3]) {
+				error_print();
+				tls_send_alert(conn, TLS_alert_unexpected_message);
+				return -1;
+			}
+			digest_update(&conn->dgst_ctx, conn->databuf, conn->datalen);
+			conn->datalen = 0;
+			conn->early_data_pending = 0;
+
+			if (tls13_cipher_suite_get(conn->cipher_suite, &digest, &cipher) != 1) {
+				error_print();
+				return -1;
+			}
+			tls13_update_client_write_key(conn, digest, cipher, conn->client_handshake_traffic_secret);
+			if (tls13_accept_finish(conn) != 1) {
+				error_print();
+				return -1;
+			}
+			return 0;
+
+		default:
+			error_print();
+			tls_send_alert(conn, TLS_alert_unexpected_message);
+			return -1;
+		}
+	}
+
+	*recvlen = outlen <= conn->datalen ? outlen : conn->datalen;
+	memcpy(out, conn->data, *recvlen);
+	conn->data += *recvlen;
+	conn->datalen -= *recvlen;
+	return 1;
+}
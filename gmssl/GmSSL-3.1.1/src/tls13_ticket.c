@@ -0,0 +1,376 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#endif
+#include <gmssl/mem.h>
+#include <gmssl/rand.h>
+#include <gmssl/sm3.h>
+#include <gmssl/sm4.h>
+#include <gmssl/tls.h>
+#include <gmssl/endian.h>
+#include <gmssl/error.h>
+
+
+uint64_t tls13_time_ms(void)
+{
+#ifdef WIN32
+	return (uint64_t)time(NULL) * 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+/*
+Ticket
+
+	struct {
+		uint16 cipher_suite;
+		uint64 issue_time; // milliseconds
+		uint32 ticket_age_add;
+		uint32 max_early_data_size;
+		opaque psk[32];
+	} TicketPlaintext;
+
+	ticket = nonce[12] || SM4-GCM(ticket_key, nonce, TicketPlaintext) || tag[16]
+*/
+
+int tls13_ticket_encrypt(const SM4_KEY *key, int cipher_suite, uint64_t issue_time,
+	uint32_t age_add, uint32_t max_early_data_size, const uint8_t psk[32],
+	uint8_t *ticket, size_t *ticketlen)
+{
+	uint8_t buf[TLS13_TICKET_PLAINTEXT_SIZE];
+	uint8_t *p = buf;
+	size_t len = 0;
+
+	if (!key || !psk || !ticket || !ticketlen) {
+		error_print();
+		return -1;
+	}
+	tls_uint16_to_bytes((uint16_t)cipher_suite, &p, &len);
+	tls_uint32_to_bytes((uint32_t)(issue_time >> 32), &p, &len);
+	tls_uint32_to_bytes((uint32_t)issue_time, &p, &len);
+	tls_uint32_to_bytes(age_add, &p, &len);
+	tls_uint32_to_bytes(max_early_data_size, &p, &len);
+	tls_array_to_bytes(psk, 32, &p, &len);
+
+	if (rand_bytes(ticket, 12) != 1
+		|| sm4_gcm_encrypt(key, ticket, 12, NULL, 0, buf, len,
+			ticket + 12, 16, ticket + 12 + len) != 1) {
+		gmssl_secure_clear(buf, sizeof(buf));
+		error_print();
+		return -1;
+	}
+	*ticketlen = TLS13_TICKET_SIZE;
+	gmssl_secure_clear(buf, sizeof(buf));
+	return 1;
+}
+
+// return 0 if the ticket is not issued with this key
+int tls13_ticket_decrypt(const SM4_KEY *key, const uint8_t *ticket, size_t ticketlen,
+	int *cipher_suite, uint64_t *issue_time, uint32_t *age_add, uint32_t *max_early_data_size,
+	uint8_t psk[32])
+{
+	uint8_t buf[TLS13_TICKET_PLAINTEXT_SIZE];
+	const uint8_t *p = buf;
+	size_t len = sizeof(buf);
+	uint16_t suite;
+	uint32_t hi, lo;
+	const uint8_t *k;
+
+	if (!key || !ticket || !cipher_suite || !issue_time || !age_add
+		|| !max_early_data_size || !psk) {
+		error_print();
+		return -1;
+	}
+	if (ticketlen != TLS13_TICKET_SIZE) {
+		return 0;
+	}
+	if (sm4_gcm_decrypt(key, ticket, 12, NULL, 0, ticket + 12, len,
+		ticket + 12 + len, 16, buf) != 1) {
+		return 0;
+	}
+	if (tls_uint16_from_bytes(&suite, &p, &len) != 1
+		|| tls_uint32_from_bytes(&hi, &p, &len) != 1
+		|| tls_uint32_from_bytes(&lo, &p, &len) != 1
+		|| tls_uint32_from_bytes(age_add, &p, &len) != 1
+		|| tls_uint32_from_bytes(max_early_data_size, &p, &len) != 1
+		|| tls_array_from_bytes(&k, 32, &p, &len) != 1
+		|| tls_length_is_zero(len) != 1) {
+		gmssl_secure_clear(buf, sizeof(buf));
+		error_print();
+		return -1;
+	}
+	*cipher_suite = suite;
+	*issue_time = ((uint64_t)hi << 32) | lo;
+	memcpy(psk, k, 32);
+	gmssl_secure_clear(buf, sizeof(buf));
+	return 1;
+}
+
+/*
+Session
+
+	struct {
+		uint16 version = TLS_protocol_tls13;
+		uint16 cipher_suite;
+		uint32 ticket_lifetime;
+		uint32 ticket_age_add;
+		uint32 max_early_data_size;
+		uint64 received_time;
+		opaque psk<1..255>;
+		opaque ticket<1..2^16-1>;
+	} Session;
+*/
+
+int tls13_session_to_bytes(const TLS13_SESSION *sess, uint8_t **out, size_t *outlen)
+{
+	if (!sess || !outlen) {
+		error_print();
+		return -1;
+	}
+	if (!sess->ticketlen || sess->ticketlen > TLS13_MAX_TICKET_SIZE) {
+		error_print();
+		return -1;
+	}
+	tls_uint16_to_bytes(TLS_protocol_tls13, out, outlen);
+	tls_uint16_to_bytes((uint16_t)sess->cipher_suite, out, outlen);
+	tls_uint32_to_bytes(sess->ticket_lifetime, out, outlen);
+	tls_uint32_to_bytes(sess->ticket_age_add, out, outlen);
+	tls_uint32_to_bytes(sess->max_early_data_size, out, outlen);
+	tls_uint32_to_bytes((uint32_t)(sess->received_time >> 32), out, outlen);
+	tls_uint32_to_bytes((uint32_t)sess->received_time, out, outlen);
+	tls_uint8array_to_bytes(sess->psk, 32, out, outlen);
+	tls_uint16array_to_bytes(sess->ticket, sess->ticketlen, out, outlen);
+	return 1;
+}
+
+int tls13_session_from_bytes(TLS13_SESSION *sess, const uint8_t **in, size_t *inlen)
+{
+	uint16_t version;
+	uint16_t cipher_suite;
+	uint32_t hi, lo;
+	const uint8_t *psk;
+	size_t psklen;
+	const uint8_t *ticket;
+	size_t ticketlen;
+
+	if (!sess || !in || !(*in) || !inlen) {
+		error_print();
+		return -1;
+	}
+	if (tls_uint16_from_bytes(&version, in, inlen) != 1
+		|| tls_uint16_from_bytes(&cipher_suite, in, inlen) != 1
+		|| tls_uint32_from_bytes(&sess->ticket_lifetime, in, inlen) != 1
+		|| tls_uint32_from_bytes(&sess->ticket_age_add, in, inlen) != 1
+		|| tls_uint32_from_bytes(&sess->max_early_data_size, in, inlen) != 1
+		|| tls_uint32_from_bytes(&hi, in, inlen) != 1
+		|| tls_uint32_from_bytes(&lo, in, inlen) != 1
+		|| tls_uint8array_from_bytes(&psk, &psklen, in, inlen) != 1
+		|| tls_uint16array_from_bytes(&ticket, &ticketlen, in, inlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (version != TLS_protocol_tls13
+		|| psklen != 32
+		|| !ticketlen || ticketlen > TLS13_MAX_TICKET_SIZE) {
+		error_print();
+		return -1;
+	}
+	sess->cipher_suite = cipher_suite;
+	sess->received_time = ((uint64_t)hi << 32) | lo;
+	memcpy(sess->psk, psk, 32);
+	memcpy(sess->ticket, ticket, ticketlen);
+	sess->ticketlen = ticketlen;
+	return 1;
+}
+
+/*
+Anti-Replay
+
+	A ClientHello passes the ticket age check for 2 * window milliseconds, so every bloom
+	filter covers 2 * window and a binder is remembered for 2 * window to 4 * window.
+	The filter bits are indexed by the SM3 digest of the binder.
+*/
+
+#define TLS13_ANTI_REPLAY_FILTER_BITS	(1 << 20)
+#define TLS13_ANTI_REPLAY_HASHES	4
+
+struct tls13_anti_replay_st {
+#ifndef WIN32
+	pthread_mutex_t mutex; // shared by the forked processes
+#endif
+	uint64_t period; // milliseconds
+	uint64_t start; // start time of the current filter
+	int current;
+	uint8_t filters[2][TLS13_ANTI_REPLAY_FILTER_BITS/8];
+};
+
+TLS13_ANTI_REPLAY *tls13_anti_replay_new(int window)
+{
+	TLS13_ANTI_REPLAY *ar;
+
+	if (window <= 0 || window > 3600) {
+		error_print();
+		return NULL;
+	}
+#ifndef WIN32
+	{
+		pthread_mutexattr_t attr;
+
+		ar = mmap(NULL, sizeof(TLS13_ANTI_REPLAY), PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+		if (ar == MAP_FAILED) {
+			error_print();
+			return NULL;
+		}
+		memset(ar, 0, sizeof(TLS13_ANTI_REPLAY));
+		if (pthread_mutexattr_init(&attr) != 0
+			|| pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0
+			|| pthread_mutex_init(&ar->mutex, &attr) != 0) {
+			munmap(ar, sizeof(TLS13_ANTI_REPLAY));
+			error_print();
+			return NULL;
+		}
+		pthread_mutexattr_destroy(&attr);
+	}
+#else
+	if (!(ar = calloc(1, sizeof(TLS13_ANTI_REPLAY)))) {
+		error_print();
+		return NULL;
+	}
+#endif
+	ar->period = (uint64_t)window * 2 * 1000;
+	ar->start = tls13_time_ms();
+	return ar;
+}
+
+// return 1 if the binder is seen for the first time, 0 if it is a replay
+int tls13_anti_replay_check(TLS13_ANTI_REPLAY *ar, const uint8_t *binder, size_t binderlen, uint64_t now)
+{
+	uint8_t dgst[SM3_DIGEST_SIZE];
+	uint32_t idx[TLS13_ANTI_REPLAY_HASHES];
+	int seen[2] = {1, 1};
+	int i, j;
+
+	if (!ar || !binder || !binderlen) {
+		error_print();
+		return -1;
+	}
+	sm3_digest(binder, binderlen, dgst);
+	for (i = 0; i < TLS13_ANTI_REPLAY_HASHES; i++) {
+		idx[i] = GETU32(dgst + 4 * i) & (TLS13_ANTI_REPLAY_FILTER_BITS - 1);
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&ar->mutex);
+#endif
+	if (now >= ar->start + 2 * ar->period) {
+		memset(ar->filters, 0, sizeof(ar->filters));
+		ar->start = now;
+	} else if (now >= ar->start + ar->period) {
+		ar->current ^= 1;
+		memset(ar->filters[ar->current], 0, sizeof(ar->filters[ar->current]));
+		ar->start += ar->period;
+	}
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < TLS13_ANTI_REPLAY_HASHES; i++) {
+			if (!(ar->filters[j][idx[i] >> 3] & (1 << (idx[i] & 7)))) {
+				seen[j] = 0;
+				break;
+			}
+		}
+	}
+	if (!seen[0] && !seen[1]) {
+		for (i = 0; i < TLS13_ANTI_REPLAY_HASHES; i++) {
+			ar->filters[ar->current][idx[i] >> 3] |= (1 << (idx[i] & 7));
+		}
+	}
+#ifndef WIN32
+	pthread_mutex_unlock(&ar->mutex);
+#endif
+
+	return (seen[0] || seen[1]) ? 0 : 1;
+}
+
+void tls13_anti_replay_free(TLS13_ANTI_REPLAY *ar)
+{
+	if (!ar) {
+		return;
+	}
+#ifndef WIN32
+	pthread_mutex_destroy(&ar->mutex);
+	munmap(ar, sizeof(TLS13_ANTI_REPLAY));
+#else
+	free(ar);
+#endif
+}
+
+int tls13_ctx_enable_session_tickets(TLS_CTX *ctx, uint32_t lifetime)
+{
+	uint8_t key[SM4_KEY_SIZE];
+
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	if (ctx->protocol != TLS_protocol_tls13 || ctx->is_client) {
+		error_print();
+		return -1;
+	}
+	if (!lifetime || lifetime > TLS13_MAX_TICKET_LIFETIME) {
+		error_print();
+		return -1;
+	}
+	if (rand_bytes(key, sizeof(key)) != 1) {
+		error_print();
+		return -1;
+	}
+	sm4_set_encrypt_key(&ctx->ticket_key, key);
+	ctx->ticket_lifetime = lifetime;
+	gmssl_secure_clear(key, sizeof(key));
+	return 1;
+}
+
+int tls13_ctx_enable_early_data(TLS_CTX *ctx, uint32_t max_early_data_size, int replay_window)
+{
+	TLS13_ANTI_REPLAY *ar;
+
+	if (!ctx) {
+		error_print();
+		return -1;
+	}
+	if (!ctx->ticket_lifetime) {
+		error_print();
+		return -1;
+	}
+	if (!max_early_data_size) {
+		error_print();
+		return -1;
+	}
+	if (!(ar = tls13_anti_replay_new(replay_window))) {
+		error_print();
+		return -1;
+	}
+	tls13_anti_replay_free(ctx->anti_replay);
+	ctx->anti_replay = ar;
+	ctx->max_early_data_size = max_early_data_size;
+	ctx->replay_window = replay_window;
+	return 1;
+}
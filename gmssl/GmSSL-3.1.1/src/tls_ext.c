@@ -787,6 +787,228 @@ int tls13_certificate_authorities_ext_to_bytes(const uint8_t *ca_names, size_t c
 	return 1;
 }
 
+/*
+psk_key_exchange_modes
+
+  enum { psk_ke(0), psk_dhe_ke(1), (255) } PskKeyExchangeMode;
+
+  struct {
+	PskKeyExchangeMode ke_modes<1..255>;
+  } PskKeyExchangeModes;
+
+Only psk_dhe_ke is supported, a resumed handshake always does the ECDHE key exchange.
+*/
+
+int tls13_psk_key_exchange_modes_ext_to_bytes(uint8_t **out, size_t *outlen)
+{
+	uint16_t ext_type = TLS_extension_psk_key_exchange_modes;
+	uint8_t ke_modes[] = { TLS_psk_dhe_ke };
+
+	if (!outlen) {
+		error_print();
+		return -1;
+	}
+	tls_uint16_to_bytes(ext_type, out, outlen);
+	tls_uint16_to_bytes((uint16_t)tls_uint8array_size(sizeof(ke_modes)), out, outlen);
+	tls_uint8array_to_bytes(ke_modes, sizeof(ke_modes), out, outlen);
+	return 1;
+}
+
+// return 1 if psk_dhe_ke is offered, 0 if not
+int tls13_process_client_psk_key_exchange_modes(const uint8_t *ext_data, size_t ext_datalen)
+{
+	const uint8_t *ke_modes;
+	size_t ke_modes_len;
+
+	if (tls_uint8array_from_bytes(&ke_modes, &ke_modes_len, &ext_data, &ext_datalen) != 1
+		|| tls_length_is_zero(ext_datalen) != 1
+		|| !ke_modes_len) {
+		error_print();
+		return -1;
+	}
+	while (ke_modes_len--) {
+		if (*ke_modes++ == TLS_psk_dhe_ke) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+early_data
+
+  struct {} Empty;
+
+  struct {
+	select (Handshake.msg_type) {
+		case new_session_ticket:   uint32 max_early_data_size;
+		case client_hello:         Empty;
+		case encrypted_extensions: Empty;
+	};
+  } EarlyDataIndication;
+*/
+
+int tls13_early_data_ext_to_bytes(int handshake_type, uint32_t max_early_data_size,
+	uint8_t **out, size_t *outlen)
+{
+	uint16_t ext_type = TLS_extension_early_data;
+
+	if (!outlen) {
+		error_print();
+		return -1;
+	}
+	tls_uint16_to_bytes(ext_type, out, outlen);
+	switch (handshake_type) {
+	case TLS_handshake_client_hello:
+	case TLS_handshake_encrypted_extensions:
+		tls_uint16_to_bytes(0, out, outlen);
+		break;
+	case TLS_handshake_new_session_ticket:
+		tls_uint16_to_bytes((uint16_t)tls_uint32_size(), out, outlen);
+		tls_uint32_to_bytes(max_early_data_size, out, outlen);
+		break;
+	default:
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int tls13_process_early_data_ext(int handshake_type, const uint8_t *ext_data, size_t ext_datalen,
+	uint32_t *max_early_data_size)
+{
+	switch (handshake_type) {
+	case TLS_handshake_client_hello:
+	case TLS_handshake_encrypted_extensions:
+		if (tls_length_is_zero(ext_datalen) != 1) {
+			error_print();
+			return -1;
+		}
+		break;
+	case TLS_handshake_new_session_ticket:
+		if (!max_early_data_size
+			|| tls_uint32_from_bytes(max_early_data_size, &ext_data, &ext_datalen) != 1
+			|| tls_length_is_zero(ext_datalen) != 1) {
+			error_print();
+			return -1;
+		}
+		break;
+	default:
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+/*
+pre_shared_key
+
+  struct {
+	opaque identity<1..2^16-1>;
+	uint32 obfuscated_ticket_age;
+  } PskIdentity;
+
+  opaque PskBinderEntry<32..255>;
+
+  struct {
+	PskIdentity identities<7..2^16-1>;
+	PskBinderEntry binders<33..2^16-1>;
+  } OfferedPsks;
+
+  struct {
+	select (Handshake.msg_type) {
+		case client_hello: OfferedPsks;
+		case server_hello: uint16 selected_identity;
+	};
+  } PreSharedKeyExtension;
+
+The client offers a single identity. The extension must be the last one of ClientHello, the
+binders are the last bytes of the message and are computed over the ClientHello up to them.
+*/
+
+int tls13_client_pre_shared_key_ext_to_bytes(const uint8_t *identity, size_t identity_len,
+	uint32_t obfuscated_ticket_age, const uint8_t *binder, size_t binder_len,
+	uint8_t **out, size_t *outlen)
+{
+	uint16_t ext_type = TLS_extension_pre_shared_key;
+	size_t identities_len;
+	size_t binders_len;
+
+	if (!identity || !identity_len || identity_len > 65535 - 6
+		|| !binder || binder_len < 32 || binder_len > 255 || !outlen) {
+		error_print();
+		return -1;
+	}
+	identities_len = tls_uint16array_size(identity_len) + tls_uint32_size();
+	binders_len = tls_uint8array_size(binder_len);
+
+	tls_uint16_to_bytes(ext_type, out, outlen);
+	tls_uint16_to_bytes((uint16_t)(tls_uint16array_size(identities_len) + tls_uint16array_size(binders_len)), out, outlen);
+	tls_uint16_to_bytes((uint16_t)identities_len, out, outlen);
+	tls_uint16array_to_bytes(identity, identity_len, out, outlen);
+	tls_uint32_to_bytes(obfuscated_ticket_age, out, outlen);
+	tls_uint16_to_bytes((uint16_t)binders_len, out, outlen);
+	tls_uint8array_to_bytes(binder, binder_len, out, outlen);
+	return 1;
+}
+
+// only the first identity and binder are returned, binders_len is the size of the binders field
+int tls13_process_client_pre_shared_key(const uint8_t *ext_data, size_t ext_datalen,
+	const uint8_t **identity, size_t *identity_len, uint32_t *obfuscated_ticket_age,
+	const uint8_t **binder, size_t *binder_len, size_t *binders_len)
+{
+	const uint8_t *identities;
+	size_t identities_len;
+	const uint8_t *binders;
+	size_t len;
+
+	if (tls_uint16array_from_bytes(&identities, &identities_len, &ext_data, &ext_datalen) != 1
+		|| tls_uint16array_from_bytes(&binders, &len, &ext_data, &ext_datalen) != 1
+		|| tls_length_is_zero(ext_datalen) != 1) {
+		error_print();
+		return -1;
+	}
+	*binders_len = tls_uint16array_size(len);
+	if (tls_uint16array_from_bytes(identity, identity_len, &identities, &identities_len) != 1
+		|| tls_uint32_from_bytes(obfuscated_ticket_age, &identities, &identities_len) != 1
+		|| tls_uint8array_from_bytes(binder, binder_len, &binders, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	if (!(*identity_len) || *binder_len < 32) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int tls13_server_pre_shared_key_ext_to_bytes(int selected_identity, uint8_t **out, size_t *outlen)
+{
+	uint16_t ext_type = TLS_extension_pre_shared_key;
+
+	if (selected_identity < 0 || selected_identity > 65535 || !outlen) {
+		error_print();
+		return -1;
+	}
+	tls_uint16_to_bytes(ext_type, out, outlen);
+	tls_uint16_to_bytes((uint16_t)tls_uint16_size(), out, outlen);
+	tls_uint16_to_bytes((uint16_t)selected_identity, out, outlen);
+	return 1;
+}
+
+int tls13_process_server_pre_shared_key(const uint8_t *ext_data, size_t ext_datalen, int *selected_identity)
+{
+	uint16_t selected;
+
+	if (tls_uint16_from_bytes(&selected, &ext_data, &ext_datalen) != 1
+		|| tls_length_is_zero(ext_datalen) != 1) {
+		error_print();
+		return -1;
+	}
+	*selected_identity = selected;
+	return 1;
+}
+
 
 int tls_ext_from_bytes(int *type, const uint8_t **data, size_t *datalen, const uint8_t **in, size_t *inlen)
 {
@@ -0,0 +1,230 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <gmssl/sm3.h>
+#include <gmssl/mem.h>
+#include <gmssl/endian.h>
+#include <gmssl/x509_cer.h>
+#include <gmssl/error.h>
+
+#ifdef WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define cache_lock_acquire()	AcquireSRWLockExclusive(&cache_lock)
+#define cache_lock_release()	ReleaseSRWLockExclusive(&cache_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define cache_lock_acquire()	pthread_mutex_lock(&cache_lock)
+#define cache_lock_release()	pthread_mutex_unlock(&cache_lock)
+#endif
+
+
+/*
+The cache is set-associative: the first 4 bytes of the fingerprint select a set of
+X509_VERIFY_CACHE_WAYS entries, a lookup compares at most WAYS fingerprints and an insert
+replaces an empty, expired or the oldest entry of the set. No list walking, no rehashing.
+*/
+typedef struct {
+	uint8_t fingerprint[32];
+	time_t expires; // 0 means empty
+} X509_VERIFY_CACHE_ENTRY;
+
+static X509_VERIFY_CACHE_ENTRY *cache_entries = NULL;
+static size_t cache_sets = 0;
+static int cache_ttl = 0;
+static size_t cache_hits = 0;
+static size_t cache_misses = 0;
+
+
+int x509_verify_cache_enable(size_t max_entries, int ttl_secs)
+{
+	X509_VERIFY_CACHE_ENTRY *entries;
+	size_t sets = 1;
+
+	if (!max_entries) {
+		max_entries = X509_VERIFY_CACHE_DEFAULT_SIZE;
+	}
+	if (max_entries > X509_VERIFY_CACHE_MAX_SIZE) {
+		error_print();
+		return -1;
+	}
+	if (ttl_secs <= 0) {
+		error_print();
+		return -1;
+	}
+	// number of sets is a power of 2, total entries not more than max_entries
+	while (sets * 2 * X509_VERIFY_CACHE_WAYS <= max_entries) {
+		sets *= 2;
+	}
+	if (!(entries = calloc(sets * X509_VERIFY_CACHE_WAYS, sizeof(X509_VERIFY_CACHE_ENTRY)))) {
+		error_print();
+		return -1;
+	}
+
+	cache_lock_acquire();
+	if (cache_entries) free(cache_entries);
+	cache_entries = entries;
+	cache_sets = sets;
+	cache_ttl = ttl_secs;
+	cache_hits = 0;
+	cache_misses = 0;
+	cache_lock_release();
+	return 1;
+}
+
+void x509_verify_cache_disable(void)
+{
+	cache_lock_acquire();
+	if (cache_entries) free(cache_entries);
+	cache_entries = NULL;
+	cache_sets = 0;
+	cache_ttl = 0;
+	cache_lock_release();
+}
+
+int x509_verify_cache_is_enabled(void)
+{
+	int ret;
+	cache_lock_acquire();
+	ret = cache_entries ? 1 : 0;
+	cache_lock_release();
+	return ret;
+}
+
+void x509_verify_cache_flush(void)
+{
+	cache_lock_acquire();
+	if (cache_entries) {
+		memset(cache_entries, 0, sizeof(X509_VERIFY_CACHE_ENTRY) * cache_sets * X509_VERIFY_CACHE_WAYS);
+	}
+	cache_lock_release();
+}
+
+int x509_verify_cache_get_stats(size_t *hits, size_t *misses, size_t *entries)
+{
+	time_t now = time(NULL);
+	size_t i;
+
+	cache_lock_acquire();
+	if (!cache_entries) {
+		cache_lock_release();
+		return 0;
+	}
+	if (hits) *hits = cache_hits;
+	if (misses) *misses = cache_misses;
+	if (entries) {
+		*entries = 0;
+		for (i = 0; i < cache_sets * X509_VERIFY_CACHE_WAYS; i++) {
+			if (cache_entries[i].expires > now) {
+				(*entries)++;
+			}
+		}
+	}
+	cache_lock_release();
+	return 1;
+}
+
+int x509_verify_cache_fingerprint(const uint8_t *cert, size_t certlen,
+	const uint8_t *cacert, size_t cacertlen,
+	const char *signer_id, size_t signer_id_len, uint8_t fingerprint[32])
+{
+	SM3_CTX sm3_ctx;
+	uint8_t len[4];
+
+	if (!cert || !certlen || !cacert || !cacertlen || !fingerprint) {
+		error_print();
+		return -1;
+	}
+
+	sm3_init(&sm3_ctx);
+	PUTU32(len, (uint32_t)certlen);
+	sm3_update(&sm3_ctx, len, sizeof(len));
+	sm3_update(&sm3_ctx, cert, certlen);
+	PUTU32(len, (uint32_t)cacertlen);
+	sm3_update(&sm3_ctx, len, sizeof(len));
+	sm3_update(&sm3_ctx, cacert, cacertlen);
+	if (signer_id && signer_id_len) {
+		sm3_update(&sm3_ctx, (const uint8_t *)signer_id, signer_id_len);
+	}
+	sm3_finish(&sm3_ctx, fingerprint);
+	return 1;
+}
+
+static X509_VERIFY_CACHE_ENTRY *cache_set(const uint8_t fingerprint[32])
+{
+	size_t index = GETU32(fingerprint) & (cache_sets - 1);
+	return cache_entries + index * X509_VERIFY_CACHE_WAYS;
+}
+
+int x509_verify_cache_lookup(const uint8_t fingerprint[32])
+{
+	X509_VERIFY_CACHE_ENTRY *set;
+	time_t now;
+	int i;
+
+	cache_lock_acquire();
+	if (!cache_entries) {
+		cache_lock_release();
+		return 0;
+	}
+	now = time(NULL);
+	set = cache_set(fingerprint);
+	for (i = 0; i < X509_VERIFY_CACHE_WAYS; i++) {
+		if (set[i].expires > now
+			&& memcmp(set[i].fingerprint, fingerprint, 32) == 0) {
+			cache_hits++;
+			cache_lock_release();
+			return 1;
+		}
+	}
+	cache_misses++;
+	cache_lock_release();
+	return 0;
+}
+
+int x509_verify_cache_add(const uint8_t fingerprint[32])
+{
+	X509_VERIFY_CACHE_ENTRY *set;
+	X509_VERIFY_CACHE_ENTRY *victim;
+	time_t now;
+	int i;
+
+	cache_lock_acquire();
+	if (!cache_entries) {
+		cache_lock_release();
+		return 0;
+	}
+	now = time(NULL);
+	set = cache_set(fingerprint);
+	victim = &set[0];
+	for (i = 0; i < X509_VERIFY_CACHE_WAYS; i++) {
+		if (memcmp(set[i].fingerprint, fingerprint, 32) == 0) {
+			victim = &set[i];
+			break;
+		}
+		if (set[i].expires <= now) {
+			victim = &set[i];
+			break;
+		}
+		if (set[i].expires < victim->expires) {
+			victim = &set[i];
+		}
+	}
+	memcpy(victim->fingerprint, fingerprint, 32);
+	victim->expires = now + cache_ttl;
+	cache_lock_release();
+	return 1;
+}
@@ -1091,6 +1091,138 @@ err:
 	return -1;
 }
 
+int x509_builder_explicit_version(ASN1_BUILDER *b, int index, int version)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (version == -1) {
+		return 0;
+	}
+	if (!x509_version_name(version)) {
+		error_print();
+		return -1;
+	}
+	if (asn1_builder_int(b, version) != 1
+		|| asn1_builder_explicit_header(b, index, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_time(ASN1_BUILDER *b, time_t tv)
+{
+	char buf[ASN1_GENERALIZED_TIME_STRLEN + 1] = {0};
+	int utc_time;
+	size_t mark = asn1_builder_mark(b);
+
+	if (tv == -1) {
+		return 0;
+	}
+	if (tv < -1 || tv > X509_MAX_GENERALIZED_TIME) {
+		error_print();
+		return -1;
+	}
+	utc_time = (tv <= X509_MAX_UTC_TIME);
+	if (asn1_time_to_str(utc_time, tv, buf) != 1
+		|| asn1_builder_data(b, (uint8_t *)buf, utc_time ? ASN1_UTC_TIME_STRLEN : ASN1_GENERALIZED_TIME_STRLEN) != 1
+		|| asn1_builder_header(b, utc_time ? ASN1_TAG_UTCTime : ASN1_TAG_GeneralizedTime, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_validity(ASN1_BUILDER *b, time_t not_before, time_t not_after)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (x509_builder_time(b, not_after) != 1
+		|| x509_builder_time(b, not_before) != 1
+		|| asn1_builder_sequence_header(b, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+// short fixed fields are encoded forward on the stack and copied
+int x509_builder_signature_algor(ASN1_BUILDER *b, int oid)
+{
+	uint8_t buf[ASN1_OID_MAX_OCTETS + 16];
+	uint8_t *p = buf;
+	size_t len = 0;
+
+	if (x509_signature_algor_to_der(oid, &p, &len) != 1
+		|| asn1_builder_data(b, buf, len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_public_key_info(ASN1_BUILDER *b, const SM2_KEY *key)
+{
+	uint8_t buf[128];
+	uint8_t *p = buf;
+	size_t len = 0;
+
+	if (x509_public_key_info_to_der(key, &p, &len) != 1
+		|| asn1_builder_data(b, buf, len) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_explicit_exts(ASN1_BUILDER *b, int index, const uint8_t *d, size_t dlen)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (dlen == 0) {
+		return 0;
+	}
+	if (asn1_builder_sequence(b, d, dlen) != 1
+		|| asn1_builder_explicit_header(b, index, mark) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_signature(ASN1_BUILDER *b, int sig_alg, size_t siglen, uint8_t **sig)
+{
+	size_t mark = asn1_builder_mark(b);
+
+	if (!(*sig = asn1_builder_reserve(b, siglen))
+		|| asn1_builder_data(b, (const uint8_t *)"", 1) != 1
+		|| asn1_builder_header(b, ASN1_TAG_BIT_STRING, mark) != 1
+		|| x509_builder_signature_algor(b, sig_alg) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_builder_sign(ASN1_BUILDER *b, size_t tbs_mark, uint8_t *sig, size_t siglen,
+	const SM2_KEY *sign_key, const char *signer_id, size_t signer_id_len)
+{
+	SM2_SIGN_CTX sign_ctx;
+	const uint8_t *tbs;
+	size_t tbslen;
+
+	tbs = asn1_builder_get_data(b, tbs_mark, &tbslen);
+	if (sm2_sign_init(&sign_ctx, sign_key, signer_id, signer_id_len) != 1
+		|| sm2_sign_update(&sign_ctx, tbs, tbslen) != 1
+		|| sm2_sign_finish_fixlen(&sign_ctx, siglen, sig) != 1) {
+		gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
+		error_print();
+		return -1;
+	}
+	gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
+	return 1;
+}
+
 int x509_cert_sign_to_der(
 	int version,
 	const uint8_t *serial, size_t serial_len,
@@ -1105,68 +1237,59 @@ int x509_cert_sign_to_der(
 	const SM2_KEY *sign_key, const char *signer_id, size_t signer_id_len,
 	uint8_t **out, size_t *outlen)
 {
-	size_t len = 0;
-	uint8_t *tbs;
+	int ret = -1;
+	uint8_t *buf = NULL;
+	size_t size;
+	ASN1_BUILDER builder;
+	ASN1_BUILDER *b = &builder;
+	size_t tbs_mark;
 	int sig_alg = OID_sm2sign_with_sm3;
-	uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+	uint8_t *sig;
 	size_t siglen = SM2_signature_typical_size;
 
-	if (x509_tbs_cert_to_der(
-		version,
-		serial, serial_len,
-		signature_algor,
-		issuer, issuer_len,
-		not_before, not_after,
-		subject, subject_len,
-		subject_public_key,
-		issuer_unique_id, issuer_unique_id_len,
-		subject_unique_id, subject_unique_id_len,
-		exts, exts_len,
-		NULL, &len) != 1
-		|| x509_signature_algor_to_der(sig_alg, NULL, &len) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, NULL, &len) != 1
-		|| asn1_sequence_header_to_der(len, out, outlen) != 1) {
+	size = serial_len + issuer_len + subject_len + issuer_unique_id_len
+		+ subject_unique_id_len + exts_len + X509_BUILDER_OVERHEAD;
+	if (!(buf = malloc(size))) {
 		error_print();
 		return -1;
 	}
-	if (out && *out) {
-		tbs = *out;
-	}
 
-	if (x509_tbs_cert_to_der(
-		version,
-		serial, serial_len,
-		signature_algor,
-		issuer, issuer_len,
-		not_before, not_after,
-		subject, subject_len,
-		subject_public_key,
-		issuer_unique_id, issuer_unique_id_len,
-		subject_unique_id, subject_unique_id_len,
-		exts, exts_len,
-		out, outlen) != 1) {
+	if (asn1_builder_init(b, buf, size) != 1
+		|| x509_builder_signature(b, sig_alg, siglen, &sig) != 1) {
 		error_print();
-		return -1;
+		goto end;
 	}
-
+	tbs_mark = asn1_builder_mark(b);
+	if (x509_builder_explicit_exts(b, 3, exts, exts_len) < 0
+		|| asn1_builder_implicit_bit_octets(b, 2, subject_unique_id, subject_unique_id_len) < 0
+		|| asn1_builder_implicit_bit_octets(b, 1, issuer_unique_id, issuer_unique_id_len) < 0
+		|| x509_builder_public_key_info(b, subject_public_key) != 1
+		|| asn1_builder_sequence(b, subject, subject_len) != 1
+		|| x509_builder_validity(b, not_before, not_after) != 1
+		|| asn1_builder_sequence(b, issuer, issuer_len) != 1
+		|| x509_builder_signature_algor(b, signature_algor) != 1
+		|| asn1_builder_integer(b, serial, serial_len) != 1
+		|| x509_builder_explicit_version(b, 0, version) < 0
+		|| asn1_builder_sequence_header(b, tbs_mark) != 1) {
+		error_print();
+		goto end;
+	}
+	// the length is known without the signature
 	if (out && *out) {
-		SM2_SIGN_CTX sign_ctx;
-		if (sm2_sign_init(&sign_ctx, sign_key, signer_id, signer_id_len) != 1
-			|| sm2_sign_update(&sign_ctx, tbs, *out - tbs) != 1
-			|| sm2_sign_finish_fixlen(&sign_ctx, siglen, sig) != 1) {
-			gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
+		if (x509_builder_sign(b, tbs_mark, sig, siglen, sign_key, signer_id, signer_id_len) != 1) {
 			error_print();
-			return -1;
+			goto end;
 		}
-		gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
 	}
-
-	if (x509_signature_algor_to_der(sig_alg, out, outlen) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, out, outlen) != 1) {
+	if (asn1_builder_sequence_header(b, 0) != 1
+		|| asn1_builder_to_der(b, out, outlen) != 1) {
 		error_print();
-		return -1;
+		goto end;
 	}
-	return 1;
+	ret = 1;
+end:
+	free(buf);
+	return ret;
 }
 
 int x509_signed_from_der(const uint8_t **tbs, size_t *tbslen,
@@ -1240,22 +1363,63 @@ int x509_signed_verify_by_ca_cert(const uint8_t *a, size_t alen,
 	return ret;
 }
 
+int x509_cert_view_verify_by_ca_view(const X509_CERT_VIEW *view, const X509_CERT_VIEW *ca_view,
+	const char *signer_id, size_t signer_id_len)
+{
+	uint8_t fingerprint[32];
+	int cached = 0;
+	SM2_KEY public_key;
+	SM2_SIGN_CTX verify_ctx;
+
+	if (x509_name_equ(view->issuer, view->issuer_len, ca_view->subject, ca_view->subject_len) != 1) {
+		error_print();
+		return -1;
+	}
+	if (x509_verify_cache_is_enabled() == 1) {
+		if (x509_verify_cache_fingerprint(view->cert, view->certlen, ca_view->cert, ca_view->certlen,
+			signer_id, signer_id_len, fingerprint) != 1) {
+			error_print();
+			return -1;
+		}
+		if (x509_verify_cache_lookup(fingerprint) == 1) {
+			return 1;
+		}
+		cached = 1;
+	}
+
+	if (view->signature_algor != OID_sm2sign_with_sm3) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_get_subject_public_key(ca_view, &public_key) != 1) {
+		error_print();
+		return -1;
+	}
+	if (sm2_verify_init(&verify_ctx, &public_key, signer_id, signer_id_len) != 1
+		|| sm2_verify_update(&verify_ctx, view->tbs, view->tbslen) != 1
+		|| sm2_verify_finish(&verify_ctx, view->signature, view->signature_len) != 1) {
+		error_print();
+		return -1;
+	}
+	if (cached) {
+		x509_verify_cache_add(fingerprint);
+	}
+	return 1;
+}
+
 int x509_cert_verify_by_ca_cert(const uint8_t *a, size_t alen,
 	const uint8_t *cacert, size_t cacertlen,
 	const char *signer_id, size_t signer_id_len)
 {
-	const uint8_t *issuer;
-	size_t issuer_len;
-	const uint8_t *subject;
-	size_t subject_len;
+	X509_CERT_VIEW view;
+	X509_CERT_VIEW ca_view;
 
-	if (x509_cert_get_issuer(a, alen, &issuer, &issuer_len) != 1
-		|| x509_cert_get_subject(cacert, cacertlen, &subject, &subject_len) != 1
-		|| x509_name_equ(issuer, issuer_len, subject, subject_len) != 1) {
+	if (x509_cert_view_init(&view, a, alen) != 1
+		|| x509_cert_view_init(&ca_view, cacert, cacertlen) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_signed_verify_by_ca_cert(a, alen, cacert, cacertlen, signer_id, signer_id_len) != 1) {
+	if (x509_cert_view_verify_by_ca_view(&view, &ca_view, signer_id, signer_id_len) != 1) {
 		error_print();
 		return -1;
 	}
@@ -1380,6 +1544,116 @@ int x509_cert_print(FILE *fp, int fmt, int ind, const char *label, const uint8_t
 	return 1;
 }
 
+int x509_cert_view_init(X509_CERT_VIEW *view, const uint8_t *a, size_t alen)
+{
+	const uint8_t *tbs;
+	size_t tbslen;
+	const uint8_t *d;
+	size_t dlen;
+	const uint8_t *exts;
+	size_t extslen;
+	const uint8_t *spki;
+	size_t spkilen;
+
+	if (!view || !a || !alen) {
+		error_print();
+		return -1;
+	}
+	memset(view, 0, sizeof(X509_CERT_VIEW));
+	view->cert = a;
+	view->certlen = alen;
+
+	if (x509_signed_from_der(&view->tbs, &view->tbslen, &view->signature_algor,
+			&view->signature, &view->signature_len, &a, &alen) != 1
+		|| asn1_length_is_zero(alen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	tbs = view->tbs;
+	tbslen = view->tbslen;
+	if (asn1_sequence_from_der(&d, &dlen, &tbs, &tbslen) != 1
+		|| asn1_length_is_zero(tbslen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (x509_explicit_version_from_der(0, &view->version, &d, &dlen) < 0
+		|| asn1_integer_from_der(&view->serial, &view->serial_len, &d, &dlen) != 1
+		|| x509_signature_algor_from_der(&view->inner_signature_algor, &d, &dlen) != 1
+		|| asn1_sequence_from_der(&view->issuer, &view->issuer_len, &d, &dlen) != 1
+		|| x509_validity_from_der(&view->not_before, &view->not_after, &d, &dlen) != 1
+		|| asn1_sequence_from_der(&view->subject, &view->subject_len, &d, &dlen) != 1
+		|| asn1_any_from_der(&view->subject_public_key_info, &view->subject_public_key_info_len, &d, &dlen) != 1
+		|| view->subject_public_key_info[0] != ASN1_TAG_SEQUENCE
+		|| asn1_implicit_bit_octets_from_der(1, &view->issuer_unique_id, &view->issuer_unique_id_len, &d, &dlen) < 0
+		|| asn1_implicit_bit_octets_from_der(2, &view->subject_unique_id, &view->subject_unique_id_len, &d, &dlen) < 0
+		|| x509_explicit_exts_from_der(3, &view->exts, &view->exts_len, &d, &dlen) < 0
+		|| asn1_length_is_zero(dlen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	spki = view->subject_public_key_info;
+	spkilen = view->subject_public_key_info_len;
+	if (x509_public_key_info_from_der(&view->subject_public_key, &spki, &spkilen) != 1
+		|| asn1_length_is_zero(spkilen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	exts = view->exts;
+	extslen = view->exts_len;
+	while (extslen) {
+		int oid;
+		uint32_t nodes[32];
+		size_t nodes_cnt;
+		int critical;
+		const uint8_t *val;
+		size_t vlen;
+
+		if (x509_ext_from_der(&oid, nodes, &nodes_cnt, &critical, &val, &vlen, &exts, &extslen) != 1) {
+			error_print();
+			return -1;
+		}
+		if (view->exts_cnt < X509_CERT_VIEW_MAX_EXTS) {
+			view->ext[view->exts_cnt].oid = oid;
+			view->ext[view->exts_cnt].critical = critical;
+			view->ext[view->exts_cnt].val = val;
+			view->ext[view->exts_cnt].vlen = vlen;
+		}
+		view->exts_cnt++;
+	}
+	return 1;
+}
+
+int x509_cert_view_get_subject_public_key(const X509_CERT_VIEW *view, SM2_KEY *public_key)
+{
+	*public_key = view->subject_public_key;
+	return 1;
+}
+
+int x509_cert_view_get_ext_by_oid(const X509_CERT_VIEW *view, int oid,
+	int *critical, const uint8_t **val, size_t *vlen)
+{
+	size_t i;
+
+	if (view->exts_cnt > X509_CERT_VIEW_MAX_EXTS) {
+		return x509_exts_get_ext_by_oid(view->exts, view->exts_len, oid, critical, val, vlen);
+	}
+	for (i = 0; i < view->exts_cnt; i++) {
+		if (view->ext[i].oid == oid) {
+			*critical = view->ext[i].critical;
+			*val = view->ext[i].val;
+			*vlen = view->ext[i].vlen;
+			return 1;
+		}
+	}
+	*critical = -1;
+	*val = NULL;
+	*vlen = 0;
+	return 0;
+}
+
 int x509_cert_get_details(const uint8_t *a, size_t alen,
 	int *version,
 	const uint8_t **serial_number, size_t *serial_number_len,
@@ -1413,6 +1687,8 @@ int x509_cert_get_details(const uint8_t *a, size_t alen,
 		const uint8_t *exts; size_t exts_len;
 	} tbs;
 
+	// the single field getters only need the TBSCertificate fields, the extensions are
+	// indexed by x509_cert_view_init() when a view is built
 	if (x509_signed_from_der(&tbs_a, &tbs_alen, &sig_alg, &sig, &sig_len, &a, &alen) != 1
 		|| asn1_length_is_zero(alen) != 1) {
 		error_print();
@@ -1686,76 +1962,43 @@ int x509_certs_get_cert_by_issuer_and_serial_number(const uint8_t *d, size_t dle
 	return 0;
 }
 
-int x509_cert_check(const uint8_t *cert, size_t certlen, int cert_type,
-	int *path_len_constraint)
+int x509_cert_view_check(const X509_CERT_VIEW *view, int cert_type, int *path_len_constraint)
 {
-	int version;
-	const uint8_t *serial;
-	size_t serial_len;
-	int tbs_sig_algor;
-	const uint8_t *issuer;
-	size_t issuer_len;
-	time_t not_before;
-	time_t not_after;
 	time_t now;
-	const uint8_t *subject;
-	size_t subject_len;
-	const uint8_t *exts;
-	size_t extslen;
-	int sig_algor;
-
 
-	if (x509_cert_get_details(cert, certlen,
-		&version, // version
-		&serial, &serial_len, // serial
-		&tbs_sig_algor, // signature_algor
-		&issuer, &issuer_len, // issuer
-		&not_before, &not_after, // validity
-		&subject, &subject_len, // subject
-		NULL, // subject_public_key
-		NULL, NULL, // issuer_unique_id
-		NULL, NULL, // subject_unique_id
-		&exts, &extslen, // extensions
-		&sig_algor, // signature_algor
-		NULL, NULL // signature
-		) != 1) {
+	if (view->version != X509_version_v3) {
 		error_print();
 		return -1;
 	}
-
-	if (version != X509_version_v3) {
+	if (!view->serial || !view->serial_len) {
 		error_print();
 		return -1;
 	}
-	if (!serial || !serial_len) {
-		error_print();
-		return -1;
-	}
-	if (serial_len < 4) {
+	if (view->serial_len < 4) {
 		error_print(); // not enough randomness
 	}
 
 	time(&now);
-	if (x509_validity_check(not_before, not_after, now, X509_VALIDITY_MAX_SECONDS) != 1) {
+	if (x509_validity_check(view->not_before, view->not_after, now, X509_VALIDITY_MAX_SECONDS) != 1) {
 		error_print();
 		return -1;
 	}
 
 	// check issuer and subject not empty
-	if (x509_name_check(issuer, issuer_len) != 1) {
+	if (x509_name_check(view->issuer, view->issuer_len) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_name_check(subject, subject_len) != 1) {
+	if (x509_name_check(view->subject, view->subject_len) != 1) {
 		error_print();
 		return -1;
 	}
 
-	if (x509_exts_check(exts, extslen, cert_type, path_len_constraint) != 1) {
+	if (x509_exts_check(view->exts, view->exts_len, cert_type, path_len_constraint) != 1) {
 		error_print();
 		return -1;
 	}
-	if (tbs_sig_algor != sig_algor) {
+	if (view->inner_signature_algor != view->signature_algor) {
 		error_print();
 		return -1;
 	}
@@ -1763,16 +2006,53 @@ int x509_cert_check(const uint8_t *cert, size_t certlen, int cert_type,
 	return 1;
 }
 
-int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
-	const uint8_t *rootcerts, size_t rootcertslen, int depth, int *verify_result)
+int x509_cert_check(const uint8_t *cert, size_t certlen, int cert_type,
+	int *path_len_constraint)
+{
+	X509_CERT_VIEW view;
+
+	if (x509_cert_view_init(&view, cert, certlen) != 1
+		|| x509_cert_view_check(&view, cert_type, path_len_constraint) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int x509_certs_get_root_cert(const uint8_t *rootcerts, size_t rootcertslen,
+	const X509_TRUST_STORE *store, const X509_CERT_VIEW *view, X509_CERT_VIEW *ca_view)
+{
+	int ret;
+	const uint8_t *cacert;
+	size_t cacertlen;
+
+	if (store) {
+		ret = x509_trust_store_get_issuer_cert_by_view(store, view, &cacert, &cacertlen);
+	} else {
+		ret = x509_certs_get_cert_by_subject(rootcerts, rootcertslen,
+			view->issuer, view->issuer_len, &cacert, &cacertlen);
+	}
+	if (ret != 1) {
+		if (ret < 0) error_print();
+		return ret;
+	}
+	if (x509_cert_view_init(ca_view, cacert, cacertlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+// every certificate of the chain is parsed into a view exactly once
+static int x509_certs_verify_ex(const uint8_t *certs, size_t certslen, int certs_type,
+	const uint8_t *rootcerts, size_t rootcertslen, const X509_TRUST_STORE *store,
+	int depth, int *verify_result)
 {
 	int entity_cert_type;
 	const uint8_t *cert;
 	size_t certlen;
-	const uint8_t *cacert;
-	size_t cacertlen;
-	const uint8_t *name;
-	size_t namelen;
+	X509_CERT_VIEW view;
+	X509_CERT_VIEW ca_view;
 
 	int path_len = 0;
 	int path_len_constraint;
@@ -1790,11 +2070,12 @@ int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 	}
 
 	// entity cert
-	if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1) {
+	if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+		|| x509_cert_view_init(&view, cert, certlen) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_cert_check(cert, certlen, entity_cert_type, &path_len_constraint) != 1) {
+	if (x509_cert_view_check(&view, entity_cert_type, &path_len_constraint) != 1) {
 		error_print();
 		x509_cert_print(stderr, 0, 10, "Invalid Entity Certificate", cert, certlen);
 		return -1;
@@ -1802,13 +2083,14 @@ int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 
 	while (certslen) {
 
-		if (x509_cert_from_der(&cacert, &cacertlen, &certs, &certslen) != 1) {
+		if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+			|| x509_cert_view_init(&ca_view, cert, certlen) != 1) {
 			error_print();
 			return -1;
 		}
-		if (x509_cert_check(cacert, cacertlen, X509_cert_ca, &path_len_constraint) != 1) {
+		if (x509_cert_view_check(&ca_view, X509_cert_ca, &path_len_constraint) != 1) {
 			error_print();
-			x509_cert_print(stderr, 0, 10, "Invalid CA Certificate", cacert, cacertlen);
+			x509_cert_print(stderr, 0, 10, "Invalid CA Certificate", cert, certlen);
 			return -1;
 		}
 
@@ -1824,28 +2106,22 @@ int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 			return -1;
 		}
 
-		if (x509_cert_verify_by_ca_cert(cert, certlen, cacert, cacertlen,
+		if (x509_cert_view_verify_by_ca_view(&view, &ca_view,
 			SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 			error_print();
 			return -1;
 		}
 
-		cert = cacert;
-		certlen = cacertlen;
+		view = ca_view;
 		path_len++;
 	}
 
-	if (x509_cert_get_issuer(cert, certlen, &name, &namelen) != 1) {
-		error_print();
-		return -1;
-	}
-	if (x509_certs_get_cert_by_subject(rootcerts, rootcertslen, name, namelen,
-		&cacert, &cacertlen) != 1) {
+	if (x509_certs_get_root_cert(rootcerts, rootcertslen, store, &view, &ca_view) != 1) {
 		error_print();
 		return -1;
 	}
 
-	if (x509_cert_check(cacert, cacertlen, X509_cert_ca, &path_len_constraint) != 1) {
+	if (x509_cert_view_check(&ca_view, X509_cert_ca, &path_len_constraint) != 1) {
 		error_print();
 		return -1;
 	}
@@ -1854,7 +2130,7 @@ int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 		error_print();
 		return -1;
 	}
-	if (x509_cert_verify_by_ca_cert(cert, certlen, cacert, cacertlen,
+	if (x509_cert_view_verify_by_ca_view(&view, &ca_view,
 		SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 		error_print();
 		return -1;
@@ -1863,19 +2139,35 @@ int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 	return 1;
 }
 
-int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type,
+int x509_certs_verify(const uint8_t *certs, size_t certslen, int certs_type,
 	const uint8_t *rootcerts, size_t rootcertslen, int depth, int *verify_result)
+{
+	return x509_certs_verify_ex(certs, certslen, certs_type,
+		rootcerts, rootcertslen, NULL, depth, verify_result);
+}
+
+int x509_certs_verify_by_trust_store(const uint8_t *certs, size_t certslen, int certs_type,
+	const X509_TRUST_STORE *store, int depth, int *verify_result)
+{
+	if (!store) {
+		error_print();
+		return -1;
+	}
+	return x509_certs_verify_ex(certs, certslen, certs_type,
+		NULL, 0, store, depth, verify_result);
+}
+
+static int x509_certs_verify_tlcp_ex(const uint8_t *certs, size_t certslen, int certs_type,
+	const uint8_t *rootcerts, size_t rootcertslen, const X509_TRUST_STORE *store,
+	int depth, int *verify_result)
 {
 	int sign_cert_type;
 	int kenc_cert_type;
 	const uint8_t *cert;
 	size_t certlen;
-	const uint8_t *kenc_cert;
-	size_t kenc_certlen;
-	const uint8_t *cacert;
-	size_t cacertlen;
-	const uint8_t *name;
-	size_t namelen;
+	X509_CERT_VIEW view;
+	X509_CERT_VIEW kenc_view;
+	X509_CERT_VIEW ca_view;
 
 	int path_len = 0;
 	int path_len_constraint;
@@ -1894,32 +2186,35 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 		return -1;
 	}
 
-	if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1) {
+	if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+		|| x509_cert_view_init(&view, cert, certlen) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_cert_check(cert, certlen, sign_cert_type, &path_len_constraint) != 1) {
+	if (x509_cert_view_check(&view, sign_cert_type, &path_len_constraint) != 1) {
 		error_print();
 		return -1;
 	}
 
 	// entity key encipherment cert
-	if (x509_cert_from_der(&kenc_cert, &kenc_certlen, &certs, &certslen) != 1) {
+	if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+		|| x509_cert_view_init(&kenc_view, cert, certlen) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_cert_check(kenc_cert, kenc_certlen, kenc_cert_type, &path_len_constraint) != 1) {
+	if (x509_cert_view_check(&kenc_view, kenc_cert_type, &path_len_constraint) != 1) {
 		error_print();
 		return -1;
 	}
 
 	while (certslen) {
 
-		if (x509_cert_from_der(&cacert, &cacertlen, &certs, &certslen) != 1) {
+		if (x509_cert_from_der(&cert, &certlen, &certs, &certslen) != 1
+			|| x509_cert_view_init(&ca_view, cert, certlen) != 1) {
 			error_print();
 			return -1;
 		}
-		if (x509_cert_check(cacert, cacertlen, X509_cert_ca, &path_len_constraint) != 1) {
+		if (x509_cert_view_check(&ca_view, X509_cert_ca, &path_len_constraint) != 1) {
 			error_print();
 			return -1;
 		}
@@ -1931,7 +2226,7 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 			}
 
 			// verify entity key encipherment cert
-			if (x509_cert_verify_by_ca_cert(kenc_cert, kenc_certlen, cacert, cacertlen,
+			if (x509_cert_view_verify_by_ca_view(&kenc_view, &ca_view,
 				SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 				error_print();
 				return -1;
@@ -1943,27 +2238,22 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 			return -1;
 		}
 
-		if (x509_cert_verify_by_ca_cert(cert, certlen, cacert, cacertlen,
+		if (x509_cert_view_verify_by_ca_view(&view, &ca_view,
 			SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 			error_print();
 			return -1;
 		}
 
-		cert = cacert;
-		certlen = cacertlen;
+		view = ca_view;
 		path_len++;
 	}
 
 
-	if (x509_cert_get_issuer(cert, certlen, &name, &namelen) != 1) {
-		error_print();
-		return -1;
-	}
-	if (x509_certs_get_cert_by_subject(rootcerts, rootcertslen, name, namelen, &cacert, &cacertlen) != 1) {
+	if (x509_certs_get_root_cert(rootcerts, rootcertslen, store, &view, &ca_view) != 1) {
 		error_print();
 		return -1;
 	}
-	if (x509_cert_check(cacert, cacertlen, X509_cert_ca, &path_len_constraint) != 1) {
+	if (x509_cert_view_check(&ca_view, X509_cert_ca, &path_len_constraint) != 1) {
 		error_print();
 		return -1;
 	}
@@ -1975,14 +2265,14 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 
 	// when no mid CA certs
 	if (path_len == 0) {
-		if (x509_cert_verify_by_ca_cert(kenc_cert, kenc_certlen, cacert, cacertlen,
+		if (x509_cert_view_verify_by_ca_view(&kenc_view, &ca_view,
 			SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 			error_print();
 			return -1;
 		}
 	}
 
-	if (x509_cert_verify_by_ca_cert(cert, certlen, cacert, cacertlen,
+	if (x509_cert_view_verify_by_ca_view(&view, &ca_view,
 		SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
 		error_print();
 		return -1;
@@ -1990,6 +2280,24 @@ int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type
 	return 1;
 }
 
+int x509_certs_verify_tlcp(const uint8_t *certs, size_t certslen, int certs_type,
+	const uint8_t *rootcerts, size_t rootcertslen, int depth, int *verify_result)
+{
+	return x509_certs_verify_tlcp_ex(certs, certslen, certs_type,
+		rootcerts, rootcertslen, NULL, depth, verify_result);
+}
+
+int x509_certs_verify_tlcp_by_trust_store(const uint8_t *certs, size_t certslen, int certs_type,
+	const X509_TRUST_STORE *store, int depth, int *verify_result)
+{
+	if (!store) {
+		error_print();
+		return -1;
+	}
+	return x509_certs_verify_tlcp_ex(certs, certslen, certs_type,
+		NULL, 0, store, depth, verify_result);
+}
+
 int x509_certs_print(FILE *fp, int fmt, int ind, const char *label, const uint8_t *d, size_t dlen)
 {
 	const uint8_t *p;
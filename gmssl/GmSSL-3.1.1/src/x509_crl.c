@@ -1425,51 +1425,57 @@ int x509_crl_sign_to_der(
 	const SM2_KEY *sign_key, const char *signer_id, size_t signer_id_len,
 	uint8_t **out, size_t *outlen)
 {
-	size_t len = 0;
-	uint8_t *tbs;
-	uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+	int ret = -1;
+	uint8_t *buf = NULL;
+	size_t size;
+	ASN1_BUILDER builder;
+	ASN1_BUILDER *b = &builder;
+	size_t tbs_mark;
+	uint8_t *sig;
 	size_t siglen = SM2_signature_typical_size;
 
 	if (sig_alg != OID_sm2sign_with_sm3) {
 		error_print();
 		return -1;
 	}
-
-	if (x509_tbs_crl_to_der(version, sig_alg, issuer, issuer_len,
-			this_update, next_update, revoked_certs, revoked_certs_len,
-			crl_exts, crl_exts_len, NULL, &len) != 1
-		|| x509_signature_algor_to_der(sig_alg, NULL, &len) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, NULL, &len) != 1
-		|| asn1_sequence_header_to_der(len, out, outlen) != 1) {
+	size = issuer_len + revoked_certs_len + crl_exts_len + X509_BUILDER_OVERHEAD;
+	if (!(buf = malloc(size))) {
 		error_print();
 		return -1;
 	}
-	if (out && *out) {
-		tbs = *out;
+
+	if (asn1_builder_init(b, buf, size) != 1
+		|| x509_builder_signature(b, sig_alg, siglen, &sig) != 1) {
+		error_print();
+		goto end;
 	}
-	if (x509_tbs_crl_to_der(version, sig_alg, issuer, issuer_len,
-			this_update, next_update, revoked_certs, revoked_certs_len,
-			crl_exts, crl_exts_len, out, outlen) != 1) {
+	tbs_mark = asn1_builder_mark(b);
+	if (x509_builder_explicit_exts(b, 0, crl_exts, crl_exts_len) < 0
+		|| asn1_builder_sequence(b, revoked_certs, revoked_certs_len) < 0
+		|| x509_builder_time(b, next_update) < 0
+		|| x509_builder_time(b, this_update) != 1
+		|| asn1_builder_sequence(b, issuer, issuer_len) != 1
+		|| x509_builder_signature_algor(b, sig_alg) != 1
+		|| asn1_builder_int(b, version) < 0
+		|| asn1_builder_sequence_header(b, tbs_mark) != 1) {
 		error_print();
-		return -1;
+		goto end;
 	}
 	if (out && *out) {
-		SM2_SIGN_CTX sign_ctx;
-		if (sm2_sign_init(&sign_ctx, sign_key, signer_id, signer_id_len) != 1
-			|| sm2_sign_update(&sign_ctx, tbs, *out - tbs) != 1
-			|| sm2_sign_finish_fixlen(&sign_ctx, siglen, sig) != 1) {
-			gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
+		if (x509_builder_sign(b, tbs_mark, sig, siglen, sign_key, signer_id, signer_id_len) != 1) {
 			error_print();
-			return -1;
+			goto end;
 		}
-		gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
 	}
-	if (x509_signature_algor_to_der(sig_alg, out, outlen) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, out, outlen) != 1) {
+	if (asn1_builder_sequence_header(b, 0) != 1
+		|| asn1_builder_to_der(b, out, outlen) != 1) {
 		error_print();
-		return -1;
+		goto end;
 	}
-	return 1;
+	ret = 1;
+end:
+	free(buf);
+	return ret;
 }
 
 int x509_crl_from_der_ex(
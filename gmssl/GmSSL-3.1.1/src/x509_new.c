@@ -58,30 +58,70 @@ end:
 
 int x509_certs_new_from_file(uint8_t **out, size_t *outlen, const char *file)
 {
-	int ret = -1;
-	FILE *fp = NULL;
-	size_t fsize;
 	uint8_t *buf = NULL;
 	size_t buflen;
+	const uint8_t *d;
+	size_t dlen;
+	int ret;
 
-	if (!(fp = fopen(file, "r"))
-		|| file_size(fp, &fsize) != 1
-		|| (buflen = (fsize * 3)/4 + 1) < 0
-		|| (buf = malloc((fsize * 3)/4 + 1)) == NULL) {
+	// CA bundles are decoded in one pass, then every certificate is checked
+	if ((ret = pem_blocks_new_from_file(file, "CERTIFICATE", &buf, &buflen)) < 0) {
 		error_print();
-		goto end;
+		return -1;
+	}
+	// a file without certificates is an empty list, the callers check the length
+	if (ret == 0) {
+		*out = NULL;
+		*outlen = 0;
+		return 1;
+	}
+	d = buf;
+	dlen = buflen;
+	while (dlen) {
+		const uint8_t *cert;
+		size_t certlen;
+
+		// x509_cert_from_der() already parses the certificate
+		if (x509_cert_from_der(&cert, &certlen, &d, &dlen) != 1) {
+			free(buf);
+			error_print();
+			return -1;
+		}
 	}
-	if (x509_certs_from_pem(buf, outlen, buflen, fp) != 1) {
+	*out = buf;
+	*outlen = buflen;
+	return 1;
+}
+
+int x509_crls_new_from_file(uint8_t **out, size_t *outlen, const char *file)
+{
+	uint8_t *buf = NULL;
+	size_t buflen;
+	const uint8_t *d;
+	size_t dlen;
+
+	if (pem_blocks_new_from_file(file, "X509 CRL", &buf, &buflen) != 1) {
 		error_print();
-		goto end;
+		return -1;
+	}
+	d = buf;
+	dlen = buflen;
+	while (dlen) {
+		const uint8_t *crl;
+		size_t crl_len;
+		const uint8_t *issuer;
+		size_t issuer_len;
+
+		if (x509_crl_from_der(&crl, &crl_len, &d, &dlen) != 1
+			|| x509_crl_get_issuer(crl, crl_len, &issuer, &issuer_len) != 1) {
+			free(buf);
+			error_print();
+			return -1;
+		}
 	}
 	*out = buf;
-	buf = NULL;
-	ret = 1;
-end:
-	if (fp) fclose(fp);
-	if (buf) free(buf);
-	return ret;
+	*outlen = buflen;
+	return 1;
 }
 
 int x509_req_new_from_pem(uint8_t **out, size_t *outlen, FILE *fp)
@@ -167,45 +167,55 @@ int x509_req_sign_to_der(
 	const SM2_KEY *sign_key, const char *signer_id, size_t signer_id_len,
 	uint8_t **out, size_t *outlen)
 {
-	size_t len = 0;
-	uint8_t *tbs;
+	int ret = -1;
+	uint8_t *buf = NULL;
+	size_t size;
+	ASN1_BUILDER builder;
+	ASN1_BUILDER *b = &builder;
+	size_t tbs_mark;
 	int sig_alg = OID_sm2sign_with_sm3;
-	uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+	uint8_t *sig;
 	size_t siglen = SM2_signature_typical_size;
 
-	if (x509_request_info_to_der(version, subject, subject_len, subject_public_key,
-			attrs, attrs_len, NULL, &len) != 1
-		|| x509_signature_algor_to_der(sig_alg, NULL, &len) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, NULL, &len) != 1
-		|| asn1_sequence_header_to_der(len, out, outlen) != 1) {
+	if (version != X509_version_v1) {
 		error_print();
 		return -1;
 	}
-	if (out && *out) {
-		tbs = *out;
-	}
-	if (x509_request_info_to_der(version, subject, subject_len, subject_public_key,
-			attrs, attrs_len, out, outlen) != 1) {
+	size = subject_len + attrs_len + X509_BUILDER_OVERHEAD;
+	if (!(buf = malloc(size))) {
 		error_print();
 		return -1;
 	}
+
+	if (asn1_builder_init(b, buf, size) != 1
+		|| x509_builder_signature(b, sig_alg, siglen, &sig) != 1) {
+		error_print();
+		goto end;
+	}
+	tbs_mark = asn1_builder_mark(b);
+	if (asn1_builder_implicit_set(b, 0, attrs, attrs_len) != 1
+		|| x509_builder_public_key_info(b, subject_public_key) != 1
+		|| asn1_builder_sequence(b, subject, subject_len) != 1
+		|| asn1_builder_int(b, version) != 1
+		|| asn1_builder_sequence_header(b, tbs_mark) != 1) {
+		error_print();
+		goto end;
+	}
 	if (out && *out) {
-		SM2_SIGN_CTX sign_ctx;
-		if (sm2_sign_init(&sign_ctx, sign_key, signer_id, signer_id_len) != 1
-			|| sm2_sign_update(&sign_ctx, tbs, *out - tbs) != 1
-			|| sm2_sign_finish_fixlen(&sign_ctx, siglen, sig) != 1) {
-			gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
+		if (x509_builder_sign(b, tbs_mark, sig, siglen, sign_key, signer_id, signer_id_len) != 1) {
 			error_print();
-			return -1;
+			goto end;
 		}
-		gmssl_secure_clear(&sign_ctx, sizeof(sign_ctx));
 	}
-	if (x509_signature_algor_to_der(sig_alg, out, outlen) != 1
-		|| asn1_bit_octets_to_der(sig, siglen, out, outlen) != 1) {
+	if (asn1_builder_sequence_header(b, 0) != 1
+		|| asn1_builder_to_der(b, out, outlen) != 1) {
 		error_print();
-		return -1;
+		goto end;
 	}
-	return 1;
+	ret = 1;
+end:
+	free(buf);
+	return ret;
 }
 
 int x509_req_verify(const uint8_t *a, size_t alen, const char *signer_id, size_t signer_id_len)
@@ -0,0 +1,351 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <gmssl/oid.h>
+#include <gmssl/asn1.h>
+#include <gmssl/x509_ext.h>
+#include <gmssl/x509.h>
+#include <gmssl/error.h>
+
+
+int x509_cert_view_get_subject_key_identifier(const X509_CERT_VIEW *view,
+	const uint8_t **key_id, size_t *key_id_len)
+{
+	int ret;
+	int critical;
+	const uint8_t *val;
+	size_t vlen;
+
+	*key_id = NULL;
+	*key_id_len = 0;
+
+	if ((ret = x509_cert_view_get_ext_by_oid(view, OID_ce_subject_key_identifier,
+		&critical, &val, &vlen)) != 1) {
+		if (ret < 0) error_print();
+		return ret;
+	}
+	if (asn1_octet_string_from_der(key_id, key_id_len, &val, &vlen) != 1
+		|| asn1_length_is_zero(vlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+int x509_cert_view_get_authority_key_identifier(const X509_CERT_VIEW *view,
+	const uint8_t **key_id, size_t *key_id_len)
+{
+	int ret;
+	int critical;
+	const uint8_t *val;
+	size_t vlen;
+	const uint8_t *issuer;
+	size_t issuer_len;
+	const uint8_t *serial;
+	size_t serial_len;
+
+	*key_id = NULL;
+	*key_id_len = 0;
+
+	if ((ret = x509_cert_view_get_ext_by_oid(view, OID_ce_authority_key_identifier,
+		&critical, &val, &vlen)) != 1) {
+		if (ret < 0) error_print();
+		return ret;
+	}
+	if (x509_authority_key_identifier_from_der(key_id, key_id_len,
+		&issuer, &issuer_len, &serial, &serial_len, &val, &vlen) != 1
+		|| asn1_length_is_zero(vlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (!*key_id || !*key_id_len) {
+		*key_id = NULL;
+		*key_id_len = 0;
+		return 0;
+	}
+	return 1;
+}
+
+int x509_cert_get_subject_key_identifier(const uint8_t *cert, size_t certlen,
+	const uint8_t **key_id, size_t *key_id_len)
+{
+	X509_CERT_VIEW view;
+
+	if (x509_cert_view_init(&view, cert, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return x509_cert_view_get_subject_key_identifier(&view, key_id, key_id_len);
+}
+
+int x509_cert_get_authority_key_identifier(const uint8_t *cert, size_t certlen,
+	const uint8_t **key_id, size_t *key_id_len)
+{
+	X509_CERT_VIEW view;
+
+	if (x509_cert_view_init(&view, cert, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return x509_cert_view_get_authority_key_identifier(&view, key_id, key_id_len);
+}
+
+// FNV-1a, names and key identifiers are compared byte by byte
+static size_t trust_store_hash(const uint8_t *d, size_t dlen, size_t table_size)
+{
+	uint32_t h = 2166136261u;
+	while (dlen--) {
+		h ^= *d++;
+		h *= 16777619u;
+	}
+	return h & (table_size - 1);
+}
+
+int x509_trust_store_init(X509_TRUST_STORE *store, const uint8_t *certs, size_t certslen)
+{
+	const uint8_t *p;
+	size_t len;
+	const uint8_t *cert;
+	size_t certlen;
+	size_t cnt = 0;
+	size_t i;
+
+	if (!store || !certs || !certslen) {
+		error_print();
+		return -1;
+	}
+	memset(store, 0, sizeof(X509_TRUST_STORE));
+
+	// first pass: count and check all certificates
+	p = certs;
+	len = certslen;
+	while (len) {
+		if (x509_cert_from_der(&cert, &certlen, &p, &len) != 1) {
+			error_print();
+			return -1;
+		}
+		cnt++;
+	}
+	if (cnt > INT32_MAX) {
+		error_print();
+		return -1;
+	}
+
+	store->table_size = 16;
+	while (store->table_size < cnt * 2) {
+		store->table_size *= 2;
+	}
+	if (!(store->certs = malloc(certslen))
+		|| !(store->anchors = calloc(cnt, sizeof(X509_TRUST_ANCHOR)))
+		|| !(store->subject_table = malloc(sizeof(int) * store->table_size))
+		|| !(store->key_id_table = malloc(sizeof(int) * store->table_size))) {
+		x509_trust_store_cleanup(store);
+		error_print();
+		return -1;
+	}
+	memcpy(store->certs, certs, certslen);
+	store->certslen = certslen;
+	for (i = 0; i < store->table_size; i++) {
+		store->subject_table[i] = -1;
+		store->key_id_table[i] = -1;
+	}
+
+	// second pass: record offsets into the arena and build the indexes
+	p = store->certs;
+	len = store->certslen;
+	for (i = 0; i < cnt; i++) {
+		X509_TRUST_ANCHOR *anchor = &store->anchors[i];
+		X509_CERT_VIEW view;
+		size_t h;
+
+		if (x509_cert_from_der(&anchor->cert, &anchor->certlen, &p, &len) != 1
+			|| x509_cert_view_init(&view, anchor->cert, anchor->certlen) != 1
+			|| x509_cert_view_get_subject_key_identifier(&view,
+				&anchor->key_id, &anchor->key_id_len) < 0) {
+			x509_trust_store_cleanup(store);
+			error_print();
+			return -1;
+		}
+		anchor->subject = view.subject;
+		anchor->subject_len = view.subject_len;
+
+		h = trust_store_hash(anchor->subject, anchor->subject_len, store->table_size);
+		anchor->subject_next = store->subject_table[h];
+		store->subject_table[h] = (int)i;
+
+		anchor->key_id_next = -1;
+		if (anchor->key_id) {
+			h = trust_store_hash(anchor->key_id, anchor->key_id_len, store->table_size);
+			anchor->key_id_next = store->key_id_table[h];
+			store->key_id_table[h] = (int)i;
+		}
+	}
+	store->anchors_cnt = cnt;
+	return 1;
+}
+
+int x509_trust_store_init_from_file(X509_TRUST_STORE *store, const char *file)
+{
+	uint8_t *certs = NULL;
+	size_t certslen;
+	int ret;
+
+	if (!store || !file) {
+		error_print();
+		return -1;
+	}
+	if (x509_certs_new_from_file(&certs, &certslen, file) != 1) {
+		error_print();
+		return -1;
+	}
+	ret = x509_trust_store_init(store, certs, certslen);
+	free(certs);
+	if (ret != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+void x509_trust_store_cleanup(X509_TRUST_STORE *store)
+{
+	if (store) {
+		if (store->certs) free(store->certs);
+		if (store->anchors) free(store->anchors);
+		if (store->subject_table) free(store->subject_table);
+		if (store->key_id_table) free(store->key_id_table);
+		memset(store, 0, sizeof(X509_TRUST_STORE));
+	}
+}
+
+// the most recently added matching anchor is returned first
+static int trust_store_find(const X509_TRUST_STORE *store,
+	const uint8_t *subject, size_t subject_len,
+	const uint8_t *key_id, size_t key_id_len)
+{
+	int i;
+
+	if (key_id && key_id_len) {
+		i = store->key_id_table[trust_store_hash(key_id, key_id_len, store->table_size)];
+		for (; i >= 0; i = store->anchors[i].key_id_next) {
+			const X509_TRUST_ANCHOR *anchor = &store->anchors[i];
+			if (anchor->key_id_len == key_id_len
+				&& memcmp(anchor->key_id, key_id, key_id_len) == 0
+				&& (!subject || x509_name_equ(anchor->subject, anchor->subject_len,
+					subject, subject_len) == 1)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	i = store->subject_table[trust_store_hash(subject, subject_len, store->table_size)];
+	for (; i >= 0; i = store->anchors[i].subject_next) {
+		const X509_TRUST_ANCHOR *anchor = &store->anchors[i];
+		if (x509_name_equ(anchor->subject, anchor->subject_len, subject, subject_len) == 1) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int x509_trust_store_get_cert_by_subject(const X509_TRUST_STORE *store,
+	const uint8_t *subject, size_t subject_len,
+	const uint8_t **cert, size_t *certlen)
+{
+	int i;
+
+	if (!store || !store->anchors || !subject || !subject_len || !cert || !certlen) {
+		error_print();
+		return -1;
+	}
+	if ((i = trust_store_find(store, subject, subject_len, NULL, 0)) < 0) {
+		*cert = NULL;
+		*certlen = 0;
+		return 0;
+	}
+	*cert = store->anchors[i].cert;
+	*certlen = store->anchors[i].certlen;
+	return 1;
+}
+
+int x509_trust_store_get_cert_by_key_identifier(const X509_TRUST_STORE *store,
+	const uint8_t *key_id, size_t key_id_len,
+	const uint8_t **cert, size_t *certlen)
+{
+	int i;
+
+	if (!store || !store->anchors || !key_id || !key_id_len || !cert || !certlen) {
+		error_print();
+		return -1;
+	}
+	if ((i = trust_store_find(store, NULL, 0, key_id, key_id_len)) < 0) {
+		*cert = NULL;
+		*certlen = 0;
+		return 0;
+	}
+	*cert = store->anchors[i].cert;
+	*certlen = store->anchors[i].certlen;
+	return 1;
+}
+
+int x509_trust_store_get_issuer_cert_by_view(const X509_TRUST_STORE *store,
+	const X509_CERT_VIEW *view,
+	const uint8_t **cacert, size_t *cacertlen)
+{
+	const uint8_t *key_id;
+	size_t key_id_len;
+	int i = -1;
+
+	if (!store || !store->anchors || !view || !cacert || !cacertlen) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_get_authority_key_identifier(view, &key_id, &key_id_len) < 0) {
+		error_print();
+		return -1;
+	}
+	if (key_id) {
+		i = trust_store_find(store, view->issuer, view->issuer_len, key_id, key_id_len);
+	}
+	// CA certificates without SubjectKeyIdentifier are only reachable by name
+	if (i < 0) {
+		i = trust_store_find(store, view->issuer, view->issuer_len, NULL, 0);
+	}
+	if (i < 0) {
+		*cacert = NULL;
+		*cacertlen = 0;
+		return 0;
+	}
+	*cacert = store->anchors[i].cert;
+	*cacertlen = store->anchors[i].certlen;
+	return 1;
+}
+
+int x509_trust_store_get_issuer_cert(const X509_TRUST_STORE *store,
+	const uint8_t *cert, size_t certlen,
+	const uint8_t **cacert, size_t *cacertlen)
+{
+	X509_CERT_VIEW view;
+
+	if (!cert || !certlen) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_init(&view, cert, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return x509_trust_store_get_issuer_cert_by_view(store, &view, cacert, cacertlen);
+}
@@ -375,11 +375,111 @@ static int test_aead_sm4_gcm(void)
 	return 1;
 }
 
+static int test_aead_sm4_gcm_threads(void)
+{
+	SM4_KEY sm4_key;
+	SM4_GCM_CTX aead_ctx;
+	uint8_t key[16];
+	uint8_t iv[12];
+	uint8_t aad[29];
+	size_t mlen = 1000007;
+	uint8_t *plain = NULL;
+	uint8_t *cipher = NULL;
+	uint8_t *tmp = NULL;
+	uint8_t *buf = NULL;
+	size_t lens[] = { 3, 250000, 16, 1, 600000 };
+	size_t cipherlen, buflen, inlen, outlen, off, i;
+	int ret = -1;
+
+	rand_bytes(key, sizeof(key));
+	rand_bytes(iv, sizeof(iv));
+	rand_bytes(aad, sizeof(aad));
+
+	if (!(plain = malloc(mlen)) || !(cipher = malloc(mlen + 32))
+		|| !(tmp = malloc(mlen + GHASH_SIZE)) || !(buf = malloc(mlen + 32))) {
+		error_print();
+		goto end;
+	}
+	rand_bytes(plain, mlen);
+
+	sm4_set_encrypt_key(&sm4_key, key);
+	if (sm4_gcm_encrypt(&sm4_key, iv, sizeof(iv), aad, sizeof(aad), plain, mlen,
+		tmp, GHASH_SIZE, tmp + mlen) != 1) {
+		error_print();
+		goto end;
+	}
+
+	if (sm4_gcm_encrypt_init(&aead_ctx, key, sizeof(key), iv, sizeof(iv), aad, sizeof(aad), GHASH_SIZE) != 1) {
+		error_print();
+		goto end;
+	}
+	for (cipherlen = 0, off = 0, i = 0; off < mlen; off += inlen, i++) {
+		inlen = mlen - off < lens[i % 5] ? mlen - off : lens[i % 5];
+		if (sm4_gcm_encrypt_update_threads(&aead_ctx, plain + off, inlen, cipher + cipherlen, &outlen, 4) != 1) {
+			error_print();
+			goto end;
+		}
+		cipherlen += outlen;
+	}
+	if (sm4_gcm_encrypt_finish(&aead_ctx, cipher + cipherlen, &outlen) != 1) {
+		error_print();
+		goto end;
+	}
+	cipherlen += outlen;
+	if (cipherlen != mlen + GHASH_SIZE
+		|| memcmp(cipher, tmp, cipherlen) != 0) {
+		error_print();
+		goto end;
+	}
+
+	if (sm4_gcm_decrypt_init(&aead_ctx, key, sizeof(key), iv, sizeof(iv), aad, sizeof(aad), GHASH_SIZE) != 1) {
+		error_print();
+		goto end;
+	}
+	for (buflen = 0, off = 0, i = 4; off < cipherlen; off += inlen, i++) {
+		inlen = cipherlen - off < lens[i % 5] ? cipherlen - off : lens[i % 5];
+		if (sm4_gcm_decrypt_update_threads(&aead_ctx, cipher + off, inlen, buf + buflen, &outlen, 3) != 1) {
+			error_print();
+			goto end;
+		}
+		buflen += outlen;
+	}
+	if (sm4_gcm_decrypt_finish(&aead_ctx, buf + buflen, &outlen) != 1) {
+		error_print();
+		goto end;
+	}
+	buflen += outlen;
+	if (buflen != mlen || memcmp(buf, plain, mlen) != 0) {
+		error_print();
+		goto end;
+	}
+
+	// a modified ciphertext is rejected
+	cipher[mlen / 2] ^= 1;
+	if (sm4_gcm_decrypt_init(&aead_ctx, key, sizeof(key), iv, sizeof(iv), aad, sizeof(aad), GHASH_SIZE) != 1
+		|| sm4_gcm_decrypt_update_threads(&aead_ctx, cipher, cipherlen, buf, &outlen, 4) != 1
+		|| sm4_gcm_decrypt_finish(&aead_ctx, buf + outlen, &outlen) == 1) {
+		error_print();
+		goto end;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (plain) free(plain);
+	if (cipher) free(cipher);
+	if (tmp) free(tmp);
+	if (buf) free(buf);
+	return ret;
+}
+
+
 int main(void)
 {
 	if (test_aead_sm4_cbc_sm3_hmac() != 1) { error_print(); return -1; }
 	if (test_aead_sm4_ctr_sm3_hmac() != 1) { error_print(); return -1; }
 	if (test_aead_sm4_gcm() != 1) { error_print(); return -1; }
+	if (test_aead_sm4_gcm_threads() != 1) { error_print(); return -1; }
 	printf("%s all tests passed!\n", __FILE__);
 	return 0;
 }
@@ -803,6 +803,112 @@ static int test_asn1_from_der_null_args(void)
 	return 1;
 }
 
+static int test_asn1_builder(void)
+{
+	int ints[] = { 0, 1, 127, 128, 65535, 1<<30 };
+	uint8_t integer[] = { 0x00, 0x00, 0x80, 0x01 };
+	size_t dlens[] = { 0, 1, 127, 128, 255, 256, 65536 };
+	uint8_t *d = NULL;
+	uint8_t *buf = NULL;
+	uint8_t *der = NULL;
+	uint8_t *p;
+	size_t len, derlen, i, j;
+	ASN1_BUILDER b;
+	size_t mark;
+	uint8_t small[4];
+	int ret = -1;
+
+	if (!(d = malloc(65536)) || !(buf = malloc(65536 * 2 + 256)) || !(der = malloc(65536 * 2 + 256))) {
+		error_print();
+		goto end;
+	}
+	for (i = 0; i < 65536; i++) {
+		d[i] = (uint8_t)i;
+	}
+
+	for (i = 0; i < sizeof(dlens)/sizeof(dlens[0]); i++) {
+		// SEQUENCE { [0] EXPLICIT INTEGER, INTEGER..., INTEGER, BIT STRING, OCTETS }
+		len = 0;
+		for (j = 0; j < sizeof(ints)/sizeof(ints[0]); j++) {
+			if (asn1_int_to_der(ints[j], NULL, &len) != 1) goto end;
+		}
+		if (asn1_explicit_header_to_der(0, 3, NULL, &len) != 1
+			|| asn1_int_to_der(2, NULL, &len) != 1
+			|| asn1_integer_to_der(integer, sizeof(integer), NULL, &len) != 1
+			|| asn1_bit_octets_to_der(d, dlens[i], NULL, &len) != 1
+			|| asn1_type_to_der(ASN1_TAG_OCTET_STRING, d, dlens[i], NULL, &len) != 1) {
+			error_print();
+			goto end;
+		}
+		p = der;
+		derlen = 0;
+		if (asn1_sequence_header_to_der(len, &p, &derlen) != 1
+			|| asn1_explicit_header_to_der(0, 3, &p, &derlen) != 1
+			|| asn1_int_to_der(2, &p, &derlen) != 1) {
+			error_print();
+			goto end;
+		}
+		for (j = 0; j < sizeof(ints)/sizeof(ints[0]); j++) {
+			if (asn1_int_to_der(ints[j], &p, &derlen) != 1) goto end;
+		}
+		if (asn1_integer_to_der(integer, sizeof(integer), &p, &derlen) != 1
+			|| asn1_bit_octets_to_der(d, dlens[i], &p, &derlen) != 1
+			|| asn1_type_to_der(ASN1_TAG_OCTET_STRING, d, dlens[i], &p, &derlen) != 1) {
+			error_print();
+			goto end;
+		}
+
+		if (asn1_builder_init(&b, buf, 65536 * 2 + 256) != 1
+			|| asn1_builder_type(&b, ASN1_TAG_OCTET_STRING, d, dlens[i]) != 1
+			|| asn1_builder_bit_octets(&b, d, dlens[i]) != 1
+			|| asn1_builder_integer(&b, integer, sizeof(integer)) != 1) {
+			error_print();
+			goto end;
+		}
+		for (j = sizeof(ints)/sizeof(ints[0]); j > 0; j--) {
+			if (asn1_builder_int(&b, ints[j - 1]) != 1) goto end;
+		}
+		mark = asn1_builder_mark(&b);
+		if (asn1_builder_int(&b, 2) != 1
+			|| asn1_builder_explicit_header(&b, 0, mark) != 1
+			|| asn1_builder_sequence_header(&b, 0) != 1) {
+			error_print();
+			goto end;
+		}
+		if (asn1_builder_int(&b, -1) != 0
+			|| asn1_builder_type(&b, ASN1_TAG_SEQUENCE, NULL, 0) != 0) {
+			error_print();
+			goto end;
+		}
+
+		len = 0;
+		if (asn1_builder_to_der(&b, NULL, &len) != 1
+			|| len != derlen
+			|| memcmp(asn1_builder_get_data(&b, 0, &len), der, derlen) != 0) {
+			error_print();
+			goto end;
+		}
+	}
+
+	// the arena is never overrun
+	if (asn1_builder_init(&b, small, sizeof(small)) != 1
+		|| asn1_builder_data(&b, d, 4) != 1
+		|| asn1_builder_data(&b, d, 1) != -1
+		|| asn1_builder_sequence_header(&b, 0) != -1
+		|| b.len != sizeof(small)) {
+		error_print();
+		goto end;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (d) free(d);
+	if (buf) free(buf);
+	if (der) free(der);
+	return ret;
+}
+
 int main(void)
 {
 	if (test_asn1_tag() != 1) goto err;
@@ -821,6 +927,7 @@ int main(void)
 	if (test_asn1_utc_time() != 1) goto err;
 	if (test_asn1_generalized_time() != 1) goto err;
 	if (test_asn1_from_der_null_args() != 1) goto err;
+	if (test_asn1_builder() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
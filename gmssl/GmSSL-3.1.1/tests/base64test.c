@@ -61,9 +61,85 @@ static int test_base64(void)
 	return 1;
 }
 
+static int test_base64_decode(void)
+{
+	uint8_t bin[300];
+	uint8_t text[BASE64_ENCODE_LENGTH(300)];
+	uint8_t crlf[BASE64_ENCODE_LENGTH(300) * 2];
+	uint8_t buf[300];
+	size_t buflen;
+	size_t textlen, crlflen;
+	BASE64_CTX ctx;
+	int len, i;
+	size_t binlen, j;
+	char *bad[] = {
+		"QUJD*",	// invalid char
+		"QUI=QUJD",	// data after padding
+		"QUJ",		// incomplete
+		"QQ===",	// too many padding
+		"Q===",
+	};
+
+	for (i = 0; i < (int)sizeof(bin); i++) {
+		bin[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	// all the lengths, so every SIMD chunk and scalar tail is covered
+	for (binlen = 0; binlen <= sizeof(bin); binlen++) {
+		base64_encode_init(&ctx);
+		base64_encode_update(&ctx, bin, (int)binlen, text, &len);
+		textlen = len;
+		base64_encode_finish(&ctx, text + textlen, &len);
+		textlen += len;
+
+		if (base64_decode(text, textlen, buf, &buflen) != 1
+			|| buflen != binlen
+			|| memcmp(buf, bin, binlen) != 0) {
+			error_print();
+			return -1;
+		}
+
+		crlflen = 0;
+		for (j = 0; j < textlen; j++) {
+			if (text[j] == '\n') {
+				crlf[crlflen++] = '\r';
+			}
+			crlf[crlflen++] = text[j];
+		}
+		if (base64_decode(crlf, crlflen, buf, &buflen) != 1
+			|| buflen != binlen
+			|| memcmp(buf, bin, binlen) != 0) {
+			error_print();
+			return -1;
+		}
+
+		// the streaming decoder
+		base64_decode_init(&ctx);
+		base64_decode_update(&ctx, text, (int)textlen, buf, &len);
+		buflen = len;
+		base64_decode_finish(&ctx, buf + buflen, &len);
+		buflen += len;
+		if (buflen != binlen || memcmp(buf, bin, binlen) != 0) {
+			error_print();
+			return -1;
+		}
+	}
+
+	for (i = 0; i < (int)(sizeof(bad)/sizeof(bad[0])); i++) {
+		if (base64_decode((uint8_t *)bad[i], strlen(bad[i]), buf, &buflen) != -1) {
+			error_print();
+			return -1;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(void)
 {
 	if (test_base64() != 1) goto err;
+	if (test_base64_decode() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
@@ -978,6 +978,282 @@ static int test_cms_key_agreement_info(void)
 	return 1;
 }
 
+static int gen_self_signed_cert(SM2_KEY *sm2_key, uint8_t *cert, size_t *certlen)
+{
+	uint8_t serial[20];
+	uint8_t name[256];
+	size_t namelen = 0;
+	time_t not_before, not_after;
+	uint8_t *p = cert;
+
+	*certlen = 0;
+	if (sm2_key_generate(sm2_key) != 1
+		|| rand_bytes(serial, sizeof(serial)) != 1
+		|| x509_name_set(name, &namelen, sizeof(name), "CN", "Beijing", "Haidian", "PKU", "CS", "Alice") != 1
+		|| time(&not_before) == -1
+		|| x509_validity_add_days(&not_after, not_before, 365) != 1
+		|| x509_cert_sign_to_der(
+			X509_version_v3,
+			serial, sizeof(serial),
+			OID_sm2sign_with_sm3,
+			name, namelen,
+			not_before, not_after,
+			name, namelen,
+			sm2_key, NULL, 0, NULL, 0, NULL, 0,
+			sm2_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH,
+			&p, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int test_cms_sign_stream(void)
+{
+	SM2_KEY sm2_key;
+	uint8_t cert[1024];
+	size_t certlen;
+	CMS_CERTS_AND_KEY signers[1];
+	uint8_t data[1000];
+	uint8_t cms[4096];
+	size_t cmslen;
+	size_t len;
+	CMS_SIGN_CTX sign_ctx;
+	CMS_VERIFY_CTX verify_ctx;
+	uint8_t content[sizeof(data)];
+	size_t content_len;
+	int content_type;
+	const uint8_t *pcontent;
+	const uint8_t *d;
+	size_t dlen;
+	const uint8_t *certs;
+	size_t certs_len;
+	const uint8_t *crls;
+	size_t crls_len;
+	const uint8_t *signer_infos;
+	size_t signer_infos_len;
+	size_t chunks[] = { 1, 7, 64, 0, 333, 4096 };
+	size_t i, off;
+
+	if (gen_self_signed_cert(&sm2_key, cert, &certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	signers[0].certs = cert;
+	signers[0].certs_len = certlen;
+	signers[0].sign_key = &sm2_key;
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = (uint8_t)i;
+	}
+
+	// streaming sign, verified by cms_verify()
+	if (cms_sign_init(&sign_ctx, signers, 1, NULL, 0, sizeof(data), cms, &cmslen) != 1) {
+		error_print();
+		return -1;
+	}
+	memcpy(cms + cmslen, data, sizeof(data));
+	cmslen += sizeof(data);
+	if (cms_sign_update(&sign_ctx, data, 100) != 1
+		|| cms_sign_update(&sign_ctx, data + 100, sizeof(data) - 100) != 1
+		|| cms_sign_finish(&sign_ctx, NULL, &len) != 1
+		|| cms_sign_finish(&sign_ctx, cms + cmslen, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	cmslen += len;
+	if (cms_verify(cms, cmslen, NULL, 0, NULL, 0,
+			&content_type, &pcontent, &content_len,
+			&certs, &certs_len, &crls, &crls_len,
+			&signer_infos, &signer_infos_len) != 1
+		|| content_type != OID_cms_data
+		|| asn1_octet_string_from_der(&d, &dlen, &pcontent, &content_len) != 1
+		|| asn1_length_is_zero(content_len) != 1
+		|| dlen != sizeof(data)
+		|| memcmp(d, data, sizeof(data)) != 0) {
+		error_print();
+		return -1;
+	}
+
+	// cms_sign() output, verified in chunks of different sizes
+	if (cms_sign(cms, &cmslen, signers, 1, OID_cms_data, data, sizeof(data), NULL, 0) != 1
+		|| cms_verify_init(&verify_ctx) != 1) {
+		error_print();
+		return -1;
+	}
+	content_len = 0;
+	for (i = off = 0; off < cmslen; i = (i + 1) % (sizeof(chunks)/sizeof(chunks[0]))) {
+		len = chunks[i] < cmslen - off ? chunks[i] : cmslen - off;
+		if (cms_verify_update(&verify_ctx, cms + off, len, content + content_len, &len) != 1) {
+			error_print();
+			return -1;
+		}
+		off += chunks[i] < cmslen - off ? chunks[i] : cmslen - off;
+		content_len += len;
+	}
+	if (cms_verify_finish(&verify_ctx) != 1
+		|| content_len != sizeof(data)
+		|| memcmp(content, data, sizeof(data)) != 0) {
+		error_print();
+		return -1;
+	}
+
+	// tampered content
+	cms[cmslen - 200] ^= 1;
+	if (cms_verify_init(&verify_ctx) != 1
+		|| cms_verify_update(&verify_ctx, cms, cmslen, NULL, &len) != 1
+		|| cms_verify_finish(&verify_ctx) == 1) {
+		error_print();
+		return -1;
+	}
+
+	// detached
+	if (cms_sign_detached_init(&sign_ctx, signers, 1, NULL, 0) != 1
+		|| cms_sign_update(&sign_ctx, data, 10) != 1
+		|| cms_sign_update(&sign_ctx, data + 10, sizeof(data) - 10) != 1
+		|| cms_sign_finish(&sign_ctx, NULL, &len) != 1
+		|| cms_sign_finish(&sign_ctx, cms, &cmslen) != 1
+		|| cmslen != len) {
+		error_print();
+		return -1;
+	}
+	if (cms_verify_detached_init(&verify_ctx, cms, cmslen) != 1
+		|| cms_verify_detached_update(&verify_ctx, data, 500) != 1
+		|| cms_verify_detached_update(&verify_ctx, data + 500, sizeof(data) - 500) != 1
+		|| cms_verify_finish(&verify_ctx) != 1) {
+		error_print();
+		return -1;
+	}
+	if (cms_verify_detached_init(&verify_ctx, cms, cmslen) != 1
+		|| cms_verify_detached_update(&verify_ctx, data, sizeof(data) - 1) != 1
+		|| cms_verify_finish(&verify_ctx) == 1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int cms_deenvelop_stream(const uint8_t *cms, size_t cmslen, size_t chunk,
+	const SM2_KEY *sm2_key, const uint8_t *cert, size_t certlen,
+	uint8_t *content, size_t *content_len)
+{
+	CMS_DEENVELOP_CTX ctx;
+	size_t len;
+
+	*content_len = 0;
+	if (cms_deenvelop_init(&ctx, sm2_key, cert, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	while (cmslen) {
+		size_t inlen = chunk < cmslen ? chunk : cmslen;
+		if (cms_deenvelop_update(&ctx, cms, inlen, content + *content_len, &len) != 1) {
+			error_print();
+			return -1;
+		}
+		*content_len += len;
+		cms += inlen;
+		cmslen -= inlen;
+	}
+	if (cms_deenvelop_finish(&ctx, content + *content_len, &len) != 1) {
+		error_print();
+		return -1;
+	}
+	*content_len += len;
+	return 1;
+}
+
+static int test_cms_envelop_stream(void)
+{
+	SM2_KEY sm2_key;
+	uint8_t cert[1024];
+	size_t certlen;
+	uint8_t key[16];
+	uint8_t iv[16];
+	uint8_t data[1000];
+	uint8_t shared_info[] = "shared info";
+	uint8_t cms[4096];
+	size_t cmslen;
+	size_t len;
+	CMS_ENVELOP_CTX ctx;
+	uint8_t content[sizeof(data) + SM4_BLOCK_SIZE];
+	size_t content_len;
+	int content_type;
+	const uint8_t *rcpt_infos;
+	size_t rcpt_infos_len;
+	const uint8_t *shared_info1;
+	size_t shared_info1_len;
+	const uint8_t *shared_info2;
+	size_t shared_info2_len;
+	size_t chunks[] = { 1, 5, 17, 512, 4096 };
+	size_t i, j;
+
+	if (gen_self_signed_cert(&sm2_key, cert, &certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	rand_bytes(key, sizeof(key));
+	rand_bytes(iv, sizeof(iv));
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = (uint8_t)i;
+	}
+
+	for (i = 0; i < 2; i++) {
+		size_t content_size = i ? CMS_CONTENT_LENGTH_UNKNOWN : sizeof(data);
+
+		if (cms_envelop_init(&ctx, cert, certlen, OID_sm4_cbc, key, sizeof(key), iv, sizeof(iv),
+				content_size, NULL, 0, shared_info, sizeof(shared_info),
+				cms, &cmslen) != 1
+			|| cms_envelop_update(&ctx, data, 3, cms + cmslen, &len) != 1
+			|| (cmslen += len) == 0
+			|| cms_envelop_update(&ctx, data + 3, 300, cms + cmslen, &len) != 1
+			|| (cmslen += len) == 0
+			|| cms_envelop_update(&ctx, data + 303, sizeof(data) - 303, cms + cmslen, &len) != 1
+			|| (cmslen += len) == 0
+			|| cms_envelop_finish(&ctx, cms + cmslen, &len) != 1) {
+			error_print();
+			return -1;
+		}
+		cmslen += len;
+
+		// DER output is accepted by cms_deenvelop()
+		if (!i) {
+			if (cms_deenvelop(cms, cmslen, &sm2_key, cert, certlen,
+					&content_type, content, &content_len,
+					&rcpt_infos, &rcpt_infos_len,
+					&shared_info1, &shared_info1_len,
+					&shared_info2, &shared_info2_len) != 1
+				|| content_type != OID_cms_data
+				|| content_len != sizeof(data)
+				|| memcmp(content, data, sizeof(data)) != 0) {
+				error_print();
+				return -1;
+			}
+		}
+
+		for (j = 0; j < sizeof(chunks)/sizeof(chunks[0]); j++) {
+			if (cms_deenvelop_stream(cms, cmslen, chunks[j], &sm2_key, cert, certlen,
+					content, &content_len) != 1
+				|| content_len != sizeof(data)
+				|| memcmp(content, data, sizeof(data)) != 0) {
+				error_print();
+				return -1;
+			}
+		}
+
+		// truncated input
+		if (cms_deenvelop_stream(cms, cmslen - 1, 64, &sm2_key, cert, certlen,
+				content, &content_len) == 1) {
+			error_print();
+			return -1;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(int argc, char **argv)
 {
 	if (test_cms_content_type() != 1) goto err;
@@ -993,6 +1269,8 @@ int main(int argc, char **argv)
 	if (test_cms_recipient_info() != 1) goto err;
 	if (test_cms_enveloped_data() != 1) goto err;
 	if (test_cms_key_agreement_info() != 1) goto err;
+	if (test_cms_sign_stream() != 1) goto err;
+	if (test_cms_envelop_stream() != 1) goto err;
 
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
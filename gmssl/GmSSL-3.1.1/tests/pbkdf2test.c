@@ -130,9 +130,134 @@ static int test_pbkdf2_genkey(void)
 	return 0;
 }
 
+struct {
+	char *pass;
+	char *salt;
+	int iter;
+	int dklen;
+	char *dk;
+} pbkdf2_hmac_sm3_tests[] = {
+	{
+		"password",
+		"salt",
+		1,
+		32,
+		"4612f922a1fdcefaf4312fc6f8f3322b489cbf24f2ea361b44c2bd8fa2c6dcb0",
+	},
+	{
+		"password",
+		"salt",
+		2,
+		32,
+		"fee723a2bc966e11dffb66133f4e8df577383c78ade30e3298edbd3e54ed85b7",
+	},
+	{
+		"password",
+		"salt",
+		4096,
+		32,
+		"b6e8f2074c87432b78f62e5ced980fdff89e86af2f693dab1638e2b3683045dd",
+	},
+	{
+		"passwordPASSWORDpassword",
+		"saltSALTsaltSALTsaltSALTsaltSALTsalt",
+		4096,
+		40,
+		"3b6282ac8519f059e465abff0ea37b0dbfe6c672a76e6b805312d53900db630732ccc1a88fa5512a",
+	},
+	{
+		// password longer than the block size
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789",
+		"salt",
+		10000,
+		16,
+		"965d3f256c52ef3cca5376e5d465bfe7",
+	},
+};
+
+static int test_pbkdf2_hmac_sm3_genkey(void)
+{
+	int i;
+	uint8_t key[64];
+	uint8_t buf[64];
+	size_t len;
+
+	for (i = 0; i < sizeof(pbkdf2_hmac_sm3_tests)/sizeof(pbkdf2_hmac_sm3_tests[0]); i++) {
+		hex_to_bytes(pbkdf2_hmac_sm3_tests[i].dk, strlen(pbkdf2_hmac_sm3_tests[i].dk), buf, &len);
+
+		if (pbkdf2_hmac_sm3_genkey(
+			pbkdf2_hmac_sm3_tests[i].pass, strlen(pbkdf2_hmac_sm3_tests[i].pass),
+			(uint8_t *)pbkdf2_hmac_sm3_tests[i].salt, strlen(pbkdf2_hmac_sm3_tests[i].salt),
+			pbkdf2_hmac_sm3_tests[i].iter, pbkdf2_hmac_sm3_tests[i].dklen, key) != 1) {
+			error_print();
+			return -1;
+		}
+		if (memcmp(key, buf, pbkdf2_hmac_sm3_tests[i].dklen) != 0) {
+			error_print();
+			return -1;
+		}
+		// the generic implementation with DIGEST_sm3()
+		memset(key, 0, sizeof(key));
+		if (pbkdf2_genkey(DIGEST_sm3(),
+			pbkdf2_hmac_sm3_tests[i].pass, strlen(pbkdf2_hmac_sm3_tests[i].pass),
+			(uint8_t *)pbkdf2_hmac_sm3_tests[i].salt, strlen(pbkdf2_hmac_sm3_tests[i].salt),
+			pbkdf2_hmac_sm3_tests[i].iter, pbkdf2_hmac_sm3_tests[i].dklen, key) != 1
+			|| memcmp(key, buf, pbkdf2_hmac_sm3_tests[i].dklen) != 0) {
+			error_print();
+			return -1;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_pbkdf2_hmac_sm3_genkey_batch(void)
+{
+	char passbuf[11][80];
+	const char *pass[11];
+	size_t passlen[11];
+	uint8_t saltbuf[11][16];
+	const uint8_t *salt[11];
+	size_t saltlen[11];
+	size_t iter = 100;
+	uint8_t out[11][70];
+	uint8_t key[70];
+	size_t count, i;
+
+	for (i = 0; i < 11; i++) {
+		passlen[i] = i * 7 + 1; // up to 71 bytes, longer than the block size
+		memset(passbuf[i], 'a' + (int)i, passlen[i]);
+		pass[i] = passbuf[i];
+		saltlen[i] = i + 1;
+		memset(saltbuf[i], (int)i, saltlen[i]);
+		salt[i] = saltbuf[i];
+	}
+
+	// full and partial lane groups, 3 blocks for every key
+	for (count = 1; count <= 11; count += 5) {
+		if (pbkdf2_hmac_sm3_genkey_batch(pass, passlen, salt, saltlen, count, iter, sizeof(key), out[0]) != 1) {
+			error_print();
+			return -1;
+		}
+		for (i = 0; i < count; i++) {
+			if (pbkdf2_hmac_sm3_genkey(pass[i], passlen[i], salt[i], saltlen[i], iter, sizeof(key), key) != 1
+				|| memcmp(out[i], key, sizeof(key)) != 0) {
+				error_print();
+				return -1;
+			}
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(int argc, char **argv)
 {
 	int err = 0;
 	err += test_pbkdf2_genkey();
+	if (test_pbkdf2_hmac_sm3_genkey() != 1) err++;
+	if (test_pbkdf2_hmac_sm3_genkey_batch() != 1) err++;
 	return err;
 }
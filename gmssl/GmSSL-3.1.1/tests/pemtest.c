@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <gmssl/pem.h>
 #include <gmssl/hex.h>
+#include <gmssl/x509_cer.h>
 #include <gmssl/error.h>
 
 
@@ -235,11 +236,84 @@ static int test_pem_windows_style_without_last_newline(void)
 	return 1;
 }
 
+static int test_pem_blocks_new_from_file(void)
+{
+	FILE *fp;
+	const char *file = "test_pem_blocks.pem";
+	const char *empty_file = "test_pem_blocks_empty.pem";
+	uint8_t bin[1024];
+	size_t binlen;
+	uint8_t *der = NULL;
+	size_t derlen;
+
+	hex_to_bytes(pem_bin_hex, strlen(pem_bin_hex), bin, &binlen);
+
+	// CA bundle with comments, another block and mixed line endings
+	if (!(fp = fopen(file, "wb"))) {
+		error_print();
+		return -1;
+	}
+	fprintf(fp, "# Root CA\n");
+	fwrite(pem_unix_style, 1, strlen(pem_unix_style), fp);
+	fprintf(fp, "\n-----BEGIN PUBLIC KEY-----\nAAAA\n-----END PUBLIC KEY-----\n");
+	fwrite(pem_windows_style, 1, strlen(pem_windows_style) - 2, fp);
+	fclose(fp);
+
+	if (pem_blocks_new_from_file(file, "CERTIFICATE", &der, &derlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (derlen != binlen * 2
+		|| memcmp(der, bin, binlen) != 0
+		|| memcmp(der + binlen, bin, binlen) != 0) {
+		free(der);
+		error_print();
+		return -1;
+	}
+	free(der);
+
+	if (pem_blocks_new_from_file(file, "X509 CRL", &der, &derlen) != 0) {
+		error_print();
+		return -1;
+	}
+	if (!(fp = fopen(empty_file, "wb"))) {
+		error_print();
+		return -1;
+	}
+	fclose(fp);
+	if (pem_blocks_new_from_file(empty_file, "CERTIFICATE", &der, &derlen) != 0) {
+		error_print();
+		return -1;
+	}
+	// an empty list of certificates is not an error
+	if (x509_certs_new_from_file(&der, &derlen, empty_file) != 1
+		|| der != NULL || derlen != 0) {
+		error_print();
+		return -1;
+	}
+
+	// END line missing
+	if (!(fp = fopen(file, "wb"))) {
+		error_print();
+		return -1;
+	}
+	fwrite(pem_unix_style, 1, strlen(pem_unix_style) - strlen("-----END CERTIFICATE-----\n"), fp);
+	fclose(fp);
+	if (pem_blocks_new_from_file(file, "CERTIFICATE", &der, &derlen) != -1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(void)
 {
 	if (test_pem_unix_style() != 1) { error_print(); return 1; }
 	if (test_pem_unix_style_without_last_newline() != 1) { error_print(); return 1; }
 	if (test_pem_windows_style() != 1) { error_print(); return 1; }
 	if (test_pem_windows_style_without_last_newline() != 1) { error_print(); return 1; }
+	if (test_pem_blocks_new_from_file() != 1) { error_print(); return 1; }
 	return 0;
 }
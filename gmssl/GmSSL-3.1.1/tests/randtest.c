@@ -0,0 +1,178 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <gmssl/rand.h>
+#include <gmssl/error.h>
+
+
+static int test_rand_bytes(void)
+{
+	size_t lens[] = { 1, 16, 32, 255, 256, 257, 1000, 65536, 65537, 200000 };
+	uint8_t *buf;
+	uint8_t a[32];
+	uint8_t b[32];
+	uint8_t zeros[16] = {0};
+	size_t i;
+
+	if (!(buf = malloc(200000))) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < sizeof(lens)/sizeof(lens[0]); i++) {
+		memset(buf, 0, lens[i]);
+		if (rand_bytes(buf, lens[i]) != 1) {
+			free(buf);
+			error_print();
+			return -1;
+		}
+		// the tail of the output is not left zero
+		if (lens[i] >= sizeof(zeros)
+			&& memcmp(buf + lens[i] - sizeof(zeros), zeros, sizeof(zeros)) == 0) {
+			free(buf);
+			error_print();
+			return -1;
+		}
+	}
+	free(buf);
+
+	// buffered output must never be returned twice
+	if (rand_bytes(a, sizeof(a)) != 1
+		|| rand_bytes(b, sizeof(b)) != 1
+		|| memcmp(a, b, sizeof(a)) == 0) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < 10000; i++) {
+		if (rand_bytes(b, sizeof(b)) != 1
+			|| memcmp(a, b, sizeof(a)) == 0) {
+			error_print();
+			return -1;
+		}
+	}
+
+	if (rand_bytes(NULL, 32) != -1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_rand_bytes_fork(void)
+{
+	uint8_t parent[32];
+	uint8_t child[32];
+	int fd[2];
+	pid_t pid;
+	int status;
+
+	// make sure the parent has buffered output before the fork
+	if (rand_bytes(parent, 1) != 1) {
+		error_print();
+		return -1;
+	}
+	if (pipe(fd) != 0) {
+		error_print();
+		return -1;
+	}
+	if ((pid = fork()) < 0) {
+		error_print();
+		return -1;
+	}
+	if (pid == 0) {
+		close(fd[0]);
+		if (rand_bytes(child, sizeof(child)) != 1
+			|| write(fd[1], child, sizeof(child)) != sizeof(child)) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+	close(fd[1]);
+	if (rand_bytes(parent, sizeof(parent)) != 1
+		|| read(fd[0], child, sizeof(child)) != sizeof(child)
+		|| waitpid(pid, &status, 0) != pid
+		|| !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		close(fd[0]);
+		error_print();
+		return -1;
+	}
+	close(fd[0]);
+	if (memcmp(parent, child, sizeof(parent)) == 0) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+#define RAND_TEST_THREADS 4
+
+static void *rand_thread(void *arg)
+{
+	uint8_t *out = arg;
+	if (rand_bytes(out, 32) != 1) {
+		memset(out, 0, 32);
+	}
+	return NULL;
+}
+
+static int test_rand_bytes_threads(void)
+{
+	pthread_t threads[RAND_TEST_THREADS];
+	uint8_t out[RAND_TEST_THREADS][32];
+	uint8_t zeros[32] = {0};
+	int i, j;
+
+	for (i = 0; i < RAND_TEST_THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, rand_thread, out[i]) != 0) {
+			error_print();
+			return -1;
+		}
+	}
+	for (i = 0; i < RAND_TEST_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	for (i = 0; i < RAND_TEST_THREADS; i++) {
+		if (memcmp(out[i], zeros, sizeof(zeros)) == 0) {
+			error_print();
+			return -1;
+		}
+		for (j = 0; j < i; j++) {
+			if (memcmp(out[i], out[j], sizeof(out[i])) == 0) {
+				error_print();
+				return -1;
+			}
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+int main(void)
+{
+	if (test_rand_bytes() != 1) goto err;
+	if (test_rand_bytes_fork() != 1) goto err;
+	if (test_rand_bytes_threads() != 1) goto err;
+	printf("%s all tests passed\n", __FILE__);
+	return 0;
+err:
+	error_print();
+	return 1;
+}
@@ -0,0 +1,254 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <dlfcn.h>
+#endif
+#include <gmssl/sm2.h>
+#include <gmssl/sdf.h>
+#include <gmssl/rand.h>
+#include <gmssl/error.h>
+
+
+#define TEST_SDF_KEY_INDEX	1
+#define TEST_SDF_PASS		"P@ssw0rd"
+#define TEST_SESSIONS		4
+#define TEST_JOBS		40
+
+static SDF_JOB jobs[TEST_JOBS];
+static SDF_JOB *job_ptrs[TEST_JOBS];
+
+static int test_sdf_job_sign_verify(SDF_DEVICE *dev)
+{
+	SDF_JOB_QUEUE *queue;
+	SM2_KEY public_key;
+	uint8_t dgst[TEST_JOBS][32];
+	size_t i;
+
+	if (!(queue = sdf_job_queue_new(dev, TEST_SDF_KEY_INDEX, TEST_SDF_PASS, TEST_SESSIONS))
+		|| sdf_job_queue_get_public_key(queue, &public_key) != 1) {
+		error_print();
+		return -1;
+	}
+
+	for (i = 0; i < TEST_JOBS; i++) {
+		rand_bytes(dgst[i], 32);
+		sdf_job_set_sign(&jobs[i], dgst[i]);
+		job_ptrs[i] = &jobs[i];
+	}
+	if (sdf_job_queue_submit(queue, job_ptrs, TEST_JOBS) != 1) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (sdf_job_wait(queue, &jobs[i]) != 1
+			|| sdf_job_poll(queue, &jobs[i]) != 1
+			|| jobs[i].ret != 1
+			|| sm2_verify(&public_key, dgst[i], jobs[i].out, jobs[i].outlen) != 1) {
+			error_print();
+			goto err;
+		}
+	}
+
+	// the odd jobs verify a signature of another digest
+	for (i = 0; i < TEST_JOBS; i++) {
+		uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+		size_t siglen = jobs[i].outlen;
+		memcpy(sig, jobs[i].out, siglen);
+		sdf_job_set_verify(&jobs[i], &public_key, dgst[(i % 2) ? (i + 1) % TEST_JOBS : i], sig, siglen);
+	}
+	if (sdf_job_queue_submit(queue, job_ptrs, TEST_JOBS) != 1) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (sdf_job_wait(queue, &jobs[i]) != 1
+			|| jobs[i].ret != ((i % 2) ? 0 : 1)) {
+			error_print();
+			goto err;
+		}
+	}
+
+	sdf_job_queue_free(queue);
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+err:
+	sdf_job_queue_free(queue);
+	return -1;
+}
+
+static void count_job(SDF_JOB *job, void *arg)
+{
+	size_t *cnt = arg;
+	if (job->ret == 1) {
+		(*cnt)++;
+	}
+}
+
+static int test_sdf_job_encrypt_callback(SDF_DEVICE *dev)
+{
+	SDF_JOB_QUEUE *queue;
+	SM2_KEY key;
+	uint8_t msg[TEST_JOBS][SM2_MAX_PLAINTEXT_SIZE];
+	uint8_t buf[SM2_MAX_PLAINTEXT_SIZE];
+	size_t len;
+	size_t ok_cnt = 0;
+	size_t done_cnt = 0;
+	size_t n;
+	size_t i;
+
+	if (!(queue = sdf_job_queue_new(dev, TEST_SDF_KEY_INDEX, TEST_SDF_PASS, TEST_SESSIONS))) {
+		error_print();
+		return -1;
+	}
+	if (sm2_key_generate(&key) != 1) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		rand_bytes(msg[i], sizeof(msg[i]));
+		sdf_job_set_encrypt(&jobs[i], &key, msg[i], 1 + i * 6);
+		sdf_job_set_callback(&jobs[i], count_job, &ok_cnt);
+	}
+	// one job at a time
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (sdf_job_queue_submit(queue, &job_ptrs[i], 1) != 1) {
+			error_print();
+			goto err;
+		}
+	}
+	if (sdf_job_poll(queue, &jobs[0]) != -1) {
+		error_print();
+		goto err;
+	}
+	while (done_cnt < TEST_JOBS) {
+		if (sdf_job_queue_poll(queue, 1000, &n) != 1 || !n) {
+			error_print();
+			goto err;
+		}
+		done_cnt += n;
+	}
+	if (ok_cnt != TEST_JOBS
+		|| sdf_job_queue_poll(queue, 0, &n) != 1 || n != 0) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (sm2_decrypt(&key, jobs[i].out, jobs[i].outlen, buf, &len) != 1
+			|| len != 1 + i * 6
+			|| memcmp(buf, msg[i], len) != 0) {
+			error_print();
+			goto err;
+		}
+	}
+
+	sdf_job_queue_free(queue);
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+err:
+	sdf_job_queue_free(queue);
+	return -1;
+}
+
+#ifndef WIN32
+// the latency of the device is hidden by the sessions, the calls of the sessions overlap
+static int test_sdf_job_latency(SDF_DEVICE *dev, const char *so_path)
+{
+	SDF_JOB_QUEUE *queue = NULL;
+	void *lib;
+	unsigned int (*get_peak_in_flight)(void);
+	unsigned int peak;
+	uint8_t dgst[32] = {0};
+	size_t i;
+
+	// the library is already loaded, this only finds the handle
+	if (!(lib = dlopen(so_path, RTLD_LAZY))
+		|| !(get_peak_in_flight = (unsigned int (*)(void))dlsym(lib, "SDF_Dummy_GetPeakInFlight"))) {
+		error_print();
+		goto err;
+	}
+
+	setenv("SDF_DUMMY_LATENCY_US", "20000", 1);
+	if (sdf_open_device(dev) != 1) {
+		error_print();
+		goto err;
+	}
+	unsetenv("SDF_DUMMY_LATENCY_US");
+
+	if (!(queue = sdf_job_queue_new(dev, TEST_SDF_KEY_INDEX, TEST_SDF_PASS, TEST_SESSIONS))) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		sdf_job_set_sign(&jobs[i], dgst);
+	}
+	if (sdf_job_queue_submit(queue, job_ptrs, TEST_JOBS) != 1) {
+		error_print();
+		goto err;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (sdf_job_wait(queue, &jobs[i]) != 1 || jobs[i].ret != 1) {
+			error_print();
+			goto err;
+		}
+	}
+
+	// one session would never have more than one call in the device
+	peak = get_peak_in_flight();
+	if (peak < 2 || peak > TEST_SESSIONS) {
+		fprintf(stderr, "%s: %u calls in flight\n", __FUNCTION__, peak);
+		error_print();
+		goto err;
+	}
+
+	sdf_job_queue_free(queue);
+	dlclose(lib);
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+err:
+	if (queue) sdf_job_queue_free(queue);
+	if (lib) dlclose(lib);
+	return -1;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	SDF_DEVICE dev;
+	size_t i;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s libsdf_dummy\n", argv[0]);
+		return 1;
+	}
+	for (i = 0; i < TEST_JOBS; i++) {
+		job_ptrs[i] = &jobs[i];
+	}
+	if (sdf_load_library(argv[1], NULL) != 1
+		|| sdf_open_device(&dev) != 1) {
+		error_print();
+		return 1;
+	}
+	if (test_sdf_job_sign_verify(&dev) != 1) goto err;
+	if (test_sdf_job_encrypt_callback(&dev) != 1) goto err;
+#ifndef WIN32
+	if (test_sdf_job_latency(&dev, argv[1]) != 1) goto err;
+#endif
+	sdf_close_device(&dev);
+	sdf_unload_library();
+	printf("%s all tests passed\n", __FILE__);
+	return 0;
+err:
+	error_print();
+	return 1;
+}
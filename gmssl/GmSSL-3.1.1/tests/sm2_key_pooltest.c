@@ -0,0 +1,181 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <gmssl/sm2.h>
+#include <gmssl/sm2_key_pool.h>
+#include <gmssl/error.h>
+
+
+#define TEST_POOL_SIZE 16
+
+static int wait_pool_full(SM2_KEY_POOL *pool, size_t size)
+{
+	int i;
+	for (i = 0; i < 1000; i++) {
+		if (sm2_key_pool_count(pool) == size) {
+			return 1;
+		}
+		usleep(10000);
+	}
+	error_print();
+	return -1;
+}
+
+static int check_key(const SM2_KEY *key)
+{
+	uint8_t dgst[32] = {1, 2, 3};
+	uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+	size_t siglen;
+
+	if (sm2_sign(key, dgst, sig, &siglen) != 1
+		|| sm2_verify(key, dgst, sig, siglen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int test_sm2_key_pool(void)
+{
+	SM2_KEY_POOL *pool;
+	SM2_KEY keys[TEST_POOL_SIZE * 2];
+	size_t i, j;
+
+	if (sm2_key_pool_new(0) != NULL
+		|| sm2_key_pool_new(SM2_KEY_POOL_MAX_SIZE + 1) != NULL) {
+		error_print();
+		return -1;
+	}
+
+	if (!(pool = sm2_key_pool_new(TEST_POOL_SIZE))) {
+		error_print();
+		return -1;
+	}
+	if (wait_pool_full(pool, TEST_POOL_SIZE) != 1) {
+		sm2_key_pool_free(pool);
+		error_print();
+		return -1;
+	}
+
+	// more keys than the pool size, the rest are from the refill or generated inline
+	for (i = 0; i < sizeof(keys)/sizeof(keys[0]); i++) {
+		if (sm2_key_pool_get(pool, &keys[i]) != 1
+			|| check_key(&keys[i]) != 1) {
+			sm2_key_pool_free(pool);
+			error_print();
+			return -1;
+		}
+		for (j = 0; j < i; j++) {
+			if (memcmp(&keys[i].public_key, &keys[j].public_key, sizeof(SM2_POINT)) == 0) {
+				sm2_key_pool_free(pool);
+				error_print();
+				return -1;
+			}
+		}
+	}
+
+	// refilled in the background
+	if (wait_pool_full(pool, TEST_POOL_SIZE) != 1) {
+		sm2_key_pool_free(pool);
+		error_print();
+		return -1;
+	}
+	sm2_key_pool_free(pool);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_sm2_key_pool_fork(void)
+{
+	SM2_KEY_POOL *pool;
+	SM2_KEY key;
+	SM2_POINT child_keys[2];
+	int fd[2];
+	pid_t pid;
+	int status;
+	size_t i;
+
+	if (!(pool = sm2_key_pool_new(TEST_POOL_SIZE))) {
+		error_print();
+		return -1;
+	}
+	if (wait_pool_full(pool, TEST_POOL_SIZE) != 1
+		|| pipe(fd) != 0) {
+		sm2_key_pool_free(pool);
+		error_print();
+		return -1;
+	}
+	if ((pid = fork()) < 0) {
+		sm2_key_pool_free(pool);
+		error_print();
+		return -1;
+	}
+	if (pid == 0) {
+		// the inherited keys are dropped, the child refills its own pool
+		close(fd[0]);
+		if (sm2_key_pool_count(pool) != 0
+			|| sm2_key_pool_get(pool, &key) != 1) {
+			_exit(1);
+		}
+		child_keys[0] = key.public_key;
+		if (wait_pool_full(pool, TEST_POOL_SIZE) != 1
+			|| sm2_key_pool_get(pool, &key) != 1) {
+			_exit(1);
+		}
+		child_keys[1] = key.public_key;
+		if (write(fd[1], child_keys, sizeof(child_keys)) != sizeof(child_keys)) {
+			_exit(1);
+		}
+		sm2_key_pool_free(pool);
+		_exit(0);
+	}
+	close(fd[1]);
+	if (read(fd[0], child_keys, sizeof(child_keys)) != sizeof(child_keys)
+		|| waitpid(pid, &status, 0) != pid
+		|| !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		close(fd[0]);
+		sm2_key_pool_free(pool);
+		error_print();
+		return -1;
+	}
+	close(fd[0]);
+
+	// the keys of the parent are never used by the child
+	for (i = 0; i < TEST_POOL_SIZE; i++) {
+		if (sm2_key_pool_get(pool, &key) != 1
+			|| memcmp(&key.public_key, &child_keys[0], sizeof(SM2_POINT)) == 0
+			|| memcmp(&key.public_key, &child_keys[1], sizeof(SM2_POINT)) == 0) {
+			sm2_key_pool_free(pool);
+			error_print();
+			return -1;
+		}
+	}
+	sm2_key_pool_free(pool);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+int main(void)
+{
+	if (test_sm2_key_pool() != 1) goto err;
+	if (test_sm2_key_pool_fork() != 1) goto err;
+	printf("%s all tests passed\n", __FILE__);
+	return 0;
+err:
+	error_print();
+	return 1;
+}
@@ -51,6 +51,51 @@ static int test_sm2_ring_do_sign(void)
 	return 1;
 }
 
+static int test_sm2_ring_do_verify_tampered(void)
+{
+	static const size_t counts[] = { 1, 2, 16, 33 };
+	SM2_KEY sign_key;
+	SM2_POINT public_keys[33];
+	uint8_t dgst[32] = { 1, 2, 3 };
+	uint8_t r[32];
+	uint8_t s[33][32];
+	size_t i, j;
+
+	for (i = 0; i < sizeof(public_keys)/sizeof(public_keys[0]); i++) {
+		SM2_KEY key;
+		sm2_key_generate(&key);
+		memcpy(&public_keys[i], &(key.public_key), sizeof(SM2_POINT));
+		if (i == 0) {
+			memcpy(&sign_key, &key, sizeof(SM2_KEY));
+		}
+	}
+
+	for (i = 0; i < sizeof(counts)/sizeof(counts[0]); i++) {
+		if (sm2_ring_do_sign(&sign_key, public_keys, counts[i], dgst, r, s) != 1
+			|| sm2_ring_do_verify(public_keys, counts[i], dgst, r, s) != 1) {
+			error_print();
+			return -1;
+		}
+		for (j = 0; j < counts[i]; j++) {
+			s[j][31] ^= 1;
+			if (sm2_ring_do_verify(public_keys, counts[i], dgst, r, s) == 1) {
+				error_print();
+				return -1;
+			}
+			s[j][31] ^= 1;
+		}
+		dgst[0] ^= 1;
+		if (sm2_ring_do_verify(public_keys, counts[i], dgst, r, s) == 1) {
+			error_print();
+			return -1;
+		}
+		dgst[0] ^= 1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 static int test_sm2_ring_sign(void)
 {
 	SM2_KEY sign_key;
@@ -167,6 +212,7 @@ static int test_sm2_ring_sign_update(void)
 int main(void)
 {
 	if (test_sm2_ring_do_sign() != 1) { error_print(); return -1; }
+	if (test_sm2_ring_do_verify_tampered() != 1) { error_print(); return -1; }
 	if (test_sm2_ring_sign() != 1) { error_print(); return -1; }
 	if (test_sm2_ring_sign_crosscheck() != 1) { error_print(); return -1; }
 	if (test_sm2_ring_sign_update() != 1) { error_print(); return -1; }
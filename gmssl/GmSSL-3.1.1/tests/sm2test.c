@@ -862,9 +862,74 @@ static int test_sm2_enced_private_key_info(void)
 }
 
 
+// safegcd and the addition chains are compared with the generic sm2_fp_exp/sm2_fn_exp
+static int test_sm2_inv_sqrt(void)
+{
+	SM2_BN p_minus_two;
+	SM2_BN n_minus_two;
+	SM2_BN u_plus_one;
+	SM2_BN one;
+	SM2_BN a, r, r2, t;
+	int i;
+
+	sm2_bn_from_hex(p_minus_two, "fffffffeffffffffffffffffffffffffffffffff00000000fffffffffffffffd");
+	sm2_bn_from_hex(n_minus_two, "fffffffeffffffffffffffffffffffff7203df6b21c6052b53bbf40939d54121");
+	sm2_bn_from_hex(u_plus_one,  "3fffffffbfffffffffffffffffffffffffffffffc00000004000000000000000");
+	sm2_bn_set_one(one);
+
+	for (i = 0; i < 64; i++) {
+		switch (i) {
+		case 0: sm2_bn_set_zero(a); break;
+		case 1: sm2_bn_set_one(a); break;
+		case 2: sm2_bn_add(a, n_minus_two, one); break;
+		case 3: sm2_bn_add(a, p_minus_two, one); break;
+		default: sm2_fn_rand(a);
+		}
+
+		// a < n < p
+		sm2_fp_exp(t, a, p_minus_two);
+		sm2_fp_inv(r, a);
+		sm2_fp_inv_fermat(r2, a);
+		if (sm2_bn_cmp(r, t) != 0 || sm2_bn_cmp(r2, t) != 0) {
+			error_print();
+			return -1;
+		}
+
+		// p - 1 > n is also inverted mod n
+		sm2_fn_exp(t, a, n_minus_two);
+		sm2_fn_inv(r, a);
+		sm2_fn_inv_fermat(r2, a);
+		if (sm2_bn_cmp(r, t) != 0 || sm2_bn_cmp(r2, t) != 0) {
+			error_print();
+			return -1;
+		}
+
+		// a^2 always has a square root, one of +/- a
+		sm2_fp_sqr(t, a);
+		if (sm2_fp_sqrt(r, t) != 1) {
+			error_print();
+			return -1;
+		}
+		sm2_fp_exp(r2, t, u_plus_one);
+		if (sm2_bn_cmp(r, r2) != 0) {
+			error_print();
+			return -1;
+		}
+		sm2_fp_neg(r2, r);
+		if (sm2_bn_cmp(r, a) != 0 && sm2_bn_cmp(r2, a) != 0) {
+			error_print();
+			return -1;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(void)
 {
 	if (test_sm2_bn()  != 1) goto err;
+	if (test_sm2_inv_sqrt() != 1) goto err;
 	if (test_sm2_jacobian_point() != 1) goto err;
 	if (test_sm2_point() != 1) goto err;
 	if (test_sm2_point_octets() != 1) goto err;
@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <gmssl/sm3.h>
+#include <gmssl/sm3_x8_avx2.h>
+#include <gmssl/rand.h>
+#include <gmssl/endian.h>
+#include <gmssl/error.h>
+
+
+static int test_sm3_x8_avx2(void)
+{
+	uint8_t data[8][96] = {0};
+	uint8_t dgst[8][32];
+	uint8_t dgst2[8][32] = {{0}};
+	int i;
+
+	rand_bytes(data[0], sizeof(data));
+	for (i = 0; i < 8; i++) {
+		sm3_digest(data[i], sizeof(data)/8, dgst[i]);
+	}
+	sm3_x8_digest(&data[0][0], sizeof(data)/8, dgst2);
+
+	if (memcmp(dgst2, dgst, sizeof(dgst)) != 0) {
+		error_print();
+		return -1;
+	}
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_sm3_x8_compress_lanes(void)
+{
+	uint8_t blocks[8][SM3_BLOCK_SIZE];
+	SM3_CTX ctx;
+	uint32_t digest[8][8];
+	uint32_t words[16][8];
+	int i, j;
+
+	rand_bytes(blocks[0], sizeof(blocks));
+	sm3_init(&ctx);
+	for (j = 0; j < 16; j++) {
+		for (i = 0; i < 8; i++) {
+			words[j][i] = GETU32(blocks[i] + 4*j);
+		}
+	}
+	for (j = 0; j < 8; j++) {
+		for (i = 0; i < 8; i++) {
+			digest[j][i] = ctx.digest[j];
+		}
+	}
+	sm3_x8_compress_lanes(digest, words);
+
+	for (i = 0; i < 8; i++) {
+		uint32_t d[8];
+		memcpy(d, ctx.digest, sizeof(d));
+		sm3_compress_blocks(d, blocks[i], 1);
+		for (j = 0; j < 8; j++) {
+			if (digest[j][i] != d[j]) {
+				error_print();
+				return -1;
+			}
+		}
+	}
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+int main(void)
+{
+	if (!sm3_x8_avx2_cpu_support()) {
+		printf("%s skipped, no AVX2\n", __FILE__);
+		return 0;
+	}
+	if (test_sm3_x8_avx2() != 1) goto err;
+	if (test_sm3_x8_compress_lanes() != 1) goto err;
+	printf("%s all tests passed\n", __FILE__);
+	return 0;
+err:
+	error_print();
+	return 1;
+}
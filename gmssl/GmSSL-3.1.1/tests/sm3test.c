@@ -172,9 +172,164 @@ static int test_sm3(void)
 }
 
 
+static void sm3_tree_node(uint8_t prefix, const uint8_t *a, size_t alen,
+	const uint8_t *b, size_t blen, uint8_t dgst[32])
+{
+	SM3_CTX ctx;
+	sm3_init(&ctx);
+	sm3_update(&ctx, &prefix, 1);
+	sm3_update(&ctx, a, alen);
+	sm3_update(&ctx, b, blen);
+	sm3_finish(&ctx, dgst);
+}
+
+static int test_sm3_tree(void)
+{
+	uint8_t *data;
+	size_t datalen = 1000003;
+	uint8_t leaves[3][32];
+	uint8_t node[32];
+	uint8_t params[12] = { 0,0,0,64, 0,0,0,0,0,0,0,150 };
+	uint8_t dgst[32];
+	uint8_t tree_dgst[32];
+	SM3_TREE_CTX ctx;
+	size_t lens[] = { 1, 63, 4095, 4097, 100000, 300 };
+	size_t i, off;
+	int threads;
+
+	if (!(data = malloc(datalen))) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < datalen; i++) {
+		data[i] = (uint8_t)(i * 31 + (i >> 8));
+	}
+
+	// 3 leaves of a 150-byte input, MTH = node(node(L0, L1), L2)
+	sm3_tree_node(0x00, data, 64, NULL, 0, leaves[0]);
+	sm3_tree_node(0x00, data + 64, 64, NULL, 0, leaves[1]);
+	sm3_tree_node(0x00, data + 128, 22, NULL, 0, leaves[2]);
+	sm3_tree_node(0x01, leaves[0], 32, leaves[1], 32, node);
+	sm3_tree_node(0x01, node, 32, leaves[2], 32, node);
+	sm3_tree_node(0x02, params, sizeof(params), node, 32, dgst);
+	if (sm3_tree_digest(data, 150, 64, 1, tree_dgst) != 1
+		|| memcmp(tree_dgst, dgst, 32) != 0) {
+		error_print();
+		free(data);
+		return -1;
+	}
+
+	// the empty input is a single empty leaf
+	memset(params + 4, 0, 8);
+	sm3_tree_node(0x00, NULL, 0, NULL, 0, node);
+	sm3_tree_node(0x02, params, sizeof(params), node, 32, dgst);
+	if (sm3_tree_digest(NULL, 0, 64, 4, tree_dgst) != 1
+		|| memcmp(tree_dgst, dgst, 32) != 0) {
+		error_print();
+		free(data);
+		return -1;
+	}
+
+	// any split of the input and any number of threads give the same root
+	if (sm3_tree_digest(data, datalen, 4096, 1, dgst) != 1) {
+		error_print();
+		free(data);
+		return -1;
+	}
+	for (threads = 1; threads <= 8; threads *= 2) {
+		if (sm3_tree_init(&ctx, 4096, threads) != 1) {
+			error_print();
+			free(data);
+			return -1;
+		}
+		for (off = 0, i = 0; off < datalen; off += lens[i % 6], i++) {
+			size_t len = datalen - off < lens[i % 6] ? datalen - off : lens[i % 6];
+			if (sm3_tree_update(&ctx, data + off, len) != 1) {
+				sm3_tree_cleanup(&ctx);
+				error_print();
+				free(data);
+				return -1;
+			}
+		}
+		if (sm3_tree_finish(&ctx, tree_dgst) != 1
+			|| memcmp(tree_dgst, dgst, 32) != 0) {
+			error_print();
+			free(data);
+			return -1;
+		}
+	}
+
+	// the leaf size is bound to the root
+	if (sm3_tree_digest(data, datalen, 8192, 4, tree_dgst) != 1
+		|| memcmp(tree_dgst, dgst, 32) == 0) {
+		error_print();
+		free(data);
+		return -1;
+	}
+
+	if (sm3_tree_init(&ctx, SM3_TREE_MIN_LEAF_SIZE - 1, 1) != -1
+		|| sm3_tree_init(&ctx, 4096, 0) != -1
+		|| sm3_tree_init(&ctx, 4096, SM3_TREE_MAX_THREADS + 1) != -1) {
+		error_print();
+		free(data);
+		return -1;
+	}
+	free(data);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+
+static int test_sm3_kdf(void)
+{
+	uint8_t z[130];
+	uint8_t out[300];
+	uint8_t ref[300 + 32];
+	size_t zlens[] = { 0, 1, 50, 51, 52, 55, 56, 59, 60, 61, 63, 64, 65, 127, 130 };
+	size_t outlens[] = { 1, 32, 33, 95, 96, 97, 200, 256, 257, 300 };
+	SM3_KDF_CTX kdf_ctx;
+	SM3_CTX sm3_ctx;
+	uint8_t counter_be[4];
+	size_t i, j, k;
+
+	for (i = 0; i < sizeof(z); i++) {
+		z[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	// the counter and the padding cross the block boundary with some lengths of Z
+	for (i = 0; i < sizeof(zlens)/sizeof(zlens[0]); i++) {
+		for (k = 0; k < sizeof(ref)/32; k++) {
+			counter_be[0] = counter_be[1] = counter_be[2] = 0;
+			counter_be[3] = (uint8_t)(k + 1);
+			sm3_init(&sm3_ctx);
+			sm3_update(&sm3_ctx, z, zlens[i]);
+			sm3_update(&sm3_ctx, counter_be, sizeof(counter_be));
+			sm3_finish(&sm3_ctx, ref + 32 * k);
+		}
+		for (j = 0; j < sizeof(outlens)/sizeof(outlens[0]); j++) {
+			memset(out, 0, sizeof(out));
+			sm3_kdf_init(&kdf_ctx, outlens[j]);
+			sm3_kdf_update(&kdf_ctx, z, zlens[i]);
+			sm3_kdf_finish(&kdf_ctx, out);
+			if (memcmp(out, ref, outlens[j]) != 0) {
+				fprintf(stderr, "sm3_kdf zlen %zu outlen %zu failed\n", zlens[i], outlens[j]);
+				error_print();
+				return -1;
+			}
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+
 int main(void)
 {
 	if (test_sm3() != 1) goto err;
+	if (test_sm3_tree() != 1) goto err;
+	if (test_sm3_kdf() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
@@ -87,9 +87,46 @@ static int test_sm4_aesni_avx(void)
 	return 1;
 }
 
+static int test_sm4_aesni_avx_cbc_decrypt(void)
+{
+	SM4_KEY enc_key;
+	SM4_KEY dec_key;
+	uint8_t key[16];
+	uint8_t iv[16];
+	uint8_t plaintext[16 * 11];
+	uint8_t ciphertext[16 * 11];
+	uint8_t buf[16 * 11];
+	size_t nblocks;
+
+	rand_bytes(key, sizeof(key));
+	rand_bytes(iv, sizeof(iv));
+	rand_bytes(plaintext, sizeof(plaintext));
+	sm4_set_encrypt_key(&enc_key, key);
+	sm4_set_decrypt_key(&dec_key, key);
+
+	for (nblocks = 1; nblocks <= sizeof(plaintext)/16; nblocks++) {
+		sm4_cbc_encrypt(&enc_key, iv, plaintext, nblocks, ciphertext);
+		sm4_cbc_decrypt(&dec_key, iv, ciphertext, nblocks, buf);
+		if (memcmp(buf, plaintext, nblocks * 16) != 0) {
+			fprintf(stderr, "%s %d: %s error\n", __FILE__, __LINE__, __FUNCTION__);
+			return -1;
+		}
+		// in-place
+		sm4_cbc_decrypt(&dec_key, iv, ciphertext, nblocks, ciphertext);
+		if (memcmp(ciphertext, plaintext, nblocks * 16) != 0) {
+			fprintf(stderr, "%s %d: %s in-place error\n", __FILE__, __LINE__, __FUNCTION__);
+			return -1;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(void)
 {
 	if (test_sm4_aesni_avx() != 1) goto err;
+	if (test_sm4_aesni_avx_cbc_decrypt() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
@@ -691,6 +691,68 @@ static int test_sm4_ctr_update(void)
 	return 1;
 }
 
+static int test_sm4_ctr_update_threads(void)
+{
+	SM4_KEY sm4_key;
+	SM4_CTR_CTX ctx;
+	uint8_t key[16];
+	uint8_t ctr[16];
+	uint8_t iv[16];
+	size_t mlen = 1000005;
+	uint8_t *mbuf = NULL;
+	uint8_t *cbuf = NULL;
+	uint8_t *tbuf = NULL;
+	size_t lens[] = { 5, 300000, 16, 17, 700000 };
+	size_t clen, inlen, len, off, i;
+	int ret = -1;
+
+	rand_bytes(key, sizeof(key));
+	rand_bytes(iv, sizeof(iv));
+	// the counter wraps around the low 64 bits inside the input
+	memset(iv + 8, 0xff, 8);
+	iv[15] = 0xf0;
+
+	if (!(mbuf = malloc(mlen)) || !(cbuf = malloc(mlen)) || !(tbuf = malloc(mlen))) {
+		error_print();
+		goto end;
+	}
+	rand_bytes(mbuf, mlen);
+
+	sm4_set_encrypt_key(&sm4_key, key);
+	memcpy(ctr, iv, sizeof(iv));
+	sm4_ctr_encrypt(&sm4_key, ctr, mbuf, mlen, tbuf);
+
+	if (sm4_ctr_encrypt_init(&ctx, key, iv) != 1) {
+		error_print();
+		goto end;
+	}
+	for (clen = 0, off = 0, i = 0; off < mlen; off += inlen, i++) {
+		inlen = mlen - off < lens[i % 5] ? mlen - off : lens[i % 5];
+		if (sm4_ctr_encrypt_update_threads(&ctx, mbuf + off, inlen, cbuf + clen, &len, 4) != 1) {
+			error_print();
+			goto end;
+		}
+		clen += len;
+	}
+	if (sm4_ctr_encrypt_finish(&ctx, cbuf + clen, &len) != 1) {
+		error_print();
+		goto end;
+	}
+	clen += len;
+	if (clen != mlen || memcmp(cbuf, tbuf, mlen) != 0) {
+		error_print();
+		goto end;
+	}
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (mbuf) free(mbuf);
+	if (cbuf) free(cbuf);
+	if (tbuf) free(tbuf);
+	return ret;
+}
+
+
 int main(void)
 {
 	if (test_sm4() != 1) goto err;
@@ -702,6 +764,7 @@ int main(void)
 	if (test_sm4_gcm_gbt36624_2() != 1) goto err;
 	if (test_sm4_cbc_update() != 1) goto err;
 	if (test_sm4_ctr_update() != 1) goto err;
+	if (test_sm4_ctr_update_threads() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
@@ -11,6 +11,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 #include <gmssl/oid.h>
 #include <gmssl/x509.h>
 #include <gmssl/rand.h>
@@ -70,9 +74,220 @@ static int test_tls13_gcm(void)
 	return 1;
 }
 
+static int test_tls13_ticket(void)
+{
+	SM4_KEY key;
+	SM4_KEY wrong_key;
+	uint8_t raw_key[16];
+	uint8_t psk[32];
+	uint8_t ticket[TLS13_MAX_TICKET_SIZE];
+	size_t ticketlen;
+	int cipher_suite;
+	uint64_t issue_time;
+	uint32_t age_add;
+	uint32_t max_early_data_size;
+	uint8_t buf[32];
+
+	rand_bytes(raw_key, sizeof(raw_key));
+	sm4_set_encrypt_key(&key, raw_key);
+	raw_key[0] ^= 1;
+	sm4_set_encrypt_key(&wrong_key, raw_key);
+	rand_bytes(psk, sizeof(psk));
+
+	if (tls13_ticket_encrypt(&key, TLS_cipher_sm4_gcm_sm3, 0x123456789a, 0x11223344, 16384, psk,
+		ticket, &ticketlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (ticketlen != TLS13_TICKET_SIZE) {
+		error_print();
+		return -1;
+	}
+	if (tls13_ticket_decrypt(&key, ticket, ticketlen,
+		&cipher_suite, &issue_time, &age_add, &max_early_data_size, buf) != 1) {
+		error_print();
+		return -1;
+	}
+	if (cipher_suite != TLS_cipher_sm4_gcm_sm3
+		|| issue_time != 0x123456789a
+		|| age_add != 0x11223344
+		|| max_early_data_size != 16384
+		|| memcmp(buf, psk, sizeof(psk)) != 0) {
+		error_print();
+		return -1;
+	}
+
+	// not issued by this server
+	if (tls13_ticket_decrypt(&wrong_key, ticket, ticketlen,
+		&cipher_suite, &issue_time, &age_add, &max_early_data_size, buf) != 0) {
+		error_print();
+		return -1;
+	}
+	if (tls13_ticket_decrypt(&key, ticket, ticketlen - 1,
+		&cipher_suite, &issue_time, &age_add, &max_early_data_size, buf) != 0) {
+		error_print();
+		return -1;
+	}
+	ticket[20] ^= 1;
+	if (tls13_ticket_decrypt(&key, ticket, ticketlen,
+		&cipher_suite, &issue_time, &age_add, &max_early_data_size, buf) != 0) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_tls13_session(void)
+{
+	TLS13_SESSION sess;
+	TLS13_SESSION sess2;
+	uint8_t buf[TLS13_MAX_SESSION_SIZE];
+	uint8_t *p = buf;
+	const uint8_t *cp = buf;
+	size_t len = 0;
+
+	memset(&sess, 0, sizeof(sess));
+	sess.cipher_suite = TLS_cipher_sm4_gcm_sm3;
+	sess.ticket_lifetime = 3600;
+	sess.ticket_age_add = 0xaabbccdd;
+	sess.max_early_data_size = 1024;
+	sess.received_time = 0x1122334455;
+	rand_bytes(sess.psk, sizeof(sess.psk));
+	rand_bytes(sess.ticket, TLS13_TICKET_SIZE);
+	sess.ticketlen = TLS13_TICKET_SIZE;
+
+	if (tls13_session_to_bytes(&sess, &p, &len) != 1
+		|| len > sizeof(buf)) {
+		error_print();
+		return -1;
+	}
+	memset(&sess2, 0, sizeof(sess2));
+	if (tls13_session_from_bytes(&sess2, &cp, &len) != 1
+		|| len != 0) {
+		error_print();
+		return -1;
+	}
+	if (sess2.cipher_suite != sess.cipher_suite
+		|| sess2.ticket_lifetime != sess.ticket_lifetime
+		|| sess2.ticket_age_add != sess.ticket_age_add
+		|| sess2.max_early_data_size != sess.max_early_data_size
+		|| sess2.received_time != sess.received_time
+		|| memcmp(sess2.psk, sess.psk, sizeof(sess.psk)) != 0
+		|| sess2.ticketlen != sess.ticketlen
+		|| memcmp(sess2.ticket, sess.ticket, sess.ticketlen) != 0) {
+		error_print();
+		return -1;
+	}
+
+	// truncated
+	cp = buf;
+	len = p - buf - 1;
+	if (tls13_session_from_bytes(&sess2, &cp, &len) == 1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_tls13_anti_replay(void)
+{
+	TLS13_ANTI_REPLAY *ar;
+	uint8_t binder1[32];
+	uint8_t binder2[32];
+	uint64_t now = tls13_time_ms();
+	uint64_t period = 2 * 1000; // 2 * window
+
+	rand_bytes(binder1, sizeof(binder1));
+	rand_bytes(binder2, sizeof(binder2));
+
+	if (tls13_anti_replay_new(0) != NULL) {
+		error_print();
+		return -1;
+	}
+	if (!(ar = tls13_anti_replay_new(1))) {
+		error_print();
+		return -1;
+	}
+	if (tls13_anti_replay_check(ar, binder1, sizeof(binder1), now) != 1
+		|| tls13_anti_replay_check(ar, binder1, sizeof(binder1), now) != 0
+		|| tls13_anti_replay_check(ar, binder2, sizeof(binder2), now + 1) != 1) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	// still remembered in the previous filter after one rotation
+	if (tls13_anti_replay_check(ar, binder1, sizeof(binder1), now + period) != 0) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	// forgotten after both filters are rotated, the freshness check rejects such a ticket
+	if (tls13_anti_replay_check(ar, binder1, sizeof(binder1), now + 3 * period) != 1) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	tls13_anti_replay_free(ar);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+#ifndef WIN32
+static int test_tls13_anti_replay_fork(void)
+{
+	TLS13_ANTI_REPLAY *ar;
+	uint8_t binder[32];
+	uint64_t now = tls13_time_ms();
+	pid_t pid;
+	int status;
+
+	rand_bytes(binder, sizeof(binder));
+
+	if (!(ar = tls13_anti_replay_new(TLS13_DEFAULT_REPLAY_WINDOW))) {
+		error_print();
+		return -1;
+	}
+	if ((pid = fork()) < 0) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	if (pid == 0) {
+		_exit(tls13_anti_replay_check(ar, binder, sizeof(binder), now) == 1 ? 0 : 1);
+	}
+	if (waitpid(pid, &status, 0) != pid
+		|| !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	// the binder seen by the child is a replay for the parent
+	if (tls13_anti_replay_check(ar, binder, sizeof(binder), now) != 0) {
+		tls13_anti_replay_free(ar);
+		error_print();
+		return -1;
+	}
+	tls13_anti_replay_free(ar);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+#endif
+
 int main(void)
 {
 	if (test_tls13_gcm() != 1) goto err;
+	if (test_tls13_ticket() != 1) goto err;
+	if (test_tls13_session() != 1) goto err;
+	if (test_tls13_anti_replay() != 1) goto err;
+#ifndef WIN32
+	if (test_tls13_anti_replay_fork() != 1) goto err;
+#endif
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
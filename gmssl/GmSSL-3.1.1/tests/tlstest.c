@@ -18,6 +18,7 @@
 #include <gmssl/tls.h>
 #include <gmssl/sm3.h>
 #include <gmssl/sm4.h>
+#include <gmssl/gcm.h>
 
 static int test_tls_encode(void)
 {
@@ -95,6 +96,280 @@ static int test_tls_cbc(void)
 	return 1;
 }
 
+static int test_tls_cbc_lengths(void)
+{
+	uint8_t key[32] = {1};
+	SM3_HMAC_CTX hmac_ctx;
+	SM4_KEY enc_key;
+	SM4_KEY dec_key;
+	uint8_t seq_num[8] = { 0,0,0,0,0,0,0,1 };
+	uint8_t header[5];
+	size_t lens[] = { 0, 1, 15, 16, 17, 1000, 1024, 1040, 4096, 16383, (1 << 14) };
+	uint8_t *in = NULL;
+	uint8_t *out = NULL;
+	uint8_t *buf = NULL;
+	uint8_t iv[16];
+	size_t len, buflen;
+	size_t i;
+	int ret = -1;
+
+	if (!(in = malloc(1 << 14))
+		|| !(out = malloc(16 + (1 << 14) + 32 + 16))
+		|| !(buf = malloc(16 + (1 << 14) + 32 + 16))) {
+		error_print();
+		goto end;
+	}
+	for (i = 0; i < (1 << 14); i++) {
+		in[i] = (uint8_t)i;
+	}
+	sm3_hmac_init(&hmac_ctx, key, 32);
+	sm4_set_encrypt_key(&enc_key, key);
+	sm4_set_decrypt_key(&dec_key, key);
+
+	for (i = 0; i < sizeof(lens)/sizeof(lens[0]); i++) {
+		header[0] = TLS_record_application_data;
+		header[1] = TLS_protocol_tlcp >> 8;
+		header[2] = TLS_protocol_tlcp & 0xff;
+		header[3] = (uint8_t)(lens[i] >> 8);
+		header[4] = (uint8_t)lens[i];
+
+		if (tls_cbc_encrypt(&hmac_ctx, &enc_key, seq_num, header, in, lens[i], out, &len) != 1
+			|| len != 16 + lens[i] - (lens[i] + 32) % 16 + 48
+			|| tls_cbc_decrypt(&hmac_ctx, &dec_key, seq_num, header, out, len, buf, &buflen) != 1
+			|| buflen != lens[i]
+			|| memcmp(buf, in, lens[i]) != 0) {
+			error_print();
+			goto end;
+		}
+
+		// the explicit iv is derived from the sequence number
+		memcpy(iv, seq_num, 8);
+		memset(iv + 8, 0, 8);
+		sm4_encrypt(&enc_key, iv, iv);
+		if (memcmp(out, iv, 16) != 0) {
+			error_print();
+			goto end;
+		}
+
+		// a modified ciphertext or sequence number is rejected
+		out[16 + lens[i]/2] ^= 1;
+		if (tls_cbc_decrypt(&hmac_ctx, &dec_key, seq_num, header, out, len, buf, &buflen) == 1) {
+			error_print();
+			goto end;
+		}
+		out[16 + lens[i]/2] ^= 1;
+		seq_num[7]++;
+		if (tls_cbc_decrypt(&hmac_ctx, &dec_key, seq_num, header, out, len, buf, &buflen) == 1) {
+			error_print();
+			goto end;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (in) free(in);
+	if (out) free(out);
+	if (buf) free(buf);
+	return ret;
+}
+
+static int test_tls_gcm(void)
+{
+	uint8_t key[16] = {2};
+	uint8_t iv[4] = { 1,2,3,4 };
+	BLOCK_CIPHER_KEY gcm_key;
+	SM4_KEY sm4_key;
+	uint8_t seq_num[8] = { 0,0,0,0,0,0,0,5 };
+	uint8_t header[5];
+	size_t lens[] = { 1, 15, 16, 17, 1024, (1 << 14) };
+	uint8_t *in = NULL;
+	uint8_t *out = NULL;
+	uint8_t *buf = NULL;
+	uint8_t nonce[12];
+	uint8_t aad[13];
+	uint8_t tag[16];
+	size_t len, buflen;
+	size_t i;
+	int ret = -1;
+
+	if (!(in = malloc(1 << 14))
+		|| !(out = malloc(8 + (1 << 14) + 16))
+		|| !(buf = malloc(8 + (1 << 14) + 16))) {
+		error_print();
+		goto end;
+	}
+	for (i = 0; i < (1 << 14); i++) {
+		in[i] = (uint8_t)i;
+	}
+	block_cipher_set_encrypt_key(&gcm_key, BLOCK_CIPHER_sm4(), key);
+	sm4_set_encrypt_key(&sm4_key, key);
+
+	for (i = 0; i < sizeof(lens)/sizeof(lens[0]); i++) {
+		header[0] = TLS_record_application_data;
+		header[1] = TLS_protocol_tls12 >> 8;
+		header[2] = TLS_protocol_tls12 & 0xff;
+		header[3] = (uint8_t)(lens[i] >> 8);
+		header[4] = (uint8_t)lens[i];
+
+		if (tls_gcm_encrypt(&gcm_key, iv, seq_num, header, in, lens[i], out, &len) != 1
+			|| len != 8 + lens[i] + 16
+			|| tls_gcm_decrypt(&gcm_key, iv, seq_num, header, out, len, buf, &buflen) != 1
+			|| buflen != lens[i]
+			|| memcmp(buf, in, lens[i]) != 0) {
+			error_print();
+			goto end;
+		}
+
+		// GenericAEADCipher of RFC 5288
+		memcpy(nonce, iv, 4);
+		memcpy(nonce + 4, seq_num, 8);
+		memcpy(aad, seq_num, 8);
+		memcpy(aad + 8, header, 5);
+		if (sm4_gcm_encrypt(&sm4_key, nonce, sizeof(nonce), aad, sizeof(aad),
+				in, lens[i], buf, sizeof(tag), tag) != 1
+			|| memcmp(out, seq_num, 8) != 0
+			|| memcmp(out + 8, buf, lens[i]) != 0
+			|| memcmp(out + 8 + lens[i], tag, sizeof(tag)) != 0) {
+			error_print();
+			goto end;
+		}
+
+		// a modified ciphertext or sequence number is rejected
+		out[8 + lens[i]/2] ^= 1;
+		if (tls_gcm_decrypt(&gcm_key, iv, seq_num, header, out, len, buf, &buflen) == 1) {
+			error_print();
+			goto end;
+		}
+		out[8 + lens[i]/2] ^= 1;
+		seq_num[7]++;
+		if (tls_gcm_decrypt(&gcm_key, iv, seq_num, header, out, len, buf, &buflen) == 1) {
+			error_print();
+			goto end;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (in) free(in);
+	if (out) free(out);
+	if (buf) free(buf);
+	return ret;
+}
+
+static int test_tls_cipher_suites_filter(void)
+{
+	const int supported[] = { TLS_cipher_ecc_sm4_gcm_sm3, TLS_cipher_ecc_sm4_cbc_sm3 };
+	const int configured[] = { TLS_cipher_ecdhe_sm4_cbc_sm3, TLS_cipher_ecc_sm4_cbc_sm3, TLS_cipher_ecc_sm4_gcm_sm3 };
+	const int unsupported[] = { TLS_cipher_sm4_gcm_sm3 };
+	int out[TLS_MAX_CIPHER_SUITES_COUNT];
+	size_t outcnt;
+
+	if (tls_cipher_suites_filter(NULL, 0, supported, 2, out, &outcnt) != 1
+		|| outcnt != 2
+		|| out[0] != TLS_cipher_ecc_sm4_gcm_sm3) {
+		error_print();
+		return -1;
+	}
+	// the configured order is kept
+	if (tls_cipher_suites_filter(configured, 3, supported, 2, out, &outcnt) != 1
+		|| outcnt != 2
+		|| out[0] != TLS_cipher_ecc_sm4_cbc_sm3
+		|| out[1] != TLS_cipher_ecc_sm4_gcm_sm3) {
+		error_print();
+		return -1;
+	}
+	if (tls_cipher_suites_filter(unsupported, 1, supported, 2, out, &outcnt) != 0) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+// records protected by one side are accepted by the other side with the same key_block
+static int test_tls_conn_record(void)
+{
+	const int cipher_suites[] = {
+		TLS_cipher_ecc_sm4_cbc_sm3,
+		TLS_cipher_ecc_sm4_gcm_sm3,
+		TLS_cipher_ecdhe_sm4_cbc_sm3,
+		TLS_cipher_ecdhe_sm4_gcm_sm3,
+	};
+	TLS_CONNECT *client = NULL;
+	TLS_CONNECT *server = NULL;
+	uint8_t record[5 + 100];
+	uint8_t enced_record[TLS_MAX_RECORD_SIZE];
+	uint8_t buf[TLS_MAX_RECORD_SIZE];
+	size_t enced_record_len, buflen;
+	size_t i;
+	int ret = -1;
+
+	if (!(client = calloc(1, sizeof(TLS_CONNECT)))
+		|| !(server = calloc(1, sizeof(TLS_CONNECT)))) {
+		error_print();
+		goto end;
+	}
+	record[0] = TLS_record_application_data;
+	record[1] = TLS_protocol_tlcp >> 8;
+	record[2] = TLS_protocol_tlcp & 0xff;
+	record[3] = 0;
+	record[4] = 100;
+	memset(record + 5, 'A', 100);
+
+	for (i = 0; i < sizeof(cipher_suites)/sizeof(cipher_suites[0]); i++) {
+		memset(client, 0, sizeof(TLS_CONNECT));
+		memset(server, 0, sizeof(TLS_CONNECT));
+		client->is_client = 1;
+		client->cipher_suite = server->cipher_suite = cipher_suites[i];
+		rand_bytes(client->key_block, sizeof(client->key_block));
+		memcpy(server->key_block, client->key_block, sizeof(client->key_block));
+		if (tls_set_record_keys(client) != 1
+			|| tls_set_record_keys(server) != 1) {
+			error_print();
+			goto end;
+		}
+
+		// client to server
+		if (tls_conn_record_encrypt(client, record, sizeof(record), enced_record, &enced_record_len) != 1
+			|| tls_conn_record_decrypt(server, enced_record, enced_record_len, buf, &buflen) != 1
+			|| buflen != sizeof(record)
+			|| memcmp(buf, record, sizeof(record)) != 0) {
+			error_print();
+			goto end;
+		}
+		if (enced_record_len != (tls_cipher_suite_is_aead(cipher_suites[i]) ? 5 + 8 + 100 + 16 : 5 + 16 + 96 + 48)) {
+			error_print();
+			goto end;
+		}
+		tls_seq_num_incr(client->client_seq_num);
+		tls_seq_num_incr(server->client_seq_num);
+
+		// server to client
+		if (tls_conn_record_encrypt(server, record, sizeof(record), enced_record, &enced_record_len) != 1
+			|| tls_conn_record_decrypt(client, enced_record, enced_record_len, buf, &buflen) != 1
+			|| buflen != sizeof(record)
+			|| memcmp(buf, record, sizeof(record)) != 0) {
+			error_print();
+			goto end;
+		}
+		// the client write keys do not decrypt the server records
+		if (tls_conn_record_decrypt(server, enced_record, enced_record_len, buf, &buflen) == 1) {
+			error_print();
+			goto end;
+		}
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	if (client) free(client);
+	if (server) free(server);
+	return ret;
+}
+
 static int test_tls_random(void)
 {
 	uint8_t random[32];
@@ -239,6 +514,101 @@ static int test_tls_certificate_verify(void)
 	return 1;
 }
 
+static int test_tls_client_verify(void)
+{
+	size_t lens[8] = { 120, 90, 3000, 150, 40, 4, 20000, 70 };
+	static uint8_t msgs[8][20000];
+	static TLS_CLIENT_VERIFY_CTX ctx;
+	SM2_KEY sign_key;
+	SM2_KEY public_key;
+	SM2_KEY other_key;
+	SM2_SIGN_CTX sign_ctx;
+	uint8_t sig[SM2_MAX_SIGNATURE_SIZE];
+	size_t siglen;
+	int set_key_at;
+	int i;
+
+	if (sm2_key_generate(&sign_key) != 1
+		|| sm2_key_generate(&other_key) != 1
+		|| sm2_key_set_public_key(&public_key, &sign_key.public_key) != 1) {
+		error_print();
+		return -1;
+	}
+	rand_bytes(msgs[0], sizeof(msgs));
+
+	sm2_sign_init(&sign_ctx, &sign_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH);
+	for (i = 0; i < 8; i++) {
+		sm2_sign_update(&sign_ctx, msgs[i], lens[i]);
+	}
+	if (sm2_sign_finish(&sign_ctx, sig, &siglen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	// public key set before the client certificate, at any other message or only at finish
+	for (set_key_at = 0; set_key_at <= 8; set_key_at++) {
+		tls_client_verify_init(&ctx);
+		for (i = 0; i < 8; i++) {
+			if (i == set_key_at
+				&& tls_client_verify_set_public_key(&ctx, &public_key) != 1) {
+				error_print();
+				return -1;
+			}
+			if (tls_client_verify_update(&ctx, msgs[i], lens[i]) != 1) {
+				error_print();
+				return -1;
+			}
+		}
+		if (tls_client_verify_finish(&ctx, sig, siglen, &public_key) != 1) {
+			error_print();
+			return -1;
+		}
+		tls_client_verify_cleanup(&ctx);
+	}
+
+	// missing message
+	tls_client_verify_init(&ctx);
+	for (i = 0; i < 7; i++) {
+		tls_client_verify_update(&ctx, msgs[i], lens[i]);
+	}
+	if (tls_client_verify_finish(&ctx, sig, siglen, &public_key) == 1) {
+		error_print();
+		return -1;
+	}
+	tls_client_verify_cleanup(&ctx);
+
+	// key of finish differs from the key set before
+	tls_client_verify_init(&ctx);
+	for (i = 0; i < 8; i++) {
+		if (i == TLS_client_verify_client_certificate) {
+			tls_client_verify_set_public_key(&ctx, &public_key);
+		}
+		tls_client_verify_update(&ctx, msgs[i], lens[i]);
+	}
+	if (tls_client_verify_finish(&ctx, sig, siglen, &other_key) == 1) {
+		error_print();
+		return -1;
+	}
+	tls_client_verify_cleanup(&ctx);
+
+	// six full records fit in the buffer before the public key is set, one more byte does not
+	tls_client_verify_init(&ctx);
+	for (i = 0; i < TLS_client_verify_client_certificate; i++) {
+		if (tls_client_verify_update(&ctx, msgs[i], TLS_MAX_PLAINTEXT_SIZE) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	if (tls_client_verify_update(&ctx, msgs[6], 1) == 1) {
+		error_print();
+		return -1;
+	}
+	tls_client_verify_cleanup(&ctx);
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 static int test_tls_finished(void)
 {
 	uint8_t record[1024];
@@ -323,16 +693,124 @@ static int test_tls_application_data(void)
 	return 1;
 }
 
+// a bundle of self-signed CA certificates, far more names than fit in a CertificateRequest
+static int write_ca_certs(const char *file, const SM2_KEY *key, int count)
+{
+	FILE *fp;
+	int i;
+
+	if (!(fp = fopen(file, "wb"))) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		uint8_t serial[16];
+		uint8_t name[256];
+		size_t namelen = 0;
+		char cn[32];
+		time_t not_before, not_after;
+		uint8_t cert[1024];
+		uint8_t *p = cert;
+		size_t certlen = 0;
+
+		rand_bytes(serial, sizeof(serial));
+		serial[0] &= 0x7f;
+		snprintf(cn, sizeof(cn), "CA %d", i);
+		time(&not_before);
+		x509_validity_add_days(&not_after, not_before, 365);
+		if (x509_name_set(name, &namelen, sizeof(name), "CN", NULL, NULL, "GmSSL", NULL, cn) != 1
+			|| x509_cert_sign_to_der(X509_version_v3, serial, sizeof(serial), OID_sm2sign_with_sm3,
+				name, namelen, not_before, not_after, name, namelen, key,
+				NULL, 0, NULL, 0, NULL, 0,
+				key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH, &p, &certlen) != 1
+			|| x509_cert_to_pem(cert, certlen, fp) != 1) {
+			fclose(fp);
+			error_print();
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 1;
+}
+
+static int test_tls_ctx_ca_names(void)
+{
+	const char *file = "tlstest_cacerts.pem";
+	SM2_KEY key;
+	TLS_CTX ctx;
+	uint8_t record[TLS_MAX_RECORD_SIZE];
+	size_t recordlen;
+	const uint8_t cert_types[] = { TLS_cert_type_ecdsa_sign };
+	const uint8_t *cert;
+	size_t certlen;
+	int ret = -1;
+
+	memset(&ctx, 0, sizeof(ctx));
+	if (sm2_key_generate(&key) != 1
+		|| tls_ctx_init(&ctx, TLS_protocol_tls12, 0) != 1) {
+		error_print();
+		return -1;
+	}
+
+	// a second call replaces the first bundle
+	if (write_ca_certs(file, &key, 2) != 1
+		|| tls_ctx_set_ca_certificates(&ctx, file, 5) != 1
+		|| write_ca_certs(file, &key, 1000) != 1
+		|| tls_ctx_set_ca_certificates(&ctx, file, 5) != 1) {
+		error_print();
+		goto end;
+	}
+	if (ctx.ca_store.certslen != ctx.cacertslen) {
+		error_print();
+		goto end;
+	}
+
+	// the names that do not fit are left out
+	if (!ctx.ca_names_len || ctx.ca_names_len > TLS_MAX_CA_NAMES_SIZE) {
+		error_print();
+		goto end;
+	}
+	if (tls_record_set_handshake_certificate_request(record, &recordlen,
+		cert_types, sizeof(cert_types), ctx.ca_names, ctx.ca_names_len) != 1) {
+		error_print();
+		goto end;
+	}
+	if (x509_certs_get_cert_by_index(ctx.cacerts, ctx.cacertslen, 0, &cert, &certlen) != 1
+		|| tls_authorities_issued_certificate(ctx.ca_names, ctx.ca_names_len, cert, certlen) != 1) {
+		error_print();
+		goto end;
+	}
+
+	// an empty list accepts any CA
+	if (tls_authorities_issued_certificate(NULL, 0, cert, certlen) != 1) {
+		error_print();
+		goto end;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	ret = 1;
+end:
+	tls_ctx_cleanup(&ctx);
+	remove(file);
+	return ret;
+}
+
 int main(void)
 {
 	if (test_tls_encode() != 1) goto err;
 	if (test_tls_cbc() != 1) goto err;
+	if (test_tls_cbc_lengths() != 1) goto err;
+	if (test_tls_gcm() != 1) goto err;
+	if (test_tls_cipher_suites_filter() != 1) goto err;
+	if (test_tls_conn_record() != 1) goto err;
 	if (test_tls_random() != 1) goto err;
 	if (test_tls_client_hello() != 1) goto err;
 	if (test_tls_server_hello() != 1) goto err;
 	if (test_tls_certificate() != 1) goto err;
 	if (test_tls_server_key_exchange() != 1) goto err;
 	if (test_tls_certificate_verify() != 1) goto err;
+	if (test_tls_client_verify() != 1) goto err;
+	if (test_tls_ctx_ca_names() != 1) goto err;
 	//if (test_tls_finished() != 1) goto err; //FIXME
 	if (test_tls_alert() != 1) goto err;
 	if (test_tls_change_cipher_spec() != 1) goto err;
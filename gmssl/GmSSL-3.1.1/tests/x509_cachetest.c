@@ -0,0 +1,153 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <gmssl/oid.h>
+#include <gmssl/x509.h>
+#include <gmssl/rand.h>
+#include <gmssl/error.h>
+
+
+static int test_x509_verify_cache_lookup(void)
+{
+	uint8_t fingerprint[32];
+	uint8_t other[32];
+	size_t hits, misses, entries;
+	int i;
+
+	if (x509_verify_cache_enable(16, X509_VERIFY_CACHE_DEFAULT_TTL) != 1) {
+		error_print();
+		return -1;
+	}
+
+	rand_bytes(fingerprint, sizeof(fingerprint));
+	memcpy(other, fingerprint, sizeof(other));
+	other[31] ^= 1;
+
+	if (x509_verify_cache_lookup(fingerprint) != 0
+		|| x509_verify_cache_add(fingerprint) != 1
+		|| x509_verify_cache_lookup(fingerprint) != 1
+		|| x509_verify_cache_lookup(other) != 0) {
+		error_print();
+		return -1;
+	}
+	if (x509_verify_cache_get_stats(&hits, &misses, &entries) != 1
+		|| hits != 1 || misses != 2 || entries != 1) {
+		error_print();
+		return -1;
+	}
+
+	// size limit: never more than max_entries live entries
+	for (i = 0; i < 100; i++) {
+		rand_bytes(other, sizeof(other));
+		x509_verify_cache_add(other);
+	}
+	if (x509_verify_cache_get_stats(NULL, NULL, &entries) != 1 || entries > 16) {
+		error_print();
+		return -1;
+	}
+
+	x509_verify_cache_flush();
+	if (x509_verify_cache_lookup(fingerprint) != 0) {
+		error_print();
+		return -1;
+	}
+
+	x509_verify_cache_disable();
+	if (x509_verify_cache_add(fingerprint) != 0
+		|| x509_verify_cache_lookup(fingerprint) != 0
+		|| x509_verify_cache_get_stats(NULL, NULL, NULL) != 0) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+static int test_x509_verify_cache_cert(void)
+{
+	uint8_t serial[20] = { 0x01, 0x00 };
+	uint8_t name[256];
+	size_t namelen = 0;
+	time_t not_before, not_after;
+	SM2_KEY sm2_key;
+	uint8_t cert[1024];
+	uint8_t *p = cert;
+	size_t certlen = 0;
+	size_t hits, misses;
+
+	x509_name_set(name, &namelen, sizeof(name), "CN", "Beijing", "Haidian", "PKU", "CS", "CA");
+	time(&not_before);
+	x509_validity_add_days(&not_after, not_before, 365);
+	sm2_key_generate(&sm2_key);
+
+	if (x509_cert_sign_to_der(
+		X509_version_v3,
+		serial, sizeof(serial),
+		OID_sm2sign_with_sm3,
+		name, namelen,
+		not_before, not_after,
+		name, namelen,
+		&sm2_key,
+		NULL, 0,
+		NULL, 0,
+		NULL, 0,
+		&sm2_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH,
+		&p, &certlen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_verify_cache_enable(0, X509_VERIFY_CACHE_DEFAULT_TTL) != 1) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_verify_by_ca_cert(cert, certlen, cert, certlen,
+			SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1
+		|| x509_cert_verify_by_ca_cert(cert, certlen, cert, certlen,
+			SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
+		error_print();
+		return -1;
+	}
+	if (x509_verify_cache_get_stats(&hits, &misses, NULL) != 1
+		|| hits != 1 || misses != 1) {
+		error_print();
+		return -1;
+	}
+
+	// a different signer_id is a different cache entry, and the signature check fails
+	if (x509_cert_verify_by_ca_cert(cert, certlen, cert, certlen, "Alice", 5) == 1) {
+		error_print();
+		return -1;
+	}
+
+	// a tampered signature must not hit
+	cert[certlen - 1] ^= 1;
+	if (x509_cert_verify_by_ca_cert(cert, certlen, cert, certlen,
+		SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) == 1) {
+		error_print();
+		return -1;
+	}
+
+	x509_verify_cache_disable();
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+int main(void)
+{
+	if (test_x509_verify_cache_lookup() != 1) { error_print(); return -1; }
+	if (test_x509_verify_cache_cert() != 1) { error_print(); return -1; }
+	printf("%s all tests passed!\n", __FILE__);
+	return 0;
+}
@@ -443,6 +443,73 @@ static int test_x509_cert_revoke(void)
 	http://crl3.digicert.com/Omniroot2025.crl
 */
 
+static int test_x509_crl_sign_to_der(void)
+{
+	uint8_t issuer[256];
+	size_t issuer_len = 0;
+	time_t this_update = time(NULL);
+	time_t next_update = this_update + 7 * 24 * 60 * 60;
+	uint8_t serial[] = { 0x80, 0x01, 0x02 };
+	uint8_t revoked_certs[256];
+	size_t revoked_certs_len = 0;
+	uint8_t exts[64];
+	size_t extslen = 0;
+	SM2_KEY sign_key;
+	uint8_t crl[1024];
+	uint8_t tbs[1024];
+	uint8_t *p;
+	size_t crllen, len, tbslen = 0;
+	const uint8_t *cp, *d, *sig;
+	size_t dlen, siglen;
+	int sig_alg;
+
+	p = revoked_certs;
+	if (x509_name_add_common_name(issuer, &issuer_len, sizeof(issuer),
+			ASN1_TAG_PrintableString, (uint8_t *)"CA", 2) != 1
+		|| x509_revoked_cert_to_der(serial, sizeof(serial), this_update, NULL, 0, &p, &revoked_certs_len) != 1
+		|| x509_crl_exts_add_crl_number(exts, &extslen, sizeof(exts), 0, 1) != 1
+		|| sm2_key_generate(&sign_key) != 1) {
+		error_print();
+		return -1;
+	}
+
+	p = tbs;
+	len = 0;
+	if (x509_crl_sign_to_der(X509_version_v2, OID_sm2sign_with_sm3, issuer, issuer_len,
+			this_update, next_update, revoked_certs, revoked_certs_len, exts, extslen,
+			&sign_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH, NULL, &len) != 1
+		|| x509_tbs_crl_to_der(X509_version_v2, OID_sm2sign_with_sm3, issuer, issuer_len,
+			this_update, next_update, revoked_certs, revoked_certs_len, exts, extslen,
+			&p, &tbslen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	p = crl;
+	crllen = 0;
+	if (x509_crl_sign_to_der(X509_version_v2, OID_sm2sign_with_sm3, issuer, issuer_len,
+			this_update, next_update, revoked_certs, revoked_certs_len, exts, extslen,
+			&sign_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH, &p, &crllen) != 1
+		|| crllen != len) {
+		error_print();
+		return -1;
+	}
+
+	cp = crl;
+	len = crllen;
+	if (x509_signed_from_der(&d, &dlen, &sig_alg, &sig, &siglen, &cp, &len) != 1
+		|| asn1_length_is_zero(len) != 1
+		|| dlen != tbslen
+		|| memcmp(d, tbs, tbslen) != 0
+		|| x509_signed_verify(crl, crllen, &sign_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
 int main(void)
 {
 	if (test_x509_crl_reason() != 1) goto err;
@@ -454,6 +521,7 @@ int main(void)
 	if (test_x509_issuing_distribution_point() != 1) goto err;
 	if (test_x509_issuing_distribution_point_from_der() != 1) goto err;
 	if (test_x509_crl_exts() != 1) goto err;
+	if (test_x509_crl_sign_to_der() != 1) goto err;
 	printf("%s all tests passed\n", __FILE__);
 	return 0;
 err:
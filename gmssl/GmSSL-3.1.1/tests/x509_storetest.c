@@ -0,0 +1,165 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <gmssl/oid.h>
+#include <gmssl/x509.h>
+#include <gmssl/x509_ext.h>
+#include <gmssl/rand.h>
+#include <gmssl/error.h>
+
+
+static int gen_cert(uint8_t **out, size_t *outlen,
+	const char *issuer_cn, const SM2_KEY *issuer_key,
+	const char *subject_cn, const SM2_KEY *subject_key)
+{
+	uint8_t serial[16];
+	uint8_t issuer[256];
+	size_t issuer_len = 0;
+	uint8_t subject[256];
+	size_t subject_len = 0;
+	time_t not_before, not_after;
+	uint8_t exts[256];
+	size_t extslen = 0;
+
+	rand_bytes(serial, sizeof(serial));
+	serial[0] &= 0x7f;
+	if (x509_name_set(issuer, &issuer_len, sizeof(issuer), "CN", NULL, NULL, "GmSSL", NULL, issuer_cn) != 1
+		|| x509_name_set(subject, &subject_len, sizeof(subject), "CN", NULL, NULL, "GmSSL", NULL, subject_cn) != 1) {
+		error_print();
+		return -1;
+	}
+	time(&not_before);
+	x509_validity_add_days(&not_after, not_before, 365);
+
+	if (x509_exts_add_subject_key_identifier_ex(exts, &extslen, sizeof(exts), -1, subject_key) != 1
+		|| x509_exts_add_default_authority_key_identifier(exts, &extslen, sizeof(exts), issuer_key) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_cert_sign_to_der(
+		X509_version_v3,
+		serial, sizeof(serial),
+		OID_sm2sign_with_sm3,
+		issuer, issuer_len,
+		not_before, not_after,
+		subject, subject_len,
+		subject_key,
+		NULL, 0,
+		NULL, 0,
+		exts, extslen,
+		issuer_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH,
+		out, outlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int test_x509_trust_store(void)
+{
+	SM2_KEY root_key[3];
+	SM2_KEY leaf_key;
+	uint8_t roots[4096];
+	uint8_t *p = roots;
+	size_t rootslen = 0;
+	uint8_t leaf[1024];
+	uint8_t *q = leaf;
+	size_t leaflen = 0;
+	X509_TRUST_STORE store;
+	const uint8_t *root[3];
+	size_t rootlen[3];
+	const uint8_t *cert;
+	size_t certlen;
+	const uint8_t *subject;
+	size_t subject_len;
+	const uint8_t *key_id;
+	size_t key_id_len;
+	int verify_result;
+	int i;
+
+	// root 0 and root 1 share the same subject name, as in a CA key rollover
+	for (i = 0; i < 3; i++) {
+		const char *cn = (i < 2) ? "Root CA" : "Other Root CA";
+		root[i] = p;
+		rootlen[i] = 0;
+		if (sm2_key_generate(&root_key[i]) != 1
+			|| gen_cert(&p, &rootlen[i], cn, &root_key[i], cn, &root_key[i]) != 1) {
+			error_print();
+			return -1;
+		}
+		rootslen += rootlen[i];
+	}
+	if (sm2_key_generate(&leaf_key) != 1
+		|| gen_cert(&q, &leaflen, "Root CA", &root_key[1], "Entity", &leaf_key) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_trust_store_init(&store, roots, rootslen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (store.anchors_cnt != 3) {
+		error_print();
+		return -1;
+	}
+
+	// lookup by subject
+	if (x509_cert_get_subject(root[2], rootlen[2], &subject, &subject_len) != 1
+		|| x509_trust_store_get_cert_by_subject(&store, subject, subject_len, &cert, &certlen) != 1
+		|| certlen != rootlen[2] || memcmp(cert, root[2], certlen) != 0) {
+		error_print();
+		return -1;
+	}
+
+	// lookup by key identifier
+	for (i = 0; i < 3; i++) {
+		if (x509_cert_get_subject_key_identifier(root[i], rootlen[i], &key_id, &key_id_len) != 1
+			|| x509_trust_store_get_cert_by_key_identifier(&store, key_id, key_id_len, &cert, &certlen) != 1
+			|| certlen != rootlen[i] || memcmp(cert, root[i], certlen) != 0) {
+			error_print();
+			return -1;
+		}
+	}
+
+	// issuer lookup uses the AuthorityKeyIdentifier to pick root 1 instead of root 0
+	if (x509_trust_store_get_issuer_cert(&store, leaf, leaflen, &cert, &certlen) != 1
+		|| certlen != rootlen[1] || memcmp(cert, root[1], certlen) != 0) {
+		error_print();
+		return -1;
+	}
+	if (x509_certs_verify_by_trust_store(leaf, leaflen, X509_cert_chain_server,
+		&store, X509_MAX_VERIFY_DEPTH, &verify_result) != 1) {
+		error_print();
+		return -1;
+	}
+
+	// unknown subject
+	if (x509_cert_get_subject(leaf, leaflen, &subject, &subject_len) != 1
+		|| x509_trust_store_get_cert_by_subject(&store, subject, subject_len, &cert, &certlen) != 0) {
+		error_print();
+		return -1;
+	}
+
+	x509_trust_store_cleanup(&store);
+	printf("%s() ok\n", __FUNCTION__);
+	return 1;
+}
+
+int main(void)
+{
+	if (test_x509_trust_store() != 1) { error_print(); return -1; }
+	printf("%s all tests passed!\n", __FILE__);
+	return 0;
+}
@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <gmssl/oid.h>
 #include <gmssl/x509_alg.h>
+#include <gmssl/x509_ext.h>
 #include <gmssl/x509.h>
 #include <gmssl/rand.h>
 #include <gmssl/error.h>
@@ -383,6 +384,210 @@ static int test_x509_cert(void)
 	return 0;
 }
 
+// x509_cert_sign_to_der() is a single pass build, the TBSCertificate is the same as x509_tbs_cert_to_der()
+static int test_x509_cert_sign_to_der(void)
+{
+	uint8_t serial[20] = { 0x00, 0x80, 0x01 };
+	uint8_t issuer[256];
+	size_t issuer_len = 0;
+	time_t not_before, not_after;
+	uint8_t subject[256];
+	size_t subject_len = 0;
+	uint8_t unique_id[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	uint8_t exts[256];
+	size_t extslen = 0;
+	SM2_KEY sm2_key;
+	uint8_t cert[1024];
+	uint8_t tbs[1024];
+	uint8_t *p;
+	size_t certlen, len, tbslen = 0;
+	const uint8_t *cp, *d, *sig;
+	size_t dlen, siglen;
+	int sig_alg;
+
+	set_x509_name(issuer, &issuer_len, sizeof(issuer));
+	set_x509_name(subject, &subject_len, sizeof(subject));
+	time(&not_before);
+	// GeneralizedTime after 2049
+	not_after = X509_MAX_UTC_TIME + 1;
+	sm2_key_generate(&sm2_key);
+	if (x509_exts_add_key_usage(exts, &extslen, sizeof(exts), 1, X509_KU_KEY_CERT_SIGN) != 1
+		|| x509_exts_add_basic_constraints(exts, &extslen, sizeof(exts), 1, 1, 0) != 1) {
+		error_print();
+		return -1;
+	}
+
+	len = 0;
+	p = tbs;
+	if (x509_cert_sign_to_der(X509_version_v3, serial, sizeof(serial), OID_sm2sign_with_sm3,
+			issuer, issuer_len, not_before, not_after, subject, subject_len, &sm2_key,
+			unique_id, sizeof(unique_id), unique_id, sizeof(unique_id), exts, extslen,
+			&sm2_key, SM2_DEFAULT_ID, strlen(SM2_DEFAULT_ID), NULL, &len) != 1
+		|| x509_tbs_cert_to_der(X509_version_v3, serial, sizeof(serial), OID_sm2sign_with_sm3,
+			issuer, issuer_len, not_before, not_after, subject, subject_len, &sm2_key,
+			unique_id, sizeof(unique_id), unique_id, sizeof(unique_id), exts, extslen,
+			&p, &tbslen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	certlen = 0;
+	p = cert;
+	if (x509_cert_sign_to_der(X509_version_v3, serial, sizeof(serial), OID_sm2sign_with_sm3,
+			issuer, issuer_len, not_before, not_after, subject, subject_len, &sm2_key,
+			unique_id, sizeof(unique_id), unique_id, sizeof(unique_id), exts, extslen,
+			&sm2_key, SM2_DEFAULT_ID, strlen(SM2_DEFAULT_ID), &p, &certlen) != 1
+		|| certlen != len
+		|| p != cert + certlen) {
+		error_print();
+		return -1;
+	}
+
+	cp = cert;
+	len = certlen;
+	if (x509_signed_from_der(&d, &dlen, &sig_alg, &sig, &siglen, &cp, &len) != 1
+		|| asn1_length_is_zero(len) != 1
+		|| dlen != tbslen
+		|| memcmp(d, tbs, tbslen) != 0
+		|| sig_alg != OID_sm2sign_with_sm3
+		|| siglen != SM2_signature_typical_size
+		|| x509_signed_verify(cert, certlen, &sm2_key, SM2_DEFAULT_ID, strlen(SM2_DEFAULT_ID)) != 1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 0;
+}
+
+static int test_x509_cert_view(void)
+{
+	uint8_t serial[20] = { 0x01, 0x00 };
+	uint8_t name[256];
+	size_t namelen = 0;
+	time_t not_before, not_after;
+	SM2_KEY sm2_key;
+	SM2_KEY public_key;
+	uint8_t exts[256];
+	size_t extslen = 0;
+	uint8_t cert[1024];
+	uint8_t *p = cert;
+	size_t certlen = 0;
+	size_t i;
+	X509_CERT_VIEW view;
+	const uint8_t *subject;
+	size_t subject_len;
+	const uint8_t *signature;
+	size_t signature_len;
+	int critical;
+	const uint8_t *val;
+	size_t vlen;
+	int path_len_constraint;
+
+	set_x509_name(name, &namelen, sizeof(name));
+	time(&not_before);
+	x509_validity_add_days(&not_after, not_before, 365);
+	sm2_key_generate(&sm2_key);
+
+	if (x509_exts_add_key_usage(exts, &extslen, sizeof(exts), X509_critical,
+			X509_KU_KEY_CERT_SIGN|X509_KU_CRL_SIGN) != 1
+		|| x509_exts_add_basic_constraints(exts, &extslen, sizeof(exts), X509_critical, 1, 0) != 1
+		|| x509_exts_add_subject_key_identifier_ex(exts, &extslen, sizeof(exts), -1, &sm2_key) != 1) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_sign_to_der(
+		X509_version_v3,
+		serial, sizeof(serial),
+		OID_sm2sign_with_sm3,
+		name, namelen,
+		not_before, not_after,
+		name, namelen,
+		&sm2_key,
+		NULL, 0,
+		NULL, 0,
+		exts, extslen,
+		&sm2_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH,
+		&p, &certlen) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_cert_view_init(&view, cert, certlen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (view.version != X509_version_v3
+		|| view.serial_len != sizeof(serial) || memcmp(view.serial, serial, sizeof(serial)) != 0
+		|| view.not_before != not_before || view.not_after != not_after
+		|| view.exts_cnt != 3) {
+		error_print();
+		return -1;
+	}
+
+	// the view points into the certificate, same as x509_cert_get_details
+	if (x509_cert_get_details(cert, certlen,
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+		&subject, &subject_len,
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+		&signature, &signature_len) != 1
+		|| subject != view.subject || subject_len != view.subject_len
+		|| signature != view.signature || signature_len != view.signature_len) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_cert_view_get_subject_public_key(&view, &public_key) != 1
+		|| memcmp(&public_key.public_key, &sm2_key.public_key, sizeof(SM2_POINT)) != 0) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_get_ext_by_oid(&view, OID_ce_basic_constraints, &critical, &val, &vlen) != 1
+		|| critical != X509_critical
+		|| x509_cert_view_get_ext_by_oid(&view, OID_ce_ext_key_usage, &critical, &val, &vlen) != 0) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_check(&view, X509_cert_ca, &path_len_constraint) != 1
+		|| path_len_constraint != 0) {
+		error_print();
+		return -1;
+	}
+	if (x509_cert_view_verify_by_ca_view(&view, &view, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) != 1) {
+		error_print();
+		return -1;
+	}
+
+	cert[certlen - 1] ^= 1;
+	if (x509_cert_view_init(&view, cert, certlen) != 1
+		|| x509_cert_view_verify_by_ca_view(&view, &view, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH) == 1) {
+		error_print();
+		return -1;
+	}
+
+	// a public key not on the curve is rejected by the view as by x509_cert_get_details
+	for (i = 0; i + sizeof(SM2_POINT) <= certlen; i++) {
+		if (memcmp(cert + i, &sm2_key.public_key, sizeof(SM2_POINT)) == 0) {
+			break;
+		}
+	}
+	if (i + sizeof(SM2_POINT) > certlen) {
+		error_print();
+		return -1;
+	}
+	cert[i + sizeof(SM2_POINT) - 1] ^= 1;
+	if (x509_cert_view_init(&view, cert, certlen) != -1
+		|| x509_cert_get_details(cert, certlen,
+			NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+			NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL) != -1) {
+		error_print();
+		return -1;
+	}
+
+	printf("%s() ok\n", __FUNCTION__);
+	return 0;
+}
+
 int main(void)
 {
 	int err = 0;
@@ -394,5 +599,7 @@ int main(void)
 	err += test_x509_public_key_info();
 	err += test_x509_tbs_cert();
 	err += test_x509_cert();
+	err += test_x509_cert_sign_to_der();
+	err += test_x509_cert_view();
 	return err;
 }
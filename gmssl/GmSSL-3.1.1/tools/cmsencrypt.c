@@ -12,6 +12,8 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <gmssl/mem.h>
+#include <gmssl/pem.h>
 #include <gmssl/file.h>
 #include <gmssl/cms.h>
 #include <gmssl/x509.h>
@@ -35,22 +37,15 @@ cms -encrypt -rcpt a.pem -rcpt b.pem -rcpt c.pem -in file -sign -signcert a.pem
 
 首先接收者可以有多个证书
 
-这里面有个问题，因为我们要输出一个加密的对象，因此我们必须把输入的内容读取进来。
-
-
-EnvelopedData 是一个封装的SEQUENCE中，因此必须读取所有的内容。
-如果是一个文件，就需要读取所有的文件内容，如果是一个stream ,也需要读取完整的内容到一个足够大的buffer中，如何设置这个buffer的大小呢
-
-
-
-对于输入文件，如果输入有文件名的话，可以直接通过stat获取文件长度
-但是如果对于stream的话，实际上我们是没有办法获得输入长度的，那么就直接准备一个buffer好了。
-不要给自己找麻烦了，直接只支持文件输入吧
+内容按块流式加密，不再需要把输入全部读入内存。
+对于输入文件，可以直接通过stat获取文件长度，输出与cms_envelop()相同的DER编码。
+对于stream输入，长度是未知的，ContentInfo、EnvelopedData、EncryptedContentInfo采用BER不定长编码，
+encryptedContent为分段的constructed OCTET STRING。
 encrypt
 
 */
 
-static const char *options = "-encrypt (-rcptcert pem)* -in file -out file";
+static const char *options = "(-rcptcert pem)* [-in file] [-out file]";
 
 
 static int get_files_size(int argc, char **argv, const char *option, size_t *len)
@@ -105,11 +100,14 @@ int cmsencrypt_main(int argc, char **argv)
 	size_t rcpt_certs_len;
 	uint8_t key[16];
 	uint8_t iv[16];
-	uint8_t *inbuf = NULL;
-	size_t inlen;
-	uint8_t *cms = NULL;
+	size_t inlen = CMS_CONTENT_LENGTH_UNKNOWN;
+	uint8_t buf[4096];
+	uint8_t cms[CMS_STREAM_BUF_SIZE];
+	size_t len;
 	size_t cmslen;
 	uint8_t *cert;
+	CMS_ENVELOP_CTX envelop_ctx;
+	PEM_CTX pem_ctx;
 
 	if (argc < 2) {
 		fprintf(stderr, "usage: %s %s\n", prog, options);
@@ -131,18 +129,6 @@ int cmsencrypt_main(int argc, char **argv)
 	}
 	cert = rcpt_certs;
 
-	if (get_files_size(argc, argv, "-in", &inlen) != 1) {
-		goto end;
-	}
-	if (inlen <= 0) {
-		fprintf(stderr, "%s: invalid input length\n", prog);
-		goto end;
-	}
-	if (!(inbuf = malloc(inlen))) {
-		fprintf(stderr, "%s: %s\n", prog, strerror(errno));
-		goto end;
-	}
-
 	argc--;
 	argv++;
 
@@ -175,8 +161,8 @@ int cmsencrypt_main(int argc, char **argv)
 				fprintf(stderr, "%s: open '%s' failure : %s\n", prog, infile, strerror(errno));
 				goto end;
 			}
-			if ((inlen = fread(inbuf, 1, inlen, infp)) <= 0) {
-				fprintf(stderr, "%s: read data error: %s\n", prog, strerror(errno));
+			if (file_size(infp, &inlen) != 1) {
+				fprintf(stderr, "%s: get input length failed\n", prog);
 				goto end;
 			}
 		} else if (!strcmp(*argv, "-out")) {
@@ -202,23 +188,37 @@ bad:
 
 	if (rand_bytes(key, sizeof(key)) != 1
 		|| rand_bytes(iv, sizeof(iv)) != 1
-		|| cms_envelop(NULL, &cmslen, rcpt_certs, rcpt_certs_len,
+		|| cms_envelop_init(&envelop_ctx, rcpt_certs, rcpt_certs_len,
 			OID_sm4_cbc, key, sizeof(key), iv, sizeof(iv),
-			OID_cms_data, inbuf, inlen, NULL, 0, NULL, 0) != 1) {
+			inlen, NULL, 0, NULL, 0, cms, &cmslen) != 1) {
 		fprintf(stderr, "%s: inner error\n", prog);
 		goto end;
 	}
-	if (!(cms = malloc(cmslen))) {
-		fprintf(stderr, "%s: malloc failure\n", prog);
+	if (pem_write_init(&pem_ctx, outfp, PEM_CMS) != 1
+		|| pem_write_update(&pem_ctx, cms, cmslen) != 1) {
+		fprintf(stderr, "%s: output CMS failure\n", prog);
+		goto end;
+	}
+	while ((len = fread(buf, 1, sizeof(buf), infp)) > 0) {
+		if (cms_envelop_update(&envelop_ctx, buf, len, cms, &cmslen) != 1) {
+			fprintf(stderr, "%s: inner error\n", prog);
+			goto end;
+		}
+		if (pem_write_update(&pem_ctx, cms, cmslen) != 1) {
+			fprintf(stderr, "%s: output CMS failure\n", prog);
+			goto end;
+		}
+	}
+	if (ferror(infp)) {
+		fprintf(stderr, "%s: read data error: %s\n", prog, strerror(errno));
 		goto end;
 	}
-	if (cms_envelop(cms, &cmslen, rcpt_certs, rcpt_certs_len,
-		OID_sm4_cbc, key, sizeof(key), iv, sizeof(iv),
-		OID_cms_data, inbuf, inlen, NULL, 0, NULL, 0) != 1) {
+	if (cms_envelop_finish(&envelop_ctx, cms, &cmslen) != 1) {
 		fprintf(stderr, "%s: inner error\n", prog);
 		goto end;
 	}
-	if (cms_to_pem(cms, cmslen, outfp) != 1) {
+	if (pem_write_update(&pem_ctx, cms, cmslen) != 1
+		|| pem_write_finish(&pem_ctx) != 1) {
 		fprintf(stderr, "%s: output CMS failure\n", prog);
 		goto end;
 	}
@@ -229,7 +229,7 @@ end:
 	if (infile && infp) fclose(infp);
 	if (outfile && outfp) fclose(outfp);
 	if (rcpt_certs) free(rcpt_certs);
-	if (inbuf) free(inbuf);
-	if (cms) free(cms);
+	gmssl_secure_clear(key, sizeof(key));
+	gmssl_secure_clear(&envelop_ctx, sizeof(envelop_ctx));
 	return ret;
 }
@@ -12,6 +12,8 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <gmssl/mem.h>
+#include <gmssl/pem.h>
 #include <gmssl/file.h>
 #include <gmssl/x509.h>
 #include <gmssl/cms.h>
@@ -19,19 +21,11 @@
 
 
 /*
-302 typedef struct {
-303         uint8_t *certs;
-304         size_t certs_len;
-305         SM2_KEY *sign_key;
-306 } CMS_CERTS_AND_KEY;
-
-
-
-输出长度主要由输入长度和
-
+The content is read from the input in chunks and never held in memory as a whole. Without
+-detach the content length must be known before the output starts, so -in is required.
 */
 
-static const char *options = "-key file -pass str -cert file -in file [-out file]";
+static const char *options = "-key file -pass str -cert file [-in file] [-detach] [-out file]";
 
 int cmssign_main(int argc, char **argv)
 {
@@ -42,18 +36,22 @@ int cmssign_main(int argc, char **argv)
 	char *certfile = NULL;
 	char *infile = NULL;
 	char *outfile = NULL;
+	int detach = 0;
 	FILE *keyfp = NULL;
 	FILE *certfp = NULL;
-	FILE *infp = NULL;
+	FILE *infp = stdin;
 	FILE *outfp = stdout;
 	SM2_KEY key;
 	uint8_t cert[1024];
 	size_t certlen;
-	uint8_t *in = NULL;
-	size_t inlen;
+	uint8_t buf[4096];
+	size_t len;
+	size_t inlen = 0;
 	uint8_t *cms = NULL;
-	size_t cmslen, cms_maxlen;
+	size_t cmslen;
 	CMS_CERTS_AND_KEY cert_and_key;
+	CMS_SIGN_CTX sign_ctx;
+	PEM_CTX pem_ctx;
 
 	argc--;
 	argv++;
@@ -63,7 +61,7 @@ int cmssign_main(int argc, char **argv)
 		return 1;
 	}
 
-	while (argc > 1) {
+	while (argc > 0) {
 		if (!strcmp(*argv, "-help")) {
 			printf("usage: %s %s\n", prog, options);
 			ret = 0;
@@ -92,6 +90,8 @@ int cmssign_main(int argc, char **argv)
 				fprintf(stderr, "%s: open '%s' failure : %s\n", prog, infile, strerror(errno));
 				goto end;
 			}
+		} else if (!strcmp(*argv, "-detach")) {
+			detach = 1;
 		} else if (!strcmp(*argv, "-out")) {
 			if (--argc < 1) goto bad;
 			outfile = *(++argv);
@@ -123,8 +123,8 @@ bad:
 		fprintf(stderr, "%s: '-cert' option required\n", prog);
 		goto end;
 	}
-	if (!infile) {
-		fprintf(stderr, "%s: '-in' option required\n", prog);
+	if (!infile && !detach) {
+		fprintf(stderr, "%s: '-in' option required without '-detach'\n", prog);
 		goto end;
 	}
 
@@ -152,31 +152,59 @@ bad:
 	cert_and_key.certs_len = certlen;
 	cert_and_key.sign_key = &key;
 
-	if (file_size(infp, &inlen) != 1) {
-		fprintf(stderr, "%s: get input length failed\n", prog);
+	if (pem_write_init(&pem_ctx, outfp, PEM_CMS) != 1) {
+		fprintf(stderr, "%s: output failure\n", prog);
 		goto end;
 	}
-	if (!(in = malloc(inlen))) {
-		fprintf(stderr, "%s: malloc failure\n", prog);
-		goto end;
+	if (detach) {
+		if (cms_sign_detached_init(&sign_ctx, &cert_and_key, 1, NULL, 0) != 1) {
+			fprintf(stderr, "%s: sign failure\n", prog);
+			goto end;
+		}
+	} else {
+		if (file_size(infp, &inlen) != 1) {
+			fprintf(stderr, "%s: get input length failed\n", prog);
+			goto end;
+		}
+		if (cms_sign_init(&sign_ctx, &cert_and_key, 1, NULL, 0, inlen, buf, &len) != 1) {
+			fprintf(stderr, "%s: sign failure\n", prog);
+			goto end;
+		}
+		if (pem_write_update(&pem_ctx, buf, len) != 1) {
+			fprintf(stderr, "%s: output failure\n", prog);
+			goto end;
+		}
 	}
-	if (fread(in, 1, inlen, infp) != inlen) {
-		fprintf(stderr, "%s: read file error : %s\n",  prog, strerror(errno));
+
+	while ((len = fread(buf, 1, sizeof(buf), infp)) > 0) {
+		if (cms_sign_update(&sign_ctx, buf, len) != 1) {
+			fprintf(stderr, "%s: sign failure\n", prog);
+			goto end;
+		}
+		if (!detach && pem_write_update(&pem_ctx, buf, len) != 1) {
+			fprintf(stderr, "%s: output failure\n", prog);
+			goto end;
+		}
+	}
+	if (ferror(infp)) {
+		fprintf(stderr, "%s: read file error : %s\n", prog, strerror(errno));
 		goto end;
 	}
 
-	cms_maxlen = (inlen * 4)/3 + 4096; // 主要由SignerInfos，其中的DN长度决定
-	if (!(cms = malloc(cms_maxlen))) {
+	if (cms_sign_finish(&sign_ctx, NULL, &cmslen) != 1) {
+		fprintf(stderr, "%s: sign failure\n", prog);
+		goto end;
+	}
+	if (!(cms = malloc(cmslen))) {
 		fprintf(stderr, "%s: malloc failure\n", prog);
 		goto end;
 	}
-
-	if (cms_sign(cms, &cmslen, &cert_and_key, 1, OID_cms_data, in, inlen, NULL, 0) != 1) {
+	if (cms_sign_finish(&sign_ctx, cms, &cmslen) != 1) {
 		fprintf(stderr, "%s: sign failure\n", prog);
 		goto end;
 	}
-
-	if (cms_to_pem(cms, cmslen, outfp) != 1) {
+	if (pem_write_update(&pem_ctx, cms, cmslen) != 1
+		|| pem_write_finish(&pem_ctx) != 1) {
 		fprintf(stderr, "%s: output failure\n", prog);
 		goto end;
 	}
@@ -187,7 +215,8 @@ end:
 	if (infile && infp) fclose(infp);
 	if (outfile && outfp) fclose(outfp);
 	if (keyfile && keyfp) fclose(keyfp);
+	if (certfile && certfp) fclose(certfp);
+	gmssl_secure_clear(&key, sizeof(key));
 	if (cms) free(cms);
-	if (in) free(in);
 	return ret;
 }
@@ -13,45 +13,45 @@
 #include <string.h>
 #include <stdlib.h>
 #include <gmssl/file.h>
+#include <gmssl/pem.h>
 #include <gmssl/cms.h>
 #include <gmssl/x509.h>
 #include <gmssl/rand.h>
 
 
+/*
+The attached content is written to -out while it is verified, the output must be discarded
+if the verification fails. A detached signature (from `cmssign -detach`) is verified over
+the -content file.
+*/
 
-static const char *options = "-in file [-out file]";
+static const char *options = "[-in file] [-content file] [-out file]";
 
 int cmsverify_main(int argc, char **argv)
 {
 	int ret = 1;
 	char *prog = argv[0];
 	char *infile = NULL;
+	char *contentfile = NULL;
 	char *outfile = NULL;
-	FILE *infp = NULL;
+	FILE *infp = stdin;
+	FILE *contentfp = NULL;
 	FILE *outfp = NULL;
 	size_t inlen;
 	uint8_t *cms = NULL;
 	size_t cmslen, cms_maxlen;
-	int content_type;
-	const uint8_t *content;
+	CMS_VERIFY_CTX verify_ctx;
+	PEM_CTX pem_ctx;
+	uint8_t buf[4096];
+	uint8_t content[sizeof(buf)];
+	size_t len;
 	size_t content_len;
-	const uint8_t *certs;
-	size_t certslen;
-	const uint8_t *crls;
-	size_t crlslen;
-	const uint8_t *signer_infos;
-	size_t signer_infos_len;
 	int rv;
 
 	argc--;
 	argv++;
 
-	if (argc < 1) {
-		fprintf(stderr, "usage: %s %s\n", prog, options);
-		return 1;
-	}
-
-	while (argc > 1) {
+	while (argc > 0) {
 		if (!strcmp(*argv, "-help")) {
 			printf("usage: %s %s\n", prog, options);
 			ret = 0;
@@ -63,6 +63,13 @@ int cmsverify_main(int argc, char **argv)
 				fprintf(stderr, "%s: open '%s' failure : %s\n", prog, infile, strerror(errno));
 				goto end;
 			}
+		} else if (!strcmp(*argv, "-content")) {
+			if (--argc < 1) goto bad;
+			contentfile = *(++argv);
+			if (!(contentfp = fopen(contentfile, "rb"))) {
+				fprintf(stderr, "%s: open '%s' failure : %s\n", prog, contentfile, strerror(errno));
+				goto end;
+			}
 		} else if (!strcmp(*argv, "-out")) {
 			if (--argc < 1) goto bad;
 			outfile = *(++argv);
@@ -82,59 +89,64 @@ bad:
 		argv++;
 	}
 
-	if (!infile) {
-		fprintf(stderr, "%s: '-in' option required\n", prog);
-		goto end;
-	}
-	if (file_size(infp, &inlen) != 1) {
-		fprintf(stderr, "%s: get input length failed\n", prog);
-		goto end;
-	}
-	cms_maxlen = (inlen * 3)/4 + 1;
-	if (!(cms = malloc(cms_maxlen))) {
-		fprintf(stderr, "%s: malloc failure\n", prog);
-		goto end;
-	}
-	if (cms_from_pem(cms, &cmslen, cms_maxlen, infp) != 1) {
-		fprintf(stderr, "%s: read CMS failure\n", prog);
-		goto end;
-	}
-
-	if ((rv = cms_verify(cms, cmslen, NULL, 0, NULL, 0,
-		&content_type, &content, &content_len,
-		&certs, &certslen, &crls, &crlslen,
-		&signer_infos, &signer_infos_len)) < 0) {
-		fprintf(stderr, "%s: verify error\n", prog);
-		goto end;
-	}
-	printf("verify %s\n", rv ? "success" : "failure");
-	ret = rv ? 0 : 1;
-
-	if (outfile) {
-		const uint8_t *p;
-		size_t len;
-
-		if (content_type == OID_cms_data) {
-			if (asn1_octet_string_from_der(&p, &len, &content, &content_len) != 1
-				|| asn1_length_is_zero(content_len) != 1) {
-				fprintf(stderr, "%s: invalid CMS\n", prog);
+	if (contentfile) {
+		if (!infile) {
+			fprintf(stderr, "%s: '-in' option required with '-content'\n", prog);
+			goto end;
+		}
+		if (file_size(infp, &inlen) != 1) {
+			fprintf(stderr, "%s: get input length failed\n", prog);
+			goto end;
+		}
+		cms_maxlen = (inlen * 3)/4 + 1;
+		if (!(cms = malloc(cms_maxlen))) {
+			fprintf(stderr, "%s: malloc failure\n", prog);
+			goto end;
+		}
+		if (cms_from_pem(cms, &cmslen, cms_maxlen, infp) != 1
+			|| cms_verify_detached_init(&verify_ctx, cms, cmslen) != 1) {
+			fprintf(stderr, "%s: read CMS failure\n", prog);
+			goto end;
+		}
+		while ((len = fread(buf, 1, sizeof(buf), contentfp)) > 0) {
+			if (cms_verify_detached_update(&verify_ctx, buf, len) != 1) {
+				fprintf(stderr, "%s: verify error\n", prog);
+				goto end;
+			}
+		}
+		if (ferror(contentfp)) {
+			fprintf(stderr, "%s: read file error : %s\n", prog, strerror(errno));
+			goto end;
+		}
+	} else {
+		if (pem_read_init(&pem_ctx, infp, PEM_CMS) != 1
+			|| cms_verify_init(&verify_ctx) != 1) {
+			fprintf(stderr, "%s: read CMS failure\n", prog);
+			goto end;
+		}
+		while ((rv = pem_read_update(&pem_ctx, buf, &len, sizeof(buf))) == 1) {
+			if (cms_verify_update(&verify_ctx, buf, len, outfp ? content : NULL, &content_len) != 1) {
+				fprintf(stderr, "%s: verify error\n", prog);
 				goto end;
 			}
-			if (len != fwrite(p, 1, len, outfp)) {
+			if (outfp && content_len != fwrite(content, 1, content_len, outfp)) {
 				fprintf(stderr, "%s: output error : %s\n", prog, strerror(errno));
 				goto end;
 			}
-		} else {
-			fprintf(stderr, "%s: error\n", prog);
+		}
+		if (rv < 0) {
+			fprintf(stderr, "%s: read CMS failure\n", prog);
 			goto end;
 		}
-
 	}
 
-
+	rv = cms_verify_finish(&verify_ctx);
+	printf("verify %s\n", rv == 1 ? "success" : "failure");
+	ret = rv == 1 ? 0 : 1;
 
 end:
 	if (infile && infp) fclose(infp);
+	if (contentfp) fclose(contentfp);
 	if (outfile && outfp) fclose(outfp);
 	if (cms) free(cms);
 	return ret;
@@ -15,6 +15,7 @@
 
 extern int version_main(int argc, char **argv);
 extern int rand_main(int argc, char **argv);
+extern int speed_main(int argc, char **argv);
 extern int certgen_main(int argc, char **argv);
 extern int certparse_main(int argc, char **argv);
 extern int certverify_main(int argc, char **argv);
@@ -53,6 +54,7 @@ extern int tls12_client_main(int argc, char **argv);
 extern int tls12_server_main(int argc, char **argv);
 extern int tls13_client_main(int argc, char **argv);
 extern int tls13_server_main(int argc, char **argv);
+extern int tlsperf_main(int argc, char **argv);
 extern int sdfutil_main(int argc, char **argv);
 extern int skfutil_main(int argc, char **argv);
 
@@ -65,6 +67,7 @@ static const char *options =
 	"  help            Print this help message\n"
 	"  version         Print version\n"
 	"  rand            Generate random bytes\n"
+	"  speed           Benchmark algorithms\n"
 	"  sm2keygen       Generate SM2 keypair\n"
 	"  sm2sign         Generate SM2 signature\n"
 	"  sm2verify       Verify SM2 signature\n"
@@ -105,6 +108,7 @@ static const char *options =
 	"  tls12_server    TLS 1.2 server\n"
 	"  tls13_client    TLS 1.3 client\n"
 	"  tls13_server    TLS 1.3 server\n"
+	"  tlsperf         TLS/TLCP handshake and throughput load generator\n"
 	"\n"
 	"run `gmssl <command> -help` to print help of the given command\n"
 	"\n";
@@ -131,6 +135,8 @@ int main(int argc, char **argv)
 			return version_main(argc, argv);
 		} else if (!strcmp(*argv, "rand")) {
 			return rand_main(argc, argv);
+		} else if (!strcmp(*argv, "speed")) {
+			return speed_main(argc, argv);
 		} else if (!strcmp(*argv, "certgen")) {
 			return certgen_main(argc, argv);
 		} else if (!strcmp(*argv, "certparse")) {
@@ -207,6 +213,8 @@ int main(int argc, char **argv)
 			return tls13_client_main(argc, argv);
 		} else if (!strcmp(*argv, "tls13_server")) {
 			return tls13_server_main(argc, argv);
+		} else if (!strcmp(*argv, "tlsperf")) {
+			return tlsperf_main(argc, argv);
 #ifndef WIN32
 		} else if (!strcmp(*argv, "sdfutil")) {
 			return sdfutil_main(argc, argv);
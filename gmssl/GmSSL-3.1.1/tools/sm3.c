@@ -12,12 +12,24 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 #include <gmssl/sm2.h>
 #include <gmssl/sm3.h>
+#include <gmssl/file.h>
 #include <gmssl/error.h>
 
 
-static const char *options = "[-hex|-bin] [-pubkey pem [-id str]] [-in file] [-out file]";
+#define SM3_TOOL_BUF_SIZE (1024 * 1024)
+
+static const char *options = "[-hex|-bin] [-pubkey pem [-id str]] [-tree [-leaf_size num] [-threads num]] [-in file] [-out file]";
+
+/*
+ * `-tree` outputs the SM3 tree hash defined in <gmssl/sm3.h>, the leaves are
+ * hashed by `-threads` threads, default the number of online CPUs. The output
+ * is not the SM3 digest of the input and depends on `-leaf_size`.
+ */
 
 int sm3_main(int argc, char **argv)
 {
@@ -31,12 +43,21 @@ int sm3_main(int argc, char **argv)
 	FILE *pubkeyfp = NULL;
 	FILE *infp = stdin;
 	FILE *outfp = stdout;
+	int tree = 0;
+	size_t leaf_size = SM3_TREE_DEFAULT_LEAF_SIZE;
+	int threads = 0;
 	SM3_CTX sm3_ctx;
+	SM3_TREE_CTX tree_ctx;
 	uint8_t dgst[32];
-	uint8_t buf[4096];
+	const uint8_t *data = NULL;
+	size_t datalen = 0;
+	uint8_t *buf = NULL;
+	size_t bufsize = SM3_TOOL_BUF_SIZE;
 	size_t len;
 	int i;
 
+	memset(&tree_ctx, 0, sizeof(tree_ctx));
+
 	argc--;
 	argv++;
 
@@ -44,6 +65,7 @@ int sm3_main(int argc, char **argv)
 		if (!strcmp(*argv, "-help")) {
 			printf("usage: %s %s\n", prog, options);
 			printf("usage: echo -n \"abc\" | %s\n", prog);
+			printf("usage: %s -tree -leaf_size 4194304 -threads 8 -in file\n", prog);
 			ret = 0;
 			goto end;
 		} else if (!strcmp(*argv, "-hex")) {
@@ -64,6 +86,22 @@ int sm3_main(int argc, char **argv)
 		} else if (!strcmp(*argv, "-id")) {
 			if (--argc < 1) goto bad;
 			id = *(++argv);
+		} else if (!strcmp(*argv, "-tree")) {
+			tree = 1;
+		} else if (!strcmp(*argv, "-leaf_size")) {
+			if (--argc < 1) goto bad;
+			leaf_size = (size_t)atol(*(++argv));
+			if (leaf_size < SM3_TREE_MIN_LEAF_SIZE || leaf_size > SM3_TREE_MAX_LEAF_SIZE) {
+				fprintf(stderr, "%s: invalid leaf_size\n", prog);
+				goto end;
+			}
+		} else if (!strcmp(*argv, "-threads")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1 || threads > SM3_TREE_MAX_THREADS) {
+				fprintf(stderr, "%s: invalid threads\n", prog);
+				goto end;
+			}
 		} else if (!strcmp(*argv, "-in")) {
 			if (--argc < 1) goto bad;
 			infile = *(++argv);
@@ -90,6 +128,32 @@ bad:
 		argv++;
 	}
 
+	if (tree) {
+		if (pubkeyfile) {
+			fprintf(stderr, "%s: option '-tree' can not be used with '-pubkey'\n", prog);
+			goto end;
+		}
+		if (!threads) {
+#ifndef WIN32
+			long n = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = n < 1 ? 1 : (n > SM3_TREE_MAX_THREADS ? SM3_TREE_MAX_THREADS : (int)n);
+#else
+			threads = 1;
+#endif
+		}
+		if (sm3_tree_init(&tree_ctx, leaf_size, threads) != 1) {
+			error_print();
+			goto end;
+		}
+		// every thread gets a leaf from each read
+		if (leaf_size * threads > bufsize) {
+			bufsize = leaf_size * threads;
+		}
+	} else if (threads || leaf_size != SM3_TREE_DEFAULT_LEAF_SIZE) {
+		fprintf(stderr, "%s: option '-threads' and '-leaf_size' must be with '-tree'\n", prog);
+		goto end;
+	}
+
 	sm3_init(&sm3_ctx);
 
 	if (pubkeyfile) {
@@ -113,10 +177,40 @@ bad:
 		}
 	}
 
-	while ((len = fread(buf, 1, sizeof(buf), infp)) > 0) {
-		sm3_update(&sm3_ctx, buf, len);
+	// a regular file is mapped and hashed in one call, otherwise read in large chunks
+	if (infile && file_map(infp, &data, &datalen) == 1) {
+		if (tree) {
+			if (sm3_tree_update(&tree_ctx, data, datalen) != 1) {
+				error_print();
+				goto end;
+			}
+		} else {
+			sm3_update(&sm3_ctx, data, datalen);
+		}
+	} else {
+		if (!(buf = malloc(bufsize))) {
+			fprintf(stderr, "%s: malloc failure\n", prog);
+			goto end;
+		}
+		while ((len = fread(buf, 1, bufsize, infp)) > 0) {
+			if (tree) {
+				if (sm3_tree_update(&tree_ctx, buf, len) != 1) {
+					error_print();
+					goto end;
+				}
+			} else {
+				sm3_update(&sm3_ctx, buf, len);
+			}
+		}
+	}
+	if (tree) {
+		if (sm3_tree_finish(&tree_ctx, dgst) != 1) {
+			error_print();
+			goto end;
+		}
+	} else {
+		sm3_finish(&sm3_ctx, dgst);
 	}
-	sm3_finish(&sm3_ctx, dgst);
 
 	if (bin) {
 		if (fwrite(dgst, 1, sizeof(dgst), outfp) != sizeof(dgst)) {
@@ -131,6 +225,9 @@ bad:
 	}
 	ret = 0;
 end:
+	sm3_tree_cleanup(&tree_ctx);
+	if (data) file_unmap(data, datalen);
+	if (buf) free(buf);
 	if (pubkeyfp) fclose(pubkeyfp);
 	if (infile && infp) fclose(infp);
 	if (outfile && outfp) fclose(outfp);
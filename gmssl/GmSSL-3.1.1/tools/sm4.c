@@ -12,9 +12,13 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 #include <gmssl/mem.h>
 #include <gmssl/sm4.h>
 #include <gmssl/hex.h>
+#include <gmssl/file.h>
 #include <gmssl/aead.h>
 #include <gmssl/error.h>
 
@@ -25,8 +29,11 @@
 #define SM4_MODE_CBC_SM3_HMAC 4
 #define SM4_MODE_CTR_SM3_HMAC 5
 
+// every thread gets 1 MB of each chunk
+#define SM4_TOOL_BUF_SIZE (1024 * 1024)
 
-static const char *usage = "(-cbc|-ctr|-gcm|-cbc_sm3_hmac|-ctr_sm3_hmac) {-encrypt|-decrypt} -key hex -iv hex [-aad str| -aad_hex hex] [-in file] [-out file]";
+
+static const char *usage = "(-cbc|-ctr|-gcm|-cbc_sm3_hmac|-ctr_sm3_hmac) {-encrypt|-decrypt} -key hex -iv hex [-aad str| -aad_hex hex] [-threads num] [-in file] [-out file]";
 
 static const char *options =
 "Options\n"
@@ -45,11 +52,15 @@ static const char *options =
 "    -iv hex             IV in HEX format\n"
 "    -aad str            Authenticated-only message\n"
 "    -aad_hex hex        Authenticated-only data in HEX format\n"
+"    -threads num        Threads of the CTR and GCM modes, default the number of online CPUs\n"
+"                        The input is split into independent counter ranges, the output is not changed\n"
 "    -in file | stdin    Input data\n"
 "    -out file | stdout  Output data\n"
 "\n"
 "Examples"
 "\n"
+"  gmssl sm4 -ctr -key 11223344556677881122334455667788 -iv 11223344556677881122334455667788 -threads 8 -in file -out ciphertext.bin\n"
+"\n"
 "  echo \"hello\" | gmssl sm4 -gcm -encrypt -key 11223344556677881122334455667788 -iv 112233445566778811223344 -out ciphertext.bin\n"
 "  gmssl sm4 -gcm -decrypt -key 11223344556677881122334455667788 -iv 112233445566778811223344 -in ciphertext.bin\n"
 "\n"
@@ -61,6 +72,22 @@ static const char *options =
 "                       -iv 11223344556677881122334455667788 -in ciphertext.bin\n"
 "\n";
 
+// the next chunk of a mapped file, or read into the buffer
+static size_t read_input(FILE *fp, const uint8_t *data, size_t datalen, size_t *offset,
+	uint8_t *buf, size_t bufsize, const uint8_t **in)
+{
+	size_t len;
+
+	if (data) {
+		len = datalen - *offset < bufsize ? datalen - *offset : bufsize;
+		*in = data + *offset;
+		*offset += len;
+		return len;
+	}
+	*in = buf;
+	return fread(buf, 1, bufsize, fp);
+}
+
 int sm4_main(int argc, char **argv)
 {
 	int ret = 1;
@@ -81,6 +108,7 @@ int sm4_main(int argc, char **argv)
 	FILE *outfp = stdout;
 	int mode = 0;
 	int enc = -1;
+	int threads = 0;
 	int rv;
 	union {
 		SM4_CBC_CTX cbc;
@@ -89,10 +117,15 @@ int sm4_main(int argc, char **argv)
 		SM4_CTR_SM3_HMAC_CTX ctr_sm3_hmac;
 		SM4_GCM_CTX gcm;
 	} sm4_ctx;
-	uint8_t inbuf[4096];
+	const uint8_t *data = NULL;
+	size_t datalen = 0;
+	size_t offset = 0;
+	const uint8_t *in;
+	uint8_t *inbuf = NULL;
 	size_t inlen;
-	uint8_t outbuf[4196];
+	uint8_t *outbuf = NULL;
 	size_t outlen;
+	size_t bufsize = 0;
 
 	argc--;
 	argv++;
@@ -173,6 +206,13 @@ int sm4_main(int argc, char **argv)
 				goto end;
 			}
 			aad = aad_buf;
+		} else if (!strcmp(*argv, "-threads")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1 || threads > SM4_MAX_THREADS) {
+				fprintf(stderr, "%s: invalid threads\n", prog);
+				goto end;
+			}
 		} else if (!strcmp(*argv, "-in")) {
 			if (--argc < 1) goto bad;
 			infile = *(++argv);
@@ -252,13 +292,46 @@ bad:
 		break;
 	}
 
+	switch (mode) {
+	case SM4_MODE_CTR:
+	case SM4_MODE_GCM:
+		if (!threads) {
+#ifndef WIN32
+			long n = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = n < 1 ? 1 : (n > SM4_MAX_THREADS ? SM4_MAX_THREADS : (int)n);
+#else
+			threads = 1;
+#endif
+		}
+		break;
+	default:
+		if (threads > 1) {
+			fprintf(stderr, "%s: option `-threads` only supported by `-ctr` and `-gcm`\n", prog);
+			goto end;
+		}
+		threads = 1;
+	}
+
+	// the output of update and finish is at most the input plus padding and MAC
+	bufsize = SM4_TOOL_BUF_SIZE * threads;
+	if (!(outbuf = malloc(bufsize + 100))) {
+		fprintf(stderr, "%s: malloc failure\n", prog);
+		goto end;
+	}
+	if (!infile || file_map(infp, &data, &datalen) != 1) {
+		if (!(inbuf = malloc(bufsize))) {
+			fprintf(stderr, "%s: malloc failure\n", prog);
+			goto end;
+		}
+	}
+
 	if (mode == SM4_MODE_CTR) {
 		if (sm4_ctr_encrypt_init(&sm4_ctx.ctr, key, iv) != 1) {
 			error_print();
 			goto end;
 		}
-		while ((inlen = fread(inbuf, 1, sizeof(inbuf), infp)) > 0) {
-			if (sm4_ctr_encrypt_update(&sm4_ctx.ctr, inbuf, inlen, outbuf, &outlen) != 1) {
+		while ((inlen = read_input(infp, data, datalen, &offset, inbuf, bufsize, &in)) > 0) {
+			if (sm4_ctr_encrypt_update_threads(&sm4_ctx.ctr, in, inlen, outbuf, &outlen, threads) != 1) {
 				error_print();
 				goto end;
 			}
@@ -297,12 +370,12 @@ bad:
 			goto end;
 		}
 
-		while ((inlen = fread(inbuf, 1, sizeof(inbuf), infp)) > 0) {
+		while ((inlen = read_input(infp, data, datalen, &offset, inbuf, bufsize, &in)) > 0) {
 			switch (mode) {
-			case SM4_MODE_CBC: rv = sm4_cbc_encrypt_update(&sm4_ctx.cbc, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_GCM: rv = sm4_gcm_encrypt_update(&sm4_ctx.gcm, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_CBC_SM3_HMAC: rv = sm4_cbc_sm3_hmac_encrypt_update(&sm4_ctx.cbc_sm3_hmac, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_CTR_SM3_HMAC: rv = sm4_ctr_sm3_hmac_encrypt_update(&sm4_ctx.ctr_sm3_hmac, inbuf, inlen, outbuf, &outlen); break;
+			case SM4_MODE_CBC: rv = sm4_cbc_encrypt_update(&sm4_ctx.cbc, in, inlen, outbuf, &outlen); break;
+			case SM4_MODE_GCM: rv = sm4_gcm_encrypt_update_threads(&sm4_ctx.gcm, in, inlen, outbuf, &outlen, threads); break;
+			case SM4_MODE_CBC_SM3_HMAC: rv = sm4_cbc_sm3_hmac_encrypt_update(&sm4_ctx.cbc_sm3_hmac, in, inlen, outbuf, &outlen); break;
+			case SM4_MODE_CTR_SM3_HMAC: rv = sm4_ctr_sm3_hmac_encrypt_update(&sm4_ctx.ctr_sm3_hmac, in, inlen, outbuf, &outlen); break;
 			}
 			if (rv != 1) {
 				error_print();
@@ -341,12 +414,12 @@ bad:
 			goto end;
 		}
 
-		while ((inlen = fread(inbuf, 1, sizeof(inbuf), infp)) > 0) {
+		while ((inlen = read_input(infp, data, datalen, &offset, inbuf, bufsize, &in)) > 0) {
 			switch (mode) {
-			case SM4_MODE_CBC: rv = sm4_cbc_decrypt_update(&sm4_ctx.cbc, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_GCM: rv = sm4_gcm_decrypt_update(&sm4_ctx.gcm, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_CBC_SM3_HMAC: rv = sm4_cbc_sm3_hmac_decrypt_update(&sm4_ctx.cbc_sm3_hmac, inbuf, inlen, outbuf, &outlen); break;
-			case SM4_MODE_CTR_SM3_HMAC: rv = sm4_ctr_sm3_hmac_decrypt_update(&sm4_ctx.ctr_sm3_hmac, inbuf, inlen, outbuf, &outlen); break;
+			case SM4_MODE_CBC: rv = sm4_cbc_decrypt_update(&sm4_ctx.cbc, in, inlen, outbuf, &outlen); break;
+			case SM4_MODE_GCM: rv = sm4_gcm_decrypt_update_threads(&sm4_ctx.gcm, in, inlen, outbuf, &outlen, threads); break;
+			case SM4_MODE_CBC_SM3_HMAC: rv = sm4_cbc_sm3_hmac_decrypt_update(&sm4_ctx.cbc_sm3_hmac, in, inlen, outbuf, &outlen); break;
+			case SM4_MODE_CTR_SM3_HMAC: rv = sm4_ctr_sm3_hmac_decrypt_update(&sm4_ctx.ctr_sm3_hmac, in, inlen, outbuf, &outlen); break;
 			}
 			if (rv != 1) {
 				error_print();
@@ -380,8 +453,15 @@ end:
 	gmssl_secure_clear(&sm4_ctx, sizeof(sm4_ctx));
 	gmssl_secure_clear(key, sizeof(key));
 	gmssl_secure_clear(iv, sizeof(iv));
-	gmssl_secure_clear(inbuf, sizeof(inbuf));
-	gmssl_secure_clear(outbuf, sizeof(outbuf));
+	if (inbuf) {
+		gmssl_secure_clear(inbuf, bufsize);
+		free(inbuf);
+	}
+	if (outbuf) {
+		gmssl_secure_clear(outbuf, bufsize + 100);
+		free(outbuf);
+	}
+	if (data) file_unmap(data, datalen);
 	if (aad_buf) {
 		gmssl_secure_clear(aad_buf, aadlen);
 		free(aad_buf);
@@ -0,0 +1,817 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+#include <gmssl/mem.h>
+#include <gmssl/sm2.h>
+#include <gmssl/sm3.h>
+#include <gmssl/sm4.h>
+#include <gmssl/sm9.h>
+#ifdef SM2_EXTS
+#include <gmssl/sm2_ring.h>
+#endif
+#include <gmssl/zuc.h>
+#include <gmssl/x509.h>
+#include <gmssl/x509_ext.h>
+#include <gmssl/aead.h>
+#include <gmssl/rand.h>
+#include <gmssl/error.h>
+
+
+/*
+Each algorithm is run in a loop for `-seconds` seconds. Bulk algorithms are measured
+with every buffer size in speed_sizes and reported in 1000s of bytes per second,
+public key algorithms are reported in operations per second. With `-multi N` the
+loop is run by N threads at the same time and the sum of their rates is reported.
+
+Keys, signatures and ciphertexts are prepared once and shared read-only by all
+threads, each thread has its own input and output buffers.
+*/
+
+#define SPEED_MAX_BUF_SIZE	16384
+#define SPEED_MAX_THREADS	256
+#define SPEED_SM9_ID		"Alice"
+
+static const size_t speed_sizes[] = { 16, 64, 256, 1024, 8192, 16384 };
+#define SPEED_SIZES_CNT		(sizeof(speed_sizes)/sizeof(speed_sizes[0]))
+
+#ifdef SM2_EXTS
+// the ring of size n is the first n keys, the key of sm2_key is the first one
+static const size_t speed_sm2_ring_sizes[] = { 8, 64, 256, 1024 };
+#define SPEED_SM2_RING_SIZES_CNT	(sizeof(speed_sm2_ring_sizes)/sizeof(speed_sm2_ring_sizes[0]))
+#define SPEED_SM2_RING_MAX_SIZE		1024
+#endif
+
+typedef struct {
+	uint8_t key[48];
+	uint8_t iv[16];
+	SM4_KEY sm4_key;
+	SM2_KEY sm2_key;
+	uint8_t sm2_peer[65];
+	uint8_t dgst[32];
+	uint8_t sm2_sig[SM2_MAX_SIGNATURE_SIZE];
+	size_t sm2_siglen;
+	uint8_t sm2_ciphertext[SM2_MAX_CIPHERTEXT_SIZE];
+	size_t sm2_ciphertext_len;
+	SM9_SIGN_MASTER_KEY sm9_sign_master;
+	SM9_SIGN_KEY sm9_sign_key;
+	uint8_t sm9_sig[SM9_SIGNATURE_SIZE];
+	size_t sm9_siglen;
+	SM9_ENC_MASTER_KEY sm9_enc_master;
+	SM9_ENC_KEY sm9_enc_key;
+	SM9_POINT sm9_kem_C;
+	uint8_t x509_name[256];
+	size_t x509_name_len;
+	uint8_t x509_exts[256];
+	size_t x509_exts_len;
+#ifdef SM2_EXTS
+	SM2_POINT sm2_ring_keys[SPEED_SM2_RING_MAX_SIZE];
+	sm2_bn_t sm2_ring_r[SPEED_SM2_RING_SIZES_CNT];
+	sm2_bn_t sm2_ring_s[SPEED_SM2_RING_SIZES_CNT][SPEED_SM2_RING_MAX_SIZE];
+#endif
+} SPEED_KEYS;
+
+typedef struct {
+	const SPEED_KEYS *keys;
+	uint8_t in[SPEED_MAX_BUF_SIZE];
+	uint8_t out[SPEED_MAX_BUF_SIZE + 64];
+} SPEED_BUF;
+
+typedef struct {
+	const char *name;
+	int bulk; // bytes per second over speed_sizes, or operations per second
+	int (*func)(SPEED_BUF *buf, size_t len);
+} SPEED_ALGOR;
+
+
+static int speed_sm3(SPEED_BUF *buf, size_t len)
+{
+	sm3_digest(buf->in, len, buf->out);
+	return 1;
+}
+
+static int speed_sm3_hmac(SPEED_BUF *buf, size_t len)
+{
+	sm3_hmac(buf->keys->key, 32, buf->in, len, buf->out);
+	return 1;
+}
+
+static int speed_sm4_ecb(SPEED_BUF *buf, size_t len)
+{
+	size_t i;
+	for (i = 0; i < len; i += SM4_BLOCK_SIZE) {
+		sm4_encrypt(&buf->keys->sm4_key, buf->in + i, buf->out + i);
+	}
+	return 1;
+}
+
+static int speed_sm4_cbc(SPEED_BUF *buf, size_t len)
+{
+	sm4_cbc_encrypt(&buf->keys->sm4_key, buf->keys->iv, buf->in, len/SM4_BLOCK_SIZE, buf->out);
+	return 1;
+}
+
+static int speed_sm4_ctr(SPEED_BUF *buf, size_t len)
+{
+	uint8_t ctr[16];
+	memcpy(ctr, buf->keys->iv, sizeof(ctr));
+	sm4_ctr_encrypt(&buf->keys->sm4_key, ctr, buf->in, len, buf->out);
+	return 1;
+}
+
+static int speed_sm4_gcm(SPEED_BUF *buf, size_t len)
+{
+	uint8_t tag[SM4_GCM_MAX_TAG_SIZE];
+	return sm4_gcm_encrypt(&buf->keys->sm4_key, buf->keys->iv, SM4_GCM_DEFAULT_IV_SIZE,
+		NULL, 0, buf->in, len, buf->out, sizeof(tag), tag);
+}
+
+static int speed_zuc(SPEED_BUF *buf, size_t len)
+{
+	ZUC_STATE state;
+	zuc_init(&state, buf->keys->key, buf->keys->iv);
+	zuc_encrypt(&state, buf->in, len, buf->out);
+	return 1;
+}
+
+static int speed_sm4_cbc_sm3_hmac(SPEED_BUF *buf, size_t len)
+{
+	SM4_CBC_SM3_HMAC_CTX ctx;
+	size_t outlen, lastlen;
+
+	if (sm4_cbc_sm3_hmac_encrypt_init(&ctx, buf->keys->key, SM4_CBC_SM3_HMAC_KEY_SIZE,
+			buf->keys->iv, SM4_CBC_SM3_HMAC_IV_SIZE, NULL, 0) != 1
+		|| sm4_cbc_sm3_hmac_encrypt_update(&ctx, buf->in, len, buf->out, &outlen) != 1
+		|| sm4_cbc_sm3_hmac_encrypt_finish(&ctx, buf->out + outlen, &lastlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int speed_sm4_ctr_sm3_hmac(SPEED_BUF *buf, size_t len)
+{
+	SM4_CTR_SM3_HMAC_CTX ctx;
+	size_t outlen, lastlen;
+
+	if (sm4_ctr_sm3_hmac_encrypt_init(&ctx, buf->keys->key, SM4_CTR_SM3_HMAC_KEY_SIZE,
+			buf->keys->iv, SM4_CTR_SM3_HMAC_IV_SIZE, NULL, 0) != 1
+		|| sm4_ctr_sm3_hmac_encrypt_update(&ctx, buf->in, len, buf->out, &outlen) != 1
+		|| sm4_ctr_sm3_hmac_encrypt_finish(&ctx, buf->out + outlen, &lastlen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int speed_rand(SPEED_BUF *buf, size_t len)
+{
+	size_t i;
+	// some platforms limit a single rand_bytes() call to 256 bytes
+	for (i = 0; i < len; i += 256) {
+		if (rand_bytes(buf->out + i, len - i < 256 ? len - i : 256) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+static int speed_sm2_sign(SPEED_BUF *buf, size_t len)
+{
+	size_t siglen;
+	return sm2_sign(&buf->keys->sm2_key, buf->keys->dgst, buf->out, &siglen);
+}
+
+static int speed_sm2_verify(SPEED_BUF *buf, size_t len)
+{
+	return sm2_verify(&buf->keys->sm2_key, buf->keys->dgst,
+		buf->keys->sm2_sig, buf->keys->sm2_siglen);
+}
+
+static int speed_sm2_encrypt(SPEED_BUF *buf, size_t len)
+{
+	size_t outlen;
+	return sm2_encrypt(&buf->keys->sm2_key, buf->in, 32, buf->out, &outlen);
+}
+
+static int speed_sm2_decrypt(SPEED_BUF *buf, size_t len)
+{
+	size_t outlen;
+	return sm2_decrypt(&buf->keys->sm2_key, buf->keys->sm2_ciphertext,
+		buf->keys->sm2_ciphertext_len, buf->out, &outlen);
+}
+
+static int speed_sm2_ecdh(SPEED_BUF *buf, size_t len)
+{
+	SM2_POINT P;
+	return sm2_ecdh(&buf->keys->sm2_key, buf->keys->sm2_peer, sizeof(buf->keys->sm2_peer), &P);
+}
+
+// field inversion and square root, the input is the digest as a number less than n
+static int speed_sm2_fp_inv(SPEED_BUF *buf, size_t len)
+{
+	SM2_BN a;
+	sm2_bn_from_bytes(a, buf->keys->dgst);
+	sm2_fp_inv(a, a);
+	return 1;
+}
+
+static int speed_sm2_fp_inv_fermat(SPEED_BUF *buf, size_t len)
+{
+	SM2_BN a;
+	sm2_bn_from_bytes(a, buf->keys->dgst);
+	sm2_fp_inv_fermat(a, a);
+	return 1;
+}
+
+static int speed_sm2_fn_inv(SPEED_BUF *buf, size_t len)
+{
+	SM2_BN a;
+	sm2_bn_from_bytes(a, buf->keys->dgst);
+	sm2_fn_inv(a, a);
+	return 1;
+}
+
+static int speed_sm2_fn_inv_fermat(SPEED_BUF *buf, size_t len)
+{
+	SM2_BN a;
+	sm2_bn_from_bytes(a, buf->keys->dgst);
+	sm2_fn_inv_fermat(a, a);
+	return 1;
+}
+
+static int speed_sm2_fp_sqrt(SPEED_BUF *buf, size_t len)
+{
+	SM2_BN a;
+	sm2_bn_from_bytes(a, buf->keys->dgst);
+	sm2_fp_sqr(a, a);
+	return sm2_fp_sqrt(a, a);
+}
+
+static int speed_sm9_sign(SPEED_BUF *buf, size_t len)
+{
+	SM9_SIGN_CTX ctx;
+	size_t siglen;
+
+	if (sm9_sign_init(&ctx) != 1
+		|| sm9_sign_update(&ctx, buf->in, 32) != 1
+		|| sm9_sign_finish(&ctx, &buf->keys->sm9_sign_key, buf->out, &siglen) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int speed_sm9_verify(SPEED_BUF *buf, size_t len)
+{
+	SM9_SIGN_CTX ctx;
+
+	if (sm9_verify_init(&ctx) != 1
+		|| sm9_verify_update(&ctx, buf->keys->dgst, sizeof(buf->keys->dgst)) != 1
+		|| sm9_verify_finish(&ctx, buf->keys->sm9_sig, buf->keys->sm9_siglen,
+			&buf->keys->sm9_sign_master, SPEED_SM9_ID, strlen(SPEED_SM9_ID)) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static int speed_sm9_kem_encrypt(SPEED_BUF *buf, size_t len)
+{
+	SM9_POINT C;
+	return sm9_kem_encrypt(&buf->keys->sm9_enc_master, SPEED_SM9_ID, strlen(SPEED_SM9_ID),
+		32, buf->out, &C);
+}
+
+static int speed_sm9_kem_decrypt(SPEED_BUF *buf, size_t len)
+{
+	return sm9_kem_decrypt(&buf->keys->sm9_enc_key, SPEED_SM9_ID, strlen(SPEED_SM9_ID),
+		&buf->keys->sm9_kem_C, 32, buf->out);
+}
+
+static int speed_sm9_pairing(SPEED_BUF *buf, size_t len)
+{
+	sm9_fp12_t r;
+	sm9_pairing(r, &buf->keys->sm9_sign_master.Ppubs, &buf->keys->sm9_enc_master.Ppube);
+	return 1;
+}
+
+// a self-signed CA certificate, x509_cert_encode is the DER encoding without the signature
+static int speed_x509_cert(SPEED_BUF *buf, int sign)
+{
+	const SPEED_KEYS *keys = buf->keys;
+	uint8_t *p = buf->out;
+	size_t len = 0;
+	time_t not_before = 1700000000;
+
+	return x509_cert_sign_to_der(X509_version_v3, buf->in, 20, OID_sm2sign_with_sm3,
+		keys->x509_name, keys->x509_name_len,
+		not_before, not_before + 365 * 24 * 60 * 60,
+		keys->x509_name, keys->x509_name_len,
+		&keys->sm2_key, NULL, 0, NULL, 0,
+		keys->x509_exts, keys->x509_exts_len,
+		&keys->sm2_key, SM2_DEFAULT_ID, SM2_DEFAULT_ID_LENGTH,
+		sign ? &p : NULL, &len);
+}
+
+static int speed_x509_cert_sign(SPEED_BUF *buf, size_t len)
+{
+	return speed_x509_cert(buf, 1);
+}
+
+static int speed_x509_cert_encode(SPEED_BUF *buf, size_t len)
+{
+	return speed_x509_cert(buf, 0);
+}
+
+#ifdef SM2_EXTS
+static int speed_sm2_ring_sign(SPEED_BUF *buf, size_t i)
+{
+	uint8_t r[32];
+	sm2_bn_t s[SPEED_SM2_RING_MAX_SIZE];
+	return sm2_ring_do_sign(&buf->keys->sm2_key, buf->keys->sm2_ring_keys, speed_sm2_ring_sizes[i],
+		buf->keys->dgst, r, s);
+}
+
+static int speed_sm2_ring_verify(SPEED_BUF *buf, size_t i)
+{
+	return sm2_ring_do_verify(buf->keys->sm2_ring_keys, speed_sm2_ring_sizes[i],
+		buf->keys->dgst, buf->keys->sm2_ring_r[i], buf->keys->sm2_ring_s[i]);
+}
+
+#define SPEED_SM2_RING(n, i) \
+static int speed_sm2_ring_sign_##n(SPEED_BUF *buf, size_t len) { return speed_sm2_ring_sign(buf, i); } \
+static int speed_sm2_ring_verify_##n(SPEED_BUF *buf, size_t len) { return speed_sm2_ring_verify(buf, i); }
+
+SPEED_SM2_RING(8, 0)
+SPEED_SM2_RING(64, 1)
+SPEED_SM2_RING(256, 2)
+SPEED_SM2_RING(1024, 3)
+#endif
+
+static const SPEED_ALGOR speed_algors[] = {
+	{ "sm3",		1, speed_sm3 },
+	{ "sm3_hmac",		1, speed_sm3_hmac },
+	{ "sm4_ecb",		1, speed_sm4_ecb },
+	{ "sm4_cbc",		1, speed_sm4_cbc },
+	{ "sm4_ctr",		1, speed_sm4_ctr },
+	{ "sm4_gcm",		1, speed_sm4_gcm },
+	{ "sm4_cbc_sm3_hmac",	1, speed_sm4_cbc_sm3_hmac },
+	{ "sm4_ctr_sm3_hmac",	1, speed_sm4_ctr_sm3_hmac },
+	{ "zuc",		1, speed_zuc },
+	{ "rand",		1, speed_rand },
+	{ "sm2_sign",		0, speed_sm2_sign },
+	{ "sm2_verify",		0, speed_sm2_verify },
+	{ "sm2_encrypt",	0, speed_sm2_encrypt },
+	{ "sm2_decrypt",	0, speed_sm2_decrypt },
+	{ "sm2_ecdh",		0, speed_sm2_ecdh },
+	{ "sm2_fp_inv",		0, speed_sm2_fp_inv },
+	{ "sm2_fp_inv_fermat",	0, speed_sm2_fp_inv_fermat },
+	{ "sm2_fn_inv",		0, speed_sm2_fn_inv },
+	{ "sm2_fn_inv_fermat",	0, speed_sm2_fn_inv_fermat },
+	{ "sm2_fp_sqrt",	0, speed_sm2_fp_sqrt },
+#ifdef SM2_EXTS
+	{ "sm2_ring_sign_8",	0, speed_sm2_ring_sign_8 },
+	{ "sm2_ring_sign_64",	0, speed_sm2_ring_sign_64 },
+	{ "sm2_ring_sign_256",	0, speed_sm2_ring_sign_256 },
+	{ "sm2_ring_sign_1024",	0, speed_sm2_ring_sign_1024 },
+	{ "sm2_ring_verify_8",	0, speed_sm2_ring_verify_8 },
+	{ "sm2_ring_verify_64",	0, speed_sm2_ring_verify_64 },
+	{ "sm2_ring_verify_256",	0, speed_sm2_ring_verify_256 },
+	{ "sm2_ring_verify_1024",	0, speed_sm2_ring_verify_1024 },
+#endif
+	{ "sm9_sign",		0, speed_sm9_sign },
+	{ "sm9_verify",		0, speed_sm9_verify },
+	{ "sm9_kem_encrypt",	0, speed_sm9_kem_encrypt },
+	{ "sm9_kem_decrypt",	0, speed_sm9_kem_decrypt },
+	{ "sm9_pairing",	0, speed_sm9_pairing },
+	{ "x509_cert_sign",	0, speed_x509_cert_sign },
+	{ "x509_cert_encode",	0, speed_x509_cert_encode },
+};
+#define SPEED_ALGORS_CNT	(sizeof(speed_algors)/sizeof(speed_algors[0]))
+
+static int speed_keys_init(SPEED_KEYS *keys)
+{
+	SM2_KEY peer;
+	SM9_SIGN_CTX sign_ctx;
+	uint8_t kbuf[32];
+
+	memset(keys, 0, sizeof(SPEED_KEYS));
+	if (rand_bytes(keys->key, sizeof(keys->key)) != 1
+		|| rand_bytes(keys->iv, sizeof(keys->iv)) != 1
+		|| rand_bytes(keys->dgst, sizeof(keys->dgst)) != 1) {
+		error_print();
+		return -1;
+	}
+	sm4_set_encrypt_key(&keys->sm4_key, keys->key);
+
+	if (sm2_key_generate(&keys->sm2_key) != 1
+		|| sm2_key_generate(&peer) != 1) {
+		error_print();
+		return -1;
+	}
+	sm2_point_to_uncompressed_octets(&peer.public_key, keys->sm2_peer);
+	if (sm2_sign(&keys->sm2_key, keys->dgst, keys->sm2_sig, &keys->sm2_siglen) != 1
+		|| sm2_encrypt(&keys->sm2_key, keys->dgst, sizeof(keys->dgst),
+			keys->sm2_ciphertext, &keys->sm2_ciphertext_len) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (sm9_sign_master_key_generate(&keys->sm9_sign_master) != 1
+		|| sm9_sign_master_key_extract_key(&keys->sm9_sign_master,
+			SPEED_SM9_ID, strlen(SPEED_SM9_ID), &keys->sm9_sign_key) != 1
+		|| sm9_sign_init(&sign_ctx) != 1
+		|| sm9_sign_update(&sign_ctx, keys->dgst, sizeof(keys->dgst)) != 1
+		|| sm9_sign_finish(&sign_ctx, &keys->sm9_sign_key, keys->sm9_sig, &keys->sm9_siglen) != 1) {
+		error_print();
+		return -1;
+	}
+	if (sm9_enc_master_key_generate(&keys->sm9_enc_master) != 1
+		|| sm9_enc_master_key_extract_key(&keys->sm9_enc_master,
+			SPEED_SM9_ID, strlen(SPEED_SM9_ID), &keys->sm9_enc_key) != 1
+		|| sm9_kem_encrypt(&keys->sm9_enc_master, SPEED_SM9_ID, strlen(SPEED_SM9_ID),
+			sizeof(kbuf), kbuf, &keys->sm9_kem_C) != 1) {
+		error_print();
+		return -1;
+	}
+
+	if (x509_name_set(keys->x509_name, &keys->x509_name_len, sizeof(keys->x509_name),
+			"CN", "Beijing", "Haidian", "PKU", "CS", "Speed CA") != 1
+		|| x509_exts_add_key_usage(keys->x509_exts, &keys->x509_exts_len, sizeof(keys->x509_exts),
+			1, X509_KU_KEY_CERT_SIGN|X509_KU_CRL_SIGN) != 1
+		|| x509_exts_add_basic_constraints(keys->x509_exts, &keys->x509_exts_len, sizeof(keys->x509_exts),
+			1, 1, -1) != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+#ifdef SM2_EXTS
+// signing the rings of 1024 keys takes a while, only done when they are selected
+static int speed_sm2_ring_keys_init(SPEED_KEYS *keys)
+{
+	SM2_KEY key;
+	size_t i;
+
+	keys->sm2_ring_keys[0] = keys->sm2_key.public_key;
+	for (i = 1; i < SPEED_SM2_RING_MAX_SIZE; i++) {
+		if (sm2_key_generate(&key) != 1) {
+			error_print();
+			return -1;
+		}
+		keys->sm2_ring_keys[i] = key.public_key;
+	}
+	for (i = 0; i < SPEED_SM2_RING_SIZES_CNT; i++) {
+		if (sm2_ring_do_sign(&keys->sm2_key, keys->sm2_ring_keys, speed_sm2_ring_sizes[i],
+			keys->dgst, keys->sm2_ring_r[i], keys->sm2_ring_s[i]) != 1) {
+			error_print();
+			return -1;
+		}
+	}
+	gmssl_secure_clear(&key, sizeof(key));
+	return 1;
+}
+#endif
+
+static double speed_time(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+typedef struct {
+	const SPEED_ALGOR *algor;
+	const SPEED_KEYS *keys;
+	size_t len;
+	double seconds;
+	uint64_t count;
+	double elapsed;
+	int ret;
+} SPEED_JOB;
+
+static void *speed_worker(void *arg)
+{
+	SPEED_JOB *job = arg;
+	SPEED_BUF *buf;
+	size_t batch;
+	double start;
+	size_t i;
+
+	job->ret = -1;
+	job->count = 0;
+	job->elapsed = 0;
+
+	if (!(buf = malloc(sizeof(SPEED_BUF)))) {
+		error_print();
+		return NULL;
+	}
+	buf->keys = job->keys;
+	for (i = 0; i < sizeof(buf->in); i++) {
+		buf->in[i] = (uint8_t)i;
+	}
+
+	// read the clock less often for short messages
+	batch = job->algor->bulk ? SPEED_MAX_BUF_SIZE/job->len : 1;
+
+	start = speed_time();
+	do {
+		for (i = 0; i < batch; i++) {
+			if (job->algor->func(buf, job->len) != 1) {
+				error_print();
+				goto end;
+			}
+		}
+		job->count += batch;
+		job->elapsed = speed_time() - start;
+	} while (job->elapsed < job->seconds);
+	job->ret = 1;
+
+end:
+	free(buf);
+	return NULL;
+}
+
+// returns bytes per second of bulk algorithms or operations per second
+static int speed_run(const SPEED_ALGOR *algor, const SPEED_KEYS *keys, size_t len,
+	double seconds, int threads, double *rate)
+{
+	SPEED_JOB jobs[SPEED_MAX_THREADS];
+	int i;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].algor = algor;
+		jobs[i].keys = keys;
+		jobs[i].len = len;
+		jobs[i].seconds = seconds;
+	}
+#ifdef WIN32
+	speed_worker(&jobs[0]);
+#else
+	if (threads == 1) {
+		speed_worker(&jobs[0]);
+	} else {
+		pthread_t tids[SPEED_MAX_THREADS];
+		int started;
+
+		for (started = 0; started < threads; started++) {
+			if (pthread_create(&tids[started], NULL, speed_worker, &jobs[started]) != 0) {
+				break;
+			}
+		}
+		for (i = 0; i < started; i++) {
+			pthread_join(tids[i], NULL);
+		}
+		if (started < threads) {
+			error_print();
+			return -1;
+		}
+	}
+#endif
+
+	*rate = 0;
+	for (i = 0; i < threads; i++) {
+		if (jobs[i].ret != 1 || jobs[i].elapsed <= 0) {
+			error_print();
+			return -1;
+		}
+		*rate += (double)jobs[i].count * (algor->bulk ? len : 1) / jobs[i].elapsed;
+	}
+	return 1;
+}
+
+// an exact name only selects itself, otherwise `sm4` selects sm4_ecb, sm4_cbc, ...
+static int speed_select(int selected[SPEED_ALGORS_CNT], const char *arg)
+{
+	size_t len = strlen(arg);
+	int found = 0;
+	size_t i;
+
+	for (i = 0; i < SPEED_ALGORS_CNT; i++) {
+		if (!strcmp(speed_algors[i].name, arg)) {
+			selected[i] = 1;
+			return 1;
+		}
+	}
+	for (i = 0; i < SPEED_ALGORS_CNT; i++) {
+		if (!strncmp(speed_algors[i].name, arg, len) && speed_algors[i].name[len] == '_') {
+			selected[i] = 1;
+			found = 1;
+		}
+	}
+	return found;
+}
+
+static const char *options = "[-seconds num] [-multi num] [-json] [algor ...]";
+
+static const char *help =
+"Options\n"
+"\n"
+"    -seconds num        Run each test for num seconds, default 1\n"
+"    -multi num          Run each test in num threads and report the total\n"
+"    -json               Output results as JSON\n"
+"    algor               Only run the given algorithms, a prefix such as sm4 or sm9\n"
+"                        selects all the algorithms starting with it\n"
+"\n"
+"Algorithms\n"
+"\n"
+"    sm3 sm3_hmac sm4_ecb sm4_cbc sm4_ctr sm4_gcm sm4_cbc_sm3_hmac sm4_ctr_sm3_hmac\n"
+"    zuc rand sm2_sign sm2_verify sm2_encrypt sm2_decrypt sm2_ecdh sm2_fp_inv\n"
+"    sm2_fp_inv_fermat sm2_fn_inv sm2_fn_inv_fermat sm2_fp_sqrt sm9_sign\n"
+"    sm9_verify sm9_kem_encrypt sm9_kem_decrypt sm9_pairing x509_cert_sign\n"
+"    x509_cert_encode\n"
+#ifdef SM2_EXTS
+"    sm2_ring_sign_8 sm2_ring_sign_64 sm2_ring_sign_256 sm2_ring_sign_1024\n"
+"    sm2_ring_verify_8 sm2_ring_verify_64 sm2_ring_verify_256 sm2_ring_verify_1024\n"
+#endif
+"\n"
+"Examples\n"
+"\n"
+"    $ gmssl speed\n"
+"    $ gmssl speed -seconds 3 sm4 sm3\n"
+"    $ gmssl speed -multi 4 -json sm2\n"
+"\n";
+
+int speed_main(int argc, char **argv)
+{
+	int ret = 1;
+	char *prog = argv[0];
+	double seconds = 1;
+	int threads = 1;
+	int json = 0;
+	int selected[SPEED_ALGORS_CNT];
+	int select_all = 1;
+	SPEED_KEYS *keys = NULL;
+	int bulk_header = 0;
+	int ops_header = 0;
+	int first = 1;
+	size_t i, j;
+
+	memset(selected, 0, sizeof(selected));
+
+	argc--;
+	argv++;
+
+	while (argc > 0) {
+		if (!strcmp(*argv, "-help")) {
+			printf("usage: %s %s\n\n", prog, options);
+			printf("%s\n", help);
+			ret = 0;
+			goto end;
+		} else if (!strcmp(*argv, "-seconds")) {
+			if (--argc < 1) goto bad;
+			seconds = atof(*(++argv));
+			if (seconds <= 0 || seconds > 3600) {
+				fprintf(stderr, "%s: invalid seconds\n", prog);
+				goto end;
+			}
+		} else if (!strcmp(*argv, "-multi")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1 || threads > SPEED_MAX_THREADS) {
+				fprintf(stderr, "%s: invalid multi, should be 1 to %d\n", prog, SPEED_MAX_THREADS);
+				goto end;
+			}
+#ifdef WIN32
+			if (threads > 1) {
+				fprintf(stderr, "%s: `-multi` is not supported on this platform\n", prog);
+				goto end;
+			}
+#endif
+		} else if (!strcmp(*argv, "-json")) {
+			json = 1;
+		} else if (**argv == '-') {
+			fprintf(stderr, "%s: illegal option '%s'\n", prog, *argv);
+			goto end;
+		} else {
+			if (!speed_select(selected, *argv)) {
+				fprintf(stderr, "%s: unknown algorithm '%s'\n", prog, *argv);
+				goto end;
+			}
+			select_all = 0;
+		}
+		argc--;
+		argv++;
+	}
+
+	if (!(keys = malloc(sizeof(SPEED_KEYS)))) {
+		fprintf(stderr, "%s: malloc failure\n", prog);
+		goto end;
+	}
+	if (speed_keys_init(keys) != 1) {
+		fprintf(stderr, "%s: inner error\n", prog);
+		goto end;
+	}
+#ifdef SM2_EXTS
+	for (i = 0; i < SPEED_ALGORS_CNT; i++) {
+		if ((select_all || selected[i]) && !strncmp(speed_algors[i].name, "sm2_ring_", 9)) {
+			if (speed_sm2_ring_keys_init(keys) != 1) {
+				fprintf(stderr, "%s: inner error\n", prog);
+				goto end;
+			}
+			break;
+		}
+	}
+#endif
+
+	if (json) {
+		printf("{\n  \"seconds\": %g,\n  \"threads\": %d,\n  \"results\": [", seconds, threads);
+	}
+
+	for (i = 0; i < SPEED_ALGORS_CNT; i++) {
+		const SPEED_ALGOR *algor = &speed_algors[i];
+		double rate;
+
+		if (!select_all && !selected[i]) {
+			continue;
+		}
+
+		if (algor->bulk) {
+			if (json) {
+				printf("%s\n    { \"algorithm\": \"%s\", \"bytes_per_second\": {", first ? "" : ",", algor->name);
+			} else {
+				if (!bulk_header) {
+					printf("The 'numbers' are in 1000s of bytes per second processed.\n");
+					printf("%-20s", "type");
+					for (j = 0; j < SPEED_SIZES_CNT; j++) {
+						printf(" %7zu bytes", speed_sizes[j]);
+					}
+					printf("\n");
+					bulk_header = 1;
+				}
+				printf("%-20s", algor->name);
+			}
+			fflush(stdout);
+			for (j = 0; j < SPEED_SIZES_CNT; j++) {
+				if (speed_run(algor, keys, speed_sizes[j], seconds, threads, &rate) != 1) {
+					fprintf(stderr, "%s: %s failed\n", prog, algor->name);
+					goto end;
+				}
+				if (json) {
+					printf("%s\"%zu\": %.0f", j ? ", " : " ", speed_sizes[j], rate);
+				} else {
+					printf(" %12.2fk", rate / 1000);
+				}
+				fflush(stdout);
+			}
+			printf(json ? " } }" : "\n");
+		} else {
+			if (speed_run(algor, keys, 0, seconds, threads, &rate) != 1) {
+				fprintf(stderr, "%s: %s failed\n", prog, algor->name);
+				goto end;
+			}
+			if (json) {
+				printf("%s\n    { \"algorithm\": \"%s\", \"ops_per_second\": %.1f }", first ? "" : ",", algor->name, rate);
+			} else {
+				if (!ops_header) {
+					printf("%s%-20s %13s %13s\n", bulk_header ? "\n" : "", "", "ops/s", "time/op");
+					ops_header = 1;
+				}
+				printf("%-20s %13.1f %12.6fs\n", algor->name, rate, threads / rate);
+			}
+			fflush(stdout);
+		}
+		first = 0;
+	}
+
+	if (json) {
+		printf("\n  ]\n}\n");
+	}
+	ret = 0;
+	goto end;
+
+bad:
+	fprintf(stderr, "%s: '%s' option value missing\n", prog, *argv);
+end:
+	if (keys) {
+		gmssl_secure_clear(keys, sizeof(SPEED_KEYS));
+		free(keys);
+	}
+	return ret;
+}
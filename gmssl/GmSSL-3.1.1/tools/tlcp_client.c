@@ -16,7 +16,7 @@
 #include <gmssl/error.h>
 
 
-static int client_ciphers[] = { TLS_cipher_ecc_sm4_cbc_sm3, };
+static int client_ciphers[] = { TLS_cipher_ecc_sm4_gcm_sm3, TLS_cipher_ecc_sm4_cbc_sm3, };
 
 static const char *http_get =
 	"GET / HTTP/1.1\r\n"
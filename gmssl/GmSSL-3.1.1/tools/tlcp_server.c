@@ -18,7 +18,9 @@
 #include <gmssl/error.h>
 
 
-static const char *options = "[-port num] -cert file -key file [-pass str] -ex_key file [-ex_pass str] [-cacert file]";
+extern int tls_workers_run(const char *prog, const TLS_CTX *ctx, int port, int threads, int processes);
+
+static const char *options = "[-port num] -cert file -key file [-pass str] -ex_key file [-ex_pass str] [-cacert file] [-threads num] [-processes num]";
 
 int tlcp_server_main(int argc , char **argv)
 {
@@ -32,17 +34,11 @@ int tlcp_server_main(int argc , char **argv)
 	char *encpass = NULL;
 	char *cacertfile = NULL;
 
-	int server_ciphers[] = { TLS_cipher_ecc_sm4_cbc_sm3, };
+	int server_ciphers[] = { TLS_cipher_ecc_sm4_gcm_sm3, TLS_cipher_ecc_sm4_cbc_sm3, };
 
 	TLS_CTX ctx;
-	TLS_CONNECT conn;
-	char buf[1600] = {0};
-	size_t len = sizeof(buf);
-	tls_socket_t sock;
-	tls_socket_t conn_sock;
-	struct sockaddr_in server_addr;
-	struct sockaddr_in client_addr;
-	tls_socklen_t client_addrlen;
+	int threads = 1;
+	int processes = 1;
 
 	argc--;
 	argv++;
@@ -77,6 +73,20 @@ int tlcp_server_main(int argc , char **argv)
 		} else if (!strcmp(*argv, "-cacert")) {
 			if (--argc < 1) goto bad;
 			cacertfile = *(++argv);
+		} else if (!strcmp(*argv, "-threads")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1) {
+				fprintf(stderr, "%s: invalid threads\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-processes")) {
+			if (--argc < 1) goto bad;
+			processes = atoi(*(++argv));
+			if (processes < 1) {
+				fprintf(stderr, "%s: invalid processes\n", prog);
+				return 1;
+			}
 		} else {
 			fprintf(stderr, "%s: invalid option '%s'\n", prog, *argv);
 			return 1;
@@ -109,7 +119,6 @@ bad:
 	}
 
 	memset(&ctx, 0, sizeof(ctx));
-	memset(&conn, 0, sizeof(conn));
 
 	if (tls_ctx_init(&ctx, TLS_protocol_tlcp, TLS_server_mode) != 1
 		|| tls_ctx_set_cipher_suites(&ctx, server_ciphers, sizeof(server_ciphers)/sizeof(int)) != 1
@@ -130,69 +139,13 @@ bad:
 		return -1;
 	}
 
-	if (tls_socket_create(&sock, AF_INET, SOCK_STREAM, 0) != 1) {
-		error_print();
-		return 1;
-	}
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_addr.s_addr = INADDR_ANY;
-	server_addr.sin_port = htons(port);
-
-	if (tls_socket_bind(sock, &server_addr) != 1) {
-		fprintf(stderr, "%s: socket bind error\n", prog);
-		goto end;
-	}
-
-	puts("start listen ...\n");
-	tls_socket_listen(sock, 1);
-
-
-restart:
-
-	client_addrlen = sizeof(client_addr);
-
-	if (tls_socket_accept(sock, &client_addr, &conn_sock) != 1) {
-		fprintf(stderr, "%s: socket accept error\n", prog);
+	if (tls_workers_run(prog, &ctx, port, threads, processes) != 1) {
+		fprintf(stderr, "%s: server failure\n", prog);
 		goto end;
 	}
-	puts("socket connected\n");
-
-	if (tls_init(&conn, &ctx) != 1
-		|| tls_set_socket(&conn, conn_sock) != 1) {
-		error_print();
-		return -1;
-	}
-
-	if (tls_do_handshake(&conn) != 1) {
-		error_print(); // 为什么这个会触发呢？
-		return -1;
-	}
-
-	for (;;) {
-
-		int rv;
-		size_t sentlen;
-
-		do {
-			len = sizeof(buf);
-			if ((rv = tls_recv(&conn, (uint8_t *)buf, sizeof(buf), &len)) != 1) {
-				if (rv < 0) fprintf(stderr, "%s: recv failure\n", prog);
-				else fprintf(stderr, "%s: Disconnected by remote\n", prog);
-
-				//tls_socket_close(conn.sock); // FIXME: 		
-				tls_cleanup(&conn);
-				goto restart;
-			}
-		} while (!len);
-
-		if (tls_send(&conn, (uint8_t *)buf, len, &sentlen) != 1) {
-			fprintf(stderr, "%s: send failure, close connection\n", prog);
-			tls_socket_close(conn.sock);
-			goto end;
-		}
-	}
-
+	ret = 0;
 
 end:
+	tls_ctx_cleanup(&ctx);
 	return ret;
 }
@@ -18,7 +18,7 @@
 
 // TLSv1.2客户单和TLCP客户端可能没有什么区别
 
-static int client_ciphers[] = { TLS_cipher_ecdhe_sm4_cbc_sm3 };
+static int client_ciphers[] = { TLS_cipher_ecdhe_sm4_gcm_sm3, TLS_cipher_ecdhe_sm4_cbc_sm3 };
 
 static const char *http_get =
 	"GET / HTTP/1.1\r\n"
@@ -25,7 +25,8 @@ static const char *http_get =
 	"Hostname: aaa\r\n"
 	"\r\n\r\n";
 
-static const char *options = "-host str [-port num] [-cacert file] [-cert file -key file -pass str]";
+static const char *options = "-host str [-port num] [-cacert file] [-cert file -key file -pass str]"
+	" [-sess_in file] [-sess_out file] [-early_data]";
 
 int tls13_client_main(int argc, char *argv[])
 {
@@ -45,6 +46,13 @@ int tls13_client_main(int argc, char *argv[])
 	char buf[1024] = {0};
 	size_t len = sizeof(buf);
 	char send_buf[1024] = {0};
+	char *sess_in = NULL;
+	char *sess_out = NULL;
+	int early_data = 0;
+	uint8_t sess[TLS13_MAX_SESSION_SIZE];
+	size_t sesslen;
+	int skip_stdin = 0;
+	FILE *fp = NULL;
 
 	argc--;
 	argv++;
@@ -74,6 +82,14 @@ int tls13_client_main(int argc, char *argv[])
 		} else if (!strcmp(*argv, "-pass")) {
 			if (--argc < 1) goto bad;
 			pass = *(++argv);
+		} else if (!strcmp(*argv, "-sess_in")) {
+			if (--argc < 1) goto bad;
+			sess_in = *(++argv);
+		} else if (!strcmp(*argv, "-sess_out")) {
+			if (--argc < 1) goto bad;
+			sess_out = *(++argv);
+		} else if (!strcmp(*argv, "-early_data")) {
+			early_data = 1;
 		} else {
 			fprintf(stderr, "%s: invalid option '%s'\n", prog, *argv);
 			return 1;
@@ -133,28 +149,76 @@ bad:
 		}
 	}
 	if (tls_init(&conn, &ctx) != 1
-		|| tls_set_socket(&conn, sock) != 1
-		|| tls_do_handshake(&conn) != 1) {
+		|| tls_set_socket(&conn, sock) != 1) {
 		fprintf(stderr, "%s: error\n", prog);
 		goto end;
 	}
+	if (sess_in) {
+		if (!(fp = fopen(sess_in, "rb"))) {
+			fprintf(stderr, "%s: open '%s' failure : %s\n", prog, sess_in, strerror(errno));
+			goto end;
+		}
+		sesslen = fread(sess, 1, sizeof(sess), fp);
+		fclose(fp);
+		if (tls13_set_session(&conn, sess, sesslen) != 1) {
+			fprintf(stderr, "%s: invalid session '%s'\n", prog, sess_in);
+			goto end;
+		}
+	}
+	// the first line of stdin is sent as 0-RTT data
+	if (early_data) {
+		if (!fgets(send_buf, sizeof(send_buf), stdin)) {
+			fprintf(stderr, "%s: no early data\n", prog);
+			goto end;
+		}
+		if (tls13_set_early_data(&conn, (uint8_t *)send_buf, strlen(send_buf)) != 1) {
+			fprintf(stderr, "%s: error\n", prog);
+			goto end;
+		}
+	}
+	if (tls_do_handshake(&conn) != 1) {
+		fprintf(stderr, "%s: error\n", prog);
+		goto end;
+	}
+	if (sess_in) {
+		fprintf(stderr, "%s: session %s\n", prog, conn.psk_resumed ? "resumed" : "not resumed");
+	}
+	if (early_data) {
+		size_t sentlen;
+
+		if (conn.early_data_status == TLS13_early_data_accepted) {
+			fprintf(stderr, "%s: early data accepted\n", prog);
+		} else {
+			fprintf(stderr, "%s: early data rejected\n", prog);
+			if (tls13_send(&conn, (uint8_t *)send_buf, strlen(send_buf), &sentlen) != 1) {
+				fprintf(stderr, "%s: send error\n", prog);
+				goto end;
+			}
+		}
+		skip_stdin = 1;
+	}
 
 	for (;;) {
 		fd_set fds;
 		size_t sentlen;
 
-		if (!fgets(send_buf, sizeof(send_buf), stdin)) {
-			if (feof(stdin)) {
-				tls_shutdown(&conn);
+		// the first line has been sent with the handshake
+		if (skip_stdin) {
+			skip_stdin = 0;
+		} else {
+			if (!fgets(send_buf, sizeof(send_buf), stdin)) {
+				if (feof(stdin)) {
+					tls_shutdown(&conn);
+					goto end;
+				} else {
+					continue;
+				}
+			}
+			if (tls13_send(&conn, (uint8_t *)send_buf, strlen(send_buf), &sentlen) != 1) {
+				fprintf(stderr, "%s: send error\n", prog);
 				goto end;
-			} else {
-				continue;
 			}
 		}
-		if (tls13_send(&conn, (uint8_t *)send_buf, strlen(send_buf), &sentlen) != 1) {
-			fprintf(stderr, "%s: send error\n", prog);
-			goto end;
-		}
 
 
 		FD_ZERO(&fds);
@@ -208,6 +272,16 @@ bad:
 	}
 
 end:
+	// the ticket is received after the handshake, the session is saved at the end
+	if (sess_out) {
+		if (tls13_get_session(&conn, sess, &sesslen) != 1) {
+			fprintf(stderr, "%s: no session ticket received\n", prog);
+		} else if (!(fp = fopen(sess_out, "wb"))
+			|| fwrite(sess, 1, sesslen, fp) != sesslen) {
+			fprintf(stderr, "%s: write '%s' failure\n", prog, sess_out);
+		}
+		if (fp) fclose(fp);
+	}
 	tls_socket_close(sock);
 	tls_ctx_cleanup(&ctx);
 	tls_cleanup(&conn);
@@ -18,7 +18,11 @@
 #include <gmssl/error.h>
 
 
-static const char *options = "[-port num] -cert file -key file -pass str [-cacert file]";
+extern int tls_workers_run(const char *prog, const TLS_CTX *ctx, int port, int threads, int processes);
+
+static const char *options = "[-port num] -cert file -key file -pass str [-cacert file] [-threads num] [-processes num] [-key_pool num]"
+	" [-tickets lifetime] [-early_data num] [-replay_window sec]"
+	" [-sdf_lib so_path -sdf_key index -sdf_pass str [-sdf_sessions num]]";
 
 int tls13_server_main(int argc , char **argv)
 {
@@ -31,14 +35,19 @@ int tls13_server_main(int argc , char **argv)
 	char *cacertfile = NULL;
 	int server_ciphers[] = { TLS_cipher_sm4_gcm_sm3, };
 	TLS_CTX ctx;
-	TLS_CONNECT conn;
-	char buf[1600] = {0};
-	size_t len = sizeof(buf);
-	tls_socket_t sock;
-	tls_socket_t conn_sock;
-	struct sockaddr_in server_addr;
-	struct sockaddr_in client_addr;
-	tls_socklen_t client_addrlen;
+	int threads = 1;
+	int processes = 1;
+	int key_pool = 0;
+	int ticket_lifetime = 0;
+	int max_early_data_size = 0;
+	int replay_window = TLS13_DEFAULT_REPLAY_WINDOW;
+	char *sdf_lib = NULL;
+	int sdf_key = -1;
+	char *sdf_pass = NULL;
+	int sdf_sessions = 8;
+	SDF_DEVICE sdf_dev;
+	SDF_JOB_QUEUE *sdf_queue = NULL;
+	int sdf_opened = 0;
 
 	argc--;
 	argv++;
@@ -67,6 +76,68 @@ int tls13_server_main(int argc , char **argv)
 		} else if (!strcmp(*argv, "-cacert")) {
 			if (--argc < 1) goto bad;
 			cacertfile = *(++argv);
+		} else if (!strcmp(*argv, "-threads")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1) {
+				fprintf(stderr, "%s: invalid threads\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-processes")) {
+			if (--argc < 1) goto bad;
+			processes = atoi(*(++argv));
+			if (processes < 1) {
+				fprintf(stderr, "%s: invalid processes\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-key_pool")) {
+			if (--argc < 1) goto bad;
+			key_pool = atoi(*(++argv));
+			if (key_pool < 0 || key_pool > SM2_KEY_POOL_MAX_SIZE) {
+				fprintf(stderr, "%s: invalid key_pool\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-tickets")) {
+			if (--argc < 1) goto bad;
+			ticket_lifetime = atoi(*(++argv));
+			if (ticket_lifetime < 1 || ticket_lifetime > TLS13_MAX_TICKET_LIFETIME) {
+				fprintf(stderr, "%s: invalid tickets lifetime\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-early_data")) {
+			if (--argc < 1) goto bad;
+			max_early_data_size = atoi(*(++argv));
+			if (max_early_data_size < 1) {
+				fprintf(stderr, "%s: invalid early_data\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-replay_window")) {
+			if (--argc < 1) goto bad;
+			replay_window = atoi(*(++argv));
+			if (replay_window < 1 || replay_window > 3600) {
+				fprintf(stderr, "%s: invalid replay_window\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-sdf_lib")) {
+			if (--argc < 1) goto bad;
+			sdf_lib = *(++argv);
+		} else if (!strcmp(*argv, "-sdf_key")) {
+			if (--argc < 1) goto bad;
+			sdf_key = atoi(*(++argv));
+			if (sdf_key < 0) {
+				fprintf(stderr, "%s: invalid sdf_key\n", prog);
+				return 1;
+			}
+		} else if (!strcmp(*argv, "-sdf_pass")) {
+			if (--argc < 1) goto bad;
+			sdf_pass = *(++argv);
+		} else if (!strcmp(*argv, "-sdf_sessions")) {
+			if (--argc < 1) goto bad;
+			sdf_sessions = atoi(*(++argv));
+			if (sdf_sessions < 1 || sdf_sessions > SDF_JOB_MAX_SESSIONS) {
+				fprintf(stderr, "%s: invalid sdf_sessions\n", prog);
+				return 1;
+			}
 		} else {
 			fprintf(stderr, "%s: invalid option '%s'\n", prog, *argv);
 			return 1;
@@ -81,12 +152,28 @@ bad:
 		fprintf(stderr, "%s: '-cert' option required\n", prog);
 		return 1;
 	}
-	if (!keyfile) {
-		fprintf(stderr, "%s: '-key' option required\n", prog);
-		return 1;
+	if (sdf_lib) {
+		if (sdf_key < 0 || !sdf_pass) {
+			fprintf(stderr, "%s: '-sdf_lib' requires '-sdf_key' and '-sdf_pass'\n", prog);
+			return 1;
+		}
+		// the workers of the queue are not inherited by forked processes
+		if (processes > 1) {
+			fprintf(stderr, "%s: '-sdf_lib' can not be used with '-processes'\n", prog);
+			return 1;
+		}
+	} else {
+		if (!keyfile) {
+			fprintf(stderr, "%s: '-key' option required\n", prog);
+			return 1;
+		}
+		if (!pass) {
+			fprintf(stderr, "%s: '-pass' option required\n", prog);
+			return 1;
+		}
 	}
-	if (!pass) {
-		fprintf(stderr, "%s: '-pass' option required\n", prog);
+	if (max_early_data_size && !ticket_lifetime) {
+		fprintf(stderr, "%s: '-early_data' requires '-tickets'\n", prog);
 		return 1;
 	}
 	if (tls_socket_lib_init() != 1) {
@@ -95,11 +182,28 @@ bad:
 	}
 
 	memset(&ctx, 0, sizeof(ctx));
-	memset(&conn, 0, sizeof(conn));
 
 	if (tls_ctx_init(&ctx, TLS_protocol_tls13, TLS_server_mode) != 1
-		|| tls_ctx_set_cipher_suites(&ctx, server_ciphers, sizeof(server_ciphers)/sizeof(int)) != 1
-		|| tls_ctx_set_certificate_and_key(&ctx, certfile, keyfile, pass) != 1) {
+		|| tls_ctx_set_cipher_suites(&ctx, server_ciphers, sizeof(server_ciphers)/sizeof(int)) != 1) {
+		error_print();
+		return -1;
+	}
+	if (sdf_lib) {
+		if (sdf_load_library(sdf_lib, NULL) != 1
+			|| sdf_open_device(&sdf_dev) != 1) {
+			fprintf(stderr, "%s: open SDF device '%s' failure\n", prog, sdf_lib);
+			goto end;
+		}
+		sdf_opened = 1;
+		if (!(sdf_queue = sdf_job_queue_new(&sdf_dev, sdf_key, sdf_pass, sdf_sessions))) {
+			fprintf(stderr, "%s: load SDF sign key failure\n", prog);
+			goto end;
+		}
+		if (tls_ctx_set_certificate_and_sdf_queue(&ctx, certfile, sdf_queue) != 1) {
+			fprintf(stderr, "%s: SDF sign key does not match the certificate\n", prog);
+			goto end;
+		}
+	} else if (tls_ctx_set_certificate_and_key(&ctx, certfile, keyfile, pass) != 1) {
 		error_print();
 		return -1;
 	}
@@ -110,68 +214,39 @@ bad:
 		}
 	}
 
-
-	if (tls_socket_create(&sock, AF_INET, SOCK_STREAM, 0) != 1) {
-		fprintf(stderr, "%s: socket create error\n", prog);
-		goto end;
-	}
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_addr.s_addr = INADDR_ANY;
-	server_addr.sin_port = htons(port);
-	if (tls_socket_bind(sock, &server_addr) != 1) {
-		fprintf(stderr, "%s: socket bind error\n", prog);
-		goto end;
-	}
-	puts("start listen ...\n");
-	tls_socket_listen(sock, 1);
-
-
-
-restart:
-
-	//client_addrlen = sizeof(client_addr);
-	if (tls_socket_accept(sock, &client_addr, &conn_sock) != 1) {
-		fprintf(stderr, "%s: socket accept error\n", prog);
-		goto end;
-	}
-	puts("socket connected\n");
-
-	if (tls_init(&conn, &ctx) != 1
-		|| tls_set_socket(&conn, conn_sock) != 1) {
-		error_print();
-		return -1;
+	if (key_pool) {
+		if (tls_ctx_set_key_pool(&ctx, key_pool) != 1) {
+			error_print();
+			return -1;
+		}
 	}
 
-	if (tls_do_handshake(&conn) != 1) {
-		error_print(); // 为什么这个会触发呢？
-		return -1;
+	// the ticket key and the anti-replay state are shared by all the workers
+	if (ticket_lifetime) {
+		if (tls13_ctx_enable_session_tickets(&ctx, ticket_lifetime) != 1) {
+			error_print();
+			return -1;
+		}
 	}
-
-	for (;;) {
-
-		int rv;
-		size_t sentlen;
-
-		do {
-			len = sizeof(buf);
-			if ((rv = tls13_recv(&conn, (uint8_t *)buf, sizeof(buf), &len)) != 1) {
-				if (rv < 0) fprintf(stderr, "%s: recv failure\n", prog);
-				else fprintf(stderr, "%s: Disconnected by remote\n", prog);
-
-				//close(conn.sock);
-				tls_cleanup(&conn);
-				goto restart;
-			}
-		} while (!len);
-
-		if (tls13_send(&conn, (uint8_t *)buf, len, &sentlen) != 1) {
-			fprintf(stderr, "%s: send failure, close connection\n", prog);
-			tls_socket_close(conn.sock);
-			goto end;
+	if (max_early_data_size) {
+		if (tls13_ctx_enable_early_data(&ctx, max_early_data_size, replay_window) != 1) {
+			error_print();
+			return -1;
 		}
 	}
 
+	if (tls_workers_run(prog, &ctx, port, threads, processes) != 1) {
+		fprintf(stderr, "%s: server failure\n", prog);
+		goto end;
+	}
+	ret = 0;
 
 end:
+	tls_ctx_cleanup(&ctx);
+	if (sdf_queue) sdf_job_queue_free(sdf_queue);
+	if (sdf_opened) {
+		sdf_close_device(&sdf_dev);
+		sdf_unload_library();
+	}
 	return ret;
 }
@@ -0,0 +1,310 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#endif
+#include <gmssl/tls.h>
+#include <gmssl/error.h>
+
+
+/*
+Worker model of the tlcp_server, tls12_server and tls13_server commands.
+
+The server runs `processes` pre-forked processes of `threads` worker threads. Every
+worker has its own SO_REUSEPORT listening socket and serves the accepted connections
+one after another: full handshake, then echo the application data (and the TLS 1.3
+0-RTT data) until the client closes. Where SO_REUSEPORT is not supported the workers of a process share one
+listening socket. All the workers share the read-only TLS_CTX.
+
+The handshake and record layer are blocking, so the number of connections served at
+the same time is processes * threads. A failed connection is logged and closed, it
+does not stop the server. A failed accept, most often EMFILE or ENFILE, makes the
+worker wait TLS_WORKERS_ACCEPT_DELAY before it accepts again.
+*/
+
+#define TLS_WORKERS_BACKLOG	128
+#define TLS_WORKERS_ACCEPT_DELAY	100 // milliseconds
+
+typedef struct {
+	const char *prog;
+	const TLS_CTX *ctx;
+	tls_socket_t sock;
+} TLS_WORKER;
+
+
+// *reuseport is cleared if SO_REUSEPORT can not be set
+static int tls_workers_listen(const char *prog, int port, int *reuseport, tls_socket_t *sock)
+{
+	struct sockaddr_in addr;
+	int on = 1;
+
+	if (tls_socket_create(sock, AF_INET, SOCK_STREAM, 0) != 1) {
+		fprintf(stderr, "%s: socket create error\n", prog);
+		return -1;
+	}
+	setsockopt(*sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+	if (*reuseport && tls_socket_set_reuseport(*sock) != 1) {
+		*reuseport = 0;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(port);
+	if (tls_socket_bind(*sock, &addr) != 1) {
+		fprintf(stderr, "%s: socket bind error\n", prog);
+		tls_socket_close(*sock);
+		return -1;
+	}
+	if (tls_socket_listen(*sock, TLS_WORKERS_BACKLOG) != 1) {
+		fprintf(stderr, "%s: socket listen error\n", prog);
+		tls_socket_close(*sock);
+		return -1;
+	}
+	return 1;
+}
+
+static void tls_workers_serve(const char *prog, const TLS_CTX *ctx, tls_socket_t conn_sock)
+{
+	TLS_CONNECT *conn = NULL;
+	uint8_t *buf = NULL;
+
+	if (!(conn = malloc(sizeof(TLS_CONNECT)))
+		|| !(buf = malloc(TLS_MAX_PLAINTEXT_SIZE))) {
+		fprintf(stderr, "%s: malloc failure\n", prog);
+		goto end;
+	}
+	if (tls_init(conn, ctx) != 1
+		|| tls_set_socket(conn, conn_sock) != 1) {
+		error_print();
+		goto end;
+	}
+	if (tls_do_handshake(conn) != 1) {
+		fprintf(stderr, "%s: handshake failure\n", prog);
+		goto end;
+	}
+	if (ctx->protocol == TLS_protocol_tls13) {
+		size_t len, sentlen;
+		int rv;
+
+		// echo the accepted 0-RTT data, the handshake is finished after it
+		while ((rv = tls13_recv_early_data(conn, buf, TLS_MAX_PLAINTEXT_SIZE, &len)) == 1) {
+			if (tls13_send(conn, buf, len, &sentlen) != 1) {
+				fprintf(stderr, "%s: send failure, close connection\n", prog);
+				goto end;
+			}
+		}
+		if (rv < 0) {
+			fprintf(stderr, "%s: handshake failure\n", prog);
+			goto end;
+		}
+	}
+
+	for (;;) {
+		size_t len, sentlen;
+		int rv;
+
+		do {
+			if (ctx->protocol == TLS_protocol_tls13) {
+				rv = tls13_recv(conn, buf, TLS_MAX_PLAINTEXT_SIZE, &len);
+			} else {
+				rv = tls_recv(conn, buf, TLS_MAX_PLAINTEXT_SIZE, &len);
+			}
+			if (rv != 1) {
+				if (rv < 0) fprintf(stderr, "%s: recv failure\n", prog);
+				else fprintf(stderr, "%s: Disconnected by remote\n", prog);
+				goto end;
+			}
+		} while (!len);
+
+		if (ctx->protocol == TLS_protocol_tls13) {
+			rv = tls13_send(conn, buf, len, &sentlen);
+		} else {
+			rv = tls_send(conn, buf, len, &sentlen);
+		}
+		if (rv != 1) {
+			fprintf(stderr, "%s: send failure, close connection\n", prog);
+			goto end;
+		}
+	}
+
+end:
+	tls_socket_close(conn_sock);
+	if (conn) {
+		tls_cleanup(conn);
+		free(conn);
+	}
+	if (buf) free(buf);
+}
+
+static void *tls_workers_thread(void *arg)
+{
+	const TLS_WORKER *worker = arg;
+	tls_socket_t sock = worker->sock;
+
+	for (;;) {
+		struct sockaddr_in client_addr;
+		tls_socket_t conn_sock;
+
+		if (tls_socket_accept(sock, &client_addr, &conn_sock) != 1) {
+			// the pending connection stays in the backlog, retrying at once would
+			// only spin on the same error until a descriptor is closed
+			fprintf(stderr, "%s: socket accept error\n", worker->prog);
+#ifdef WIN32
+			Sleep(TLS_WORKERS_ACCEPT_DELAY);
+#else
+			usleep(TLS_WORKERS_ACCEPT_DELAY * 1000);
+#endif
+			continue;
+		}
+		tls_workers_serve(worker->prog, worker->ctx, conn_sock);
+	}
+	return NULL;
+}
+
+// the calling thread serves the given listening socket, the other threads bind their own
+// listeners if SO_REUSEPORT is supported, or share the given socket.
+// The detached threads use workers[i] until the process exits, so workers is never freed
+// once a thread is started, and a failure after that keeps the started threads running.
+static int tls_workers_run_threads(const char *prog, const TLS_CTX *ctx, int port,
+	tls_socket_t sock, int reuseport, int threads)
+{
+	TLS_WORKER *workers;
+	int i;
+
+	if (!(workers = calloc(threads, sizeof(TLS_WORKER)))) {
+		fprintf(stderr, "%s: malloc failure\n", prog);
+		return -1;
+	}
+	for (i = 0; i < threads; i++) {
+		workers[i].prog = prog;
+		workers[i].ctx = ctx;
+		workers[i].sock = sock;
+	}
+#ifndef WIN32
+	for (i = 1; i < threads; i++) {
+		pthread_t tid;
+
+		if (reuseport && tls_workers_listen(prog, port, &reuseport, &workers[i].sock) != 1) {
+			break;
+		}
+		if (pthread_create(&tid, NULL, tls_workers_thread, &workers[i]) != 0) {
+			fprintf(stderr, "%s: create thread failure\n", prog);
+			if (workers[i].sock != sock) {
+				tls_socket_close(workers[i].sock);
+			}
+			break;
+		}
+		pthread_detach(tid);
+	}
+	if (i < threads) {
+		if (i == 1) {
+			free(workers);
+			return -1;
+		}
+		fprintf(stderr, "%s: running %d of %d worker threads\n", prog, i, threads);
+	}
+#endif
+	// never returns
+	tls_workers_thread(&workers[0]);
+	return 1;
+}
+
+#ifndef WIN32
+static pid_t *tls_workers_children = NULL;
+static int tls_workers_children_cnt = 0;
+
+static void tls_workers_stop(int sig)
+{
+	int i;
+	for (i = 0; i < tls_workers_children_cnt; i++) {
+		if (tls_workers_children[i] > 0) {
+			kill(tls_workers_children[i], SIGTERM);
+		}
+	}
+	_exit(0);
+}
+#endif
+
+int tls_workers_run(const char *prog, const TLS_CTX *ctx, int port, int threads, int processes)
+{
+	tls_socket_t sock;
+	int reuseport;
+
+	if (!prog || !ctx || threads < 1 || processes < 1) {
+		error_print();
+		return -1;
+	}
+#ifdef WIN32
+	if (threads > 1 || processes > 1) {
+		fprintf(stderr, "%s: multiple workers are not supported on this platform\n", prog);
+		return -1;
+	}
+#endif
+
+	// the first listener is opened before the fork and shared by the first thread of
+	// every process, it also tells if SO_REUSEPORT is supported
+	reuseport = (threads > 1 || processes > 1);
+	if (tls_workers_listen(prog, port, &reuseport, &sock) != 1) {
+		return -1;
+	}
+	puts("start listen ...\n");
+	fflush(stdout);
+
+#ifndef WIN32
+	// a client closing the connection should only fail this connection
+	signal(SIGPIPE, SIG_IGN);
+
+	if (processes > 1) {
+		int i;
+
+		if (!(tls_workers_children = calloc(processes, sizeof(pid_t)))) {
+			fprintf(stderr, "%s: malloc failure\n", prog);
+			tls_socket_close(sock);
+			return -1;
+		}
+		tls_workers_children_cnt = processes;
+		signal(SIGTERM, tls_workers_stop);
+		signal(SIGINT, tls_workers_stop);
+		for (i = 0; i < processes; i++) {
+			pid_t pid;
+			if ((pid = fork()) < 0) {
+				fprintf(stderr, "%s: fork failure\n", prog);
+				tls_workers_stop(0);
+			}
+			if (pid == 0) {
+				free(tls_workers_children);
+				tls_workers_children = NULL;
+				tls_workers_children_cnt = 0;
+				signal(SIGTERM, SIG_DFL);
+				signal(SIGINT, SIG_DFL);
+				_exit(tls_workers_run_threads(prog, ctx, port, sock, reuseport, threads) == 1 ? 0 : 1);
+			}
+			tls_workers_children[i] = pid;
+		}
+		tls_socket_close(sock);
+
+		// the server runs as long as all the worker processes are running
+		while (wait(NULL) < 0 && errno == EINTR) {
+		}
+		fprintf(stderr, "%s: worker process exited\n", prog);
+		tls_workers_stop(0);
+		return -1;
+	}
+#endif
+	return tls_workers_run_threads(prog, ctx, port, sock, reuseport, threads);
+}
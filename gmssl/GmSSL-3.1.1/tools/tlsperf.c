@@ -0,0 +1,769 @@
+/*
+ *  Copyright 2014-2023 The GmSSL Project. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the License); you may
+ *  not use this file except in compliance with the License.
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+#endif
+#include <gmssl/tls.h>
+#include <gmssl/error.h>
+
+
+/*
+Load generator for the tlcp_server, tls12_server and tls13_server commands.
+
+For every cipher suite two kinds of tests are run for `-seconds` seconds each:
+
+	* Handshake test: every thread repeatedly connects, finishes a full handshake and
+	  closes the connection. The handshake rate and latency percentiles are reported,
+	  the latency includes the TCP connect.
+	* Resumption test, TLS 1.3 with `-resume` only: every thread gets one session ticket
+	  from a full handshake and then repeatedly resumes that session. The server should
+	  be started with `-tickets`.
+	* Throughput test, once per record size: every thread opens one connection, sends
+	  application data records of the given size and reads back the echo of the server.
+
+The handshake and record layer of GmSSL are blocking, so every concurrent connection
+is driven by its own thread, `-threads` sets the number of concurrent connections.
+*/
+
+#define TLSPERF_MAX_THREADS	1024
+#define TLSPERF_MAX_CIPHERS	8
+#define TLSPERF_MAX_RECORDS	8
+
+typedef struct {
+	const TLS_CTX *ctx;
+	const struct sockaddr_in *server;
+	double seconds;
+	size_t record_size; // 0 for the handshake test
+	int resume;
+
+	uint64_t handshakes;
+	uint64_t bytes;
+	double elapsed;
+	uint32_t *latencies; // in microseconds
+	size_t latencies_cnt;
+	size_t latencies_max;
+	int ret;
+} TLSPERF_JOB;
+
+
+static double tlsperf_time(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static int tlsperf_connect(const TLS_CTX *ctx, const struct sockaddr_in *server,
+	const uint8_t *sess, size_t sesslen, TLS_CONNECT *conn)
+{
+	tls_socket_t sock;
+	int nodelay = 1;
+
+	if (tls_socket_create(&sock, AF_INET, SOCK_STREAM, 0) != 1) {
+		error_print();
+		return -1;
+	}
+	// records larger than TLS_MAX_PLAINTEXT_SIZE are sent as several writes
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+
+	if (tls_socket_connect(sock, server) != 1
+		|| tls_init(conn, ctx) != 1
+		|| (sess && tls13_set_session(conn, sess, sesslen) != 1)
+		|| tls_set_socket(conn, sock) != 1
+		|| tls_do_handshake(conn) != 1) {
+		tls_socket_close(sock);
+		tls_cleanup(conn);
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static void tlsperf_close(TLS_CONNECT *conn)
+{
+	tls_socket_close(conn->sock);
+	tls_cleanup(conn);
+}
+
+static int tlsperf_send(TLS_CONNECT *conn, const uint8_t *in, size_t inlen)
+{
+	size_t sentlen;
+
+	while (inlen) {
+		size_t len = inlen < TLS_MAX_PLAINTEXT_SIZE ? inlen : TLS_MAX_PLAINTEXT_SIZE;
+		int ret;
+
+		if (conn->protocol == TLS_protocol_tls13) {
+			ret = tls13_send(conn, in, len, &sentlen);
+		} else {
+			ret = tls_send(conn, in, len, &sentlen);
+		}
+		if (ret != 1) {
+			error_print();
+			return -1;
+		}
+		in += sentlen;
+		inlen -= sentlen;
+	}
+	return 1;
+}
+
+static int tlsperf_recv(TLS_CONNECT *conn, uint8_t *out, size_t outlen)
+{
+	size_t recvlen;
+
+	while (outlen) {
+		int ret;
+
+		if (conn->protocol == TLS_protocol_tls13) {
+			ret = tls13_recv(conn, out, outlen, &recvlen);
+		} else {
+			ret = tls_recv(conn, out, outlen, &recvlen);
+		}
+		if (ret != 1) {
+			error_print();
+			return -1;
+		}
+		out += recvlen;
+		outlen -= recvlen;
+	}
+	return 1;
+}
+
+static int tlsperf_add_latency(TLSPERF_JOB *job, double latency)
+{
+	if (job->latencies_cnt == job->latencies_max) {
+		size_t max = job->latencies_max ? job->latencies_max * 2 : 1024;
+		uint32_t *p;
+		if (!(p = realloc(job->latencies, max * sizeof(uint32_t)))) {
+			error_print();
+			return -1;
+		}
+		job->latencies = p;
+		job->latencies_max = max;
+	}
+	job->latencies[job->latencies_cnt++] = (uint32_t)(latency * 1e6);
+	return 1;
+}
+
+// the ticket is sent after the handshake, it is read before the echo of one byte
+static int tlsperf_get_session(const TLS_CTX *ctx, const struct sockaddr_in *server,
+	TLS_CONNECT *conn, uint8_t *sess, size_t *sesslen)
+{
+	uint8_t buf[1] = { 0 };
+	int ret;
+
+	if (tlsperf_connect(ctx, server, NULL, 0, conn) != 1) {
+		error_print();
+		return -1;
+	}
+	if (tlsperf_send(conn, buf, sizeof(buf)) != 1
+		|| tlsperf_recv(conn, buf, sizeof(buf)) != 1) {
+		tlsperf_close(conn);
+		error_print();
+		return -1;
+	}
+	ret = tls13_get_session(conn, sess, sesslen);
+	tlsperf_close(conn);
+	if (ret != 1) {
+		error_print();
+		return -1;
+	}
+	return 1;
+}
+
+static void *tlsperf_handshake_worker(void *arg)
+{
+	TLSPERF_JOB *job = arg;
+	TLS_CONNECT *conn;
+	uint8_t sess[TLS13_MAX_SESSION_SIZE];
+	size_t sesslen = 0;
+	double start, t;
+
+	job->ret = -1;
+	if (!(conn = malloc(sizeof(TLS_CONNECT)))) {
+		error_print();
+		return NULL;
+	}
+	if (job->resume
+		&& tlsperf_get_session(job->ctx, job->server, conn, sess, &sesslen) != 1) {
+		error_print();
+		goto end;
+	}
+	start = tlsperf_time();
+	do {
+		t = tlsperf_time();
+		if (tlsperf_connect(job->ctx, job->server, job->resume ? sess : NULL, sesslen, conn) != 1) {
+			error_print();
+			goto end;
+		}
+		t = tlsperf_time() - t;
+		if (job->resume && !conn->psk_resumed) {
+			tlsperf_close(conn);
+			error_print();
+			goto end;
+		}
+		tlsperf_close(conn);
+		if (tlsperf_add_latency(job, t) != 1) {
+			error_print();
+			goto end;
+		}
+		job->handshakes++;
+		job->elapsed = tlsperf_time() - start;
+	} while (job->elapsed < job->seconds);
+	job->ret = 1;
+
+end:
+	free(conn);
+	return NULL;
+}
+
+static void *tlsperf_throughput_worker(void *arg)
+{
+	TLSPERF_JOB *job = arg;
+	TLS_CONNECT *conn = NULL;
+	uint8_t *buf = NULL;
+	int connected = 0;
+	double start;
+	size_t i;
+
+	job->ret = -1;
+	if (!(conn = malloc(sizeof(TLS_CONNECT)))
+		|| !(buf = malloc(job->record_size * 2))) {
+		error_print();
+		goto end;
+	}
+	for (i = 0; i < job->record_size; i++) {
+		buf[i] = (uint8_t)i;
+	}
+	if (tlsperf_connect(job->ctx, job->server, NULL, 0, conn) != 1) {
+		error_print();
+		goto end;
+	}
+	connected = 1;
+
+	start = tlsperf_time();
+	do {
+		if (tlsperf_send(conn, buf, job->record_size) != 1
+			|| tlsperf_recv(conn, buf + job->record_size, job->record_size) != 1) {
+			error_print();
+			goto end;
+		}
+		job->bytes += job->record_size;
+		job->elapsed = tlsperf_time() - start;
+	} while (job->elapsed < job->seconds);
+	job->ret = 1;
+
+end:
+	if (connected) tlsperf_close(conn);
+	if (conn) free(conn);
+	if (buf) free(buf);
+	return NULL;
+}
+
+static int tlsperf_run(TLSPERF_JOB *jobs, int threads, void *(*worker)(void *))
+{
+	int i;
+
+#ifdef WIN32
+	worker(&jobs[0]);
+#else
+	if (threads == 1) {
+		worker(&jobs[0]);
+	} else {
+		pthread_t *tids;
+		int started;
+
+		if (!(tids = malloc(sizeof(pthread_t) * threads))) {
+			error_print();
+			return -1;
+		}
+		for (started = 0; started < threads; started++) {
+			if (pthread_create(&tids[started], NULL, worker, &jobs[started]) != 0) {
+				break;
+			}
+		}
+		for (i = 0; i < started; i++) {
+			pthread_join(tids[i], NULL);
+		}
+		free(tids);
+		if (started < threads) {
+			error_print();
+			return -1;
+		}
+	}
+#endif
+	for (i = 0; i < threads; i++) {
+		if (jobs[i].ret != 1 || jobs[i].elapsed <= 0) {
+			error_print();
+			return -1;
+		}
+	}
+	return 1;
+}
+
+static int tlsperf_uint32_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double tlsperf_percentile(const uint32_t *sorted, size_t cnt, double p)
+{
+	return sorted[(size_t)(p * (cnt - 1))] / 1000.0;
+}
+
+static int tlsperf_handshakes(const TLS_CTX *ctx, const struct sockaddr_in *server,
+	int threads, double seconds, int resume)
+{
+	int ret = -1;
+	TLSPERF_JOB *jobs;
+	uint32_t *latencies = NULL;
+	size_t cnt = 0;
+	double rate = 0;
+	int i;
+
+	if (!(jobs = calloc(threads, sizeof(TLSPERF_JOB)))) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < threads; i++) {
+		jobs[i].ctx = ctx;
+		jobs[i].server = server;
+		jobs[i].seconds = seconds;
+		jobs[i].resume = resume;
+	}
+	if (tlsperf_run(jobs, threads, tlsperf_handshake_worker) != 1) {
+		error_print();
+		goto end;
+	}
+
+	for (i = 0; i < threads; i++) {
+		rate += jobs[i].handshakes / jobs[i].elapsed;
+		cnt += jobs[i].latencies_cnt;
+	}
+	if (!(latencies = malloc(cnt * sizeof(uint32_t)))) {
+		error_print();
+		goto end;
+	}
+	cnt = 0;
+	for (i = 0; i < threads; i++) {
+		memcpy(latencies + cnt, jobs[i].latencies, jobs[i].latencies_cnt * sizeof(uint32_t));
+		cnt += jobs[i].latencies_cnt;
+	}
+	qsort(latencies, cnt, sizeof(uint32_t), tlsperf_uint32_cmp);
+
+	printf("  %-14s %10.1f/s  p50 %.3fms  p99 %.3fms  p999 %.3fms  (%zu handshakes)\n",
+		resume ? "resumptions" : "handshakes",
+		rate,
+		tlsperf_percentile(latencies, cnt, 0.50),
+		tlsperf_percentile(latencies, cnt, 0.99),
+		tlsperf_percentile(latencies, cnt, 0.999),
+		cnt);
+	ret = 1;
+
+end:
+	for (i = 0; i < threads; i++) {
+		if (jobs[i].latencies) free(jobs[i].latencies);
+	}
+	free(jobs);
+	if (latencies) free(latencies);
+	return ret;
+}
+
+static int tlsperf_throughput(const TLS_CTX *ctx, const struct sockaddr_in *server,
+	int threads, double seconds, size_t record_size)
+{
+	TLSPERF_JOB *jobs;
+	double rate = 0;
+	int i;
+
+	if (!(jobs = calloc(threads, sizeof(TLSPERF_JOB)))) {
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < threads; i++) {
+		jobs[i].ctx = ctx;
+		jobs[i].server = server;
+		jobs[i].seconds = seconds;
+		jobs[i].record_size = record_size;
+	}
+	if (tlsperf_run(jobs, threads, tlsperf_throughput_worker) != 1) {
+		free(jobs);
+		error_print();
+		return -1;
+	}
+	for (i = 0; i < threads; i++) {
+		rate += jobs[i].bytes / jobs[i].elapsed;
+	}
+	free(jobs);
+
+	printf("  record %5zu   %10.2f MB/s\n", record_size, rate / 1000000);
+	return 1;
+}
+
+static const int tlcp_ciphers[] = { TLS_cipher_ecc_sm4_cbc_sm3, TLS_cipher_ecc_sm4_gcm_sm3,
+	TLS_cipher_ecdhe_sm4_cbc_sm3, TLS_cipher_ecdhe_sm4_gcm_sm3 };
+static const int tls12_ciphers[] = { TLS_cipher_ecdhe_sm4_cbc_sm3, TLS_cipher_ecdhe_sm4_gcm_sm3 };
+static const int tls13_ciphers[] = { TLS_cipher_sm4_gcm_sm3, TLS_cipher_sm4_ccm_sm3 };
+
+// accepts both `TLS_ECC_SM4_CBC_SM3` and `ecc_sm4_cbc_sm3`
+static int tlsperf_cipher_from_name(int protocol, const char *name)
+{
+	const int *ciphers;
+	size_t ciphers_cnt;
+	size_t i;
+
+	switch (protocol) {
+	case TLS_protocol_tlcp:
+		ciphers = tlcp_ciphers;
+		ciphers_cnt = sizeof(tlcp_ciphers)/sizeof(int);
+		break;
+	case TLS_protocol_tls12:
+		ciphers = tls12_ciphers;
+		ciphers_cnt = sizeof(tls12_ciphers)/sizeof(int);
+		break;
+	default:
+		ciphers = tls13_ciphers;
+		ciphers_cnt = sizeof(tls13_ciphers)/sizeof(int);
+	}
+	if (!strncmp(name, "TLS_", 4) || !strncmp(name, "tls_", 4)) {
+		name += 4;
+	}
+	for (i = 0; i < ciphers_cnt; i++) {
+		const char *cipher_name = tls_cipher_suite_name(ciphers[i]) + 4;
+		size_t j;
+		for (j = 0; cipher_name[j] && name[j]; j++) {
+			if ((cipher_name[j] | 0x20) != (name[j] | 0x20)) {
+				break;
+			}
+		}
+		if (!cipher_name[j] && !name[j]) {
+			return ciphers[i];
+		}
+	}
+	return -1;
+}
+
+static const char *options =
+	"-protocol tlcp|tls12|tls13 -host str [-port num] [-cacert file]\n"
+	"               [-cert file -key file -pass str] [-cipher name]* [-threads num] [-seconds num]\n"
+	"               [-records size,size,...] [-nohandshake] [-resume] [-key_pool num]";
+
+static const char *help =
+"Options\n"
+"\n"
+"    -protocol tlcp|tls12|tls13    Protocol of the server\n"
+"    -host str                     Server address, the server should be one of the\n"
+"                                  tlcp_server, tls12_server and tls13_server commands\n"
+"    -port num                     Server port, default 443\n"
+"    -cacert file                  CA certificates to verify the server certificate\n"
+"    -cert file                    Client certificate chain, enables client authentication\n"
+"    -key file                     Client private key\n"
+"    -pass str                     Password of the client private key\n"
+"    -cipher name                  Cipher suite to test, can be given more than once.\n"
+"                                  Default is the cipher suite of the protocol client command\n"
+"    -threads num                  Number of concurrent connections, default 1\n"
+"    -seconds num                  Duration of every test, default 3\n"
+"    -records size,size,...        Record sizes of the throughput tests, 0 to skip them,\n"
+"                                  default 1024,16384\n"
+"    -nohandshake                  Skip the handshake tests\n"
+"    -resume                       Also test TLS 1.3 session resumption with tickets,\n"
+"                                  the tls13_server should be run with `-tickets`\n"
+"    -key_pool num                 Take the TLS 1.2 and TLS 1.3 ECDHE keys from a pool of\n"
+"                                  num keys generated in the background, default 0 (off)\n"
+"\n"
+"Examples\n"
+"\n"
+"    gmssl tls12_server -port 4433 -cert certs.pem -key signkey.pem -pass 1234 &\n"
+"    gmssl tlsperf -protocol tls12 -host 127.0.0.1 -port 4433 -cacert rootcacert.pem \\\n"
+"        -threads 8 -records 256,1024,4096,16384\n"
+"\n"
+"    gmssl tls13_server -port 4433 -cert certs.pem -key signkey.pem -pass 1234 -tickets 3600 &\n"
+"    gmssl tlsperf -protocol tls13 -host 127.0.0.1 -port 4433 -cacert rootcacert.pem \\\n"
+"        -threads 8 -resume -records 0\n"
+"\n";
+
+int tlsperf_main(int argc, char **argv)
+{
+	int ret = 1;
+	char *prog = argv[0];
+	int protocol = 0;
+	char *host = NULL;
+	int port = 443;
+	char *cacertfile = NULL;
+	char *certfile = NULL;
+	char *keyfile = NULL;
+	char *pass = NULL;
+	char *cipher_names[TLSPERF_MAX_CIPHERS];
+	size_t cipher_names_cnt = 0;
+	int ciphers[TLSPERF_MAX_CIPHERS];
+	size_t ciphers_cnt = 0;
+	size_t records[TLSPERF_MAX_RECORDS] = { 1024, 16384 };
+	size_t records_cnt = 2;
+	int threads = 1;
+	double seconds = 3;
+	int handshake = 1;
+	int resume = 0;
+	int key_pool = 0;
+	struct hostent *hp;
+	struct sockaddr_in server;
+	TLS_CTX ctx;
+	size_t i, j;
+
+	memset(&ctx, 0, sizeof(ctx));
+#ifndef WIN32
+	// a server closing the connection should fail the test, not kill the process
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	argc--;
+	argv++;
+
+	if (argc < 1) {
+		fprintf(stderr, "usage: %s %s\n", prog, options);
+		return 1;
+	}
+
+	while (argc > 0) {
+		if (!strcmp(*argv, "-help")) {
+			printf("usage: %s %s\n\n", prog, options);
+			printf("%s\n", help);
+			ret = 0;
+			goto end;
+		} else if (!strcmp(*argv, "-protocol")) {
+			if (--argc < 1) goto bad;
+			argv++;
+			if (!strcmp(*argv, "tlcp")) {
+				protocol = TLS_protocol_tlcp;
+			} else if (!strcmp(*argv, "tls12")) {
+				protocol = TLS_protocol_tls12;
+			} else if (!strcmp(*argv, "tls13")) {
+				protocol = TLS_protocol_tls13;
+			} else {
+				fprintf(stderr, "%s: invalid protocol '%s'\n", prog, *argv);
+				goto end;
+			}
+		} else if (!strcmp(*argv, "-host")) {
+			if (--argc < 1) goto bad;
+			host = *(++argv);
+		} else if (!strcmp(*argv, "-port")) {
+			if (--argc < 1) goto bad;
+			port = atoi(*(++argv));
+			if (port <= 0 || port > 65535) {
+				fprintf(stderr, "%s: invalid port\n", prog);
+				goto end;
+			}
+		} else if (!strcmp(*argv, "-cacert")) {
+			if (--argc < 1) goto bad;
+			cacertfile = *(++argv);
+		} else if (!strcmp(*argv, "-cert")) {
+			if (--argc < 1) goto bad;
+			certfile = *(++argv);
+		} else if (!strcmp(*argv, "-key")) {
+			if (--argc < 1) goto bad;
+			keyfile = *(++argv);
+		} else if (!strcmp(*argv, "-pass")) {
+			if (--argc < 1) goto bad;
+			pass = *(++argv);
+		} else if (!strcmp(*argv, "-cipher")) {
+			if (--argc < 1) goto bad;
+			if (cipher_names_cnt >= TLSPERF_MAX_CIPHERS) {
+				fprintf(stderr, "%s: too many cipher suites\n", prog);
+				goto end;
+			}
+			cipher_names[cipher_names_cnt++] = *(++argv);
+		} else if (!strcmp(*argv, "-threads")) {
+			if (--argc < 1) goto bad;
+			threads = atoi(*(++argv));
+			if (threads < 1 || threads > TLSPERF_MAX_THREADS) {
+				fprintf(stderr, "%s: invalid threads, should be 1 to %d\n", prog, TLSPERF_MAX_THREADS);
+				goto end;
+			}
+#ifdef WIN32
+			if (threads > 1) {
+				fprintf(stderr, "%s: `-threads` is not supported on this platform\n", prog);
+				goto end;
+			}
+#endif
+		} else if (!strcmp(*argv, "-seconds")) {
+			if (--argc < 1) goto bad;
+			seconds = atof(*(++argv));
+			if (seconds <= 0 || seconds > 3600) {
+				fprintf(stderr, "%s: invalid seconds\n", prog);
+				goto end;
+			}
+		} else if (!strcmp(*argv, "-records")) {
+			char *p;
+			if (--argc < 1) goto bad;
+			p = *(++argv);
+			records_cnt = 0;
+			while (*p) {
+				long size = strtol(p, &p, 10);
+				if (size < 0 || size > 1024 * 1024 || (*p && *p != ',')
+					|| records_cnt >= TLSPERF_MAX_RECORDS) {
+					fprintf(stderr, "%s: invalid records '%s'\n", prog, *argv);
+					goto end;
+				}
+				if (size) {
+					records[records_cnt++] = (size_t)size;
+				}
+				if (*p == ',') p++;
+			}
+		} else if (!strcmp(*argv, "-nohandshake")) {
+			handshake = 0;
+		} else if (!strcmp(*argv, "-resume")) {
+			resume = 1;
+		} else if (!strcmp(*argv, "-key_pool")) {
+			if (--argc < 1) goto bad;
+			key_pool = atoi(*(++argv));
+			if (key_pool < 0 || key_pool > SM2_KEY_POOL_MAX_SIZE) {
+				fprintf(stderr, "%s: invalid key_pool\n", prog);
+				goto end;
+			}
+		} else {
+			fprintf(stderr, "%s: illegal option '%s'\n", prog, *argv);
+			goto end;
+bad:
+			fprintf(stderr, "%s: '%s' option value missing\n", prog, *argv);
+			goto end;
+		}
+		argc--;
+		argv++;
+	}
+
+	if (!protocol) {
+		fprintf(stderr, "%s: '-protocol' option required\n", prog);
+		goto end;
+	}
+	if (!host) {
+		fprintf(stderr, "%s: '-host' option required\n", prog);
+		goto end;
+	}
+	if (certfile && (!keyfile || !pass)) {
+		fprintf(stderr, "%s: '-key' and '-pass' options required with '-cert'\n", prog);
+		goto end;
+	}
+	if (resume && protocol != TLS_protocol_tls13) {
+		fprintf(stderr, "%s: '-resume' is only supported by tls13\n", prog);
+		goto end;
+	}
+	// the server does not issue tickets when it requests client certificates
+	if (resume && certfile) {
+		fprintf(stderr, "%s: '-resume' can not be used with '-cert'\n", prog);
+		goto end;
+	}
+
+	for (i = 0; i < cipher_names_cnt; i++) {
+		if ((ciphers[ciphers_cnt++] = tlsperf_cipher_from_name(protocol, cipher_names[i])) < 0) {
+			fprintf(stderr, "%s: cipher suite '%s' not supported by %s\n", prog,
+				cipher_names[i], tls_protocol_name(protocol));
+			goto end;
+		}
+	}
+	if (!ciphers_cnt) {
+		switch (protocol) {
+		case TLS_protocol_tlcp: ciphers[ciphers_cnt++] = TLS_cipher_ecc_sm4_cbc_sm3; break;
+		case TLS_protocol_tls12: ciphers[ciphers_cnt++] = TLS_cipher_ecdhe_sm4_cbc_sm3; break;
+		case TLS_protocol_tls13: ciphers[ciphers_cnt++] = TLS_cipher_sm4_gcm_sm3; break;
+		}
+	}
+
+	if (tls_socket_lib_init() != 1) {
+		error_print();
+		goto end;
+	}
+	if (!(hp = gethostbyname(host))) {
+		fprintf(stderr, "%s: invalid host '%s'\n", prog, host);
+		goto end;
+	}
+	memset(&server, 0, sizeof(server));
+	server.sin_addr = *((struct in_addr *)hp->h_addr_list[0]);
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+
+	printf("%s, %d concurrent connections, %g seconds per test, client authentication %s, resumption %s\n",
+		tls_protocol_name(protocol), threads, seconds, certfile ? "on" : "off", resume ? "on" : "off");
+
+	for (i = 0; i < ciphers_cnt; i++) {
+		if (tls_ctx_init(&ctx, protocol, TLS_client_mode) != 1
+			|| tls_ctx_set_cipher_suites(&ctx, &ciphers[i], 1) != 1) {
+			fprintf(stderr, "%s: context init error\n", prog);
+			goto end;
+		}
+		if (cacertfile) {
+			if (tls_ctx_set_ca_certificates(&ctx, cacertfile, TLS_DEFAULT_VERIFY_DEPTH) != 1) {
+				fprintf(stderr, "%s: load CA certificates failure\n", prog);
+				goto end;
+			}
+		}
+		if (certfile) {
+			if (tls_ctx_set_certificate_and_key(&ctx, certfile, keyfile, pass) != 1) {
+				fprintf(stderr, "%s: load client certificate and key failure\n", prog);
+				goto end;
+			}
+		}
+		if (key_pool) {
+			if (tls_ctx_set_key_pool(&ctx, key_pool) != 1) {
+				fprintf(stderr, "%s: key pool init failure\n", prog);
+				goto end;
+			}
+		}
+
+		printf("%s\n", tls_cipher_suite_name(ciphers[i]));
+		fflush(stdout);
+		if (handshake) {
+			if (tlsperf_handshakes(&ctx, &server, threads, seconds, 0) != 1) {
+				fprintf(stderr, "%s: handshake test failure\n", prog);
+				goto end;
+			}
+			fflush(stdout);
+			if (resume) {
+				if (tlsperf_handshakes(&ctx, &server, threads, seconds, 1) != 1) {
+					fprintf(stderr, "%s: resumption test failure, is the server issuing tickets?\n", prog);
+					goto end;
+				}
+				fflush(stdout);
+			}
+		}
+		for (j = 0; j < records_cnt; j++) {
+			if (tlsperf_throughput(&ctx, &server, threads, seconds, records[j]) != 1) {
+				fprintf(stderr, "%s: throughput test failure\n", prog);
+				goto end;
+			}
+			fflush(stdout);
+		}
+		tls_ctx_cleanup(&ctx);
+	}
+	ret = 0;
+
+end:
+	tls_ctx_cleanup(&ctx);
+	return ret;
+}
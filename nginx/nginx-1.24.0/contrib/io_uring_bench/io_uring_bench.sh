@@ -0,0 +1,107 @@
+#!/bin/sh
+
+# Copyright (C) Nginx, Inc.
+
+
+# The loopback benchmark of "use io_uring" against "use epoll":
+#
+#   contrib/io_uring_bench/io_uring_bench.sh objs/nginx [seconds] [port]
+#
+# nginx runs one worker process under the ngx_bench_count.c preload and
+# ngx_bench_load.c requests a 138 byte file over 50 keepalive and 50
+# short connections and a 1 MB file over 20 keepalive connections.  Every
+# run prints the requests per second and the calls per request.
+
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <nginx binary> [seconds] [port]" >&2
+    exit 1
+fi
+
+NGINX=`cd \`dirname $1\` && pwd`/`basename $1`
+TIME=${2:-5}
+PORT=${3:-8080}
+SRC=`cd \`dirname $0\` && pwd`
+DIR=`mktemp -d /tmp/io_uring_bench.XXXXXX` || exit 1
+
+trap "rm -rf $DIR" EXIT
+
+# the worker may run as nobody
+chmod 755 $DIR
+mkdir $DIR/conf $DIR/logs $DIR/html $DIR/count
+chmod 1777 $DIR/count
+
+cc -O -o $DIR/ngx_bench_load $SRC/ngx_bench_load.c || exit 1
+cc -O -shared -fPIC -o $DIR/ngx_bench_count.so $SRC/ngx_bench_count.c -ldl \
+    || exit 1
+
+head -c 138 /dev/zero | tr '\0' x > $DIR/html/small.html
+head -c 1048576 /dev/zero > $DIR/html/big.bin
+
+
+run() {
+    method=$1
+    uri=$2
+    conns=$3
+    keepalive=$4
+
+    cat > $DIR/conf/bench.conf << END
+worker_processes 1;
+error_log logs/error.log;
+pid logs/nginx.pid;
+
+events {
+    use $method;
+    worker_connections 1024;
+}
+
+http {
+    access_log off;
+    sendfile on;
+    keepalive_requests 100000;
+    default_type application/octet-stream;
+
+    server {
+        listen 127.0.0.1:$PORT;
+        root $DIR/html;
+    }
+}
+END
+
+    rm -f $DIR/count/*
+
+    NGX_BENCH_COUNT=$DIR/count LD_PRELOAD=$DIR/ngx_bench_count.so \
+        $NGINX -p $DIR -c conf/bench.conf > /dev/null || exit 1
+
+    sleep 1
+
+    out=`$DIR/ngx_bench_load 127.0.0.1 $PORT $uri $conns $TIME $keepalive`
+
+    $NGINX -p $DIR -c conf/bench.conf -s quit > /dev/null 2>&1
+
+    while [ -f $DIR/logs/nginx.pid ]; do
+        sleep 0.1
+    done
+
+    requests=`echo "$out" | sed -e 's/.*(\([0-9]*\) requests.*/\1/'`
+
+    echo "$method $uri, $conns connections, keepalive $keepalive: $out"
+
+    cat $DIR/count/count.* | awk -v n=$requests '
+        { sum[$1] += $2; if (!($1 in seen)) { seen[$1] = 1; names[k++] = $1 } }
+        END {
+            for (i = 0; i < k; i++) {
+                if (sum[names[i]] && n) {
+                    printf "    %-16s %.2f per request\n",
+                           names[i], sum[names[i]] / n
+                }
+            }
+        }'
+}
+
+
+for method in epoll io_uring; do
+    run $method /small.html 50 1
+    run $method /small.html 50 0
+    run $method /big.bin 20 1
+done
@@ -0,0 +1,269 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+/*
+ * The syscall counter of io_uring_bench.sh, preloaded into nginx:
+ *
+ *   cc -O -shared -fPIC -o ngx_bench_count.so ngx_bench_count.c -ldl
+ *   NGX_BENCH_COUNT=<dir> LD_PRELOAD=./ngx_bench_count.so nginx ...
+ *
+ * It counts the calls of the event and socket I/O functions nginx uses
+ * and every process writes its counts to <dir>/count.<pid> on exit.
+ * Only the libc wrappers are seen, the io_uring module enters the ring
+ * with syscall(SYS_io_uring_enter).
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+
+
+enum {
+    NGX_BENCH_EPOLL_WAIT = 0,
+    NGX_BENCH_EPOLL_CTL,
+    NGX_BENCH_IO_URING_ENTER,
+    NGX_BENCH_ACCEPT,
+    NGX_BENCH_RECV,
+    NGX_BENCH_READ,
+    NGX_BENCH_READV,
+    NGX_BENCH_SEND,
+    NGX_BENCH_WRITEV,
+    NGX_BENCH_SENDFILE,
+    NGX_BENCH_PREAD,
+    NGX_BENCH_CLOSE,
+    NGX_BENCH_LAST
+};
+
+
+static const char  *names[] = {
+    "epoll_wait",
+    "epoll_ctl",
+    "io_uring_enter",
+    "accept",
+    "recv",
+    "read",
+    "readv",
+    "send",
+    "writev",
+    "sendfile",
+    "pread",
+    "close"
+};
+
+
+static unsigned long  counts[NGX_BENCH_LAST];
+static char           path[256];
+
+
+#define ngx_bench_count(n)                                                    \
+    __atomic_fetch_add(&counts[n], 1, __ATOMIC_RELAXED)
+
+#define ngx_bench_next(name)                                                  \
+    static __typeof__(&name)  next;                                           \
+    if (next == NULL) {                                                       \
+        next = (__typeof__(&name)) dlsym(RTLD_NEXT, #name);                   \
+    }
+
+
+int
+epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    ngx_bench_next(epoll_wait);
+    ngx_bench_count(NGX_BENCH_EPOLL_WAIT);
+    return next(epfd, events, maxevents, timeout);
+}
+
+
+int
+epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    ngx_bench_next(epoll_ctl);
+    ngx_bench_count(NGX_BENCH_EPOLL_CTL);
+    return next(epfd, op, fd, event);
+}
+
+
+long
+syscall(long number, ...)
+{
+    long     a[6];
+    int      i;
+    va_list  args;
+
+    ngx_bench_next(syscall);
+
+    va_start(args, number);
+    for (i = 0; i < 6; i++) {
+        a[i] = va_arg(args, long);
+    }
+    va_end(args);
+
+    if (number == SYS_io_uring_enter) {
+        ngx_bench_count(NGX_BENCH_IO_URING_ENTER);
+    }
+
+    return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+
+int
+accept4(int fd, struct sockaddr *addr, socklen_t *len, int flags)
+{
+    ngx_bench_next(accept4);
+    ngx_bench_count(NGX_BENCH_ACCEPT);
+    return next(fd, addr, len, flags);
+}
+
+
+int
+accept(int fd, struct sockaddr *addr, socklen_t *len)
+{
+    ngx_bench_next(accept);
+    ngx_bench_count(NGX_BENCH_ACCEPT);
+    return next(fd, addr, len);
+}
+
+
+ssize_t
+recv(int fd, void *buf, size_t len, int flags)
+{
+    ngx_bench_next(recv);
+    ngx_bench_count(NGX_BENCH_RECV);
+    return next(fd, buf, len, flags);
+}
+
+
+ssize_t
+read(int fd, void *buf, size_t len)
+{
+    ngx_bench_next(read);
+    ngx_bench_count(NGX_BENCH_READ);
+    return next(fd, buf, len);
+}
+
+
+ssize_t
+readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    ngx_bench_next(readv);
+    ngx_bench_count(NGX_BENCH_READV);
+    return next(fd, iov, iovcnt);
+}
+
+
+ssize_t
+send(int fd, const void *buf, size_t len, int flags)
+{
+    ngx_bench_next(send);
+    ngx_bench_count(NGX_BENCH_SEND);
+    return next(fd, buf, len, flags);
+}
+
+
+ssize_t
+writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    ngx_bench_next(writev);
+    ngx_bench_count(NGX_BENCH_WRITEV);
+    return next(fd, iov, iovcnt);
+}
+
+
+ssize_t
+sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    ngx_bench_next(sendfile);
+    ngx_bench_count(NGX_BENCH_SENDFILE);
+    return next(out_fd, in_fd, offset, count);
+}
+
+
+ssize_t
+sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count)
+{
+    ngx_bench_next(sendfile64);
+    ngx_bench_count(NGX_BENCH_SENDFILE);
+    return next(out_fd, in_fd, offset, count);
+}
+
+
+ssize_t
+pread(int fd, void *buf, size_t len, off_t offset)
+{
+    ngx_bench_next(pread);
+    ngx_bench_count(NGX_BENCH_PREAD);
+    return next(fd, buf, len, offset);
+}
+
+
+ssize_t
+pread64(int fd, void *buf, size_t len, off64_t offset)
+{
+    ngx_bench_next(pread64);
+    ngx_bench_count(NGX_BENCH_PREAD);
+    return next(fd, buf, len, offset);
+}
+
+
+int
+close(int fd)
+{
+    ngx_bench_next(close);
+    ngx_bench_count(NGX_BENCH_CLOSE);
+    return next(fd);
+}
+
+
+/* the directory is saved at start, nginx clears the environment of workers */
+
+static void __attribute__((constructor))
+ngx_bench_count_init(void)
+{
+    const char  *dir;
+
+    dir = getenv("NGX_BENCH_COUNT");
+
+    if (dir != NULL) {
+        snprintf(path, sizeof(path), "%s", dir);
+    }
+}
+
+
+static void __attribute__((destructor))
+ngx_bench_count_write(void)
+{
+    int    i;
+    char   name[300];
+    FILE  *f;
+
+    if (path[0] == '\0') {
+        return;
+    }
+
+    snprintf(name, sizeof(name), "%s/count.%d", path, (int) getpid());
+
+    f = fopen(name, "w");
+    if (f == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NGX_BENCH_LAST; i++) {
+        fprintf(f, "%s %lu\n", names[i], counts[i]);
+    }
+
+    fclose(f);
+}
@@ -0,0 +1,348 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+/*
+ * The loopback HTTP load client of io_uring_bench.sh.  It keeps the
+ * given number of connections busy with "GET <uri>" for the given time
+ * and prints the requests per second:
+ *
+ *   cc -O -o ngx_bench_load ngx_bench_load.c
+ *   ngx_bench_load <addr> <port> <uri> <connections> <seconds> <keepalive>
+ *
+ * With keepalive 0 every request is sent on a new connection with
+ * "Connection: close".  The responses must have Content-Length, the
+ * body is read and discarded.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+#define NGX_BENCH_HEADER_SIZE  4096
+
+
+typedef struct {
+    int     fd;
+    size_t  sent;
+    size_t  header_len;
+    off_t   body_left;
+    int     last;
+    char    header[NGX_BENCH_HEADER_SIZE];
+} ngx_bench_conn_t;
+
+
+static int ngx_bench_connect(ngx_bench_conn_t *c);
+static int ngx_bench_send(ngx_bench_conn_t *c);
+static int ngx_bench_recv(ngx_bench_conn_t *c);
+static double ngx_bench_now(void);
+
+
+static struct sockaddr_in   addr;
+static char                 request[1024];
+static size_t               request_len;
+static int                  keepalive;
+static int                  ep;
+static unsigned long        requests;
+static unsigned long        errors;
+static char                 buf[65536];
+
+
+int
+main(int argc, char *const *argv)
+{
+    int                  i, n, conns, seconds;
+    double               start, now;
+    ngx_bench_conn_t    *c, *cs;
+    struct epoll_event   ee[64];
+
+    if (argc != 7) {
+        fprintf(stderr, "usage: %s <addr> <port> <uri> <connections> "
+                        "<seconds> <keepalive>\n", argv[0]);
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(argv[2]));
+
+    if (inet_pton(AF_INET, argv[1], &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid address \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    conns = atoi(argv[4]);
+    seconds = atoi(argv[5]);
+    keepalive = atoi(argv[6]);
+
+    if (conns <= 0 || seconds <= 0) {
+        fprintf(stderr, "invalid connections or seconds\n");
+        return 1;
+    }
+
+    request_len = snprintf(request, sizeof(request),
+                           "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+                           argv[3], argv[1],
+                           keepalive ? "" : "Connection: close\r\n");
+
+    if (request_len >= sizeof(request)) {
+        fprintf(stderr, "too long uri \"%s\"\n", argv[3]);
+        return 1;
+    }
+
+    ep = epoll_create(conns);
+    if (ep == -1) {
+        perror("epoll_create()");
+        return 1;
+    }
+
+    cs = calloc(conns, sizeof(ngx_bench_conn_t));
+    if (cs == NULL) {
+        perror("calloc()");
+        return 1;
+    }
+
+    for (i = 0; i < conns; i++) {
+        cs[i].fd = -1;
+
+        if (ngx_bench_connect(&cs[i]) != 0) {
+            return 1;
+        }
+    }
+
+    start = ngx_bench_now();
+
+    for ( ;; ) {
+        now = ngx_bench_now();
+
+        if (now - start >= seconds) {
+            break;
+        }
+
+        n = epoll_wait(ep, ee, 64, 100);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            perror("epoll_wait()");
+            return 1;
+        }
+
+        for (i = 0; i < n; i++) {
+            c = ee[i].data.ptr;
+
+            if (c->sent < request_len) {
+                if (ngx_bench_send(c) == 0) {
+                    continue;
+                }
+
+            } else if (ngx_bench_recv(c) == 0) {
+                continue;
+            }
+
+            /* an error or a closed connection, start a new one */
+
+            if (ngx_bench_connect(c) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    now = ngx_bench_now();
+
+    printf("%.0f req/s (%lu requests, %lu errors)\n",
+           requests / (now - start), requests, errors);
+
+    return 0;
+}
+
+
+static int
+ngx_bench_connect(ngx_bench_conn_t *c)
+{
+    int                 nodelay;
+    struct epoll_event  ee;
+
+    if (c->fd != -1) {
+        close(c->fd);
+    }
+
+    c->sent = 0;
+    c->header_len = 0;
+    c->body_left = -1;
+    c->last = 0;
+
+    c->fd = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
+    if (c->fd == -1) {
+        perror("socket()");
+        return -1;
+    }
+
+    nodelay = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(int));
+
+    if (connect(c->fd, (struct sockaddr *) &addr, sizeof(struct sockaddr_in))
+        == -1 && errno != EINPROGRESS)
+    {
+        perror("connect()");
+        return -1;
+    }
+
+    ee.events = EPOLLIN|EPOLLOUT|EPOLLET;
+    ee.data.ptr = c;
+
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ee) == -1) {
+        perror("epoll_ctl()");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* returns 0 while the connection is usable, -1 if a new one is needed */
+
+static int
+ngx_bench_send(ngx_bench_conn_t *c)
+{
+    ssize_t  n;
+
+    while (c->sent < request_len) {
+        n = send(c->fd, request + c->sent, request_len - c->sent, 0);
+
+        if (n == -1) {
+            if (errno == EAGAIN) {
+                return 0;
+            }
+
+            errors++;
+            return -1;
+        }
+
+        c->sent += n;
+    }
+
+    /* the response may already be there */
+
+    return ngx_bench_recv(c);
+}
+
+
+static int
+ngx_bench_recv(ngx_bench_conn_t *c)
+{
+    char     *p, *end;
+    size_t    size;
+    ssize_t   n;
+
+    for ( ;; ) {
+        if (c->body_left == -1) {
+            size = NGX_BENCH_HEADER_SIZE - 1 - c->header_len;
+            n = recv(c->fd, c->header + c->header_len, size, 0);
+
+        } else {
+            size = sizeof(buf);
+            n = recv(c->fd, buf, size, 0);
+        }
+
+        if (n == -1) {
+            if (errno == EAGAIN) {
+                return 0;
+            }
+
+            errors++;
+            return -1;
+        }
+
+        if (n == 0) {
+            if (c->sent || c->header_len) {
+                errors++;
+            }
+
+            return -1;
+        }
+
+        if (c->body_left == -1) {
+            c->header_len += n;
+            c->header[c->header_len] = '\0';
+
+            end = strstr(c->header, "\r\n\r\n");
+
+            if (end == NULL) {
+                if (c->header_len == NGX_BENCH_HEADER_SIZE - 1) {
+                    errors++;
+                    return -1;
+                }
+
+                continue;
+            }
+
+            p = strstr(c->header, "Content-Length: ");
+
+            if (p == NULL || p > end || strncmp(c->header + 9, "200", 3) != 0)
+            {
+                errors++;
+                return -1;
+            }
+
+            c->body_left = strtoll(p + sizeof("Content-Length: ") - 1, NULL,
+                                   10)
+                           - (c->header + c->header_len - (end + 4));
+
+            /* keepalive_requests or keepalive_timeout reached */
+
+            p = strstr(c->header, "Connection: close");
+            c->last = (p != NULL && p < end);
+
+        } else {
+            c->body_left -= n;
+        }
+
+        if (c->body_left > 0) {
+            continue;
+        }
+
+        if (c->body_left < 0) {
+            errors++;
+            return -1;
+        }
+
+        requests++;
+
+        if (!keepalive || c->last) {
+            return -1;
+        }
+
+        c->header_len = 0;
+        c->body_left = -1;
+        c->sent = 0;
+
+        return ngx_bench_send(c);
+    }
+}
+
+
+static double
+ngx_bench_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
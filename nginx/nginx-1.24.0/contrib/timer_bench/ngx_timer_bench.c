@@ -0,0 +1,235 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+/*
+ * The microbenchmark of the event timer backends, the rbtree and the
+ * timing wheel of "timer_wheel on".  It is linked against the objects
+ * of a configured and built nginx tree, main() of nginx.o is renamed:
+ *
+ *   make
+ *   objcopy --redefine-sym main=ngx_nginx_main \
+ *       objs/src/core/nginx.o objs/ngx_timer_bench_nginx.o
+ *   cc -O -I src/core -I src/event -I src/event/modules -I src/os/unix \
+ *       -I objs -o objs/ngx_timer_bench contrib/timer_bench/ngx_timer_bench.c \
+ *       objs/ngx_timer_bench_nginx.o objs/ngx_modules.o \
+ *       `find objs/src -name '*.o' ! -name nginx.o` <libraries of objs/Makefile>
+ *   objs/ngx_timer_bench [timers]
+ *
+ * Every backend arms the timers with random timeouts of 1..60000 ms,
+ * re-arms all of them 3 times, and then steps the time by 1..7 ms up to
+ * the nearest timer until all of them have fired.  A quarter of the
+ * handlers re-arm their timers, as keepalive connections do.
+ *
+ * The timeouts of the re-armed timers depend only on the timer and the
+ * time it fired, so both backends must fire the same timers at the same
+ * milliseconds, and print the same firings, late and sum.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+#define NGX_TIMER_BENCH_TIMERS   1000000
+#define NGX_TIMER_BENCH_MAX      60000
+#define NGX_TIMER_BENCH_REARM    200000
+
+
+static void ngx_timer_bench_run(ngx_uint_t wheel, ngx_uint_t n, ngx_log_t *log);
+static void ngx_timer_bench_add(ngx_event_t *ev, ngx_msec_t timer);
+static void ngx_timer_bench_handler(ngx_event_t *ev);
+static uint32_t ngx_timer_bench_hash(uint32_t a, uint32_t b);
+static double ngx_timer_bench_now(void);
+
+
+static ngx_event_t       *events;
+static ngx_msec_t        *keys;
+static ngx_connection_t   conn;
+static ngx_msec_t         start;
+static ngx_uint_t         firings;
+static ngx_uint_t         late;
+static uint64_t           sum;
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    ngx_uint_t  n;
+    ngx_log_t   log;
+
+    n = NGX_TIMER_BENCH_TIMERS;
+
+    if (argc > 1) {
+        n = (ngx_uint_t) ngx_atoi((u_char *) argv[1], ngx_strlen(argv[1]));
+
+        if (n == (ngx_uint_t) NGX_ERROR || n == 0) {
+            fprintf(stderr, "invalid number of timers \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    ngx_memzero(&log, sizeof(ngx_log_t));
+
+    ngx_time_init();
+
+    events = calloc(n, sizeof(ngx_event_t));
+    keys = calloc(n, sizeof(ngx_msec_t));
+
+    if (events == NULL || keys == NULL) {
+        return 1;
+    }
+
+    conn.fd = (ngx_socket_t) -1;
+
+    printf("%lu timers, %s build\n", (unsigned long) n,
+#if (NGX_DEBUG)
+           "debug"
+#else
+           "non-debug"
+#endif
+           );
+
+    printf("%-7s %10s %10s %12s %10s %6s %20s\n",
+           "", "add", "re-arm", "expire", "firings", "late", "sum");
+
+    ngx_timer_bench_run(0, n, &log);
+    ngx_timer_bench_run(1, n, &log);
+
+    free(events);
+    free(keys);
+
+    return 0;
+}
+
+
+static void
+ngx_timer_bench_run(ngx_uint_t wheel, ngx_uint_t n, ngx_log_t *log)
+{
+    double      t, add, rearm, expire;
+    ngx_uint_t  i, k;
+    ngx_msec_t  timer, step;
+
+    ngx_event_timer_use_wheel = wheel;
+    ngx_current_msec = 1000;
+    start = ngx_current_msec;
+
+    (void) ngx_event_timer_init(log);
+
+    firings = 0;
+    late = 0;
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        ngx_memzero(&events[i], sizeof(ngx_event_t));
+        events[i].data = &conn;
+        events[i].log = log;
+        events[i].handler = ngx_timer_bench_handler;
+    }
+
+    srandom(1);
+
+    t = ngx_timer_bench_now();
+
+    for (i = 0; i < n; i++) {
+        ngx_timer_bench_add(&events[i], 1 + ngx_random() % NGX_TIMER_BENCH_MAX);
+    }
+
+    add = ngx_timer_bench_now() - t;
+
+    /* most of the new timeouts are past NGX_TIMER_LAZY_DELAY */
+
+    t = ngx_timer_bench_now();
+
+    for (k = 0; k < 3; k++) {
+        for (i = 0; i < n; i++) {
+            ngx_timer_bench_add(&events[i],
+                                1 + ngx_random() % NGX_TIMER_BENCH_MAX);
+        }
+    }
+
+    rearm = (ngx_timer_bench_now() - t) / 3;
+
+    t = ngx_timer_bench_now();
+
+    for ( ;; ) {
+        timer = ngx_event_find_timer();
+
+        if (timer == NGX_TIMER_INFINITE) {
+            break;
+        }
+
+        step = 1 + ngx_timer_bench_hash((uint32_t) ngx_current_msec, 0) % 7;
+
+        ngx_current_msec += ngx_min(timer, step);
+
+        ngx_event_expire_timers();
+    }
+
+    expire = ngx_timer_bench_now() - t;
+
+    printf("%-7s %7.1f ns %7.1f ns %10.3f s %10lu %6lu %20llu\n",
+           wheel ? "wheel" : "rbtree", add * 1e9 / n, rearm * 1e9 / n,
+           expire, (unsigned long) firings, (unsigned long) late,
+           (unsigned long long) sum);
+}
+
+
+static void
+ngx_timer_bench_handler(ngx_event_t *ev)
+{
+    uint32_t  i, h;
+
+    i = (uint32_t) (ev - events);
+    h = ngx_timer_bench_hash(i, (uint32_t) ngx_current_msec);
+
+    firings++;
+    sum += h;
+
+    if (keys[i] != ngx_current_msec) {
+        late++;
+    }
+
+    if (i % 4 == 0 && ngx_current_msec - start < NGX_TIMER_BENCH_REARM) {
+        ngx_timer_bench_add(ev, 1 + h % 5000);
+    }
+}
+
+
+/* ngx_rbtree_delete() clears the key, so it is kept aside */
+
+static void
+ngx_timer_bench_add(ngx_event_t *ev, ngx_msec_t timer)
+{
+    ngx_add_timer(ev, timer);
+
+    keys[ev - events] = ev->timer.key;
+}
+
+
+static uint32_t
+ngx_timer_bench_hash(uint32_t a, uint32_t b)
+{
+    uint32_t  h;
+
+    h = a * 0x9e3779b1 ^ b * 0x85ebca77;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6d;
+    h ^= h >> 13;
+
+    return h;
+}
+
+
+static double
+ngx_timer_bench_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -9,10 +9,51 @@
 #include <ngx_core.h>
 
 
+#define NGX_POOL_CACHE_PAGES  16
+#define NGX_POOL_CACHE_SIZES  8
+
+
+typedef struct ngx_pool_cached_s  ngx_pool_cached_t;
+
+struct ngx_pool_cached_s {
+    ngx_pool_cached_t    *next;
+};
+
+
+typedef struct {
+    size_t                size;
+    ngx_pool_cached_t    *free;
+} ngx_pool_cache_slot_t;
+
+
 static ngx_inline void *ngx_palloc_small(ngx_pool_t *pool, size_t size,
     ngx_uint_t align);
 static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
 static void *ngx_palloc_large(ngx_pool_t *pool, size_t size);
+static ngx_pool_cache_slot_t *ngx_pool_cache_slot(size_t size,
+    ngx_uint_t add);
+static void *ngx_pool_cache_alloc(size_t size, ngx_log_t *log);
+static void ngx_pool_cache_free(void *p, size_t size);
+
+
+/*
+ * Pool blocks and large allocations of up to NGX_POOL_CACHE_PAGES pages
+ * freed by a worker are kept on per-size free lists, up to
+ * ngx_pool_cache_max bytes in total, and are reused by the next pools
+ * instead of going through malloc() and free() for every request.
+ * Pools are only used by the worker thread, so no locking is needed.
+ */
+
+size_t                        ngx_pool_cache_max;
+
+static size_t                 ngx_pool_cache_size;
+
+/* page multiples are indexed by the number of pages */
+static ngx_pool_cache_slot_t  ngx_pool_cache_pages[NGX_POOL_CACHE_PAGES + 1];
+
+/* other pool sizes, such as connection_pool_size */
+static ngx_pool_cache_slot_t  ngx_pool_cache_sizes[NGX_POOL_CACHE_SIZES];
+
 
 /*************************************
  * 
@@ -27,7 +68,7 @@ ngx_create_pool(size_t size, ngx_log_t *log)
 {
     ngx_pool_t  *p;
 
-    p = ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+    p = ngx_pool_cache_alloc(size, log);
     if (p == NULL) {
         return NULL;
     }
@@ -89,12 +130,12 @@ ngx_destroy_pool(ngx_pool_t *pool)
 
     for (l = pool->large; l; l = l->next) {
         if (l->alloc) {
-            ngx_free(l->alloc);
+            ngx_pool_cache_free(l->alloc, l->size);
         }
     }
 
     for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next) {
-        ngx_free(p);
+        ngx_pool_cache_free(p, p->d.end - (u_char *) p);
 
         if (n == NULL) {
             break;
@@ -111,7 +152,7 @@ ngx_reset_pool(ngx_pool_t *pool)
 
     for (l = pool->large; l; l = l->next) {
         if (l->alloc) {
-            ngx_free(l->alloc);
+            ngx_pool_cache_free(l->alloc, l->size);
         }
     }
 
@@ -191,7 +232,7 @@ ngx_palloc_block(ngx_pool_t *pool, size_t size)
 
     psize = (size_t) (pool->d.end - (u_char *) pool);
 
-    m = ngx_memalign(NGX_POOL_ALIGNMENT, psize, pool->log);
+    m = ngx_pool_cache_alloc(psize, pool->log);
     if (m == NULL) {
         return NULL;
     }
@@ -225,7 +266,14 @@ ngx_palloc_large(ngx_pool_t *pool, size_t size)
     ngx_uint_t         n;
     ngx_pool_large_t  *large;
 
-    p = ngx_alloc(size, pool->log);
+    if (ngx_pool_cache_max && size <= NGX_POOL_CACHE_PAGES * ngx_pagesize) {
+        size = ngx_align(size, ngx_pagesize);
+        p = ngx_pool_cache_alloc(size, pool->log);
+
+    } else {
+        p = ngx_alloc(size, pool->log);
+    }
+
     if (p == NULL) {
         return NULL;
     }
@@ -235,6 +283,7 @@ ngx_palloc_large(ngx_pool_t *pool, size_t size)
     for (large = pool->large; large; large = large->next) {
         if (large->alloc == NULL) {
             large->alloc = p;
+            large->size = size;
             return p;
         }
 
@@ -245,11 +294,12 @@ ngx_palloc_large(ngx_pool_t *pool, size_t size)
 
     large = ngx_palloc_small(pool, sizeof(ngx_pool_large_t), 1);
     if (large == NULL) {
-        ngx_free(p);
+        ngx_pool_cache_free(p, size);
         return NULL;
     }
 
     large->alloc = p;
+    large->size = size;
     large->next = pool->large;
     pool->large = large;
 
@@ -275,6 +325,7 @@ ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment)
     }
 
     large->alloc = p;
+    large->size = size;
     large->next = pool->large;
     pool->large = large;
 
@@ -291,7 +342,7 @@ ngx_pfree(ngx_pool_t *pool, void *p)
         if (p == l->alloc) {
             ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, pool->log, 0,
                            "free: %p", l->alloc);
-            ngx_free(l->alloc);
+            ngx_pool_cache_free(l->alloc, l->size);
             l->alloc = NULL;
 
             return NGX_OK;
@@ -302,6 +353,114 @@ ngx_pfree(ngx_pool_t *pool, void *p)
 }
 
 
+void
+ngx_pool_usage(ngx_pool_t *pool, ngx_uint_t *blocks, size_t *large)
+{
+    ngx_pool_t        *p;
+    ngx_pool_large_t  *l;
+
+    *blocks = 0;
+    *large = 0;
+
+    for (p = pool; p; p = p->d.next) {
+        (*blocks)++;
+    }
+
+    for (l = pool->large; l; l = l->next) {
+        if (l->alloc) {
+            *large += l->size;
+        }
+    }
+}
+
+
+static ngx_pool_cache_slot_t *
+ngx_pool_cache_slot(size_t size, ngx_uint_t add)
+{
+    ngx_uint_t  i;
+
+    if ((size & (ngx_pagesize - 1)) == 0) {
+        i = size >> ngx_pagesize_shift;
+
+        if (i == 0 || i > NGX_POOL_CACHE_PAGES) {
+            return NULL;
+        }
+
+        return &ngx_pool_cache_pages[i];
+    }
+
+    /* other sizes are only added by pools, not by odd large allocations */
+
+    for (i = 0; i < NGX_POOL_CACHE_SIZES; i++) {
+
+        if (ngx_pool_cache_sizes[i].size == size) {
+            return &ngx_pool_cache_sizes[i];
+        }
+
+        if (ngx_pool_cache_sizes[i].size == 0) {
+
+            if (!add) {
+                return NULL;
+            }
+
+            ngx_pool_cache_sizes[i].size = size;
+            return &ngx_pool_cache_sizes[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static void *
+ngx_pool_cache_alloc(size_t size, ngx_log_t *log)
+{
+    ngx_pool_cached_t      *c;
+    ngx_pool_cache_slot_t  *slot;
+
+    if (ngx_pool_cache_max) {
+        slot = ngx_pool_cache_slot(size, 1);
+
+        if (slot && slot->free) {
+            c = slot->free;
+            slot->free = c->next;
+            ngx_pool_cache_size -= size;
+
+            return c;
+        }
+    }
+
+    return ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+}
+
+
+static void
+ngx_pool_cache_free(void *p, size_t size)
+{
+    ngx_pool_cached_t      *c;
+    ngx_pool_cache_slot_t  *slot;
+
+    /* blocks allocated with ngx_alloc() before may be less aligned */
+
+    if (ngx_pool_cache_size + size <= ngx_pool_cache_max
+        && ((uintptr_t) p & (NGX_POOL_ALIGNMENT - 1)) == 0)
+    {
+        slot = ngx_pool_cache_slot(size, 0);
+
+        if (slot) {
+            c = p;
+            c->next = slot->free;
+            slot->free = c;
+            ngx_pool_cache_size += size;
+
+            return;
+        }
+    }
+
+    ngx_free(p);
+}
+
+
 void *
 ngx_pcalloc(ngx_pool_t *pool, size_t size)
 {
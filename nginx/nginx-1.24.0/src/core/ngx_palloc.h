@@ -43,6 +43,7 @@ typedef struct ngx_pool_large_s  ngx_pool_large_t;
 struct ngx_pool_large_s {
     ngx_pool_large_t     *next;
     void                 *alloc;
+    size_t                size;
 };
 
 
@@ -82,6 +83,8 @@ void *ngx_pcalloc(ngx_pool_t *pool, size_t size);
 void *ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment);
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p);
 
+void ngx_pool_usage(ngx_pool_t *pool, ngx_uint_t *blocks, size_t *large);
+
 
 ngx_pool_cleanup_t *ngx_pool_cleanup_add(ngx_pool_t *p, size_t size);
 void ngx_pool_run_cleanup_file(ngx_pool_t *p, ngx_fd_t fd);
@@ -89,4 +92,7 @@ void ngx_pool_cleanup_file(void *data);
 void ngx_pool_delete_file(void *data);
 
 
+extern size_t  ngx_pool_cache_max;
+
+
 #endif /* _NGX_PALLOC_H_INCLUDED_ */
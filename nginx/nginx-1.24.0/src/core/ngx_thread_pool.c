@@ -16,27 +16,52 @@ typedef struct { //  定义线程池配置结构体
 } ngx_thread_pool_conf_t;
 
 
-typedef struct { //  定义线程池队列结构体
-    ngx_thread_task_t        *first; //  指向队列中第一个任务的指针
-    ngx_thread_task_t       **last; //  指向队列中最后一个任务指针的指针
-} ngx_thread_pool_queue_t;
-
-#define ngx_thread_pool_queue_init(q)                                         \ //  初始化线程池队列的宏定义
-    (q)->first = NULL;                                                        \
-    (q)->last = &(q)->first //  将队列的first指针置为NULL，last指针指向first
+typedef struct {
+    ngx_atomic_t              seq;
+    ngx_thread_task_t        *task;
+} ngx_thread_pool_cell_t;
 
 
 struct ngx_thread_pool_s { //  定义线程池结构体
-    ngx_thread_mutex_t        mtx; //  线程互斥锁，用于保护线程池的同步
-    ngx_thread_pool_queue_t   queue; //  线程池任务队列
-    ngx_int_t                 waiting; //  等待任务的线程数量
-    ngx_thread_cond_t         cond; //  条件变量，用于线程同步
+    /*
+     * A bounded queue of tasks: the worker adds them at the tail,
+     * pool threads take them from the head, each cell has a sequence
+     * number telling which lap of the ring it belongs to.
+     */
+    ngx_thread_pool_cell_t   *cells;
+    ngx_atomic_uint_t         mask;
+
+    u_char                    pad1[NGX_CPU_CACHE_LINE];
+    ngx_atomic_t              tail;
+    u_char                    pad2[NGX_CPU_CACHE_LINE];
+    ngx_atomic_t              head;
+    u_char                    pad3[NGX_CPU_CACHE_LINE];
+
+    ngx_atomic_t              waiting;
+    ngx_atomic_t              sleeping;
+
+    ngx_thread_mutex_t        mtx;
+    ngx_thread_cond_t         cond;
 
     ngx_log_t                *log; //  指向日志结构的指针，用于记录线程池的日志信息
 
     ngx_str_t                 name; //  线程池的名称
     ngx_uint_t                threads; //  线程池中的线程数量
     ngx_int_t                 max_queue; //  线程池的最大队列长度
+    ngx_uint_t                cpu_affinity;
+
+    ngx_msec_t                stats;
+    ngx_event_t               stats_event;
+    ngx_uint_t                max_waiting;
+    ngx_uint_t                overflows;
+    ngx_atomic_t              completed;
+    ngx_atomic_t              wait_time;
+    ngx_atomic_t              run_time;
+    ngx_atomic_t              max_wait_time;
+    ngx_atomic_t              max_run_time;
+    ngx_atomic_uint_t         last_completed;
+    ngx_atomic_uint_t         last_wait_time;
+    ngx_atomic_uint_t         last_run_time;
 
     u_char                   *file; //  文件指针，用于记录配置文件的位置
     ngx_uint_t                line; //  行号，用于记录配置文件的位置
@@ -48,9 +73,23 @@ static ngx_int_t ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, //
 static void ngx_thread_pool_destroy(ngx_thread_pool_t *tp); //  销毁线程池
 static void ngx_thread_pool_exit_handler(void *data, ngx_log_t *log); //  线程池退出处理函数
 
+static ngx_int_t ngx_thread_pool_enqueue(ngx_thread_pool_t *tp,
+    ngx_thread_task_t *task);
+static ngx_thread_task_t *ngx_thread_pool_dequeue(ngx_thread_pool_t *tp);
+static ngx_thread_task_t *ngx_thread_pool_wait(ngx_thread_pool_t *tp);
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+static void ngx_thread_pool_setaffinity(ngx_thread_pool_t *tp, pthread_t tid,
+    ngx_uint_t n, cpu_set_t *allowed, ngx_log_t *log);
+#endif
+
 static void *ngx_thread_pool_cycle(void *data); //  线程池循环函数
 static void ngx_thread_pool_handler(ngx_event_t *ev); //  线程池事件处理函数
 
+static uint64_t ngx_thread_pool_usec(void);
+static void ngx_thread_pool_max(ngx_atomic_t *max, ngx_atomic_uint_t value);
+static void ngx_thread_pool_stats_handler(ngx_event_t *ev);
+static void ngx_thread_pool_log_stats(ngx_thread_pool_t *tp);
+
 static char *ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf); //  配置线程池
 
 static void *ngx_thread_pool_create_conf(ngx_cycle_t *cycle); //  创建线程池配置
@@ -63,7 +102,7 @@ static void ngx_thread_pool_exit_worker(ngx_cycle_t *cycle); //  退出工作线
 static ngx_command_t  ngx_thread_pool_commands[] = { //  线程池命令数组
 
     { ngx_string("thread_pool"), //  定义一个名为 "thread_pool" 的配置指令
-      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE23, //  指令可以在主配置块中使用，并且是直接配置指令，可以接受2或3个参数
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_2MORE,
       ngx_thread_pool, //  指令的处理函数
       0, //  指令的偏移量，这里为0，表示不需要偏移
       0, //  指令的默认值，这里为0，表示没有默认值
@@ -98,18 +137,22 @@ ngx_module_t  ngx_thread_pool_module = {
 
 static ngx_str_t  ngx_thread_pool_default = ngx_string("default");
 
-static ngx_uint_t               ngx_thread_pool_task_id;
-static ngx_atomic_t             ngx_thread_pool_done_lock;
-static ngx_thread_pool_queue_t  ngx_thread_pool_done;
+static ngx_uint_t     ngx_thread_pool_task_id;
+
+/* a stack of completed tasks, pushed by pool threads */
+static ngx_atomic_t   ngx_thread_pool_done;
 
 
 static ngx_int_t
 ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
 {
-    int             err; //  用于存储pthread函数的返回错误码
-    pthread_t       tid; //  用于存储线程ID
-    ngx_uint_t      n; //  用于循环计数
-    pthread_attr_t  attr; //  用于设置线程属性
+    int                err; //  用于存储pthread函数的返回错误码
+    pthread_t          tid; //  用于存储线程ID
+    ngx_uint_t         n, size;
+    pthread_attr_t     attr; //  用于设置线程属性
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+    cpu_set_t          allowed;
+#endif
 
     if (ngx_notify == NULL) { //  检查ngx_notify是否为NULL，如果为NULL则表示配置的事件方法不能与线程池一起使用
         ngx_log_error(NGX_LOG_ALERT, log, 0,
@@ -117,19 +160,50 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
         return NGX_ERROR;
     }
 
-    ngx_thread_pool_queue_init(&tp->queue); //  初始化线程池队列
+    /* the ring holds at least max_queue tasks, so it is never full */
+
+    for (size = 2; size < (ngx_uint_t) tp->max_queue; size <<= 1) {
+        /* void */
+    }
+
+    tp->cells = ngx_palloc(pool, size * sizeof(ngx_thread_pool_cell_t));
+    if (tp->cells == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (n = 0; n < size; n++) {
+        tp->cells[n].seq = n;
+    }
+
+    tp->mask = size - 1;
+    tp->head = 0;
+    tp->tail = 0;
+    tp->waiting = 0;
+    tp->sleeping = 0;
 
-    if (ngx_thread_mutex_create(&tp->mtx, log) != NGX_OK) { //  创建线程互斥锁
+    if (ngx_thread_mutex_create(&tp->mtx, log) != NGX_OK) {
         return NGX_ERROR;
     }
 
-    if (ngx_thread_cond_create(&tp->cond, log) != NGX_OK) { //  创建线程条件变量
-        (void) ngx_thread_mutex_destroy(&tp->mtx, log); //  如果条件变量创建失败，销毁已创建的互斥锁
+    if (ngx_thread_cond_create(&tp->cond, log) != NGX_OK) {
+        (void) ngx_thread_mutex_destroy(&tp->mtx, log);
         return NGX_ERROR;
     }
 
     tp->log = log; //  设置线程池的日志
 
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+
+    if (tp->cpu_affinity && sched_getaffinity(0, sizeof(cpu_set_t), &allowed)
+                            == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "sched_getaffinity() failed");
+        tp->cpu_affinity = 0;
+    }
+
+#endif
+
     err = pthread_attr_init(&attr); //  初始化线程属性
     if (err) {
         ngx_log_error(NGX_LOG_ALERT, log, err,
@@ -160,14 +234,66 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
                           "pthread_create() failed");
             return NGX_ERROR;
         }
+
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+        if (tp->cpu_affinity) {
+            ngx_thread_pool_setaffinity(tp, tid, n, &allowed, log);
+        }
+#endif
     }
 
     (void) pthread_attr_destroy(&attr); //  使用 pthread_attr_destroy 函数销毁线程属性对象     该函数用于释放与线程属性对象相关的资源     参数 &attr 是指向要销毁的线程属性对象的指针     (void) 表示忽略该函数的返回值，因为在此处不需要处理返回值
 
+    if (tp->stats) {
+        tp->stats_event.handler = ngx_thread_pool_stats_handler;
+        tp->stats_event.data = tp;
+        tp->stats_event.log = log;
+        tp->stats_event.cancelable = 1;
+
+        ngx_add_timer(&tp->stats_event, tp->stats);
+    }
+
     return NGX_OK;
 }
 
 
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+
+static void
+ngx_thread_pool_setaffinity(ngx_thread_pool_t *tp, pthread_t tid, ngx_uint_t n,
+    cpu_set_t *allowed, ngx_log_t *log)
+{
+    int         err;
+    ngx_uint_t  cpu;
+    cpu_set_t   mask;
+
+    /* the n-th thread goes to the n-th CPU the worker is allowed to run on */
+
+    n %= CPU_COUNT(allowed);
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, allowed) && n-- == 0) {
+            break;
+        }
+    }
+
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+
+    err = pthread_setaffinity_np(tid, sizeof(cpu_set_t), &mask);
+    if (err) {
+        ngx_log_error(NGX_LOG_ALERT, log, err,
+                      "pthread_setaffinity_np(%ui) failed", cpu);
+        return;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, log, 0,
+                   "thread in pool \"%V\" bound to CPU%ui", &tp->name, cpu);
+}
+
+#endif
+
+
 static void
 ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
 {
@@ -175,6 +301,10 @@ ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
     ngx_thread_task_t    task; //  定义一个线程任务结构体task
     volatile ngx_uint_t  lock; //  定义一个volatile修饰的无符号整数lock，用于线程同步
 
+    if (tp->stats) {
+        ngx_thread_pool_log_stats(tp);
+    }
+
     ngx_memzero(&task, sizeof(ngx_thread_task_t)); //  使用ngx_memzero函数将task结构体初始化为0
 
     task.handler = ngx_thread_pool_exit_handler; //  设置task的handler为ngx_thread_pool_exit_handler，这是一个退出处理函数
@@ -230,22 +360,24 @@ ngx_thread_task_alloc(ngx_pool_t *pool, size_t size)
 ngx_int_t
 ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 {
+    ngx_uint_t  waiting;
+
     if (task->event.active) {
         ngx_log_error(NGX_LOG_ALERT, tp->log, 0,
                       "task #%ui already active", task->id);
         return NGX_ERROR;
     }
 
-    if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
-        return NGX_ERROR;
-    }
+    /* tasks are only posted by the worker, pool threads only decrement */
 
-    if (tp->waiting >= tp->max_queue) {
-        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+    waiting = tp->waiting;
+
+    if ((ngx_int_t) waiting >= tp->max_queue) {
+        tp->overflows++;
 
         ngx_log_error(NGX_LOG_ERR, tp->log, 0,
-                      "thread pool \"%V\" queue overflow: %i tasks waiting",
-                      &tp->name, tp->waiting);
+                      "thread pool \"%V\" queue overflow: %ui tasks waiting",
+                      &tp->name, waiting);
         return NGX_ERROR;
     }
 
@@ -254,17 +386,46 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
     task->id = ngx_thread_pool_task_id++;
     task->next = NULL;
 
-    if (ngx_thread_cond_signal(&tp->cond, tp->log) != NGX_OK) {
-        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+    if (tp->stats) {
+        task->posted = ngx_thread_pool_usec();
+
+        if (waiting + 1 > tp->max_waiting) {
+            tp->max_waiting = waiting + 1;
+        }
+    }
+
+    (void) ngx_atomic_fetch_add(&tp->waiting, 1);
+
+    if (ngx_thread_pool_enqueue(tp, task) != NGX_OK) {
+        (void) ngx_atomic_fetch_add(&tp->waiting, -1);
+        task->event.active = 0;
+
+        ngx_log_error(NGX_LOG_ALERT, tp->log, 0,
+                      "thread pool \"%V\" queue is full", &tp->name);
         return NGX_ERROR;
     }
 
-    *tp->queue.last = task;
-    tp->queue.last = &task->next;
+    /*
+     * A thread that found the queue empty increments tp->sleeping
+     * before it looks at the queue for the last time, and the locked
+     * operation below orders our load after the store to the cell:
+     * either the thread sees the task, or we see the thread sleeping.
+     * The mutex is only taken when somebody is to be woken up.
+     */
 
-    tp->waiting++;
+    if (ngx_atomic_fetch_add(&tp->sleeping, 0) != 0) {
 
-    (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+        if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if (ngx_thread_cond_signal(&tp->cond, tp->log) != NGX_OK) {
+            (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+            return NGX_ERROR;
+        }
+
+        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+    }
 
     ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
                    "task #%ui added to thread pool \"%V\"",
@@ -274,13 +435,119 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 }
 
 
+static ngx_int_t
+ngx_thread_pool_enqueue(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
+{
+    ngx_atomic_int_t         diff;
+    ngx_atomic_uint_t        pos;
+    ngx_thread_pool_cell_t  *cell;
+
+    pos = tp->tail;
+
+    for ( ;; ) {
+        cell = &tp->cells[pos & tp->mask];
+        diff = (ngx_atomic_int_t) (cell->seq - pos);
+
+        if (diff == 0) {
+            if (ngx_atomic_cmp_set(&tp->tail, pos, pos + 1)) {
+                break;
+            }
+
+        } else if (diff < 0) {
+            return NGX_ERROR;
+        }
+
+        pos = tp->tail;
+    }
+
+    cell->task = task;
+
+    ngx_memory_barrier();
+
+    cell->seq = pos + 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_thread_task_t *
+ngx_thread_pool_dequeue(ngx_thread_pool_t *tp)
+{
+    ngx_atomic_int_t         diff;
+    ngx_atomic_uint_t        pos;
+    ngx_thread_task_t       *task;
+    ngx_thread_pool_cell_t  *cell;
+
+    pos = tp->head;
+
+    for ( ;; ) {
+        cell = &tp->cells[pos & tp->mask];
+        diff = (ngx_atomic_int_t) (cell->seq - (pos + 1));
+
+        if (diff == 0) {
+            if (ngx_atomic_cmp_set(&tp->head, pos, pos + 1)) {
+                break;
+            }
+
+        } else if (diff < 0) {
+            return NULL;
+        }
+
+        pos = tp->head;
+    }
+
+    ngx_memory_barrier();
+
+    task = cell->task;
+
+    ngx_memory_barrier();
+
+    cell->seq = pos + tp->mask + 1;
+
+    return task;
+}
+
+
+static ngx_thread_task_t *
+ngx_thread_pool_wait(ngx_thread_pool_t *tp)
+{
+    ngx_thread_task_t  *task;
+
+    if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
+        return NULL;
+    }
+
+    (void) ngx_atomic_fetch_add(&tp->sleeping, 1);
+
+    for ( ;; ) {
+        task = ngx_thread_pool_dequeue(tp);
+
+        if (task) {
+            break;
+        }
+
+        if (ngx_thread_cond_wait(&tp->cond, &tp->mtx, tp->log) != NGX_OK) {
+            break;
+        }
+    }
+
+    (void) ngx_atomic_fetch_add(&tp->sleeping, -1);
+
+    (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+
+    return task;
+}
+
+
 static void *
 ngx_thread_pool_cycle(void *data)
 {
     ngx_thread_pool_t *tp = data;
 
     int                 err;
+    uint64_t            start, now;
     sigset_t            set;
+    ngx_atomic_uint_t   head;
     ngx_thread_task_t  *task;
 
 #if 0
@@ -304,32 +571,17 @@ ngx_thread_pool_cycle(void *data)
     }
 
     for ( ;; ) {
-        if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
-            return NULL;
-        }
+        task = ngx_thread_pool_dequeue(tp);
 
-        /* the number may become negative */
-        tp->waiting--;
+        if (task == NULL) {
+            task = ngx_thread_pool_wait(tp);
 
-        while (tp->queue.first == NULL) {
-            if (ngx_thread_cond_wait(&tp->cond, &tp->mtx, tp->log)
-                != NGX_OK)
-            {
-                (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+            if (task == NULL) {
                 return NULL;
             }
         }
 
-        task = tp->queue.first;
-        tp->queue.first = task->next;
-
-        if (tp->queue.first == NULL) {
-            tp->queue.last = &tp->queue.first;
-        }
-
-        if (ngx_thread_mutex_unlock(&tp->mtx, tp->log) != NGX_OK) {
-            return NULL;
-        }
+        (void) ngx_atomic_fetch_add(&tp->waiting, -1);
 
 #if 0
         ngx_time_update();
@@ -339,24 +591,40 @@ ngx_thread_pool_cycle(void *data)
                        "run task #%ui in thread pool \"%V\"",
                        task->id, &tp->name);
 
+        start = tp->stats ? ngx_thread_pool_usec() : 0;
+
         task->handler(task->ctx, tp->log);
 
+        if (tp->stats) {
+            now = ngx_thread_pool_usec();
+
+            (void) ngx_atomic_fetch_add(&tp->completed, 1);
+            (void) ngx_atomic_fetch_add(&tp->wait_time, start - task->posted);
+            (void) ngx_atomic_fetch_add(&tp->run_time, now - start);
+
+            ngx_thread_pool_max(&tp->max_wait_time, start - task->posted);
+            ngx_thread_pool_max(&tp->max_run_time, now - start);
+        }
+
         ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
                        "complete task #%ui in thread pool \"%V\"",
                        task->id, &tp->name);
 
-        task->next = NULL;
-
-        ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+        do {
+            head = ngx_thread_pool_done;
+            task->next = (ngx_thread_task_t *) head;
 
-        *ngx_thread_pool_done.last = task;
-        ngx_thread_pool_done.last = &task->next;
+        } while (!ngx_atomic_cmp_set(&ngx_thread_pool_done, head,
+                                     (ngx_atomic_uint_t) task));
 
-        ngx_memory_barrier();
+        /*
+         * The handler takes all completed tasks at once,
+         * so the worker is only notified when the stack was empty.
+         */
 
-        ngx_unlock(&ngx_thread_pool_done_lock);
-
-        (void) ngx_notify(ngx_thread_pool_handler);
+        if (head == 0) {
+            (void) ngx_notify(ngx_thread_pool_handler);
+        }
     }
 }
 
@@ -365,19 +633,27 @@ static void
 ngx_thread_pool_handler(ngx_event_t *ev)
 {
     ngx_event_t        *event;
-    ngx_thread_task_t  *task;
+    ngx_atomic_uint_t   head;
+    ngx_thread_task_t  *task, *next, *done;
 
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ev->log, 0, "thread pool handler");
 
-    ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+    do {
+        head = ngx_thread_pool_done;
 
-    task = ngx_thread_pool_done.first;
-    ngx_thread_pool_done.first = NULL;
-    ngx_thread_pool_done.last = &ngx_thread_pool_done.first;
+    } while (head && !ngx_atomic_cmp_set(&ngx_thread_pool_done, head, 0));
 
-    ngx_memory_barrier();
+    /* the stack is in reverse order of completion */
 
-    ngx_unlock(&ngx_thread_pool_done_lock);
+    done = NULL;
+
+    for (task = (ngx_thread_task_t *) head; task; task = next) {
+        next = task->next;
+        task->next = done;
+        done = task;
+    }
+
+    task = done;
 
     while (task) {
         ngx_log_debug1(NGX_LOG_DEBUG_CORE, ev->log, 0,
@@ -394,6 +670,90 @@ ngx_thread_pool_handler(ngx_event_t *ev)
 }
 
 
+static uint64_t
+ngx_thread_pool_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval   tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+static void
+ngx_thread_pool_max(ngx_atomic_t *max, ngx_atomic_uint_t value)
+{
+    ngx_atomic_uint_t  old;
+
+    do {
+        old = *max;
+
+        if (old >= value) {
+            return;
+        }
+
+    } while (!ngx_atomic_cmp_set(max, old, value));
+}
+
+
+static void
+ngx_thread_pool_stats_handler(ngx_event_t *ev)
+{
+    ngx_thread_pool_t  *tp = ev->data;
+
+    ngx_thread_pool_log_stats(tp);
+
+    if (!ngx_exiting) {
+        ngx_add_timer(ev, tp->stats);
+    }
+}
+
+
+static void
+ngx_thread_pool_log_stats(ngx_thread_pool_t *tp)
+{
+    ngx_atomic_uint_t  completed, wait_time, run_time, max_wait, max_run;
+
+    completed = tp->completed - tp->last_completed;
+    wait_time = tp->wait_time - tp->last_wait_time;
+    run_time = tp->run_time - tp->last_run_time;
+
+    tp->last_completed += completed;
+    tp->last_wait_time += wait_time;
+    tp->last_run_time += run_time;
+
+    /* a maximum raised by a thread right now may be lost, it is only stats */
+
+    max_wait = tp->max_wait_time;
+    max_run = tp->max_run_time;
+    tp->max_wait_time = 0;
+    tp->max_run_time = 0;
+
+    if (completed) {
+        wait_time /= completed;
+        run_time /= completed;
+    }
+
+    ngx_log_error(NGX_LOG_INFO, tp->log, 0,
+                  "thread pool \"%V\": tasks:%uA queue:%uA max_queue:%ui "
+                  "overflows:%ui wait:%uA/%uAus run:%uA/%uAus",
+                  &tp->name, completed, tp->waiting, tp->max_waiting,
+                  tp->overflows, wait_time, max_wait, run_time, max_run);
+
+    tp->max_waiting = tp->waiting;
+    tp->overflows = 0;
+}
+
+
 static void *
 ngx_thread_pool_create_conf(ngx_cycle_t *cycle)
 {
@@ -455,7 +815,7 @@ ngx_thread_pool_init_conf(ngx_cycle_t *cycle, void *conf)
 static char *
 ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
-    ngx_str_t          *value;
+    ngx_str_t          *value, s;
     ngx_uint_t          i;
     ngx_thread_pool_t  *tp;
 
@@ -502,6 +862,38 @@ ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
             continue;
         }
+
+        if (ngx_strcmp(value[i].data, "cpu_affinity=auto") == 0) {
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+            tp->cpu_affinity = 1;
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"cpu_affinity\" is not supported "
+                               "on this platform");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
+        if (ngx_strncmp(value[i].data, "stats=", 6) == 0) {
+
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            tp->stats = ngx_parse_time(&s, 0);
+
+            if (tp->stats == (ngx_msec_t) NGX_ERROR || tp->stats == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid stats value \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
     }
 
     if (tp->threads == 0) {
@@ -599,7 +991,7 @@ ngx_thread_pool_init_worker(ngx_cycle_t *cycle)
         return NGX_OK;
     }
 
-    ngx_thread_pool_queue_init(&ngx_thread_pool_done); //  初始化线程池队列 ngx_thread_pool_done
+    ngx_thread_pool_done = 0;
 
     tpp = tcf->pools.elts; //  获取线程池数组 tpp，该数组存储了所有的线程池
 
@@ -20,6 +20,7 @@ struct ngx_thread_task_s {
     void                *ctx;
     void               (*handler)(void *data, ngx_log_t *log);
     ngx_event_t          event;
+    uint64_t             posted;
 };
 
 
@@ -0,0 +1,1060 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * The io_uring readiness backend, a replacement of the epoll module and
+ * not a completion based I/O path.  The sockets are watched by multishot
+ * IORING_OP_POLL_ADD requests with the same edge triggered semantics as
+ * epoll, and all socket I/O is still done by nginx itself with accept4(),
+ * recv(), writev() and sendfile().  Multishot accept, receives into
+ * provided buffers and send, writev or splice requests are not used.
+ *
+ * What the ring gives over epoll is that the poll changes are not passed
+ * to the kernel one by one as epoll_ctl() calls, but are queued as SQEs
+ * and submitted in the same io_uring_enter() which waits for the
+ * completions.  File AIO reads and the notify eventfd reads are
+ * submitted to the same ring, so "aio on" works without directio.
+ * contrib/io_uring_bench compares the backend with epoll on loopback.
+ *
+ * The user data of a poll request is the connection pointer with the
+ * instance bit as in epoll, the user data of a read is the event pointer
+ * marked with NGX_IO_URING_EVENT, and the poll update and remove requests
+ * use 0 as their completions are of no interest.
+ */
+
+#define NGX_IO_URING_EVENT  2
+
+#if (NGX_HAVE_EPOLLRDHUP)
+#define NGX_IO_URING_READ   (EPOLLIN|EPOLLRDHUP)
+#else
+#define NGX_IO_URING_READ   EPOLLIN
+#endif
+
+
+typedef struct {
+    ngx_uint_t  entries;
+} ngx_io_uring_conf_t;
+
+
+typedef struct {
+    uint32_t              *head;
+    uint32_t              *tail;
+    uint32_t              *array;
+    uint32_t               mask;
+    uint32_t               entries;
+    uint32_t               local_tail;
+} ngx_io_uring_sq_t;
+
+
+typedef struct {
+    uint32_t              *head;
+    uint32_t              *tail;
+    struct io_uring_cqe   *cqes;
+    uint32_t               mask;
+} ngx_io_uring_cq_t;
+
+
+static ngx_int_t ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+static ngx_int_t ngx_io_uring_setup_ring(ngx_cycle_t *cycle,
+    ngx_io_uring_conf_t *urcf);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify_init(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_notify_read(ngx_log_t *log);
+static void ngx_io_uring_notify_handler(ngx_event_t *ev, int res);
+#endif
+static void ngx_io_uring_done(ngx_cycle_t *cycle);
+static struct io_uring_sqe *ngx_io_uring_get_sqe(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_submit(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_poll(ngx_connection_t *c, uint32_t events,
+    ngx_uint_t update);
+static ngx_int_t ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_add_connection(ngx_connection_t *c);
+static ngx_int_t ngx_io_uring_del_connection(ngx_connection_t *c,
+    ngx_uint_t flags);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify(ngx_event_handler_pt handler);
+#endif
+static ngx_int_t ngx_io_uring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+static void ngx_io_uring_process_poll(ngx_cycle_t *cycle, uint64_t data,
+    int res, uint32_t cqe_flags, ngx_uint_t flags);
+
+static void *ngx_io_uring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+static int                  ring = -1;
+static u_char              *ring_map;
+static size_t               ring_map_size;
+static struct io_uring_sqe *ring_sqes;
+static size_t               ring_sqes_size;
+static ngx_io_uring_sq_t    sq;
+static ngx_io_uring_cq_t    cq;
+
+#if (NGX_HAVE_EVENTFD)
+static int                  notify_fd = -1;
+static ngx_event_t          notify_event;
+static uint64_t             notify_count;
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+ngx_uint_t                  ngx_io_uring_aio;
+#endif
+
+static ngx_str_t      io_uring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_io_uring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, entries),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_event_module_t  ngx_io_uring_module_ctx = {
+    &io_uring_name,
+    ngx_io_uring_create_conf,            /* create configuration */
+    ngx_io_uring_init_conf,              /* init configuration */
+
+    {
+        ngx_io_uring_add_event,          /* add an event */
+        ngx_io_uring_del_event,          /* delete an event */
+        ngx_io_uring_add_event,          /* enable an event */
+        ngx_io_uring_del_event,          /* disable an event */
+        ngx_io_uring_add_connection,     /* add an connection */
+        ngx_io_uring_del_connection,     /* delete an connection */
+#if (NGX_HAVE_EVENTFD)
+        ngx_io_uring_notify,             /* trigger a notify */
+#else
+        NULL,                            /* trigger a notify */
+#endif
+        ngx_io_uring_process_events,     /* process the events */
+        ngx_io_uring_init,               /* init the events */
+        ngx_io_uring_done,               /* done the events */
+    }
+};
+
+ngx_module_t  ngx_io_uring_module = {
+    NGX_MODULE_V1,
+    &ngx_io_uring_module_ctx,            /* module context */
+    ngx_io_uring_commands,               /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls
+ * instead of liburing usage, the ring is small enough to be handled here.
+ */
+
+static int
+io_uring_setup(u_int entries, struct io_uring_params *p)
+{
+    return syscall(SYS_io_uring_setup, entries, p);
+}
+
+
+static int
+io_uring_enter(int fd, u_int to_submit, u_int min_complete, u_int flags,
+    void *arg, size_t argsz)
+{
+    return syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+
+static ngx_int_t
+ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_event_get_conf(cycle->conf_ctx, ngx_io_uring_module);
+
+    if (ring == -1) {
+        if (ngx_io_uring_setup_ring(cycle, urcf) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+#if (NGX_HAVE_EVENTFD)
+        if (ngx_io_uring_notify_init(cycle->log) != NGX_OK) {
+            ngx_io_uring_module_ctx.actions.notify = NULL;
+        }
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+        ngx_io_uring_aio = 1;
+#endif
+    }
+
+    ngx_io = ngx_os_io;
+
+    ngx_event_actions = ngx_io_uring_module_ctx.actions;
+
+    /*
+     * the rest of nginx treats the module as epoll: the accepted
+     * connections and the channel are registered lazily by events
+     */
+
+    ngx_event_flags = NGX_USE_CLEAR_EVENT
+                      |NGX_USE_GREEDY_EVENT
+                      |NGX_USE_EPOLL_EVENT;
+
+#if (NGX_HAVE_EPOLLRDHUP)
+
+    /*
+     * POLLRDHUP is always reported by the poll requests, so a short recv()
+     * resets the ready flag as with epoll, and the next recv() is not
+     * called only to get EAGAIN
+     */
+
+    ngx_use_epoll_rdhup = 1;
+#endif
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_setup_ring(ngx_cycle_t *cycle, ngx_io_uring_conf_t *urcf)
+{
+    size_t                  size;
+    uint32_t                i;
+    struct io_uring_params  p;
+
+    ngx_memzero(&p, sizeof(struct io_uring_params));
+
+    ring = io_uring_setup(urcf->entries, &p);
+
+    if (ring == -1) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "io_uring_setup() failed");
+        return NGX_ERROR;
+    }
+
+    /*
+     * IORING_FEAT_RSRC_TAGS appeared in Linux 5.13 together with
+     * the multishot poll, there is no feature bit for the poll itself
+     */
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)
+        || !(p.features & IORING_FEAT_EXT_ARG)
+        || !(p.features & IORING_FEAT_RSRC_TAGS))
+    {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "io_uring features 0x%xD are not enough, "
+                      "Linux 5.13 or newer is required", p.features);
+        goto failed;
+    }
+
+    ring_map_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (ring_map_size < size) {
+        ring_map_size = size;
+    }
+
+    ring_map = mmap(NULL, ring_map_size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+
+    if (ring_map == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "mmap(%uz) of io_uring failed", ring_map_size);
+        ring_map = NULL;
+        goto failed;
+    }
+
+    ring_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring_sqes = mmap(NULL, ring_sqes_size, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQES);
+
+    if (ring_sqes == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "mmap(%uz) of io_uring sqes failed", ring_sqes_size);
+        ring_sqes = NULL;
+        goto failed;
+    }
+
+    sq.head = (uint32_t *) (ring_map + p.sq_off.head);
+    sq.tail = (uint32_t *) (ring_map + p.sq_off.tail);
+    sq.array = (uint32_t *) (ring_map + p.sq_off.array);
+    sq.mask = *(uint32_t *) (ring_map + p.sq_off.ring_mask);
+    sq.entries = p.sq_entries;
+    sq.local_tail = *sq.tail;
+
+    /* the SQEs are always used in order */
+
+    for (i = 0; i < sq.entries; i++) {
+        sq.array[i] = i;
+    }
+
+    cq.head = (uint32_t *) (ring_map + p.cq_off.head);
+    cq.tail = (uint32_t *) (ring_map + p.cq_off.tail);
+    cq.cqes = (struct io_uring_cqe *) (ring_map + p.cq_off.cqes);
+    cq.mask = *(uint32_t *) (ring_map + p.cq_off.ring_mask);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring: fd:%d sq:%uD cq:%uD",
+                   ring, p.sq_entries, p.cq_entries);
+
+    return NGX_OK;
+
+failed:
+
+    if (ring_map) {
+        if (munmap(ring_map, ring_map_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(%uz) of io_uring failed", ring_map_size);
+        }
+
+        ring_map = NULL;
+    }
+
+    if (close(ring) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring = -1;
+
+    return NGX_ERROR;
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify_init(ngx_log_t *log)
+{
+#if (NGX_HAVE_SYS_EVENTFD_H)
+    notify_fd = eventfd(0, 0);
+#else
+    notify_fd = syscall(SYS_eventfd, 0);
+#endif
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.log = log;
+
+    /*
+     * the eventfd is read by the ring itself, so a notification costs
+     * neither a poll wakeup nor a read() syscall
+     */
+
+    if (ngx_io_uring_notify_read(log) != NGX_OK) {
+
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_notify_read(ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = notify_fd;
+    sqe->addr = (uint64_t) (uintptr_t) &notify_count;
+    sqe->len = sizeof(uint64_t);
+    sqe->user_data = (uint64_t) ((uintptr_t) &notify_event
+                                 | NGX_IO_URING_EVENT);
+
+    notify_event.active = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_notify_handler(ngx_event_t *ev, int res)
+{
+    ngx_event_handler_pt  handler;
+
+    ev->active = 0;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "read() eventfd %d: %d count:%uL",
+                   notify_fd, res, notify_count);
+
+    if (res == -ECANCELED) {
+        return;
+    }
+
+    if (res != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, res < 0 ? -res : 0,
+                      "read() eventfd %d failed", notify_fd);
+
+        if (res != -EINTR && res != -EAGAIN) {
+            return;
+        }
+
+    } else {
+        handler = ev->data;
+        handler(ev);
+    }
+
+    if (ngx_io_uring_notify_read(ev->log) != NGX_OK) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
+                      "io_uring eventfd %d read not posted", notify_fd);
+    }
+}
+
+#endif
+
+
+static void
+ngx_io_uring_done(ngx_cycle_t *cycle)
+{
+    /* the pending requests are cancelled by the ring close */
+
+    if (munmap(ring_sqes, ring_sqes_size) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "munmap(%uz) of io_uring sqes failed", ring_sqes_size);
+    }
+
+    ring_sqes = NULL;
+
+    if (munmap(ring_map, ring_map_size) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "munmap(%uz) of io_uring failed", ring_map_size);
+    }
+
+    ring_map = NULL;
+
+    if (close(ring) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring = -1;
+
+#if (NGX_HAVE_EVENTFD)
+
+    if (notify_fd != -1) {
+
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+    }
+
+    notify_event.active = 0;
+
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+    ngx_io_uring_aio = 0;
+#endif
+}
+
+
+static struct io_uring_sqe *
+ngx_io_uring_get_sqe(ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    if (sq.local_tail - *sq.head == sq.entries) {
+
+        /* the queue is full, pass it to the kernel without waiting */
+
+        if (ngx_io_uring_submit(log) != NGX_OK) {
+            return NULL;
+        }
+
+        if (sq.local_tail - *sq.head == sq.entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission queue is full");
+            return NULL;
+        }
+    }
+
+    sqe = &ring_sqes[sq.local_tail & sq.mask];
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    sq.local_tail++;
+
+    return sqe;
+}
+
+
+static ngx_int_t
+ngx_io_uring_submit(ngx_log_t *log)
+{
+    int  n;
+
+    ngx_memory_barrier();
+
+    *sq.tail = sq.local_tail;
+
+    n = io_uring_enter(ring, sq.local_tail - *sq.head, 0, 0, NULL, 0);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "io_uring submit: %d", n);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+/*
+ * The listening sockets are armed one shot and rearmed after each
+ * completion, this gives the level triggered notifications which
+ * ngx_event_accept() expects without multi_accept.
+ */
+
+static ngx_int_t
+ngx_io_uring_poll(ngx_connection_t *c, uint32_t events, ngx_uint_t update)
+{
+    uint32_t              mask;
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(c->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+#if (NGX_HAVE_LITTLE_ENDIAN)
+    mask = events;
+#else
+    mask = (events << 16) | (events >> 16);
+#endif
+
+    if (update) {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t) ((uintptr_t) c | c->read->instance);
+
+        if (events) {
+            sqe->len = IORING_POLL_UPDATE_EVENTS
+                       | (c->read->accept ? 0 : IORING_POLL_ADD_MULTI);
+            sqe->poll32_events = mask;
+        }
+
+    } else {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = c->fd;
+        sqe->len = c->read->accept ? 0 : IORING_POLL_ADD_MULTI;
+        sqe->poll32_events = mask;
+        sqe->user_data = (uint64_t) ((uintptr_t) c | c->read->instance);
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "io_uring poll: fd:%d op:%d ev:%08XD flags:%uD",
+                   c->fd, sqe->opcode, events, sqe->len);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    uint32_t           events, prev;
+    ngx_event_t       *e;
+    ngx_connection_t  *c;
+
+    c = ev->data;
+
+    if (event == NGX_READ_EVENT) {
+        e = c->write;
+        prev = EPOLLOUT;
+        events = NGX_IO_URING_READ;
+
+    } else {
+        e = c->read;
+        prev = NGX_IO_URING_READ;
+        events = EPOLLOUT;
+    }
+
+    if (e->active) {
+        events |= prev;
+    }
+
+    if (ngx_io_uring_poll(c, events, e->active) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    uint32_t           events;
+    ngx_event_t       *e;
+    ngx_connection_t  *c;
+
+    /*
+     * unlike epoll the poll request holds a reference to the file,
+     * so it must be removed even if the file is going to be closed
+     */
+
+    c = ev->data;
+
+    if (event == NGX_READ_EVENT) {
+        e = c->write;
+        events = EPOLLOUT;
+
+    } else {
+        e = c->read;
+        events = NGX_IO_URING_READ;
+    }
+
+    if (ngx_io_uring_poll(c, e->active ? events : 0, 1) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_connection(ngx_connection_t *c)
+{
+    if (ngx_io_uring_poll(c, NGX_IO_URING_READ|EPOLLOUT, 0) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    c->read->active = 1;
+    c->write->active = 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_connection(ngx_connection_t *c, ngx_uint_t flags)
+{
+    if (c->read->active || c->write->active) {
+        if (ngx_io_uring_poll(c, 0, 1) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    c->read->active = 0;
+    c->write->active = 0;
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t inc = 1;
+
+    notify_event.data = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_io_uring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                             n, res;
+    uint32_t                        head, tail, cqe_flags;
+    uint64_t                        data;
+    ngx_err_t                       err;
+    ngx_uint_t                      level, events;
+    ngx_event_t                    *ev;
+    struct io_uring_cqe            *cqe;
+    struct __kernel_timespec        ts;
+    struct io_uring_getevents_arg   arg;
+#if (NGX_HAVE_FILE_AIO)
+    ngx_event_aio_t                *aio;
+#endif
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M, submit: %uD",
+                   timer, sq.local_tail - *sq.head);
+
+    ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+
+    if (timer != NGX_TIMER_INFINITE) {
+        ts.tv_sec = timer / 1000;
+        ts.tv_nsec = (timer % 1000) * 1000000;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+    }
+
+    ngx_memory_barrier();
+
+    *sq.tail = sq.local_tail;
+
+    n = io_uring_enter(ring, sq.local_tail - *sq.head, timer ? 1 : 0,
+                       IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+                       &arg, sizeof(struct io_uring_getevents_arg));
+
+    err = (n == -1) ? ngx_errno : 0;
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    if (err) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else if (err == ETIME || err == NGX_EBUSY || err == NGX_EAGAIN) {
+
+            /*
+             * ETIME is the timeout, EBUSY and EAGAIN are returned
+             * while the completions overflowed the queue or the kernel
+             * is short of memory, the completions are reaped anyway
+             */
+
+            level = 0;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        if (level) {
+            ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    head = *cq.head;
+
+    ngx_memory_barrier();
+
+    tail = *cq.tail;
+
+    ngx_memory_barrier();
+
+    if (head == tail) {
+        if (timer != NGX_TIMER_INFINITE || err) {
+            return NGX_OK;
+        }
+
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
+                      "io_uring_enter() returned no events without timeout");
+        return NGX_ERROR;
+    }
+
+    for (events = 0; head != tail; head++, events++) {
+        cqe = &cq.cqes[head & cq.mask];
+
+        data = cqe->user_data;
+        res = cqe->res;
+        cqe_flags = cqe->flags;
+
+        /*
+         * the entry is released before the handlers are called,
+         * as they may submit new requests
+         */
+
+        ngx_memory_barrier();
+
+        *cq.head = head + 1;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: data:%XL res:%d flags:%uD",
+                       data, res, cqe_flags);
+
+        if (data == 0) {
+
+            /* a poll update or remove, the request may be already gone */
+
+            if (res < 0 && res != -ENOENT && res != -EALREADY) {
+                ngx_log_error(NGX_LOG_ALERT, cycle->log, -res,
+                              "io_uring poll update failed");
+            }
+
+            continue;
+        }
+
+        if (data & NGX_IO_URING_EVENT) {
+            ev = (ngx_event_t *) (uintptr_t) (data & ~NGX_IO_URING_EVENT);
+
+#if (NGX_HAVE_EVENTFD)
+            if (ev == &notify_event) {
+                ngx_io_uring_notify_handler(ev, res);
+                continue;
+            }
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+            ev->complete = 1;
+            ev->active = 0;
+            ev->ready = 1;
+
+            aio = ev->data;
+            aio->res = res;
+
+            ngx_post_event(ev, &ngx_posted_events);
+#endif
+
+            continue;
+        }
+
+        ngx_io_uring_process_poll(cycle, data, res, cqe_flags, flags);
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring events: %ui", events);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_process_poll(ngx_cycle_t *cycle, uint64_t data, int res,
+    uint32_t cqe_flags, ngx_uint_t flags)
+{
+    uint32_t           revents, events;
+    ngx_int_t          instance;
+    ngx_event_t       *rev, *wev;
+    ngx_queue_t       *queue;
+    ngx_connection_t  *c;
+
+    if (res == -ECANCELED) {
+
+        /* the removed request, the connection may be already reused */
+
+        return;
+    }
+
+    c = (ngx_connection_t *) (uintptr_t) data;
+
+    instance = (uintptr_t) c & 1;
+    c = (ngx_connection_t *) ((uintptr_t) c & (uintptr_t) ~1);
+
+    rev = c->read;
+
+    if (c->fd == -1 || rev->instance != instance) {
+
+        /*
+         * the stale event from a file descriptor
+         * that was just closed in this iteration
+         */
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: stale event %p", c);
+        return;
+    }
+
+    if (res < 0) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, -res,
+                      "io_uring poll on fd:%d failed", c->fd);
+
+        revents = EPOLLERR;
+
+    } else {
+        revents = (uint32_t) res;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring: fd:%d ev:%04XD", c->fd, revents);
+
+    if (revents & (EPOLLERR|EPOLLHUP)) {
+
+        /*
+         * if the error events were returned, add EPOLLIN and EPOLLOUT
+         * to handle the events at least in one active handler
+         */
+
+        revents |= EPOLLIN|EPOLLOUT;
+    }
+
+    if ((revents & EPOLLIN) && rev->active) {
+
+#if (NGX_HAVE_EPOLLRDHUP)
+        if (revents & EPOLLRDHUP) {
+            rev->pending_eof = 1;
+        }
+#endif
+
+        rev->ready = 1;
+        rev->available = -1;
+
+        if (flags & NGX_POST_EVENTS) {
+            queue = rev->accept ? &ngx_posted_accept_events
+                                : &ngx_posted_events;
+
+            ngx_post_event(rev, queue);
+
+        } else {
+            rev->handler(rev);
+        }
+    }
+
+    wev = c->write;
+
+    if ((revents & EPOLLOUT) && wev->active) {
+
+        if (c->fd == -1 || wev->instance != instance) {
+
+            /*
+             * the stale event from a file descriptor
+             * that was just closed in this iteration
+             */
+
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: stale event %p", c);
+            return;
+        }
+
+        wev->ready = 1;
+#if (NGX_THREADS)
+        wev->complete = 1;
+#endif
+
+        if (flags & NGX_POST_EVENTS) {
+            ngx_post_event(wev, &ngx_posted_events);
+
+        } else {
+            wev->handler(wev);
+        }
+    }
+
+    /*
+     * a one shot request is finished after the completion,
+     * and a multishot one may be terminated by the kernel,
+     * for example, on the completion queue overflow
+     */
+
+    if ((cqe_flags & IORING_CQE_F_MORE)
+        || res < 0
+        || c->fd == -1
+        || rev->instance != instance)
+    {
+        return;
+    }
+
+    events = (rev->active ? NGX_IO_URING_READ : 0)
+             | (wev->active ? EPOLLOUT : 0);
+
+    if (events) {
+        (void) ngx_io_uring_poll(c, events, 0);
+    }
+}
+
+
+#if (NGX_HAVE_FILE_AIO)
+
+ngx_int_t
+ngx_io_uring_aio_read(ngx_event_aio_t *aio, u_char *buf, size_t size,
+    off_t offset)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(aio->event.log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = aio->fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = (uint32_t) size;
+    sqe->off = (uint64_t) offset;
+    sqe->user_data = (uint64_t) ((uintptr_t) &aio->event
+                                 | NGX_IO_URING_EVENT);
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static void *
+ngx_io_uring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_palloc(cycle->pool, sizeof(ngx_io_uring_conf_t));
+    if (urcf == NULL) {
+        return NULL;
+    }
+
+    urcf->entries = NGX_CONF_UNSET;
+
+    return urcf;
+}
+
+
+static char *
+ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_io_uring_conf_t *urcf = conf;
+
+    ngx_conf_init_uint_value(urcf->entries, 1024);
+
+    return NGX_CONF_OK;
+}
@@ -187,6 +187,12 @@ extern ngx_event_actions_t   ngx_event_actions;
 #if (NGX_HAVE_EPOLLRDHUP)
 extern ngx_uint_t            ngx_use_epoll_rdhup;
 #endif
+#if (NGX_HAVE_IO_URING && NGX_HAVE_FILE_AIO)
+extern ngx_uint_t            ngx_io_uring_aio;
+
+ngx_int_t ngx_io_uring_aio_read(ngx_event_aio_t *aio, u_char *buf, size_t size,
+    off_t offset);
+#endif
 
 
 /*
@@ -435,6 +441,8 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
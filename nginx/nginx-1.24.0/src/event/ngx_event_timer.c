@@ -10,8 +10,53 @@
 #include <ngx_event.h>
 
 
-ngx_rbtree_t              ngx_event_timer_rbtree;
-static ngx_rbtree_node_t  ngx_event_timer_sentinel;
+#define NGX_TIMER_WHEEL_BITS    6
+#define NGX_TIMER_WHEEL_SLOTS   (1 << NGX_TIMER_WHEEL_BITS)
+#define NGX_TIMER_WHEEL_MASK    (NGX_TIMER_WHEEL_SLOTS - 1)
+#define NGX_TIMER_WHEEL_LEVELS  6
+
+#if (NGX_PTR_SIZE == 8)
+#define NGX_TIMER_WHEEL_MAX                                                    \
+    (((ngx_msec_t) 1 << (NGX_TIMER_WHEEL_BITS * NGX_TIMER_WHEEL_LEVELS)) - 1)
+#endif
+
+
+/*
+ * A hierarchical timing wheel: level 0 has a slot per millisecond,
+ * each next level has slots 64 times longer, 6 levels cover 2^36 ms.
+ * A timer is placed at the lowest level its distance from "now" fits in,
+ * into the slot indexed by the corresponding bits of its key.  When "now"
+ * crosses a slot boundary of a level, the timers of the slot are moved
+ * to the lower levels, so timers expire exactly at their keys.
+ *
+ * Slots are circular lists linked through the left and right pointers
+ * of the timer rbtree node, its parent points to the slot head.
+ */
+
+typedef struct {
+    ngx_msec_t                now;
+    ngx_uint_t                count;
+    uint64_t                  used[NGX_TIMER_WHEEL_LEVELS];
+    ngx_rbtree_node_t         slots[NGX_TIMER_WHEEL_LEVELS]
+                                   [NGX_TIMER_WHEEL_SLOTS];
+} ngx_event_timer_wheel_t;
+
+
+static void ngx_event_timer_wheel_init(void);
+static void ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node);
+static void ngx_event_timer_wheel_unlink(ngx_rbtree_node_t *node);
+static ngx_msec_t ngx_event_timer_wheel_next(void);
+static void ngx_event_timer_wheel_cascade(void);
+static void ngx_event_timer_wheel_expire(void);
+static ngx_int_t ngx_event_timer_wheel_left(void);
+static ngx_uint_t ngx_event_timer_wheel_ffs(uint64_t bits, ngx_uint_t from);
+
+
+ngx_rbtree_t                    ngx_event_timer_rbtree;
+static ngx_rbtree_node_t        ngx_event_timer_sentinel;
+
+ngx_uint_t                      ngx_event_timer_use_wheel;
+static ngx_event_timer_wheel_t  ngx_event_timer_wheel;
 
 /*
  * the event timer rbtree may contain the duplicate keys, however,
@@ -22,6 +67,10 @@ static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 ngx_int_t
 ngx_event_timer_init(ngx_log_t *log)
 {
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_init();
+    }
+
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
@@ -35,6 +84,18 @@ ngx_event_find_timer(void)
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_use_wheel) {
+
+        if (ngx_event_timer_wheel.count == 0) {
+            return NGX_TIMER_INFINITE;
+        }
+
+        timer = (ngx_msec_int_t)
+                    (ngx_event_timer_wheel_next() - ngx_current_msec);
+
+        return (ngx_msec_t) (timer > 0 ? timer : 0);
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -56,6 +117,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_expire();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -102,6 +168,10 @@ ngx_event_no_timers_left(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_use_wheel) {
+        return ngx_event_timer_wheel_left();
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
     root = ngx_event_timer_rbtree.root;
 
@@ -124,3 +194,327 @@ ngx_event_no_timers_left(void)
 
     return NGX_OK;
 }
+
+
+static void
+ngx_event_timer_wheel_init(void)
+{
+    ngx_uint_t                level, n;
+    ngx_rbtree_node_t        *slot;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    for (level = 0; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+        for (n = 0; n < NGX_TIMER_WHEEL_SLOTS; n++) {
+            slot = &w->slots[level][n];
+            slot->left = slot;
+            slot->right = slot;
+        }
+
+        w->used[level] = 0;
+    }
+
+    w->count = 0;
+    w->now = ngx_current_msec;
+}
+
+
+void
+ngx_event_timer_wheel_add(ngx_event_t *ev)
+{
+    ngx_event_timer_wheel_insert(&ev->timer);
+    ngx_event_timer_wheel.count++;
+}
+
+
+void
+ngx_event_timer_wheel_del(ngx_event_t *ev)
+{
+    ngx_event_timer_wheel_unlink(&ev->timer);
+    ngx_event_timer_wheel.count--;
+}
+
+
+static void
+ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t                level, n;
+    ngx_msec_t                key, delta;
+    ngx_rbtree_node_t        *slot;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    key = node->key;
+    delta = key - w->now;
+
+    if ((ngx_msec_int_t) delta < 0) {
+
+        /* already expired, it goes to the current slot */
+
+        key = w->now;
+        delta = 0;
+    }
+
+#if (NGX_PTR_SIZE == 8)
+
+    if (delta > NGX_TIMER_WHEEL_MAX) {
+
+        /* the timer is moved down again when the slot is reached */
+
+        key = w->now + NGX_TIMER_WHEEL_MAX;
+        delta = NGX_TIMER_WHEEL_MAX;
+    }
+
+#endif
+
+    for (level = 0; level < NGX_TIMER_WHEEL_LEVELS - 1; level++) {
+        if ((delta >> (NGX_TIMER_WHEEL_BITS * (level + 1))) == 0) {
+            break;
+        }
+    }
+
+    n = (key >> (NGX_TIMER_WHEEL_BITS * level)) & NGX_TIMER_WHEEL_MASK;
+    slot = &w->slots[level][n];
+
+    node->parent = slot;
+    node->right = slot;
+    node->left = slot->left;
+    slot->left->right = node;
+    slot->left = node;
+
+    w->used[level] |= (uint64_t) 1 << n;
+}
+
+
+static void
+ngx_event_timer_wheel_unlink(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t                n;
+    ngx_rbtree_node_t        *slot;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    slot = node->parent;
+
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    if (slot->right == slot) {
+        n = slot - &w->slots[0][0];
+        w->used[n / NGX_TIMER_WHEEL_SLOTS] &=
+                               ~((uint64_t) 1 << (n % NGX_TIMER_WHEEL_SLOTS));
+    }
+}
+
+
+/*
+ * The time of the nearest level 0 slot with timers, or of the nearest
+ * boundary of an upper level slot with timers, whichever is earlier.
+ * It is never later than the nearest timer.
+ */
+
+static ngx_msec_t
+ngx_event_timer_wheel_next(void)
+{
+    ngx_uint_t                level, shift, n;
+    ngx_msec_t                next, time;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    next = w->now + NGX_TIMER_INFINITE / 2;
+
+    if (w->used[0]) {
+        n = ngx_event_timer_wheel_ffs(w->used[0],
+                                      w->now & NGX_TIMER_WHEEL_MASK);
+        next = w->now + n;
+    }
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        if (w->used[level] == 0) {
+            continue;
+        }
+
+        /* the current slot of a level was already moved down */
+
+        shift = NGX_TIMER_WHEEL_BITS * level;
+
+        n = ngx_event_timer_wheel_ffs(w->used[level],
+                                      ((w->now >> shift) + 1)
+                                      & NGX_TIMER_WHEEL_MASK);
+
+        time = ((w->now >> shift) + 1 + n) << shift;
+
+        if ((ngx_msec_int_t) (time - next) < 0) {
+            next = time;
+        }
+    }
+
+    return next;
+}
+
+
+static void
+ngx_event_timer_wheel_cascade(void)
+{
+    ngx_uint_t                level, shift, n;
+    ngx_rbtree_node_t        *node, *slot, list;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+        shift = NGX_TIMER_WHEEL_BITS * level;
+
+        if (w->now & (((ngx_msec_t) 1 << shift) - 1)) {
+            return;
+        }
+
+        n = (w->now >> shift) & NGX_TIMER_WHEEL_MASK;
+
+        if ((w->used[level] & ((uint64_t) 1 << n)) == 0) {
+            continue;
+        }
+
+        slot = &w->slots[level][n];
+
+        list.left = slot->left;
+        list.right = slot->right;
+        list.left->right = &list;
+        list.right->left = &list;
+
+        slot->left = slot;
+        slot->right = slot;
+        w->used[level] &= ~((uint64_t) 1 << n);
+
+        while (list.right != &list) {
+            node = list.right;
+
+            node->left->right = node->right;
+            node->right->left = node->left;
+
+            ngx_event_timer_wheel_insert(node);
+        }
+    }
+}
+
+
+static void
+ngx_event_timer_wheel_expire(void)
+{
+    ngx_msec_t                next;
+    ngx_event_t              *ev;
+    ngx_rbtree_node_t        *node, *slot;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    for ( ;; ) {
+
+        /* timers added by the handlers with past keys go to the same slot */
+
+        slot = &w->slots[0][w->now & NGX_TIMER_WHEEL_MASK];
+
+        while (slot->right != slot) {
+            node = slot->right;
+
+            ev = ngx_rbtree_data(node, ngx_event_t, timer);
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %M",
+                           ngx_event_ident(ev->data), ev->timer.key);
+
+            ngx_event_timer_wheel_del(ev);
+
+#if (NGX_DEBUG)
+            ev->timer.left = NULL;
+            ev->timer.right = NULL;
+            ev->timer.parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+            ev->timedout = 1;
+
+            ev->handler(ev);
+        }
+
+        if ((ngx_msec_int_t) (ngx_current_msec - w->now) <= 0) {
+            return;
+        }
+
+        /* skip the time with no timers to expire or to move down */
+
+        if (w->count) {
+            next = ngx_event_timer_wheel_next();
+
+            if ((ngx_msec_int_t) (next - ngx_current_msec) > 0) {
+                next = ngx_current_msec;
+            }
+
+        } else {
+            next = ngx_current_msec;
+        }
+
+        w->now = next;
+
+        ngx_event_timer_wheel_cascade();
+    }
+}
+
+
+static ngx_int_t
+ngx_event_timer_wheel_left(void)
+{
+    ngx_uint_t                level, n;
+    ngx_event_t              *ev;
+    ngx_rbtree_node_t        *node, *slot;
+    ngx_event_timer_wheel_t  *w;
+
+    w = &ngx_event_timer_wheel;
+
+    for (level = 0; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+        for (n = 0; n < NGX_TIMER_WHEEL_SLOTS; n++) {
+            slot = &w->slots[level][n];
+
+            for (node = slot->right; node != slot; node = node->right) {
+                ev = ngx_rbtree_data(node, ngx_event_t, timer);
+
+                if (!ev->cancelable) {
+                    return NGX_AGAIN;
+                }
+            }
+        }
+    }
+
+    /* only cancelable timers left */
+
+    return NGX_OK;
+}
+
+
+/* the distance from the "from" bit to the next set bit, circularly */
+
+static ngx_uint_t
+ngx_event_timer_wheel_ffs(uint64_t bits, ngx_uint_t from)
+{
+    ngx_uint_t  n;
+
+    if (from) {
+        bits = (bits >> from) | (bits << (NGX_TIMER_WHEEL_SLOTS - from));
+    }
+
+#if (NGX_HAVE_GCC_CTZLL)
+    n = __builtin_ctzll(bits);
+#else
+    for (n = 0; (bits & 1) == 0; n++) {
+        bits >>= 1;
+    }
+#endif
+
+    return n;
+}
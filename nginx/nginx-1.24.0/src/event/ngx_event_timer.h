@@ -24,8 +24,12 @@ ngx_msec_t ngx_event_find_timer(void);
 void ngx_event_expire_timers(void);
 ngx_int_t ngx_event_no_timers_left(void);
 
+void ngx_event_timer_wheel_add(ngx_event_t *ev);
+void ngx_event_timer_wheel_del(ngx_event_t *ev);
+
 
 extern ngx_rbtree_t  ngx_event_timer_rbtree;
+extern ngx_uint_t    ngx_event_timer_use_wheel;
 
 
 static ngx_inline void
@@ -35,7 +39,12 @@ ngx_event_del_timer(ngx_event_t *ev)
                    "event timer del: %d: %M",
                     ngx_event_ident(ev->data), ev->timer.key);
 
-    ngx_rbtree_delete(&ngx_event_timer_rbtree, &ev->timer);
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_del(ev);
+
+    } else {
+        ngx_rbtree_delete(&ngx_event_timer_rbtree, &ev->timer);
+    }
 
 #if (NGX_DEBUG)
     ev->timer.left = NULL;
@@ -60,7 +69,7 @@ ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
         /*
          * Use a previous timer value if difference between it and a new
          * value is less than NGX_TIMER_LAZY_DELAY milliseconds: this allows
-         * to minimize the rbtree operations for fast connections.
+         * to minimize the timer operations for fast connections.
          */
 
         diff = (ngx_msec_int_t) (key - ev->timer.key);
@@ -81,7 +90,12 @@ ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
                    "event timer add: %d: %M:%M",
                     ngx_event_ident(ev->data), timer, ev->timer.key);
 
-    ngx_rbtree_insert(&ngx_event_timer_rbtree, &ev->timer);
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_add(ev);
+
+    } else {
+        ngx_rbtree_insert(&ngx_event_timer_rbtree, &ev->timer);
+    }
 
     ev->timer_set = 1;
 }
@@ -103,6 +103,8 @@ static ngx_int_t ngx_http_variable_request_length(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_request_time(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_variable_request_pool(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_request_id(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_status(ngx_http_request_t *r,
@@ -302,6 +304,12 @@ static ngx_http_variable_t  ngx_http_core_variables[] = {
     { ngx_string("request_time"), NULL, ngx_http_variable_request_time,
       0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
 
+    { ngx_string("request_pool_blocks"), NULL, ngx_http_variable_request_pool,
+      0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_pool_large"), NULL, ngx_http_variable_request_pool,
+      1, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
     { ngx_string("request_id"), NULL,
       ngx_http_variable_request_id,
       0, 0, 0 },
@@ -2237,6 +2245,39 @@ ngx_http_variable_request_time(ngx_http_request_t *r,
 }
 
 
+static ngx_int_t
+ngx_http_variable_request_pool(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    u_char      *p;
+    size_t       large;
+    ngx_uint_t   blocks;
+
+    /* the growth of the pool before the variable's own allocation */
+
+    ngx_pool_usage(r->pool, &blocks, &large);
+
+    p = ngx_pnalloc(r->pool, NGX_INT_T_LEN);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (data) {
+        v->len = ngx_sprintf(p, "%uz", large) - p;
+
+    } else {
+        v->len = ngx_sprintf(p, "%ui", blocks) - p;
+    }
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_variable_request_id(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
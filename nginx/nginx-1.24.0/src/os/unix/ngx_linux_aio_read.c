@@ -93,6 +93,30 @@ ngx_file_aio_read(ngx_file_t *file, u_char *buf, size_t size, off_t offset,
         return NGX_ERROR;
     }
 
+    ev->handler = ngx_file_aio_event_handler;
+
+#if (NGX_HAVE_IO_URING)
+
+    /*
+     * io_uring reads are asynchronous without directio,
+     * the completion is reaped by ngx_io_uring_process_events()
+     */
+
+    if (ngx_io_uring_aio) {
+
+        if (ngx_io_uring_aio_read(aio, buf, size, offset) == NGX_OK) {
+            ev->active = 1;
+            ev->ready = 0;
+            ev->complete = 0;
+
+            return NGX_AGAIN;
+        }
+
+        return ngx_read_file(file, buf, size, offset);
+    }
+
+#endif
+
     ngx_memzero(&aio->aiocb, sizeof(struct iocb));
 
     aio->aiocb.aio_data = (uint64_t) (uintptr_t) ev;
@@ -104,8 +128,6 @@ ngx_file_aio_read(ngx_file_t *file, u_char *buf, size_t size, off_t offset,
     aio->aiocb.aio_flags = IOCB_FLAG_RESFD;
     aio->aiocb.aio_resfd = ngx_eventfd;
 
-    ev->handler = ngx_file_aio_event_handler;
-
     piocb[0] = &aio->aiocb;
 
     if (io_submit(ngx_aio_ctx, 1, piocb) == 1) {